@@ -0,0 +1,86 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Host build implementations of the parts of CGX which need actual hardware.
+// There's no GPU on the host, so commands are only recorded, and everything
+// which has been recorded counts as processed immediately.
+
+#include "cgx.h"
+#include "cgx_fake.h"
+
+static CGXRecordingPipe host_pipe(0x100000);
+CGXRecordingPipe* const wgPipe = &host_pipe;
+
+static u16 last_fence = 0;
+static CGXShadowState* display_list_saved_shadow;
+
+GXFifoObj* GX_Init(void* base, u32 size)
+{
+	static GXFifoObj fifo;
+	return &fifo;
+}
+
+void CGX_WaitForGpuToFinish()
+{
+	CGX_LOAD_BP_REG(0x45000002); // draw done
+	CGX_ForcePipelineFlush();
+
+	// Drop whatever has been recorded so far, so that the recording doesn't
+	// run out of space
+	host_pipe.Clear();
+}
+
+// Nothing gets rasterized, so the bounding box always stays empty
+void CGX_ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom)
+{
+	*left = *top = 0x3FF;
+	*right = *bottom = 0;
+}
+
+void CGX_ClearPerfCounters()
+{
+	CGX_LOAD_BP_REG(BPMEM_CLEAR_PIXEL_PERF << 24);
+	CGX_LOAD_BP_REG((BPMEM_CLEAR_PIXEL_PERF << 24) | 0xAAA);
+}
+
+// No pixels are drawn, hence all counters stay at zero
+CGXPerfCounters CGX_ReadPerfCounters()
+{
+	const u16 cp_regs[2] = { 0, 0 };
+	const u16 pe_regs[12] = { 0 };
+	return CGX_DecodePerfCounters(cp_regs, pe_regs);
+}
+
+CGXFence CGX_InsertFence()
+{
+	CGXFence fence = ++last_fence;
+
+	CGX_LOAD_BP_REG((BPMEM_PE_TOKEN_INT_ID << 24) | fence);
+	CGX_LOAD_BP_REG((BPMEM_PE_TOKEN_ID << 24) | fence);
+	CGX_ForcePipelineFlush();
+
+	return fence;
+}
+
+bool CGX_IsFenceReached(CGXFence fence)
+{
+	return (s16)(last_fence - fence) >= 0;
+}
+
+void CGX_WaitForFence(CGXFence fence)
+{
+}
+
+void CGX_BeginDisplayList(void* buffer, u32 size)
+{
+	display_list_saved_shadow = CGX_SetShadowState(NULL);
+	host_pipe.BeginDisplayList(buffer, size);
+}
+
+u32 CGX_EndDisplayList()
+{
+	u32 size = host_pipe.EndDisplayList();
+	CGX_SetShadowState(display_list_saved_shadow);
+	return size;
+}
@@ -0,0 +1,18 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <string.h>
+
+#include <ogc/system.h>
+#include <ogc/cache.h>
+#include <ogc/gx.h>
+#include <ogc/video.h>
+
+static inline void guMtxIdentity(Mtx mt)
+{
+	memset(mt, 0, sizeof(Mtx));
+	mt[0][0] = mt[1][1] = mt[2][2] = 1.0f;
+}
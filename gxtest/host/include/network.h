@@ -0,0 +1,24 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Maps libogc's network functions to POSIX sockets
+
+#pragma once
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+static inline int net_init() { return 0; }
+
+static inline int net_socket(int domain, int type, int protocol) { return socket(domain, type, protocol); }
+static inline int net_setsockopt(int s, int level, int optname, const void* optval, socklen_t optlen) { return setsockopt(s, level, optname, optval, optlen); }
+static inline int net_bind(int s, struct sockaddr* name, socklen_t namelen) { return bind(s, name, namelen); }
+static inline int net_listen(int s, int backlog) { return listen(s, backlog); }
+static inline int net_accept(int s, struct sockaddr* addr, socklen_t* addrlen) { return accept(s, addr, addrlen); }
+static inline int net_send(int s, const void* data, int size, int flags) { return send(s, data, size, flags | MSG_NOSIGNAL); }
+static inline int net_recv(int s, void* mem, int len, int flags) { return recv(s, mem, len, flags); }
+static inline int net_close(int s) { return close(s); }
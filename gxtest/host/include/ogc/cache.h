@@ -0,0 +1,11 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+// The host doesn't share memory with a GPU, so there's nothing to synchronize
+static inline void DCFlushRange(void* startaddress, u32 len) {}
+static inline void DCInvalidateRange(void* startaddress, u32 len) {}
@@ -0,0 +1,116 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Host build stand-in for libogc's GX
+// Provides just enough for compiling gxtest natively. All GPU commands end up
+// in a CGXRecordingPipe, and the remaining GX functions don't do anything.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CommonTypes.h"
+#include "cgx_fake.h"
+
+typedef float f32;
+typedef volatile u8 vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+
+#define GX_FALSE 0
+#define GX_TRUE 1
+
+#define GX_TF_I4 0x0
+#define GX_TF_I8 0x1
+#define GX_TF_IA4 0x2
+#define GX_TF_IA8 0x3
+#define GX_TF_RGB565 0x4
+#define GX_TF_RGB5A3 0x5
+#define GX_TF_RGBA8 0x6
+#define GX_TF_Z8 0x11
+#define GX_TF_Z16 0x13
+#define GX_TF_Z24X8 0x16
+
+#define GX_CTF_R4 0x20
+#define GX_CTF_RA4 0x22
+#define GX_CTF_RA8 0x23
+#define GX_CTF_A8 0x27
+#define GX_CTF_R8 0x28
+#define GX_CTF_G8 0x29
+#define GX_CTF_B8 0x2A
+#define GX_CTF_RG8 0x2B
+#define GX_CTF_GB8 0x2C
+#define GX_CTF_Z4 0x30
+#define GX_CTF_Z8M 0x39
+#define GX_CTF_Z8L 0x3A
+#define GX_CTF_Z16L 0x3C
+
+#define GX_PNMTX0 0
+#define GX_VTXFMT0 0
+#define GX_TEVSTAGE0 0
+#define GX_TEXCOORDNULL 0xff
+#define GX_TEXMAP_NULL 0xff
+#define GX_COLOR0A0 4
+#define GX_PASSCLR 4
+#define GX_QUADS 0x80
+#define GX_DIRECT 1
+#define GX_VA_POS 9
+#define GX_VA_CLR0 11
+#define GX_POS_XYZ 1
+#define GX_CLR_RGBA 1
+#define GX_F32 4
+#define GX_RGBA8 5
+#define GX_GM_1_0 0
+
+typedef f32 Mtx[3][4];
+typedef f32 Mtx44[4][4];
+
+struct GXColor
+{
+	u8 r, g, b, a;
+};
+
+struct GXFifoObj
+{
+	u8 pad[128];
+};
+
+// Defined in host/cgx_host.cpp
+extern CGXRecordingPipe* const wgPipe;
+
+extern "C"
+{
+GXFifoObj* GX_Init(void* base, u32 size);
+}
+
+static inline void GX_SetCopyClear(GXColor color, u32 zvalue) {}
+static inline void GX_SetViewport(f32 xorig, f32 yorig, f32 wd, f32 ht, f32 nearz, f32 farz) {}
+static inline void GX_SetScissor(u32 xorigin, u32 yorigin, u32 wd, u32 ht) {}
+static inline void GX_SetTexCopySrc(u16 left, u16 top, u16 wd, u16 ht) {}
+static inline void GX_SetTexCopyDst(u16 wd, u16 ht, u32 fmt, u8 mipmap) {}
+static inline void GX_SetDispCopySrc(u16 left, u16 top, u16 wd, u16 ht) {}
+static inline u32 GX_SetDispCopyDst(u16 wd, u16 ht) { return 0; }
+static inline void GX_CopyDisp(void* dest, u8 clear) {}
+static inline void GX_ClearVtxDesc() {}
+static inline void GX_SetVtxDesc(u8 attr, u8 type) {}
+static inline void GX_SetVtxAttrFmt(u8 vtxfmt, u32 vtxattr, u32 comptype, u32 compsize, u32 frac) {}
+static inline void GX_LoadPosMtxImm(Mtx mt, u32 pnidx) {}
+static inline void GX_LoadProjectionMtx(Mtx44 mt, u8 type) {}
+static inline void GX_SetNumChans(u8 num) {}
+static inline void GX_SetNumTexGens(u32 nr) {}
+static inline void GX_SetTevOrder(u8 tevstage, u8 texcoord, u32 texmap, u8 color) {}
+static inline void GX_SetTevOp(u8 tevstage, u8 mode) {}
+static inline void GX_Begin(u8 primitve, u8 vtxfmt, u16 vtxcnt) {}
+static inline void GX_End() {}
+static inline void GX_Flush() {}
+
+// Only covers the texture formats used by gxtest
+static inline u32 GX_GetTexBufferSize(u16 wd, u16 ht, u32 fmt, u8 mipmap, u8 maxlod)
+{
+	if (fmt == GX_TF_I8)
+		return ((wd + 7) / 8) * ((ht + 3) / 4) * 32;
+
+	return ((wd + 3) / 4) * ((ht + 3) / 4) * 64;
+}
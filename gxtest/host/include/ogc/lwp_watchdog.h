@@ -0,0 +1,27 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <time.h>
+
+#include "CommonTypes.h"
+
+// Time base, in nanoseconds instead of bus clock ticks
+static inline u64 gettime()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static inline u32 diff_usec(u64 start, u64 end)
+{
+	return (u32)((end - start) / 1000);
+}
+
+static inline u64 ticks_to_microsecs(u64 ticks)
+{
+	return ticks / 1000;
+}
@@ -0,0 +1,10 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <stdint.h>
+
+// There's no physical address space on the host, so just keep the lower address bits
+#define MEM_VIRTUAL_TO_PHYSICAL(x) ((u32)(uintptr_t)(x) & ~0xC0000000)
@@ -0,0 +1,8 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+// Debug display output isn't supported on the host
+struct GXRModeObj;
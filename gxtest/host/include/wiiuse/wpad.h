@@ -0,0 +1,14 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+// No controllers on the host, so no button is ever pressed
+#define WPAD_BUTTON_HOME 0x0080
+
+static inline s32 WPAD_Init() { return 0; }
+static inline u32 WPAD_ScanPads() { return 0; }
+static inline u32 WPAD_ButtonsDown(int chan) { return 0; }
@@ -0,0 +1,338 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Receives test results from one or more consoles running gxtest (or from
+// gxtest_host), prints them as text and optionally writes JSON and CSV
+// summaries. All connections are handled by a single epoll loop. Devices
+// which don't accept connections yet are retried until the timeout expires,
+// so that the receiver can be started together with gxtest.
+//
+// Exit status: 0 if all tests passed, 1 if any test failed, 2 if a device
+// couldn't be reached, sent a broken stream or dropped results.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "CommonTypes.h"
+#include "result_protocol.h"
+#include "result_aggregator.h"
+
+#define DEFAULT_PORT 16784
+#define DEFAULT_TIMEOUT_SECONDS 30
+#define RETRY_INTERVAL_US 100000
+
+static u64 GetTime()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+struct Device
+{
+	enum State
+	{
+		STATE_WAITING,    // for the next connection attempt
+		STATE_CONNECTING,
+		STATE_RECEIVING,
+		STATE_DONE,
+	};
+
+	Device(const GXTest::RunSummary& summary) : summary(summary), decoder(*summary.results), fd(-1), state(STATE_WAITING), next_attempt(0), connect_time(0)
+	{
+	}
+
+	GXTest::RunSummary summary;
+	GXTest::ResultDecoder decoder;
+	sockaddr_in addr;
+
+	int fd;
+	State state;
+	u64 next_attempt;
+	u64 connect_time;
+};
+
+static int epoll_fd;
+
+static void Finish(Device& device, const char* error)
+{
+	if (device.fd >= 0)
+	{
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device.fd, NULL);
+		close(device.fd);
+		device.fd = -1;
+	}
+	if (device.summary.connected)
+		device.summary.wall_time = GetTime() - device.connect_time;
+	if (error)
+		device.summary.error = error;
+	device.state = Device::STATE_DONE;
+}
+
+static void Retry(Device& device, u64 now, u64 deadline)
+{
+	close(device.fd);
+	device.fd = -1;
+	if (now + RETRY_INTERVAL_US > deadline)
+	{
+		Finish(device, "Couldn't connect");
+		return;
+	}
+	device.state = Device::STATE_WAITING;
+	device.next_attempt = now + RETRY_INTERVAL_US;
+}
+
+static void Connected(Device& device)
+{
+	device.state = Device::STATE_RECEIVING;
+	device.summary.connected = true;
+	device.connect_time = GetTime();
+
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = &device;
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, device.fd, &event);
+}
+
+static void StartConnecting(Device& device, u64 now, u64 deadline)
+{
+	device.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (device.fd < 0)
+	{
+		Finish(device, strerror(errno));
+		return;
+	}
+
+	// Completion of the connection is signaled by the socket becoming writable
+	epoll_event event;
+	event.events = EPOLLOUT;
+	event.data.ptr = &device;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, device.fd, &event);
+	device.state = Device::STATE_CONNECTING;
+
+	if (connect(device.fd, (sockaddr*)&device.addr, sizeof(device.addr)) == 0)
+		Connected(device);
+	else if (errno != EINPROGRESS)
+	{
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device.fd, NULL);
+		Retry(device, now, deadline);
+	}
+}
+
+// Decodes everything which is available on the socket
+static void Receive(Device& device)
+{
+	// Complete records are decoded directly from this buffer, only records
+	// which are split across reads get copied by the decoder
+	static u8 buffer[256 * 1024];
+
+	while (true)
+	{
+		ssize_t size = recv(device.fd, buffer, sizeof(buffer), 0);
+		if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (size < 0 && errno == EINTR)
+			continue;
+		if (size < 0)
+		{
+			Finish(device, strerror(errno));
+			return;
+		}
+		if (size == 0)
+		{
+			device.summary.complete = device.decoder.IsAtRecordBoundary();
+			Finish(device, device.summary.complete ? NULL : "Connection closed in the middle of a record");
+			return;
+		}
+		if (!device.decoder.Feed(buffer, size))
+		{
+			Finish(device, "Received malformed results");
+			return;
+		}
+	}
+}
+
+static void PrintUsage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [options] <address[:port]>...\n"
+	                "  -j, --json <file>     write a JSON summary\n"
+	                "  -c, --csv <file>      write a CSV summary, one row per test\n"
+	                "  -q, --quiet           don't print the test output\n"
+	                "  -t, --timeout <secs>  give up connecting after this time (default: %d)\n",
+	        name, DEFAULT_TIMEOUT_SECONDS);
+}
+
+static bool WriteSummary(const char* filename, void (*write)(FILE*, const std::vector<GXTest::RunSummary>&), const std::vector<GXTest::RunSummary>& runs)
+{
+	FILE* file = fopen(filename, "w");
+	if (!file)
+	{
+		fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+		return false;
+	}
+	write(file, runs);
+	return fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* json_filename = NULL;
+	const char* csv_filename = NULL;
+	bool quiet = false;
+	int timeout = DEFAULT_TIMEOUT_SECONDS;
+
+	static const option options[] = {
+		{ "json", required_argument, NULL, 'j' },
+		{ "csv", required_argument, NULL, 'c' },
+		{ "quiet", no_argument, NULL, 'q' },
+		{ "timeout", required_argument, NULL, 't' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "j:c:qt:", options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+		case 'j': json_filename = optarg; break;
+		case 'c': csv_filename = optarg; break;
+		case 'q': quiet = true; break;
+		case 't': timeout = atoi(optarg); break;
+		default: PrintUsage(argv[0]); return 2;
+		}
+	}
+	if (optind == argc)
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	// Lines are prefixed with the device name if there's more than one
+	int num_devices = argc - optind;
+	std::vector<Device*> devices;
+	for (int i = optind; i < argc; ++i)
+	{
+		char host[256];
+		int port = DEFAULT_PORT;
+		snprintf(host, sizeof(host), "%s", argv[i]);
+		char* colon = strchr(host, ':');
+		if (colon)
+		{
+			*colon = 0;
+			port = atoi(colon + 1);
+		}
+
+		char name[300];
+		snprintf(name, sizeof(name), "%s:%d", host, port);
+
+		GXTest::RunSummary summary;
+		summary.device = name;
+		summary.connected = false;
+		summary.complete = false;
+		summary.wall_time = 0;
+		summary.results = new GXTest::ResultAggregator(quiet ? NULL : stdout, (num_devices > 1) ? "[" + summary.device + "] " : "");
+
+		Device* device = new Device(summary);
+		device->addr.sin_family = AF_INET;
+		device->addr.sin_port = htons(port);
+		if (inet_pton(AF_INET, host, &device->addr.sin_addr) != 1)
+		{
+			fprintf(stderr, "Invalid address %s\n", host);
+			return 2;
+		}
+		devices.push_back(device);
+	}
+
+	epoll_fd = epoll_create1(0);
+	const u64 deadline = GetTime() + (u64)timeout * 1000000;
+	while (true)
+	{
+		u64 now = GetTime();
+		u64 next_attempt = 0;
+		bool done = true;
+		for (size_t i = 0; i < devices.size(); ++i)
+		{
+			Device& device = *devices[i];
+			if (device.state == Device::STATE_WAITING && device.next_attempt <= now)
+				StartConnecting(device, now, deadline);
+			if (device.state == Device::STATE_WAITING && (next_attempt == 0 || device.next_attempt < next_attempt))
+				next_attempt = device.next_attempt;
+			done &= (device.state == Device::STATE_DONE);
+		}
+		if (done)
+			break;
+
+		epoll_event events[64];
+		int wait_ms = next_attempt ? (int)((next_attempt - now + 999) / 1000) : -1;
+		int num_events = epoll_wait(epoll_fd, events, 64, wait_ms);
+		if (num_events < 0 && errno != EINTR)
+		{
+			perror("epoll_wait");
+			return 2;
+		}
+
+		now = GetTime();
+		for (int i = 0; i < num_events; ++i)
+		{
+			Device& device = *(Device*)events[i].data.ptr;
+			if (device.state == Device::STATE_CONNECTING)
+			{
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(device.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+				if (error == 0)
+				{
+					Connected(device);
+				}
+				else
+				{
+					epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device.fd, NULL);
+					Retry(device, now, deadline);
+				}
+			}
+			else if (device.state == Device::STATE_RECEIVING)
+			{
+				Receive(device);
+				if (!quiet)
+					fflush(stdout);
+			}
+		}
+	}
+	close(epoll_fd);
+
+	std::vector<GXTest::RunSummary> runs;
+	int status = 0;
+	for (size_t i = 0; i < devices.size(); ++i)
+	{
+		const GXTest::RunSummary& run = devices[i]->summary;
+		if (!run.error.empty())
+			fprintf(stderr, "%s: %s\n", run.device.c_str(), run.error.c_str());
+		if (!run.complete || run.results->GetNumDroppedBytes())
+			status = 2;
+		else if (run.results->GetNumFailedTests() && status == 0)
+			status = 1;
+		runs.push_back(run);
+	}
+
+	if (json_filename && !WriteSummary(json_filename, GXTest::WriteJsonSummary, runs))
+		status = 2;
+	if (csv_filename && !WriteSummary(csv_filename, GXTest::WriteCsvSummary, runs))
+		status = 2;
+
+	for (size_t i = 0; i < devices.size(); ++i)
+	{
+		delete devices[i]->summary.results;
+		delete devices[i];
+	}
+	return status;
+}
@@ -0,0 +1,370 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <stdarg.h>
+#include <string.h>
+#include <map>
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "tev_sweep.h"
+#include "result_aggregator.h"
+
+namespace GXTest
+{
+
+ResultAggregator::ResultAggregator(FILE* output, const std::string& prefix)
+	: output(output), prefix(prefix), at_line_start(true), version(0), num_dropped_bytes(0)
+{
+}
+
+void ResultAggregator::Print(const char* format, ...)
+{
+	if (!output)
+		return;
+
+	char text[8192];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	// Messages don't necessarily consist of whole lines
+	for (const char* p = text; *p; )
+	{
+		if (at_line_start)
+			fputs(prefix.c_str(), output);
+		const char* line_end = strchr(p, '\n');
+		size_t length = line_end ? line_end + 1 - p : strlen(p);
+		fwrite(p, 1, length, output);
+		at_line_start = (line_end != NULL);
+		p += length;
+	}
+}
+
+TestResult* ResultAggregator::GetCurrentTest()
+{
+	if (tests.empty() || tests.back().finished)
+		return NULL;
+	return &tests.back();
+}
+
+void ResultAggregator::OnHello(int version)
+{
+	this->version = version;
+}
+
+void ResultAggregator::OnTestStart(int test_number, const char* file, int line, u64 time)
+{
+	TestResult test;
+	test.test_number = test_number;
+	test.file = file ? file : "";
+	test.line = line;
+	test.num_subtests = 0;
+	test.num_failures = 0;
+	test.num_passed = 0;
+	test.start_time = time;
+	test.end_time = time;
+	test.finished = false;
+	tests.push_back(test);
+}
+
+void ResultAggregator::OnPassed(u32 count)
+{
+	TestResult* test = GetCurrentTest();
+	if (test)
+		test->num_passed += count;
+}
+
+void ResultAggregator::OnFailed(int subtest, const char* file, int line, const char* message)
+{
+	Print("Subtest %d failed in %s on line %d: %s\n", subtest, file ? file : "(unknown)", line, message);
+
+	TestResult* test = GetCurrentTest();
+	if (!test)
+		return;
+
+	SubtestFailure failure;
+	failure.subtest = subtest;
+	failure.file = file ? file : "";
+	failure.line = line;
+	failure.message = message;
+	test->failures.push_back(failure);
+}
+
+void ResultAggregator::OnMessage(const char* message)
+{
+	Print("%s", message);
+}
+
+void ResultAggregator::OnProgress(u32 current, u32 total)
+{
+	Print("progress: %u/%u\n", current, total);
+}
+
+// Number of failing samples per sweep record which get printed
+#define MAX_PRINTED_SWEEP_FAILURES 16
+
+// Number of failing samples per sweep which get described in the JSON summary
+#define MAX_DESCRIBED_SWEEP_FAILURES 256
+
+bool DescribeSweepSample(const std::string& sweep, u32 seed, u32 index, std::string* description)
+{
+	char text[512];
+	if (sweep == TEV_SWEEP_NAME)
+	{
+		// The expectation is recomputed here, independently of the device
+		TevSweepSample sample;
+		GetTevSweepSample(seed, index, &sample);
+		FormatTevSweepSample(sample, text, sizeof(text));
+		Vec4<int> expected = GetTevSweepExpectation(sample);
+		size_t length = strlen(text);
+		snprintf(text + length, sizeof(text) - length, "; expected r=%d, g=%d, b=%d, a=%d", expected.r, expected.g, expected.b, expected.a);
+	}
+	else
+	{
+		return false;
+	}
+	*description = text;
+	return true;
+}
+
+void ResultAggregator::OnSweepResults(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits)
+{
+	std::string name = sweep ? sweep : "";
+	std::vector<u32> failed_indices;
+	for (u32 i = 0; i < count; ++i)
+		if (IsSweepSampleFailed(bits, i))
+			failed_indices.push_back(first_index + i);
+
+	if (!failed_indices.empty())
+	{
+		Print("Sweep %s (seed %u): %u of %u samples failed\n", name.c_str(), seed, (u32)failed_indices.size(), count);
+		for (size_t i = 0; i < failed_indices.size() && i < MAX_PRINTED_SWEEP_FAILURES; ++i)
+		{
+			std::string description;
+			if (DescribeSweepSample(name, seed, failed_indices[i], &description))
+				Print("  Sample %u: %s\n", failed_indices[i], description.c_str());
+			else
+				Print("  Sample %u\n", failed_indices[i]);
+		}
+	}
+
+	TestResult* test = GetCurrentTest();
+	if (!test)
+		return;
+
+	// Large sweeps arrive in several consecutive records
+	if (!test->sweeps.empty())
+	{
+		SweepResult& last = test->sweeps.back();
+		if (last.name == name && last.seed == seed && last.first_index + last.num_samples == first_index)
+		{
+			last.num_samples += count;
+			last.failed_indices.insert(last.failed_indices.end(), failed_indices.begin(), failed_indices.end());
+			return;
+		}
+	}
+
+	SweepResult result;
+	result.name = name;
+	result.seed = seed;
+	result.first_index = first_index;
+	result.num_samples = count;
+	result.failed_indices = failed_indices;
+	test->sweeps.push_back(result);
+}
+
+void ResultAggregator::OnTestEnd(int test_number, int num_subtests, int num_failures, u64 time)
+{
+	if (num_failures == 0)
+		Print("Test %d passed (%d subtests)\n", test_number, num_subtests);
+	else
+		Print("Test %d failed (%d subtests, %d failures)\n", test_number, num_subtests, num_failures);
+
+	TestResult* test = GetCurrentTest();
+	if (!test)
+		return;
+
+	test->num_subtests = num_subtests;
+	test->num_failures = num_failures;
+	test->end_time = time;
+	test->finished = true;
+}
+
+void ResultAggregator::OnDropped(u32 num_bytes)
+{
+	Print("Lost %u bytes of results\n", num_bytes);
+	num_dropped_bytes += num_bytes;
+}
+
+int ResultAggregator::GetNumFailedTests() const
+{
+	int count = 0;
+	for (size_t i = 0; i < tests.size(); ++i)
+		count += (!tests[i].finished || tests[i].num_failures != 0);
+	return count;
+}
+
+static void WriteJsonString(FILE* file, const std::string& str)
+{
+	fputc('"', file);
+	for (size_t i = 0; i < str.size(); ++i)
+	{
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if (c == '\n')
+			fputs("\\n", file);
+		else if (c == '\t')
+			fputs("\\t", file);
+		else if (c < 0x20)
+			fprintf(file, "\\u%04x", c);
+		else
+			fputc(c, file);
+	}
+	fputc('"', file);
+}
+
+void WriteJsonSummary(FILE* file, const std::vector<RunSummary>& runs)
+{
+	// Pass/fail counts of each test across all runs
+	struct TestTotals
+	{
+		const TestResult* first;
+		int num_runs;
+		int num_failed_runs;
+	};
+	std::map<int, TestTotals> totals;
+
+	fputs("{\n\t\"runs\": [", file);
+	for (size_t r = 0; r < runs.size(); ++r)
+	{
+		const RunSummary& run = runs[r];
+		const std::vector<TestResult>& tests = run.results->GetTests();
+
+		u64 num_subtests = 0;
+		u64 num_failed_subtests = 0;
+		u64 run_time = 0;
+		for (size_t i = 0; i < tests.size(); ++i)
+		{
+			num_subtests += tests[i].finished ? tests[i].num_subtests : tests[i].num_passed + tests[i].failures.size();
+			num_failed_subtests += tests[i].finished ? tests[i].num_failures : tests[i].failures.size();
+			run_time = tests[i].end_time;
+		}
+
+		fprintf(file, "%s\n\t\t{\n\t\t\t\"device\": ", r ? "," : "");
+		WriteJsonString(file, run.device);
+		fprintf(file, ",\n\t\t\t\"connected\": %s,\n\t\t\t\"complete\": %s,\n\t\t\t\"error\": ", run.connected ? "true" : "false", run.complete ? "true" : "false");
+		if (run.error.empty())
+			fputs("null", file);
+		else
+			WriteJsonString(file, run.error);
+		fprintf(file, ",\n\t\t\t\"protocol_version\": %d,\n", run.results->GetVersion());
+		fprintf(file, "\t\t\t\"dropped_bytes\": %llu,\n", (unsigned long long)run.results->GetNumDroppedBytes());
+		fprintf(file, "\t\t\t\"wall_time_us\": %llu,\n\t\t\t\"run_time_us\": %llu,\n", (unsigned long long)run.wall_time, (unsigned long long)run_time);
+		fprintf(file, "\t\t\t\"tests\": %d,\n\t\t\t\"failed_tests\": %d,\n", (int)tests.size(), run.results->GetNumFailedTests());
+		fprintf(file, "\t\t\t\"subtests\": %llu,\n\t\t\t\"failed_subtests\": %llu,\n", (unsigned long long)num_subtests, (unsigned long long)num_failed_subtests);
+		fputs("\t\t\t\"results\": [", file);
+
+		for (size_t i = 0; i < tests.size(); ++i)
+		{
+			const TestResult& test = tests[i];
+			fprintf(file, "%s\n\t\t\t\t{ \"test\": %d, \"file\": ", i ? "," : "", test.test_number);
+			WriteJsonString(file, test.file);
+			fprintf(file, ", \"line\": %d, \"finished\": %s, \"subtests\": %d, \"passed\": %u, \"failed\": %d, ", test.line,
+			        test.finished ? "true" : "false", test.num_subtests, test.num_passed, test.num_failures);
+			fprintf(file, "\"start_us\": %llu, \"duration_us\": %llu, \"sweeps\": [",
+			        (unsigned long long)test.start_time, (unsigned long long)(test.end_time - test.start_time));
+			for (size_t w = 0; w < test.sweeps.size(); ++w)
+			{
+				const SweepResult& sweep = test.sweeps[w];
+				fprintf(file, "%s\n\t\t\t\t\t{ \"name\": ", w ? "," : "");
+				WriteJsonString(file, sweep.name);
+				fprintf(file, ", \"seed\": %u, \"first_index\": %u, \"samples\": %u, \"failed\": %u, \"failed_indices\": [",
+				        sweep.seed, sweep.first_index, sweep.num_samples, (u32)sweep.failed_indices.size());
+				for (size_t f = 0; f < sweep.failed_indices.size(); ++f)
+					fprintf(file, "%s%u", f ? ", " : "", sweep.failed_indices[f]);
+				fputs("], \"failed_samples\": [", file);
+				for (size_t f = 0; f < sweep.failed_indices.size() && f < MAX_DESCRIBED_SWEEP_FAILURES; ++f)
+				{
+					std::string description;
+					DescribeSweepSample(sweep.name, sweep.seed, sweep.failed_indices[f], &description);
+					fprintf(file, "%s\n\t\t\t\t\t\t{ \"index\": %u, \"sample\": ", f ? "," : "", sweep.failed_indices[f]);
+					WriteJsonString(file, description);
+					fputs(" }", file);
+				}
+				fputs(sweep.failed_indices.empty() ? "] }" : "\n\t\t\t\t\t] }", file);
+			}
+			fputs(test.sweeps.empty() ? "], \"failures\": [" : "\n\t\t\t\t], \"failures\": [", file);
+			for (size_t f = 0; f < test.failures.size(); ++f)
+			{
+				const SubtestFailure& failure = test.failures[f];
+				fprintf(file, "%s\n\t\t\t\t\t{ \"subtest\": %d, \"file\": ", f ? "," : "", failure.subtest);
+				WriteJsonString(file, failure.file);
+				fprintf(file, ", \"line\": %d, \"message\": ", failure.line);
+				WriteJsonString(file, failure.message);
+				fputs(" }", file);
+			}
+			fputs(test.failures.empty() ? "] }" : "\n\t\t\t\t] }", file);
+
+			TestTotals& total = totals[test.test_number];
+			if (total.num_runs++ == 0)
+				total.first = &test;
+			total.num_failed_runs += (!test.finished || test.num_failures != 0);
+		}
+		fputs(tests.empty() ? "]\n\t\t}" : "\n\t\t\t]\n\t\t}", file);
+	}
+	fputs(runs.empty() ? "],\n" : "\n\t],\n", file);
+
+	fputs("\t\"tests\": [", file);
+	for (std::map<int, TestTotals>::const_iterator it = totals.begin(); it != totals.end(); ++it)
+	{
+		fprintf(file, "%s\n\t\t{ \"test\": %d, \"file\": ", (it != totals.begin()) ? "," : "", it->first);
+		WriteJsonString(file, it->second.first->file);
+		fprintf(file, ", \"line\": %d, \"runs\": %d, \"passed_runs\": %d, \"failed_runs\": %d }", it->second.first->line,
+		        it->second.num_runs, it->second.num_runs - it->second.num_failed_runs, it->second.num_failed_runs);
+	}
+	fputs(totals.empty() ? "]\n}\n" : "\n\t]\n}\n", file);
+}
+
+// Quotes fields containing separators, as described in RFC 4180
+static void WriteCsvField(FILE* file, const std::string& str)
+{
+	if (str.find_first_of(",\"\n") == std::string::npos)
+	{
+		fputs(str.c_str(), file);
+		return;
+	}
+
+	fputc('"', file);
+	for (size_t i = 0; i < str.size(); ++i)
+	{
+		if (str[i] == '"')
+			fputc('"', file);
+		fputc(str[i], file);
+	}
+	fputc('"', file);
+}
+
+void WriteCsvSummary(FILE* file, const std::vector<RunSummary>& runs)
+{
+	fputs("device,test,file,line,finished,subtests,passed,failed,start_us,duration_us\n", file);
+	for (size_t r = 0; r < runs.size(); ++r)
+	{
+		const std::vector<TestResult>& tests = runs[r].results->GetTests();
+		for (size_t i = 0; i < tests.size(); ++i)
+		{
+			const TestResult& test = tests[i];
+			WriteCsvField(file, runs[r].device);
+			fprintf(file, ",%d,", test.test_number);
+			WriteCsvField(file, test.file);
+			fprintf(file, ",%d,%d,%d,%u,%d,%llu,%llu\n", test.line, test.finished ? 1 : 0, test.num_subtests, test.num_passed, test.num_failures,
+			        (unsigned long long)test.start_time, (unsigned long long)(test.end_time - test.start_time));
+		}
+	}
+}
+
+} // namespace
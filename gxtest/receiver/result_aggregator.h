@@ -0,0 +1,122 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Collects the results sent by gxtest runs and writes summaries of them
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "CommonTypes.h"
+#include "result_protocol.h"
+
+namespace GXTest
+{
+
+struct SubtestFailure
+{
+	int subtest;
+	std::string file;
+	int line;
+	std::string message;
+};
+
+// Outcomes of a random sweep, see network_sweep_results
+struct SweepResult
+{
+	std::string name;
+	u32 seed;
+	u32 first_index;
+	u32 num_samples;
+	std::vector<u32> failed_indices;
+};
+
+struct TestResult
+{
+	int test_number;
+	std::string file;
+	int line;
+
+	// As reported by the test end record
+	int num_subtests;
+	int num_failures;
+
+	// Counted from the individual records, these only differ from the
+	// reported values if the stream got cut off
+	u32 num_passed;
+	std::vector<SubtestFailure> failures;
+	std::vector<SweepResult> sweeps;
+
+	// Microseconds since the start of the run, measured by the sender
+	u64 start_time;
+	u64 end_time;
+	bool finished;
+};
+
+// Results of a single connection. Text output (messages, failures and the
+// test summaries) is printed to the given file with each line prefixed by
+// prefix, unless output is NULL.
+class ResultAggregator : public ResultHandler
+{
+public:
+	ResultAggregator(FILE* output, const std::string& prefix);
+
+	virtual void OnHello(int version);
+	virtual void OnTestStart(int test_number, const char* file, int line, u64 time);
+	virtual void OnPassed(u32 count);
+	virtual void OnFailed(int subtest, const char* file, int line, const char* message);
+	virtual void OnMessage(const char* message);
+	virtual void OnProgress(u32 current, u32 total);
+	virtual void OnSweepResults(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits);
+	virtual void OnTestEnd(int test_number, int num_subtests, int num_failures, u64 time);
+	virtual void OnDropped(u32 num_bytes);
+
+	const std::vector<TestResult>& GetTests() const { return tests; }
+	int GetVersion() const { return version; }
+	u64 GetNumDroppedBytes() const { return num_dropped_bytes; }
+	int GetNumFailedTests() const;
+
+private:
+	void Print(const char* format, ...);
+	TestResult* GetCurrentTest();
+
+	FILE* output;
+	std::string prefix;
+	bool at_line_start;
+
+	int version;
+	u64 num_dropped_bytes;
+	std::vector<TestResult> tests;
+};
+
+// Everything known about the run on a single device
+struct RunSummary
+{
+	std::string device;
+	bool connected;
+	bool complete; // the stream was closed cleanly at a record boundary
+	std::string error;
+
+	// Microseconds between connecting and the connection being closed,
+	// measured by the receiver
+	u64 wall_time;
+
+	ResultAggregator* results;
+};
+
+// Regenerates the given sample of a known sweep and describes it, including
+// its expected outcome. Returns false for unknown sweeps.
+bool DescribeSweepSample(const std::string& sweep, u32 seed, u32 index, std::string* description);
+
+// One object per run, with the results of each test, plus the pass/fail
+// counts of each test across all runs. Failing sweep samples are described
+// up to a limit.
+void WriteJsonSummary(FILE* file, const std::vector<RunSummary>& runs);
+
+// One row per test and run
+void WriteCsvSummary(FILE* file, const std::vector<RunSummary>& runs);
+
+} // namespace
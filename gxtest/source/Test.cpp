@@ -1,4 +1,7 @@
 #include "Test.h"
+#include <ogc/lwp_watchdog.h>
+#include "log_ring.h"
+#include "result_protocol.h"
 
 struct TestStatus
 {
@@ -16,16 +19,47 @@ struct TestStatus
 
 static TestStatus status(NULL, 0);
 static int number_of_tests = 0;
+static u64 start_time = 0;
 
 int client_socket;
 int server_socket;
 
+// Runs on the sender thread
+static bool SendResults(const u8* data, u32 size, void* userdata)
+{
+	while (size)
+	{
+		int sent = net_send(client_socket, data, size, 0);
+		if (sent <= 0)
+			return false; // Nobody is listening anymore, drop the results
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+// Encoded results are handed to a background thread through the ring, so
+// that tests don't wait for the network
+static GXTest::LogRing send_ring(1024 * 1024, GXTest::LogRing::POLICY_SPILL);
+static GXTest::LogSender sender(send_ring, SendResults, NULL);
+
+static bool QueueResults(const u8* data, u32 size, void* userdata)
+{
+	return send_ring.Write(data, size);
+}
+
+static u8 encode_buffer[128 * 1024];
+static GXTest::ResultEncoder encoder(encode_buffer, sizeof(encode_buffer), QueueResults, NULL);
+
+// Microseconds since network_init
+static u64 GetTime()
+{
+	return ticks_to_microsecs(gettime() - start_time);
+}
+
 void network_vprintf(const char* str, va_list args)
 {
-	char buffer[4096];
-//	int len = vsnprintf(buffer, 4096, str, args);
-	int len = vsprintf(buffer, str, args);
-	net_send(client_socket, buffer, len+1, 0);
+	encoder.Message(str, args);
 }
 
 void network_printf(const char* str, ...)
@@ -36,46 +70,59 @@ void network_printf(const char* str, ...)
 	va_end(args);
 }
 
+void network_progress(u32 current, u32 total)
+{
+	encoder.Progress(current, total);
+	encoder.Flush();
+}
+
+void network_sweep_results(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits)
+{
+	encoder.SweepResults(sweep, seed, first_index, count, bits);
+}
+
+void network_flush()
+{
+	encoder.Flush();
+}
+
+void network_set_backpressure(GXTest::LogRing::Policy policy)
+{
+	send_ring.SetPolicy(policy);
+}
+
 void privStartTest(const char* file, int line)
 {
 	status = TestStatus(file, line);
 
 	number_of_tests++;
+	encoder.TestStart(number_of_tests, file, line, GetTime());
 }
 
 void privDoTest(bool condition, const char* file, int line, const char* fail_msg, ...)
 {
-	va_list arglist;
-	va_start(arglist, fail_msg);
-
 	++status.num_subtests;
 
 	if (condition)
 	{
 		++status.num_passes;
+		encoder.SubtestPassed();
 	}
 	else
 	{
 		++status.num_failures;
 
-		// TODO: vprintf forwarding doesn't seem to work?
-		network_printf("Subtest %d failed in %s on line %d: ", status.num_subtests, file, line);
-		network_vprintf(fail_msg, arglist);
-		network_printf("\n");
+		va_list arglist;
+		va_start(arglist, fail_msg);
+		encoder.SubtestFailed(status.num_subtests, file, line, fail_msg, arglist);
+		va_end(arglist);
 	}
-	va_end(arglist);
 }
 
 void privEndTest()
 {
-	if (0 == status.num_failures)
-	{
-		network_printf("Test %d passed (%d subtests)\n", number_of_tests, status.num_subtests);
-	}
-	else
-	{
-		network_printf("Test %d failed (%d subtests, %d failures)\n", number_of_tests, status.num_subtests, status.num_failures);
-	}
+	encoder.TestEnd(status.num_subtests, status.num_failures, GetTime());
+	encoder.Flush();
 }
 
 void privSimpleTest(bool condition, const char* file, int line, const char* fail_msg, ...)
@@ -109,11 +156,18 @@ void network_init()
 	socklen_t ssize = sizeof(client_info);
 	client_socket = net_accept(server_socket, (struct sockaddr*)&client_info, &ssize);
 
+	sender.Start();
+
+	start_time = gettime();
+	encoder.Hello();
 	network_printf("Hello world!\n");
+	encoder.Flush();
 }
 
 void network_shutdown()
 {
+	encoder.Flush();
+	sender.Stop();
 	net_close(client_socket);
 	net_close(server_socket);
 }
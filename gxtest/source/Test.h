@@ -5,13 +5,15 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <network.h>
+#include "CommonTypes.h"
+#include "log_ring.h"
 
 #pragma once
 
 #define SERVER_PORT 16784
 
 #define START_TEST() privStartTest(__FILE__, __LINE__)
-#define DO_TEST(condition, fail_msg, ...) privDoTest(condition, __FILE__, __LINE__, fail_msg, __VA_ARGS__)
+#define DO_TEST(condition, fail_msg, ...) privDoTest(condition, __FILE__, __LINE__, fail_msg, ##__VA_ARGS__)
 #define END_TEST() privEndTest()
 #define SIMPLE_TEST()
 
@@ -22,7 +24,24 @@ void privEndTest();
 // TODO: Not implemented, yet
 //void privSimpleTest(bool condition, const char* file, int line, const char* fail_msg, ...);
 
+// Results are sent in the binary format described in result_protocol.h and
+// formatted by the receiver. Format strings passed to any of these functions
+// (and to DO_TEST) must be string literals, since they are only sent once.
+// Output is buffered until the current test ends, network_progress or
+// network_flush get called, or the send buffer is full. It is then sent by
+// a background thread, so none of these functions wait for the network.
 void network_init();
 void network_shutdown();
 void network_vprintf(const char* str, va_list args);
 void network_printf(const char* str, ...);
+void network_progress(u32 current, u32 total);
+
+// Sends the outcomes of a random sweep as one bit per sample (see
+// GXTest::SetSweepSampleFailed), instead of a message per failure. The
+// receiver regenerates failing samples from the sweep name, seed and index.
+void network_sweep_results(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits);
+void network_flush();
+
+// What to do when results are produced faster than they can be sent.
+// Defaults to spilling them into heap memory.
+void network_set_backpressure(GXTest::LogRing::Policy policy);
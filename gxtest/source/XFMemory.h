@@ -4,6 +4,57 @@
 
 #pragma once
 
+// Lighting diffuse function
+#define LIGHTDIF_NONE  0
+#define LIGHTDIF_SIGN  1
+#define LIGHTDIF_CLAMP 2
+
+// Lighting attenuation function (attnfunc field of LitChannel)
+// Bit 0 enables attenuation, bit 1 selects spotlight instead of specular
+// attenuation. libogc's GX_AF_NONE sets both bits to 2.
+#define LIGHTATTN_NONE 0
+#define LIGHTATTN_SPEC 1 // specular attenuation
+#define LIGHTATTN_DIR  2 // no attenuation, as set up by GX_AF_NONE
+#define LIGHTATTN_SPOT 3 // distance/spotlight attenuation
+
+// XF memory layout
+#define XFMEM_POSMATRICES       0x000
+#define XFMEM_POSMATRICES_END   0x100
+#define XFMEM_NORMALMATRICES    0x400
+#define XFMEM_NORMALMATRICES_END 0x460
+#define XFMEM_POSTMATRICES      0x500
+#define XFMEM_POSTMATRICES_END  0x600
+#define XFMEM_LIGHTS            0x600
+#define XFMEM_LIGHTS_END        0x680
+
+// XF registers
+#define XFMEM_CLIPDISABLE       0x1005
+#define XFMEM_INVTXSPEC         0x1008
+#define XFMEM_SETNUMCHAN        0x1009
+#define XFMEM_SETCHAN0_AMBCOLOR 0x100a
+#define XFMEM_SETCHAN1_AMBCOLOR 0x100b
+#define XFMEM_SETCHAN0_MATCOLOR 0x100c
+#define XFMEM_SETCHAN1_MATCOLOR 0x100d
+#define XFMEM_SETCHAN0_COLOR    0x100e
+#define XFMEM_SETCHAN1_COLOR    0x100f
+#define XFMEM_SETCHAN0_ALPHA    0x1010
+#define XFMEM_SETCHAN1_ALPHA    0x1011
+
+// One of the eight lights at XFMEM_LIGHTS + XF_LIGHT_SIZE * index
+// Each field corresponds to a single 32 bit XF register.
+#define XF_LIGHT_SIZE 0x10
+
+struct Light
+{
+	u32 useless[3];
+	u32 color; // RGBA, with red in the most significant byte
+	float cosatt[3]; // cos attenuation (A0, A1, A2)
+	float distatt[3]; // dist attenuation (K0, K1, K2)
+
+	float dpos[3]; // position
+	float ddir[3]; // direction of spot lights, half-angle vector of specular lights
+};
+
 union LitChannel
 {
 	BitField<0,1,u32> matsource;
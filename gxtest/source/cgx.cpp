@@ -8,8 +8,10 @@
 #include <ogc/system.h>
 #include <ogc/cache.h>
 #include <ogc/gx.h>
+#ifndef GXTEST_HOST
 #include <ogc/irq.h>
 #include <ogc/machine/processor.h>
+#endif
 
 #include "CommonTypes.h"
 #include "BPMemory.h"
@@ -40,29 +42,24 @@ extern "C"
 GXFifoObj* GX_Init(void* base, u32 size);
 }
 
+// Synchronization with the GPU and display list recording are implemented
+// in host/cgx_host.cpp for host builds.
+#ifndef GXTEST_HOST
 static void __CGXFinishInterruptHandler(u32 irq,void *ctx);
 static vu16* const _peReg = (u16*)0xCC001000;
 static lwpq_t _cgxwaitfinish;
 static vu32 _cgxfinished = 0;
-
-#define CGX_LOAD_BP_REG(x) \
-	do { \
-		wgPipe->U8 = 0x61; \
-		wgPipe->U32 = (u32)(x); \
-	} while(0)
-
-#define CGX_LOAD_CP_REG(x, y) \
-	do { \
-		wgPipe->U8 = 0x08; \
-		wgPipe->U8 = (u8)(x); \
-		wgPipe->U32 = (u32)(y); \
-	} while(0)
-
-#define CGX_BEGIN_LOAD_XF_REGS(x, n) \
-	do { \
-		wgPipe->U8 = 0x10; \
-		wgPipe->U32 = (u32)(((((n)&0xffff)-1)<<16)|((x)&0xffff)); \
-	} while(0)
+static void __CGXTokenInterruptHandler(u32 irq,void *ctx);
+static lwpq_t _cgxwaittoken;
+static u16 _cgxlastfence = 0;
+
+static vu32* const _piReg = (u32*)0xCC003000;
+static vu16* const _cpReg = (u16*)0xCC000000;
+static u32 _cgxdlsavedfifo[3]; // PI FIFO base, end and write pointer
+static u16 _cgxdlsavedcpcr;
+static u32 _cgxdlbase;
+static CGXShadowState* _cgxdlsavedshadow;
+#endif
 
 void CGX_Init()
 {
@@ -72,12 +69,18 @@ void CGX_Init()
     memset(gp_fifo, 0, 256*1024);
 
 	GX_Init(gp_fifo, 256*1024);
+	CGX_InvalidateShadowState();
 
+#ifndef GXTEST_HOST
 	LWP_InitQueue(&_cgxwaitfinish);
+	LWP_InitQueue(&_cgxwaittoken);
 
 	IRQ_Request(IRQ_PI_PEFINISH,__CGXFinishInterruptHandler,NULL);
 	__UnmaskIrq(IRQMASK(IRQ_PI_PEFINISH));
+	IRQ_Request(IRQ_PI_PETOKEN,__CGXTokenInterruptHandler,NULL);
+	__UnmaskIrq(IRQMASK(IRQ_PI_PETOKEN));
 	_peReg[5] = 0x0F;
+#endif
 }
 
 void CGX_SetViewport(float origin_x, float origin_y, float width, float height, float near, f32 far)
@@ -91,6 +94,7 @@ void CGX_SetViewport(float origin_x, float origin_y, float width, float height,
 	wgPipe->F32 = far*16777215.0f;
 }
 
+#ifndef GXTEST_HOST
 static inline void WriteMtxPS4x2(register f32 mt[3][4], register void* wgpipe)
 {
 	// Untested
@@ -110,6 +114,7 @@ static inline void WriteMtxPS4x2(register f32 mt[3][4], register void* wgpipe)
 		: "memory"
 	);
 }
+#endif
 
 void CGX_LoadPosMatrixDirect(f32 mt[3][4], u32 index)
 {
@@ -117,34 +122,160 @@ void CGX_LoadPosMatrixDirect(f32 mt[3][4], u32 index)
 /*	CGX_BEGIN_LOAD_XF_REGS((index<<2)&0xFF, 12);
 	WriteMtxPS4x2(mt, (void*)wgPipe);*/
 	GX_LoadPosMtxImm(mt, index);
+	CGX_ShadowInvalidateXF((index<<2)&0xFF, 12);
+}
+
+static inline u32 FloatBits(f32 value)
+{
+	union { f32 f; u32 u; } bits;
+	bits.f = value;
+	return bits.u;
+}
+
+void CGX_LoadNormalMatrixDirect(f32 mt[3][3], u32 index)
+{
+	u32 values[9];
+	for (int i = 0; i < 9; ++i)
+		values[i] = FloatBits(mt[i / 3][i % 3]);
+	CGX_LOAD_XF_REGS(XFMEM_NORMALMATRICES + index * 3, 9, values);
 }
 
+void CGX_LoadLight(u32 index, const Light& light)
+{
+	// The first three registers of each light are unused
+	u32 values[13];
+	values[0] = light.color;
+	for (int i = 0; i < 3; ++i)
+	{
+		values[1 + i] = FloatBits(light.cosatt[i]);
+		values[4 + i] = FloatBits(light.distatt[i]);
+		values[7 + i] = FloatBits(light.dpos[i]);
+		values[10 + i] = FloatBits(light.ddir[i]);
+	}
+	CGX_LOAD_XF_REGS(XFMEM_LIGHTS + index * XF_LIGHT_SIZE + 3, 13, values);
+}
+
+// Same register layout as libogc's GX_LoadProjectionMtx
 void CGX_LoadProjectionMatrixPerspective(float mtx[4][4])
 {
-	// Untested
-/*	CGX_BEGIN_LOAD_XF_REGS(0x1020, 7);
-	wgPipe->F32 = mtx[0][0];
-	wgPipe->F32 = mtx[0][2];
-	wgPipe->F32 = mtx[1][1];
-	wgPipe->F32 = mtx[1][2];
-	wgPipe->F32 = mtx[2][2];
-	wgPipe->F32 = mtx[2][3];
-	wgPipe->U32 = 0;*/
-	GX_LoadProjectionMtx(mtx, 0);
+	const u32 values[7] = {
+		FloatBits(mtx[0][0]), FloatBits(mtx[0][2]),
+		FloatBits(mtx[1][1]), FloatBits(mtx[1][2]),
+		FloatBits(mtx[2][2]), FloatBits(mtx[2][3]),
+		0
+	};
+	CGX_LOAD_XF_REGS(0x1020, 7, values);
 }
 
 void CGX_LoadProjectionMatrixOrthographic(float mtx[4][4])
 {
-	// Untested
-/*	CGX_BEGIN_LOAD_XF_REGS(0x1020, 7);
-	wgPipe->F32 = mtx[0][0];
-	wgPipe->F32 = mtx[0][3];
-	wgPipe->F32 = mtx[1][1];
-	wgPipe->F32 = mtx[1][3];
-	wgPipe->F32 = mtx[2][2];
-	wgPipe->F32 = mtx[2][3];
-	wgPipe->U32 = 1;*/
-	GX_LoadProjectionMtx(mtx, 1);
+	const u32 values[7] = {
+		FloatBits(mtx[0][0]), FloatBits(mtx[0][3]),
+		FloatBits(mtx[1][1]), FloatBits(mtx[1][3]),
+		FloatBits(mtx[2][2]), FloatBits(mtx[2][3]),
+		1
+	};
+	CGX_LOAD_XF_REGS(0x1020, 7, values);
+}
+
+void CGX_LoadTexture(u8 texmap, const void* data, u16 width, u16 height, u8 format)
+{
+	assert(texmap < 8);
+	assert(width <= 1024 && height <= 1024);
+
+	int unit = texmap & 3;
+	bool upper = texmap >= 4;
+
+	TexMode0 mode0;
+	mode0.hex = 0;
+	mode0.wrap_s = 0; // clamp
+	mode0.wrap_t = 0;
+	mode0.mag_filter = 0; // near
+	mode0.min_filter = 0; // near, no mipmaps
+	CGX_LOAD_BP_REG((((upper ? BPMEM_TX_SETMODE0_4 : BPMEM_TX_SETMODE0) + unit) << 24) | mode0.hex);
+
+	TexMode1 mode1;
+	mode1.hex = 0;
+	mode1.min_lod = 0;
+	mode1.max_lod = 0;
+	CGX_LOAD_BP_REG((((upper ? BPMEM_TX_SETMODE1_4 : BPMEM_TX_SETMODE1) + unit) << 24) | mode1.hex);
+
+	TexImage0 image0;
+	image0.hex = 0;
+	image0.width = width - 1;
+	image0.height = height - 1;
+	image0.format = format;
+	CGX_LOAD_BP_REG((((upper ? BPMEM_TX_SETIMAGE0_4 : BPMEM_TX_SETIMAGE0) + unit) << 24) | image0.hex);
+
+	// 32 KB cache regions for even and odd LODs (cache size code 3)
+	TexImage1 image1;
+	image1.hex = 0;
+	image1.tmem_even = (texmap * 0x8000) >> 5;
+	image1.cache_width = 3;
+	image1.cache_height = 3;
+	image1.image_type = 0;
+	CGX_LOAD_BP_REG((((upper ? BPMEM_TX_SETIMAGE1_4 : BPMEM_TX_SETIMAGE1) + unit) << 24) | image1.hex);
+
+	TexImage2 image2;
+	image2.hex = 0;
+	image2.tmem_odd = (texmap * 0x8000 + 0x80000) >> 5;
+	image2.cache_width = 3;
+	image2.cache_height = 3;
+	CGX_LOAD_BP_REG((((upper ? BPMEM_TX_SETIMAGE2_4 : BPMEM_TX_SETIMAGE2) + unit) << 24) | image2.hex);
+
+	TexImage3 image3;
+	image3.hex = 0;
+	image3.image_base = MEM_VIRTUAL_TO_PHYSICAL(data) >> 5;
+	CGX_LOAD_BP_REG((((upper ? BPMEM_TX_SETIMAGE3_4 : BPMEM_TX_SETIMAGE3) + unit) << 24) | image3.hex);
+
+	// Make sure the GPU doesn't use stale texture data
+	DCFlushRange((void*)data, GX_GetTexBufferSize(width, height, format, GX_FALSE, 1));
+	CGX_LOAD_BP_REG((BPMEM_TEXINVALIDATE << 24) | 0x001000);
+	CGX_LOAD_BP_REG((BPMEM_TEXINVALIDATE << 24) | 0x001100);
+}
+
+int CGX_GetTexelBits(u8 format)
+{
+	switch (format)
+	{
+	case GX_TF_I4:
+	case GX_CTF_R4:
+	case GX_CTF_Z4:
+		return 4;
+
+	case GX_TF_I8:
+	case GX_TF_IA4:
+	case GX_TF_Z8:
+	case GX_CTF_RA4:
+	case GX_CTF_A8:
+	case GX_CTF_R8:
+	case GX_CTF_G8:
+	case GX_CTF_B8:
+	case GX_CTF_Z8M:
+	case GX_CTF_Z8L:
+		return 8;
+
+	case GX_TF_RGBA8:
+	case GX_TF_Z24X8:
+		return 32;
+
+	default:
+		return 16;
+	}
+}
+
+u32 CGX_GetEfbCopyStride(u16 width, u8 dest_format)
+{
+	int bits = CGX_GetTexelBits(dest_format);
+	int block_width = (bits <= 8) ? 8 : 4;
+	u32 block_size = (bits == 32) ? 64 : 32;
+	return ((width + block_width - 1) / block_width) * block_size;
+}
+
+u32 CGX_GetEfbCopySize(u16 width, u16 height, u8 dest_format)
+{
+	int block_height = (CGX_GetTexelBits(dest_format) == 4) ? 8 : 4;
+	return CGX_GetEfbCopyStride(width, dest_format) * ((height + block_height - 1) / block_height);
 }
 
 void CGX_DoEfbCopyTex(u16 left, u16 top, u16 width, u16 height, u8 dest_format, bool copy_to_intensity, void* dest, bool scale_down, bool clear)
@@ -154,7 +285,8 @@ void CGX_DoEfbCopyTex(u16 left, u16 top, u16 width, u16 height, u8 dest_format,
 	assert(width <= 1023);
 	assert(height <= 1023);
 
-	// TODO: GX_TF_Z16 seems to have special treatment in libogc? oO
+	u16 dest_width = scale_down ? width / 2 : width;
+	u16 dest_height = scale_down ? height / 2 : height;
 
 	X10Y10 coords;
 	coords.hex = BPMEM_EFB_TL << 24;
@@ -167,22 +299,30 @@ void CGX_DoEfbCopyTex(u16 left, u16 top, u16 width, u16 height, u8 dest_format,
 	coords.y = height - 1;
 	CGX_LOAD_BP_REG(coords.hex);
 
-	// TODO: this one is hardcoded against dest_format=RGBA8...
-	CGX_LOAD_BP_REG((BPMEM_MIPMAP_STRIDE << 24) | (((width+3)>>2) * 2));
+	// Distance between rows of blocks, in units of 32 bytes
+	CGX_LOAD_BP_REG((BPMEM_MIPMAP_STRIDE << 24) | (CGX_GetEfbCopyStride(dest_width, dest_format) >> 5));
 
 	CGX_LOAD_BP_REG((BPMEM_EFB_ADDR<<24) | (MEM_VIRTUAL_TO_PHYSICAL(dest)>>5));
 
+	// Drop stale cache lines of the destination before the GPU writes to it.
+	// This also discards any dirty lines, which would otherwise be written
+	// back on top of the copy at some point.
+	DCInvalidateRange(dest, CGX_GetEfbCopySize(dest_width, dest_height, dest_format));
+
 	UPE_Copy reg;
 	reg.Hex = BPMEM_TRIGGER_EFB_COPY<<24;
-	reg.target_pixel_format = ((dest_format << 1) & 0xE) | (dest_format >> 3);
+	// The copy and Z formats (GX_CTF_X, GX_TF_ZX) are distinguished by the
+	// upper bits, the register only takes the lower four. Whether color or
+	// depth gets copied depends on the EFB pixel format, see PIXELFMT_Z24.
+	// Like libogc, use the RG8 slot for GX_TF_Z16.
+	u8 real_format = (dest_format == GX_TF_Z16) ? 0xB : (dest_format & 0xF);
+	reg.target_pixel_format = ((real_format << 1) & 0xE) | (real_format >> 3);
 	reg.half_scale = scale_down;
 	reg.clear = clear;
 	reg.intensity_fmt = copy_to_intensity;
 	reg.clamp0 = 1;
 	reg.clamp1 = 1;
 	CGX_LOAD_BP_REG(reg.Hex);
-
-    DCFlushRange(dest, GX_GetTexBufferSize(width,height,GX_TF_RGBA8,GX_FALSE,1));
 }
 
 void CGX_DoEfbCopyXfb(u16 left, u16 top, u16 width, u16 src_height, u16 dst_height, void* dest, bool clear)
@@ -215,6 +355,9 @@ void CGX_DoEfbCopyXfb(u16 left, u16 top, u16 width, u16 src_height, u16 dst_heig
 	GX_SetDispCopyDst(width, dst_height);
 	// SetCopyFilter, SetFieldMode, SetDispCopyGamma
 	GX_CopyDisp(dest, clear);
+
+	// libogc's GX doesn't go through our shadow state
+	CGX_InvalidateShadowState();
 }
 
 void CGX_ForcePipelineFlush()
@@ -229,6 +372,89 @@ void CGX_ForcePipelineFlush()
 	wgPipe->U32 = 0;
 }
 
+void CGX_ClearBoundingBox()
+{
+	// Bits 0-9: left/top, bits 10-19: right/bottom
+	CGX_LOAD_BP_REG((BPMEM_CLEARBBOX1 << 24) | 0x3FF);
+	CGX_LOAD_BP_REG((BPMEM_CLEARBBOX2 << 24) | 0x3FF);
+}
+
+void CGX_GetPerf0SelectRegs(CGXPerf0Metric metric, u32* tri_reg, u32* quad_reg)
+{
+	// Same encodings as used by libogc's GX_SetGPMetric
+	static const u32 tri_values[] = { 0xAE7F, 0x8E7F, 0x9E7F, 0x1E7F };
+	static const u32 quad_values[] = { 0x2C0C6, 0x2C16B, 0x2C0E6, 0x2C0A6, 0x2C066, 0x2C026 };
+
+	*tri_reg = BPMEM_PERF0_TRI << 24;
+	*quad_reg = BPMEM_PERF0_QUAD << 24;
+	if (metric <= CGX_PERF0_TRIANGLES_SCISSORED)
+		*tri_reg |= tri_values[metric - CGX_PERF0_TRIANGLES];
+	else if (metric <= CGX_PERF0_QUAD_4CVG)
+		*quad_reg |= quad_values[metric - CGX_PERF0_QUAD_0CVG];
+}
+
+void CGX_SelectPerf0Metric(CGXPerf0Metric metric)
+{
+	u32 tri_reg, quad_reg;
+	CGX_GetPerf0SelectRegs(metric, &tri_reg, &quad_reg);
+
+	// Disable the previous metric before enabling the new one
+	if (tri_reg & 0xFFFFFF)
+	{
+		CGX_LOAD_BP_REG(quad_reg);
+		CGX_LOAD_BP_REG(tri_reg);
+	}
+	else
+	{
+		CGX_LOAD_BP_REG(tri_reg);
+		CGX_LOAD_BP_REG(quad_reg);
+	}
+}
+
+CGXPerfCounters CGX_DecodePerfCounters(const u16 cp_regs[2], const u16 pe_regs[12])
+{
+	CGXPerfCounters ret;
+	ret.perf0 = cp_regs[0] | ((u32)cp_regs[1] << 16);
+
+	u32* const pe_counters[6] = {
+		&ret.zcomploc_pixels_in, &ret.zcomploc_pixels_out,
+		&ret.zcomp_pixels_in, &ret.zcomp_pixels_out,
+		&ret.blend_pixels_in, &ret.copy_clocks
+	};
+	for (int i = 0; i < 6; ++i)
+		*pe_counters[i] = pe_regs[2 * i] | ((u32)pe_regs[2 * i + 1] << 16);
+
+	return ret;
+}
+
+#ifndef GXTEST_HOST
+void CGX_ClearPerfCounters()
+{
+	// Pixel engine counters are cleared by toggling the register
+	CGX_LOAD_BP_REG(BPMEM_CLEAR_PIXEL_PERF << 24);
+	CGX_LOAD_BP_REG((BPMEM_CLEAR_PIXEL_PERF << 24) | 0xAAA);
+
+	// Command processor clear register, bit 2 clears the perf0 counter
+	_cpReg[2] = 4;
+}
+
+CGXPerfCounters CGX_ReadPerfCounters()
+{
+	u16 cp_regs[2] = { _cpReg[32], _cpReg[33] };
+	u16 pe_regs[12];
+	for (int i = 0; i < 12; ++i)
+		pe_regs[i] = _peReg[12 + i];
+	return CGX_DecodePerfCounters(cp_regs, pe_regs);
+}
+
+void CGX_ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom)
+{
+	*left = _peReg[8];
+	*right = _peReg[9];
+	*top = _peReg[10];
+	*bottom = _peReg[11];
+}
+
 static void __CGXFinishInterruptHandler(u32 irq,void *ctx)
 {
 	_peReg[5] = (_peReg[5]&~0x08)|0x08;
@@ -253,3 +479,117 @@ void CGX_WaitForGpuToFinish()
 
 	_CPU_ISR_Restore(level);
 }
+
+static void __CGXTokenInterruptHandler(u32 irq,void *ctx)
+{
+	_peReg[5] = (_peReg[5]&~0x04)|0x04;
+
+	LWP_ThreadBroadcast(_cgxwaittoken);
+}
+
+CGXFence CGX_InsertFence()
+{
+	CGXFence fence = ++_cgxlastfence;
+
+	// The token register is updated once all preceding commands have been
+	// processed, the interrupt variant additionally raises IRQ_PI_PETOKEN.
+	CGX_LOAD_BP_REG((BPMEM_PE_TOKEN_INT_ID << 24) | fence);
+	CGX_LOAD_BP_REG((BPMEM_PE_TOKEN_ID << 24) | fence);
+	CGX_ForcePipelineFlush();
+
+	return fence;
+}
+
+bool CGX_IsFenceReached(CGXFence fence)
+{
+	// Fences wrap around, so compare relative to the current token
+	return (s16)(_peReg[7] - fence) >= 0;
+}
+
+void CGX_WaitForFence(CGXFence fence)
+{
+	u32 level;
+
+	_CPU_ISR_Disable(level);
+	while (!CGX_IsFenceReached(fence))
+		LWP_ThreadSleep(_cgxwaittoken);
+	_CPU_ISR_Restore(level);
+}
+
+// Drops any data which is still pending in the write gather pipe.
+// Only use this after CGX_ForcePipelineFlush, so that the dropped data only consists of NOPs.
+static void __CGXResetWriteGatherPipe()
+{
+	ppcsync();
+	while (mfwpar() & 1);
+	mtwpar(0x0C008000);
+}
+
+void CGX_BeginDisplayList(void* buffer, u32 size)
+{
+	assert(((uintptr_t)buffer & 31) == 0 && (size & 31) == 0);
+
+	// Commands recorded to the list must not depend on the current state
+	_cgxdlsavedshadow = CGX_SetShadowState(NULL);
+
+	// Make sure previous commands end up in the regular FIFO
+	CGX_ForcePipelineFlush();
+
+	// The write gather pipe writes to memory directly, so don't let the
+	// CPU read stale cache lines of the buffer later on.
+	DCInvalidateRange(buffer, size);
+
+	u32 level;
+	_CPU_ISR_Disable(level);
+	__CGXResetWriteGatherPipe();
+
+	_cgxdlsavedfifo[0] = _piReg[3];
+	_cgxdlsavedfifo[1] = _piReg[4];
+	_cgxdlsavedfifo[2] = _piReg[5];
+	_cgxdlsavedcpcr = _cpReg[1];
+
+	// Unlink the CPU FIFO from the GP FIFO and disable the FIFO watermark
+	// interrupts, then point the CPU FIFO to the display list buffer.
+	_cpReg[1] = _cgxdlsavedcpcr & ~0x1C;
+	_cgxdlbase = MEM_VIRTUAL_TO_PHYSICAL(buffer);
+	_piReg[3] = _cgxdlbase;
+	_piReg[4] = _cgxdlbase + size - 4;
+	_piReg[5] = _cgxdlbase;
+	_CPU_ISR_Restore(level);
+}
+
+u32 CGX_EndDisplayList()
+{
+	CGX_ForcePipelineFlush();
+
+	u32 level;
+	_CPU_ISR_Disable(level);
+	__CGXResetWriteGatherPipe();
+
+	u32 write_pointer = _piReg[5];
+	bool wrapped = (write_pointer & 0x04000000) != 0;
+	u32 size = (write_pointer & 0x1FFFFFE0) - _cgxdlbase;
+
+	_piReg[3] = _cgxdlsavedfifo[0];
+	_piReg[4] = _cgxdlsavedfifo[1];
+	_piReg[5] = _cgxdlsavedfifo[2];
+	_cpReg[1] = _cgxdlsavedcpcr;
+	_CPU_ISR_Restore(level);
+
+	CGX_SetShadowState(_cgxdlsavedshadow);
+
+	return wrapped ? 0 : size;
+}
+#endif
+
+void CGX_CallDisplayList(const void* list, u32 size)
+{
+	assert(((uintptr_t)list & 31) == 0 && (size & 31) == 0);
+
+	wgPipe->U8 = 0x40; // call display list
+	wgPipe->U32 = MEM_VIRTUAL_TO_PHYSICAL(list);
+	wgPipe->U32 = size;
+
+	// The list may have changed any register
+	CGX_InvalidateShadowState();
+}
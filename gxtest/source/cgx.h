@@ -14,6 +14,7 @@
 #include <ogc/gx.h>
 
 #include "CommonTypes.h"
+#include "cgx_shadow.h"
 
 #pragma once
 
@@ -33,20 +34,53 @@ typedef union
 static CWGPipe* const wgPipe = (CWGPipe*)0xCC008000;
 */
 
+// Register loads go through the shadow state (see cgx_shadow.h),
+// which may drop writes that wouldn't change anything.
 #define CGX_LOAD_BP_REG(x) \
 	do { \
-		wgPipe->U8 = 0x61; \
-		wgPipe->U32 = (u32)(x); \
+		u32 _cgx_value = (u32)(x); \
+		if (CGX_ShadowBP(_cgx_value)) { \
+			wgPipe->U8 = 0x61; \
+			wgPipe->U32 = _cgx_value; \
+		} \
 	} while(0)
 
 #define CGX_LOAD_CP_REG(x, y) \
 	do { \
-		wgPipe->U8 = 0x08; \
-		wgPipe->U8 = (u8)(x); \
-		wgPipe->U32 = (u32)(y); \
+		u8 _cgx_addr = (u8)(x); \
+		u32 _cgx_value = (u32)(y); \
+		if (CGX_ShadowCP(_cgx_addr, _cgx_value)) { \
+			wgPipe->U8 = 0x08; \
+			wgPipe->U8 = _cgx_addr; \
+			wgPipe->U32 = _cgx_value; \
+		} \
 	} while(0)
 
+// Unfiltered XF load: The caller writes the n register values to wgPipe afterwards.
 #define CGX_BEGIN_LOAD_XF_REGS(x, n) \
+	do { \
+		CGX_ShadowInvalidateXF((x), (n)); \
+		CGX_WRITE_XF_HEADER(x, n); \
+	} while(0)
+
+// Filtered XF load of n registers, taking the values from a u32 array
+#define CGX_LOAD_XF_REGS(x, n, values) \
+	do { \
+		const u32* _cgx_values = (values); \
+		if (CGX_ShadowXF((x), (n), _cgx_values)) { \
+			CGX_WRITE_XF_HEADER(x, n); \
+			for (int _cgx_i = 0; _cgx_i < (n); ++_cgx_i) \
+				wgPipe->U32 = _cgx_values[_cgx_i]; \
+		} \
+	} while(0)
+
+#define CGX_LOAD_XF_REG(x, y) \
+	do { \
+		u32 _cgx_xf_value = (u32)(y); \
+		CGX_LOAD_XF_REGS(x, 1, &_cgx_xf_value); \
+	} while(0)
+
+#define CGX_WRITE_XF_HEADER(x, n) \
 	do { \
 		wgPipe->U8 = 0x10; \
 		wgPipe->U32 = (u32)(((((n)&0xffff)-1)<<16)|((x)&0xffff)); \
@@ -57,9 +91,33 @@ void CGX_Init();
 void CGX_SetViewport(float origin_x, float origin_y, float width, float height, float near, f32 far);
 
 void CGX_LoadPosMatrixDirect(f32 mt[3][4], u32 index);
+void CGX_LoadNormalMatrixDirect(f32 mt[3][3], u32 index);
 void CGX_LoadProjectionMatrixPerspective(float mtx[4][4]);
 void CGX_LoadProjectionMatrixOrthographic(float mtx[4][4]);
 
+// Load the given light (0-7) to XF memory, see XFMemory.h
+struct Light;
+void CGX_LoadLight(u32 index, const Light& light);
+
+// Load a texture with the given format (GX_TF_X) to the given texture map.
+// Uses nearest filtering, clamps texture coordinates and disables mipmapping.
+// The texture cache region of each map is set up like in libogc.
+void CGX_LoadTexture(u8 texmap, const void* data, u16 width, u16 height, u8 format);
+
+// Bits per texel of the given texture format (GX_TF_X or GX_CTF_X): 4, 8, 16 or 32
+int CGX_GetTexelBits(u8 format);
+
+// Size in bytes of the GX tiled texture written by an EFB copy of the given
+// dimensions to the given format (GX_TF_X or GX_CTF_X). Textures consist of
+// 32 byte blocks of 8x8 (4 bit formats), 8x4 (8 bit) or 4x4 (16 bit) texels.
+// 32 bit formats use 4x4 blocks of 64 bytes.
+u32 CGX_GetEfbCopySize(u16 width, u16 height, u8 dest_format);
+
+// Distance in bytes between two rows of blocks of such a texture
+u32 CGX_GetEfbCopyStride(u16 width, u8 dest_format);
+
+// dest is invalidated from the CPU cache when issuing the copy, so it must
+// not be accessed until the GPU has finished the copy.
 void CGX_DoEfbCopyTex(u16 left, u16 top, u16 width, u16 height, u8 dest_format, bool copy_to_intensity, void* dest, bool scale_down=false, bool clear=false);
 
 // TODO: Add support for other parameters...
@@ -68,3 +126,92 @@ void CGX_DoEfbCopyXfb(u16 left, u16 top, u16 width, u16 src_height, u16 dst_heig
 void CGX_ForcePipelineFlush();
 
 void CGX_WaitForGpuToFinish();
+
+// Bounding box
+// The pixel engine keeps track of the extents of all pixels drawn since the
+// bounding box was cleared. Clearing sets left and top to 1023 and right and
+// bottom to 0, i.e. the box stays empty until anything gets drawn.
+void CGX_ClearBoundingBox();
+
+// Reads the bounding box registers, which are only up to date once the GPU
+// has finished drawing (e.g. after CGX_WaitForGpuToFinish).
+void CGX_ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom);
+
+// Performance counters
+// The setup unit has a single counter (perf0), which counts triangles or
+// quads depending on the selected metric. The pixel engine counts pixels
+// entering and leaving the early (zcomploc) and late depth tests, pixels
+// entering blending, and GPU clocks spent on EFB copies.
+// All counters keep running until they're cleared, and they're only up to
+// date once the GPU has finished drawing.
+enum CGXPerf0Metric
+{
+	CGX_PERF0_TRIANGLES, // triangles entering setup
+	CGX_PERF0_TRIANGLES_CULLED,
+	CGX_PERF0_TRIANGLES_PASSED, // triangles leaving setup
+	CGX_PERF0_TRIANGLES_SCISSORED,
+	CGX_PERF0_QUAD_0CVG, // 2x2 pixel quads with the given number of covered pixels
+	CGX_PERF0_QUAD_NON0CVG,
+	CGX_PERF0_QUAD_1CVG,
+	CGX_PERF0_QUAD_2CVG,
+	CGX_PERF0_QUAD_3CVG,
+	CGX_PERF0_QUAD_4CVG,
+	CGX_PERF0_NONE,
+};
+
+struct CGXPerfCounters
+{
+	u32 perf0; // selected CGXPerf0Metric
+
+	u32 zcomploc_pixels_in; // early depth test
+	u32 zcomploc_pixels_out;
+	u32 zcomp_pixels_in; // late depth test
+	u32 zcomp_pixels_out;
+	u32 blend_pixels_in; // passed all tests
+	u32 copy_clocks;
+};
+
+// Values for BPMEM_PERF0_TRI and BPMEM_PERF0_QUAD which select the given metric.
+// Both registers are always written, since only one of them may be enabled.
+void CGX_GetPerf0SelectRegs(CGXPerf0Metric metric, u32* tri_reg, u32* quad_reg);
+
+void CGX_SelectPerf0Metric(CGXPerf0Metric metric);
+
+// Resets all counters to zero
+void CGX_ClearPerfCounters();
+
+// Combines the raw 16 bit halves of the counter registers, lower half first:
+// cp_regs are the two perf0 registers of the command processor, pe_regs the
+// twelve pixel counter registers of the pixel engine.
+CGXPerfCounters CGX_DecodePerfCounters(const u16 cp_regs[2], const u16 pe_regs[12]);
+
+CGXPerfCounters CGX_ReadPerfCounters();
+
+// Fences are markers in the command stream, which allow for checking the
+// GPU's progress without waiting for all issued commands to finish.
+// They are implemented via the PE token register and wrap around after
+// 65536 fences, so only keep a reasonable number of them pending.
+typedef u16 CGXFence;
+
+// Flushes the command stream
+CGXFence CGX_InsertFence();
+
+// Returns true if all commands issued before the fence have been processed
+bool CGX_IsFenceReached(CGXFence fence);
+
+void CGX_WaitForFence(CGXFence fence);
+
+// Display lists
+// Between CGX_BeginDisplayList and CGX_EndDisplayList, all GPU commands are
+// recorded to the given buffer instead of being executed. Buffer address and
+// size must be multiples of 32 bytes. Redundant register writes are never
+// dropped while recording, since the list may be called in any GPU state.
+void CGX_BeginDisplayList(void* buffer, u32 size);
+
+// Returns the size of the recorded list, which is padded with NOPs to a
+// multiple of 32 bytes, or 0 if the buffer was too small.
+u32 CGX_EndDisplayList();
+
+// Execute a previously recorded display list with a single FIFO command.
+// Invalidates the shadow state.
+void CGX_CallDisplayList(const void* list, u32 size);
@@ -0,0 +1,222 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+#include <string.h>
+
+#include "BPMemory.h"
+#include "cgx_fake.h"
+
+#define EFB_WIDTH 640
+#define EFB_HEIGHT 528
+
+CGXFakeEfb::CGXFakeEfb()
+{
+	pixels = new u32[EFB_WIDTH * EFB_HEIGHT];
+	memset(pixels, 0, EFB_WIDTH * EFB_HEIGHT * sizeof(u32));
+}
+
+CGXFakeEfb::~CGXFakeEfb()
+{
+	delete[] pixels;
+}
+
+void CGXFakeEfb::SetPixel(int x, int y, u32 rgba)
+{
+	assert(x >= 0 && x < EFB_WIDTH);
+	assert(y >= 0 && y < EFB_HEIGHT);
+	pixels[y * EFB_WIDTH + x] = rgba;
+}
+
+u32 CGXFakeEfb::GetPixel(int x, int y) const
+{
+	assert(x >= 0 && x < EFB_WIDTH);
+	assert(y >= 0 && y < EFB_HEIGHT);
+	return pixels[y * EFB_WIDTH + x];
+}
+
+void CGXFakeEfb::Fill(int left, int top, int width, int height, u32 rgba)
+{
+	for (int y = top; y < top + height; ++y)
+		for (int x = left; x < left + width; ++x)
+			SetPixel(x, y, rgba);
+}
+
+void CGXFakeEfb::CopyTex(u16 left, u16 top, u16 width, u16 height, void* dest) const
+{
+	// RGBA8 textures consist of 4x4 pixel blocks of 64 bytes each.
+	// The first 32 bytes of a block store AR pairs, the other ones GB pairs.
+	u8* dst = (u8*)dest;
+	int width_blocks = (width + 3) >> 2;
+	int height_blocks = (height + 3) >> 2;
+
+	for (int block_y = 0; block_y < height_blocks; ++block_y)
+	{
+		for (int block_x = 0; block_x < width_blocks; ++block_x)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				int x = (block_x << 2) + (i & 3);
+				int y = (block_y << 2) + (i >> 2);
+
+				// Pixels outside the copy rectangle are undefined, just use zero for these.
+				u32 rgba = (x < width && y < height) ? GetPixel(left + x, top + y) : 0;
+
+				dst[2*i] = rgba & 0xFF;
+				dst[2*i+1] = rgba >> 24;
+				dst[32+2*i] = (rgba >> 16) & 0xFF;
+				dst[32+2*i+1] = (rgba >> 8) & 0xFF;
+			}
+			dst += 64;
+		}
+	}
+}
+
+CGXFakeFences::CGXFakeFences(u16 first_fence)
+	: last_inserted(first_fence - 1), last_reached(first_fence - 1), num_waits(0)
+{
+}
+
+u16 CGXFakeFences::InsertFence()
+{
+	// Pending fences must not wrap around onto each other
+	assert(GetNumPending() < 0x7FFF);
+	return ++last_inserted;
+}
+
+bool CGXFakeFences::IsFenceReached(u16 fence)
+{
+	return (s16)(last_reached - fence) >= 0;
+}
+
+void CGXFakeFences::WaitForFence(u16 fence)
+{
+	// Waiting for a fence which was never inserted would hang the real GPU
+	assert((s16)(last_inserted - fence) >= 0);
+
+	++num_waits;
+	if (!IsFenceReached(fence))
+		last_reached = fence;
+}
+
+void CGXFakeFences::Retire(int count)
+{
+	assert(count <= GetNumPending());
+	last_reached += count;
+}
+
+CGXFakeBoundingBox::CGXFakeBoundingBox() : num_reads(0)
+{
+	ClearBoundingBox();
+}
+
+void CGXFakeBoundingBox::LoadBPReg(u32 value)
+{
+	if ((value >> 24) == BPMEM_CLEARBBOX1)
+	{
+		left = value & 0x3FF;
+		right = (value >> 10) & 0x3FF;
+	}
+	else if ((value >> 24) == BPMEM_CLEARBBOX2)
+	{
+		top = value & 0x3FF;
+		bottom = (value >> 10) & 0x3FF;
+	}
+}
+
+void CGXFakeBoundingBox::Draw(int left, int top, int right, int bottom)
+{
+	if (left < this->left)
+		this->left = left;
+	if (right > this->right)
+		this->right = right;
+	if (top < this->top)
+		this->top = top;
+	if (bottom > this->bottom)
+		this->bottom = bottom;
+}
+
+void CGXFakeBoundingBox::ClearBoundingBox()
+{
+	// Same values as used by CGX_ClearBoundingBox
+	LoadBPReg((BPMEM_CLEARBBOX1 << 24) | 0x3FF);
+	LoadBPReg((BPMEM_CLEARBBOX2 << 24) | 0x3FF);
+}
+
+void CGXFakeBoundingBox::ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom)
+{
+	*left = this->left;
+	*right = this->right;
+	*top = this->top;
+	*bottom = this->bottom;
+	++num_reads;
+}
+
+CGXRecordingPipe::CGXRecordingPipe(u32 capacity)
+	: U8(this), S8(this), U16(this), S16(this), U32(this), S32(this), F32(this),
+	  size(0), capacity(capacity), overflow(false), saved_data(NULL), saved_size(0), saved_capacity(0)
+{
+	data = new u8[capacity];
+}
+
+CGXRecordingPipe::~CGXRecordingPipe()
+{
+	assert(!saved_data);
+	delete[] data;
+}
+
+void CGXRecordingPipe::BeginDisplayList(void* buffer, u32 buffer_size)
+{
+	assert(!saved_data);
+	assert(((uintptr_t)buffer & 31) == 0 && (buffer_size & 31) == 0);
+
+	saved_data = data;
+	saved_size = size;
+	saved_capacity = capacity;
+
+	data = (u8*)buffer;
+	size = 0;
+	capacity = buffer_size;
+	overflow = false;
+}
+
+u32 CGXRecordingPipe::EndDisplayList()
+{
+	assert(saved_data);
+
+	// CGX_EndDisplayList flushes the pipe by writing 32 bytes worth of NOPs,
+	// of which only the ones up to the next 32 byte boundary reach memory.
+	// Filling the buffer completely reaches the FIFO end (base + size - 4),
+	// which makes the hardware wrap around, so that counts as overflow, too.
+	u32 list_size = (size + 32) & ~31;
+	if (list_size >= capacity)
+		overflow = true;
+	else
+		memset(data + size, 0, list_size - size);
+
+	data = saved_data;
+	size = saved_size;
+	capacity = saved_capacity;
+	saved_data = NULL;
+
+	return overflow ? 0 : list_size;
+}
+
+void CGXRecordingPipe::Write(const void* value, u32 value_size)
+{
+	if (size + value_size > capacity)
+	{
+		// Only display lists may run out of space
+		assert(saved_data);
+		overflow = true;
+		return;
+	}
+
+	const u16 endianness_probe = 1;
+	bool little_endian = *(const u8*)&endianness_probe == 1;
+
+	const u8* bytes = (const u8*)value;
+	for (u32 i = 0; i < value_size; ++i)
+		data[size++] = bytes[little_endian ? (value_size - 1 - i) : i];
+}
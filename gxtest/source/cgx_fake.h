@@ -0,0 +1,148 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Software stand-ins for parts of the GPU.
+// These don't emulate any actual rendering, but they allow for exercising
+// the readback and decoding logic of GXTest without real hardware.
+
+#pragma once
+
+#include "CommonTypes.h"
+#include "readback_ring.h"
+#include "coverage_probe.h"
+
+// Embedded framebuffer, stored as linear RGBA8 pixels (0xRRGGBBAA)
+class CGXFakeEfb
+{
+public:
+	CGXFakeEfb();
+	~CGXFakeEfb();
+
+	void SetPixel(int x, int y, u32 rgba);
+	u32 GetPixel(int x, int y) const;
+
+	void Fill(int left, int top, int width, int height, u32 rgba);
+
+	// Equivalent of CGX_DoEfbCopyTex with dest_format=RGBA8:
+	// Writes the given EFB region to dest using the GX tiled texture layout.
+	void CopyTex(u16 left, u16 top, u16 width, u16 height, void* dest) const;
+
+private:
+	CGXFakeEfb(const CGXFakeEfb&) = delete;
+	CGXFakeEfb& operator = (const CGXFakeEfb&) = delete;
+
+	u32* pixels;
+};
+
+// PE token register, as used by fences
+// Commands are never processed on their own. Instead, the test drives the
+// fake GPU with Retire, or implicitly by waiting for a fence.
+class CGXFakeFences : public GXTest::FenceSource
+{
+public:
+	// first_fence allows for starting right before the 16 bit wrap-around
+	CGXFakeFences(u16 first_fence = 1);
+
+	u16 InsertFence();
+	bool IsFenceReached(u16 fence);
+	void WaitForFence(u16 fence);
+
+	// Pretend that the GPU finished processing the given number of pending fences
+	void Retire(int count);
+
+	int GetNumPending() const { return (u16)(last_inserted - last_reached); }
+	int GetNumWaits() const { return num_waits; }
+
+private:
+	u16 last_inserted;
+	u16 last_reached;
+	int num_waits;
+};
+
+// Bounding box registers of the pixel engine
+// Like the fences, the fake doesn't rasterize anything on its own: The test
+// reports drawn pixels with Draw.
+class CGXFakeBoundingBox : public GXTest::BoundingBoxSource
+{
+public:
+	CGXFakeBoundingBox();
+
+	// Same effect as writing the given value to BPMEM_CLEARBBOX1/2
+	void LoadBPReg(u32 value);
+
+	// Pretend that the given pixel region (edges inclusive) got drawn
+	void Draw(int left, int top, int right, int bottom);
+
+	void ClearBoundingBox();
+	void ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom);
+
+	int GetNumReads() const { return num_reads; }
+
+private:
+	u16 left, right;
+	u16 top, bottom;
+	int num_reads;
+};
+
+// Write gather pipe which records everything written to it, using the byte
+// order of the GPU (big endian). The CGX macros write to whatever "wgPipe"
+// refers to at the place they're used, so a local variable of that name
+// pointing to a CGXRecordingPipe redirects them to the recording.
+class CGXRecordingPipe
+{
+public:
+	template<typename T>
+	class Port
+	{
+	public:
+		Port(CGXRecordingPipe* pipe) : pipe(pipe) {}
+
+		Port& operator = (T value)
+		{
+			pipe->Write(&value, sizeof(T));
+			return *this;
+		}
+
+	private:
+		CGXRecordingPipe* pipe;
+	};
+
+	CGXRecordingPipe(u32 capacity = 0x10000);
+	~CGXRecordingPipe();
+
+	const u8* GetData() const { return data; }
+	u32 GetSize() const { return size; }
+	void Clear() { size = 0; }
+
+	// Equivalents of CGX_BeginDisplayList/CGX_EndDisplayList: Writes go to
+	// the given buffer in the meantime, and the list gets padded like the real
+	// write gather pipe would do.
+	void BeginDisplayList(void* buffer, u32 buffer_size);
+	u32 EndDisplayList();
+
+	Port<u8> U8;
+	Port<s8> S8;
+	Port<u16> U16;
+	Port<s16> S16;
+	Port<u32> U32;
+	Port<s32> S32;
+	Port<float> F32;
+
+private:
+	CGXRecordingPipe(const CGXRecordingPipe&) = delete;
+	CGXRecordingPipe& operator = (const CGXRecordingPipe&) = delete;
+
+	// Appends the given native-endian value
+	void Write(const void* value, u32 value_size);
+
+	u8* data;
+	u32 size;
+	u32 capacity;
+	bool overflow;
+
+	// Regular recording, while recording a display list
+	u8* saved_data;
+	u32 saved_size;
+	u32 saved_capacity;
+};
@@ -0,0 +1,139 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <string.h>
+
+#include "cgx_shadow.h"
+
+static_assert(sizeof(BPMemory) == 256 * sizeof(u32), "BPMemory must cover all BP registers");
+
+CGXShadowState* _cgxshadow = NULL;
+
+CGXShadowState* CGX_SetShadowState(CGXShadowState* state)
+{
+	CGXShadowState* previous = _cgxshadow;
+	_cgxshadow = state;
+	return previous;
+}
+
+void CGX_InvalidateShadowState()
+{
+	if (_cgxshadow)
+		_cgxshadow->Invalidate();
+}
+
+// Returns true for BP registers which trigger an action when written to,
+// or which otherwise mustn't be assumed to keep their value.
+static bool IsBPTrigger(u8 addr)
+{
+	switch (addr)
+	{
+	case BPMEM_PERF0_TRI:
+	case BPMEM_PERF0_QUAD:
+	case BPMEM_SETDRAWDONE:
+	case BPMEM_PE_TOKEN_ID:
+	case BPMEM_PE_TOKEN_INT_ID:
+	case BPMEM_TRIGGER_EFB_COPY:
+	case BPMEM_CLEARBBOX1:
+	case BPMEM_CLEARBBOX2:
+	case BPMEM_CLEAR_PIXEL_PERF:
+	case BPMEM_PRELOAD_MODE:
+	case BPMEM_LOADTLUT0:
+	case BPMEM_LOADTLUT1:
+	case BPMEM_TEXINVALIDATE:
+	case BPMEM_PERF1:
+	case BPMEM_BP_MASK:
+		return true;
+
+	default:
+		// Writing the high part of a color register has side effects
+		// (libogc writes it three times in a row), so be safe and always
+		// send the tev registers.
+		return addr >= BPMEM_TEV_REGISTER_L && addr < BPMEM_TEV_REGISTER_L + 8;
+	}
+}
+
+CGXShadowState::CGXShadowState()
+{
+	Invalidate();
+	bytes_saved = 0;
+}
+
+bool CGXShadowState::WriteBP(u32 value)
+{
+	u8 addr = value >> 24;
+	u32* regs = (u32*)&bp;
+
+	if (bp_masked)
+	{
+		// Only some bits get updated, hence we don't know the new value
+		bp_masked = false;
+		bp_valid[addr] = false;
+		return true;
+	}
+
+	if (IsBPTrigger(addr))
+	{
+		bp_masked = (addr == BPMEM_BP_MASK);
+		return true;
+	}
+
+	if (bp_valid[addr] && regs[addr] == value)
+	{
+		bytes_saved += 5;
+		return false;
+	}
+
+	regs[addr] = value;
+	bp_valid[addr] = true;
+	return true;
+}
+
+bool CGXShadowState::WriteCP(u8 addr, u32 value)
+{
+	if (cp_valid[addr] && cp[addr] == value)
+	{
+		bytes_saved += 6;
+		return false;
+	}
+
+	cp[addr] = value;
+	cp_valid[addr] = true;
+	return true;
+}
+
+bool CGXShadowState::WriteXF(u16 addr, u16 count, const u32* values)
+{
+	if (addr + count > CGX_SHADOW_XF_SIZE)
+		return true;
+
+	bool redundant = true;
+	for (int i = 0; i < count; ++i)
+	{
+		if (!xf_valid[addr + i] || xf[addr + i] != values[i])
+			redundant = false;
+
+		xf[addr + i] = values[i];
+		xf_valid[addr + i] = true;
+	}
+
+	if (redundant)
+		bytes_saved += 5 + 4 * count;
+
+	return !redundant;
+}
+
+void CGXShadowState::InvalidateXF(u16 addr, u16 count)
+{
+	for (int i = addr; i < addr + count && i < CGX_SHADOW_XF_SIZE; ++i)
+		xf_valid[i] = false;
+}
+
+void CGXShadowState::Invalidate()
+{
+	memset(bp_valid, 0, sizeof(bp_valid));
+	memset(cp_valid, 0, sizeof(cp_valid));
+	memset(xf_valid, 0, sizeof(xf_valid));
+	bp_masked = false;
+}
@@ -0,0 +1,90 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Optional filter for redundant register writes
+// When enabled via CGX_SetShadowState, the CGX register load macros compare
+// each write against the last value sent to the same register and skip it if
+// nothing would change. Writes which have side effects (EFB copies, tokens,
+// texture cache invalidation, ...) are never skipped.
+// The shadow state doesn't know about GPU commands issued by other means than
+// the CGX macros, so use CGX_InvalidateShadowState after using libogc's GX
+// functions or when deliberately re-triggering registers.
+
+#pragma once
+
+#include "CommonTypes.h"
+#include "BPMemory.h"
+
+// Covers XF memory (matrices, lights) and XF registers
+#define CGX_SHADOW_XF_SIZE 0x1058
+
+class CGXShadowState
+{
+public:
+	CGXShadowState();
+
+	// Each of these returns true if the given write needs to be sent to the
+	// GPU, and updates the shadow state accordingly.
+	bool WriteBP(u32 value);
+	bool WriteCP(u8 addr, u32 value);
+	bool WriteXF(u16 addr, u16 count, const u32* values);
+
+	// Forget about the given XF registers, e.g. after they were loaded
+	// without going through WriteXF.
+	void InvalidateXF(u16 addr, u16 count);
+
+	// Forget about all registers, such that all following writes are sent.
+	void Invalidate();
+
+	// Number of FIFO bytes which have been skipped
+	u32 GetBytesSaved() const { return bytes_saved; }
+	void ResetBytesSaved() { bytes_saved = 0; }
+
+private:
+	CGXShadowState(const CGXShadowState&) = delete;
+	CGXShadowState& operator = (const CGXShadowState&) = delete;
+
+	BPMemory bp;
+	u32 cp[256];
+	u32 xf[CGX_SHADOW_XF_SIZE];
+
+	bool bp_valid[256];
+	bool cp_valid[256];
+	bool xf_valid[CGX_SHADOW_XF_SIZE];
+
+	// The write following BPMEM_BP_MASK only updates the masked bits
+	bool bp_masked;
+
+	u32 bytes_saved;
+};
+
+// Shadow state used by the CGX macros, or NULL if redundant writes aren't filtered (default).
+// Returns the previously used shadow state.
+CGXShadowState* CGX_SetShadowState(CGXShadowState* state);
+
+void CGX_InvalidateShadowState();
+
+// Used by the CGX macros
+extern CGXShadowState* _cgxshadow;
+
+static inline bool CGX_ShadowBP(u32 value)
+{
+	return !_cgxshadow || _cgxshadow->WriteBP(value);
+}
+
+static inline bool CGX_ShadowCP(u8 addr, u32 value)
+{
+	return !_cgxshadow || _cgxshadow->WriteCP(addr, value);
+}
+
+static inline bool CGX_ShadowXF(u16 addr, u16 count, const u32* values)
+{
+	return !_cgxshadow || _cgxshadow->WriteXF(addr, count, values);
+}
+
+static inline void CGX_ShadowInvalidateXF(u16 addr, u16 count)
+{
+	if (_cgxshadow)
+		_cgxshadow->InvalidateXF(addr, count);
+}
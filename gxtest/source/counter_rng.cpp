@@ -0,0 +1,96 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <stdlib.h>
+
+#include "counter_rng.h"
+
+namespace GXTest
+{
+
+// Round multipliers and key increments (golden ratio and sqrt(3) - 1) of
+// Philox4x32
+#define PHILOX_M0 0xD2511F53
+#define PHILOX_M1 0xCD9E8D57
+#define PHILOX_W0 0x9E3779B9
+#define PHILOX_W1 0xBB67AE85
+#define PHILOX_ROUNDS 10
+
+void Philox4x32(const u32 counter[4], const u32 key[2], u32 result[4])
+{
+	u32 c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	u32 k0 = key[0], k1 = key[1];
+	for (int round = 0; round < PHILOX_ROUNDS; ++round)
+	{
+		// mulhwu and mullw on the console
+		u64 product0 = (u64)PHILOX_M0 * c0;
+		u64 product1 = (u64)PHILOX_M1 * c2;
+		u32 hi0 = (u32)(product0 >> 32), lo0 = (u32)product0;
+		u32 hi1 = (u32)(product1 >> 32), lo1 = (u32)product1;
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	result[0] = c0;
+	result[1] = c1;
+	result[2] = c2;
+	result[3] = c3;
+}
+
+CounterRandom::CounterRandom(u32 seed, u32 index) : num_used(4)
+{
+	key[0] = seed;
+	key[1] = 0;
+	counter[0] = 0; // block number within the sample
+	counter[1] = index;
+	counter[2] = 0;
+	counter[3] = 0;
+}
+
+u32 CounterRandom::Next()
+{
+	if (num_used == 4)
+	{
+		Philox4x32(counter, key, block);
+		++counter[0];
+		num_used = 0;
+	}
+	return block[num_used++];
+}
+
+void SweepShard::GetRange(u32 num_samples, u32 alignment, u32* first_index, u32* count) const
+{
+	u64 num_units = (num_samples + (u64)alignment - 1) / alignment;
+	u64 first = num_units * shard / num_shards * alignment;
+	u64 end = num_units * (shard + 1) / num_shards * alignment;
+	if (first > num_samples)
+		first = num_samples;
+	if (end > num_samples)
+		end = num_samples;
+	*first_index = (u32)first;
+	*count = (u32)(end - first);
+}
+
+bool ParseSweepShard(const char* text, SweepShard* shard)
+{
+	char* end;
+	unsigned long index = strtoul(text, &end, 10);
+	if (end == text || *end != '/')
+		return false;
+
+	const char* count_text = end + 1;
+	unsigned long count = strtoul(count_text, &end, 10);
+	if (end == count_text || *end != 0 || count == 0 || index >= count)
+		return false;
+
+	shard->shard = (u32)index;
+	shard->num_shards = (u32)count;
+	return true;
+}
+
+} // namespace
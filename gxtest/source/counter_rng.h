@@ -0,0 +1,63 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Counter-based random numbers for random sweeps
+// Values are a pure function of a key and a counter (Philox4x32-10, see
+// Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"), instead of
+// the result of a sequence of state updates like with rand(). Any sample of a
+// sweep can hence be generated on its own, which allows for splitting sweeps
+// across consoles, resuming them and regenerating single samples on the host.
+// Only 32 bit integer arithmetic is used, so the output is the same on the
+// console and on the host, regardless of endianness and C library.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Encrypts the counter with the key, giving four random 32 bit values
+void Philox4x32(const u32 counter[4], const u32 key[2], u32 result[4]);
+
+// Stream of random values for a single sample of a sweep
+// The sweep seed and the sample index select the stream. Values are drawn
+// from consecutive counters, four at a time.
+class CounterRandom
+{
+public:
+	CounterRandom(u32 seed, u32 index);
+
+	u32 Next();
+
+	// Value in [0, range), computed without a division. The bias of this is
+	// below range / 2^32, which doesn't matter for the ranges used in sweeps.
+	u32 NextBelow(u32 range) { return (u32)(((u64)Next() * range) >> 32); }
+
+	// Value in [min, max]
+	int NextInRange(int min, int max) { return min + (int)NextBelow((u32)(max - min + 1)); }
+
+private:
+	u32 key[2];
+	u32 counter[4];
+	u32 block[4];
+	u32 num_used; // values of block which have been returned already
+};
+
+// Part of a sweep which is run on one of several devices
+// Samples are split into num_shards contiguous index ranges of about the same
+// size. Range boundaries are multiples of alignment (e.g. the batch size of
+// the sweep), only the last range may end elsewhere.
+struct SweepShard
+{
+	u32 shard;
+	u32 num_shards;
+
+	void GetRange(u32 num_samples, u32 alignment, u32* first_index, u32* count) const;
+};
+
+// Parses "K/N", returns false if it's not a valid shard
+bool ParseSweepShard(const char* text, SweepShard* shard);
+
+} // namespace
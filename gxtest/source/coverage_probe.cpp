@@ -0,0 +1,29 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include "coverage_probe.h"
+
+namespace GXTest
+{
+
+void CoverageProbe::Begin()
+{
+	source.ClearBoundingBox();
+}
+
+BoundingBox CoverageProbe::End()
+{
+	u16 left, right, top, bottom;
+	source.ReadBoundingBox(&left, &right, &top, &bottom);
+
+	// The registers are 10 bits wide
+	BoundingBox ret;
+	ret.left = left & 0x3FF;
+	ret.right = right & 0x3FF;
+	ret.top = top & 0x3FF;
+	ret.bottom = bottom & 0x3FF;
+	return ret;
+}
+
+} // namespace
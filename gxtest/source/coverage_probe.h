@@ -0,0 +1,66 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Source of bounding box readings, i.e. the extents of all pixels the GPU
+// has drawn since the bounding box was last cleared.
+// Register values are 10 bit EFB coordinates. A cleared bounding box has
+// left=top=1023 and right=bottom=0, so that it is empty until anything
+// gets drawn.
+class BoundingBoxSource
+{
+public:
+	virtual ~BoundingBoxSource() {}
+
+	virtual void ClearBoundingBox() = 0;
+
+	// Waits until the GPU is done with all previously issued commands
+	virtual void ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom) = 0;
+};
+
+// Pixel region in EFB coordinates, all edges inclusive
+struct BoundingBox
+{
+	int left, right;
+	int top, bottom;
+
+	bool IsEmpty() const { return left > right || top > bottom; }
+
+	bool Contains(int x, int y) const
+	{
+		return x >= left && x <= right && y >= top && y <= bottom;
+	}
+
+	bool Intersects(int other_left, int other_top, int other_right, int other_bottom) const
+	{
+		return !IsEmpty() && other_left <= right && other_right >= left && other_top <= bottom && other_bottom >= top;
+	}
+};
+
+// Tells whether draws touched a pixel region, without an EFB copy:
+// Begin clears the bounding box, End reads it back after the GPU is done.
+// Only the extents of drawn pixels are known, so this is suited for tests
+// which check whether a primitive was drawn at all (e.g. clipping), but
+// not for checking which pixels within the extents got covered.
+class CoverageProbe
+{
+public:
+	CoverageProbe(BoundingBoxSource& source) : source(source) {}
+
+	void Begin();
+
+	// Extents of all pixels drawn since Begin
+	BoundingBox End();
+
+private:
+	BoundingBoxSource& source;
+};
+
+} // namespace
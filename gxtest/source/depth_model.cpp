@@ -0,0 +1,106 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "depth_model.h"
+
+namespace GXTest
+{
+
+int GetDepthExponentBits(int zformat)
+{
+	static const int exponent_bits[4] = { 0, 2, 3, 4 }; // linear, 14e2, 13e3, 12e4
+	return exponent_bits[zformat & 3];
+}
+
+// Position (counted from the most significant bit) of the first mantissa bit
+// for the given exponent. The terminating zero is only there if the number
+// of leading ones is below the maximum exponent.
+static inline int GetMantissaStart(int exponent, int max_exponent)
+{
+	return (exponent < max_exponent) ? exponent + 1 : exponent;
+}
+
+u16 CompressDepth(int zformat, u32 depth)
+{
+	int exponent_bits = GetDepthExponentBits(zformat);
+	if (exponent_bits == 0)
+		return depth >> 8;
+
+	int mantissa_bits = 16 - exponent_bits;
+	int max_exponent = (1 << exponent_bits) - 1;
+
+	int exponent = 0;
+	while (exponent < max_exponent && (depth & (0x800000 >> exponent)))
+		++exponent;
+
+	// Mantissas of large exponents extend below bit 0 and are padded with zeros
+	int shift = 24 - GetMantissaStart(exponent, max_exponent) - mantissa_bits;
+	u32 mantissa = (shift >= 0) ? (depth >> shift) : (depth << -shift);
+	return (exponent << mantissa_bits) | (mantissa & ((1 << mantissa_bits) - 1));
+}
+
+u32 DecompressDepth(int zformat, u16 value)
+{
+	int exponent_bits = GetDepthExponentBits(zformat);
+	if (exponent_bits == 0)
+		return value << 8;
+
+	int mantissa_bits = 16 - exponent_bits;
+	int max_exponent = (1 << exponent_bits) - 1;
+	int exponent = value >> mantissa_bits;
+	u32 mantissa = value & ((1 << mantissa_bits) - 1);
+
+	u32 leading_ones = (0xFFFFFF << (24 - exponent)) & 0xFFFFFF;
+	int shift = 24 - GetMantissaStart(exponent, max_exponent) - mantissa_bits;
+	return leading_ones | ((shift >= 0) ? (mantissa << shift) : (mantissa >> -shift));
+}
+
+u32 DepthBufferExpectation(int pixel_format, int zformat, u32 depth)
+{
+	if (pixel_format == PIXELFMT_RGB565_Z16)
+		return DecompressDepth(zformat, CompressDepth(zformat, depth));
+	return depth & 0xFFFFFF;
+}
+
+bool DepthCompareExpectation(int func, u32 depth, u32 stored)
+{
+	switch (func)
+	{
+	case COMPARE_NEVER: return false;
+	case COMPARE_LESS: return depth < stored;
+	case COMPARE_EQUAL: return depth == stored;
+	case COMPARE_LEQUAL: return depth <= stored;
+	case COMPARE_GREATER: return depth > stored;
+	case COMPARE_NEQUAL: return depth != stored;
+	case COMPARE_GEQUAL: return depth >= stored;
+	default: return true; // COMPARE_ALWAYS
+	}
+}
+
+u32 DepthTestExpectation(const ZMode& zmode, int pixel_format, int zformat, u32 depth, u32 stored)
+{
+	// Without depth testing, the depth buffer isn't updated either
+	if (!zmode.testenable || !zmode.updateenable)
+		return stored;
+
+	u32 value = DepthBufferExpectation(pixel_format, zformat, depth);
+	bool passed;
+	if (pixel_format == PIXELFMT_RGB565_Z16)
+		passed = DepthCompareExpectation(zmode.func, CompressDepth(zformat, depth), CompressDepth(zformat, stored));
+	else
+		passed = DepthCompareExpectation(zmode.func, depth & 0xFFFFFF, stored);
+	return passed ? value : stored;
+}
+
+void DepthTestBatch(const ZMode& zmode, int pixel_format, int zformat, const u32* depth, u32* stored, int count)
+{
+	for (int i = 0; i < count; ++i)
+		stored[i] = DepthTestExpectation(zmode, pixel_format, zformat, depth[i], stored[i]);
+}
+
+} // namespace
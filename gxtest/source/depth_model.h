@@ -0,0 +1,49 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Reference model of the depth buffer
+// Describes how depth values are stored by the different EFB pixel formats
+// and how the depth test compares them. Depth values are 24 bit integers, as
+// read back by a GX_TF_Z24X8 copy.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Number of exponent bits of the 16 bit depth encoding selected by the given
+// PE_CONTROL zformat (ZC_LINEAR, ZC_NEAR, ZC_MID or ZC_FAR): 0, 2, 3 or 4.
+int GetDepthExponentBits(int zformat);
+
+// 16 bit depth value stored by PIXELFMT_RGB565_Z16.
+// ZC_LINEAR keeps the upper 16 bits. The other formats are floating point
+// like: The exponent counts the leading one bits (up to its maximum value),
+// the mantissa holds the bits following the leading ones and the zero which
+// terminates them. Precision hence increases towards the far plane.
+u16 CompressDepth(int zformat, u32 depth);
+
+// 24 bit depth value encoded by CompressDepth, with the bits that weren't
+// stored set to 0. DecompressDepth(CompressDepth(x)) never exceeds x.
+u32 DecompressDepth(int zformat, u16 value);
+
+// Depth value read back after the given depth value has been written with
+// the given PE_CONTROL pixel_format and zformat.
+u32 DepthBufferExpectation(int pixel_format, int zformat, u32 depth);
+
+// Whether a fragment of the given depth passes the depth test against the
+// stored value with the given ZMode func (COMPARE_X).
+bool DepthCompareExpectation(int func, u32 depth, u32 stored);
+
+// Depth value read back after drawing a fragment of the given depth on top
+// of the stored one (which must have been written with the same format).
+// With 16 bit depth, the compressed values are compared. The depth buffer
+// is only updated if both testenable and updateenable are set.
+u32 DepthTestExpectation(const ZMode& zmode, int pixel_format, int zformat, u32 depth, u32 stored);
+
+// DepthTestExpectation for count fragments, updating stored in place.
+void DepthTestBatch(const ZMode& zmode, int pixel_format, int zformat, const u32* depth, u32* stored, int count);
+
+} // namespace
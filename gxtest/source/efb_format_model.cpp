@@ -0,0 +1,80 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "efb_format_model.h"
+
+namespace GXTest
+{
+
+// Masks applied to packed RGBA words, see QuantizeEfbColor
+struct EfbFormatMasks
+{
+	u32 stored; // bits kept in the EFB
+	u32 replicate5; // lower bits of 5 bit channels, filled from their upper bits
+	u32 replicate6; // same for 6 bit channels
+	u32 missing; // channels which aren't stored
+};
+
+static EfbFormatMasks GetEfbFormatMasks(int pixel_format)
+{
+	EfbFormatMasks masks = { 0xFFFFFF00, 0, 0, 0x000000FF }; // PIXELFMT_RGB8_Z24
+	if (pixel_format == PIXELFMT_RGBA6_Z24)
+	{
+		masks.stored = 0xFCFCFCFC;
+		masks.replicate6 = 0x03030303;
+		masks.missing = 0;
+	}
+	else if (pixel_format == PIXELFMT_RGB565_Z16)
+	{
+		masks.stored = 0xF8FCF800;
+		masks.replicate5 = 0x07000700;
+		masks.replicate6 = 0x00030000;
+	}
+	else
+	{
+		assert(pixel_format == PIXELFMT_RGB8_Z24);
+	}
+	return masks;
+}
+
+static inline u32 PackLowerBits(const Vec4<int>& color)
+{
+	return ((color.r & 0xFF) << 24) | ((color.g & 0xFF) << 16) | ((color.b & 0xFF) << 8) | (color.a & 0xFF);
+}
+
+// A channel of n bits sits in the upper bits of its byte, so shifting it
+// right by n moves its upper bits into the lower 8-n ones.
+static inline u32 QuantizeEfbColor(const EfbFormatMasks& masks, u32 rgba)
+{
+	u32 stored = rgba & masks.stored;
+	return stored | ((stored >> 5) & masks.replicate5) | ((stored >> 6) & masks.replicate6) | masks.missing;
+}
+
+int GetEfbChannelBits(int pixel_format, int channel)
+{
+	u32 stored = GetEfbFormatMasks(pixel_format).stored >> (24 - 8 * channel);
+	int bits = 0;
+	for (u32 bit = 0x80; bit & stored; bit >>= 1)
+		++bits;
+	return bits;
+}
+
+u32 EfbColorExpectation(int pixel_format, const Vec4<int>& tev_output)
+{
+	return QuantizeEfbColor(GetEfbFormatMasks(pixel_format), PackLowerBits(tev_output));
+}
+
+void EfbColorExpectationBatch(int pixel_format, const Vec4<int>* tev_output, int count, u32* colors)
+{
+	const EfbFormatMasks masks = GetEfbFormatMasks(pixel_format);
+	for (int i = 0; i < count; ++i)
+		colors[i] = QuantizeEfbColor(masks, PackLowerBits(tev_output[i]));
+}
+
+} // namespace
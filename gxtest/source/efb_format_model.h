@@ -0,0 +1,33 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Reference model of the EFB color formats
+// Describes how PIXELFMT_RGB8_Z24, PIXELFMT_RGBA6_Z24 and PIXELFMT_RGB565_Z16
+// store tev output and how RGBA8 EFB copies expand it back to 8 bits.
+// Pixels are handled as packed RGBA words (red in the most significant
+// byte), so that all channels are quantized at once by a few masks and
+// shifts. Loops over many pixels hence vectorize well.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Number of bits stored for the given channel (0-3: r, g, b, a) by the given
+// pixel format. Channels which aren't stored at all have 0 bits.
+int GetEfbChannelBits(int pixel_format, int channel);
+
+// Color read back by an RGBA8 copy after the given tev output was written
+// to the EFB with the given pixel format, with dithering disabled.
+// The EFB keeps the lower 8 bits of each channel truncated to the precision
+// of the format. The copy expands stored channels by replicating their upper
+// bits, channels which aren't stored read back as 255.
+u32 EfbColorExpectation(int pixel_format, const Vec4<int>& tev_output);
+
+// EfbColorExpectation for count pixels
+void EfbColorExpectationBatch(int pixel_format, const Vec4<int>* tev_output, int count, u32* colors);
+
+} // namespace
@@ -11,6 +11,7 @@
 #include "cgx.h"
 #include "cgx_defaults.h"
 #include "gxtest_util.h"
+#include "texture_decoder.h"
 
 //#define ENABLE_DEBUG_DISPLAY
 
@@ -18,6 +19,7 @@ namespace GXTest
 {
 #define TEST_BUFFER_SIZE (640*528*4)
 static u32* test_buffer;
+static u8* tev_input_textures[3];
 
 #ifdef ENABLE_DEBUG_DISPLAY
 static u32 fb = 0;
@@ -69,6 +71,8 @@ void Init()
 #endif
 
 	test_buffer = (u32*)memalign(32, 640*528*4);
+	for (auto& texture : tev_input_textures)
+		texture = (u8*)memalign(32, TEV_INPUT_FRAME_SIZE);
 
 	GX_SetTexCopySrc(0, 0, 100, 100);
 	GX_SetTexCopyDst(100, 100, GX_TF_RGBA8, false);
@@ -127,6 +131,9 @@ void Init()
 	GX_End();
 	GX_Flush();
 
+	// None of the above went through the CGX shadow state
+	CGX_InvalidateShadowState();
+
 	PE_CONTROL ctrl;
 	ctrl.hex = BPMEM_ZCOMPARE<<24;
 	ctrl.pixel_format = PIXELFMT_RGBA6_Z24;
@@ -148,25 +155,24 @@ void DebugDisplayEfbContents()
 #endif
 }
 
-Vec4<u8> ReadTestBuffer(int s, int t, int width)
+Vec4<u8> ReadTestBuffer(int x, int y, int width, u8 format)
 {
-	u16 sBlk = s >> 2;
-	u16 tBlk = t >> 2;
-	u16 widthBlks = (width >> 2) + 1;
-	u32 base = (tBlk * widthBlks + sBlk) << 5;
-	u16 blkS = s & 3;
-	u16 blkT =  t & 3;
-	u32 blkOff = (blkT << 2) + blkS;
+	return DecodeCopyPixel(format, test_buffer, x, y, width);
+}
 
-	u32 offset = (base + blkOff) << 1 ;
-	const u8* valAddr = ((u8*)test_buffer) + offset;
+u32 ReadTestBufferDepth(int x, int y, int width, u8 format)
+{
+	return DecodeDepthPixel(format, test_buffer, x, y, width);
+}
 
-	Vec4<u8> ret;
-	ret.r = valAddr[1];
-	ret.g = valAddr[32];
-	ret.b = valAddr[33];
-	ret.a = valAddr[0];
-	return ret;
+const void* GetTestBuffer()
+{
+	return test_buffer;
+}
+
+Vec4<u8> ReadTestBufferTile(int x, int y)
+{
+	return DecodeRGBA8Pixel(test_buffer, x & 3, y & 3, 4);
 }
 
 Quad::Quad()
@@ -191,7 +197,9 @@ Quad::Quad()
 	y[3] = -1.0;
 	z[3] =  1.0;
 
+	has_normal = false;
 	has_color = false;
+	has_texcoords = false;
 }
 
 Quad& Quad::VertexTopLeft(f32 x, f32 y, f32 z)
@@ -241,6 +249,31 @@ Quad& Quad::ColorRGBA(u8 r, u8 g, u8 b, u8 a)
 	return *this;
 }
 
+Quad& Quad::Normal(f32 nx, f32 ny, f32 nz)
+{
+	normal[0] = nx;
+	normal[1] = ny;
+	normal[2] = nz;
+	has_normal = true;
+
+	return *this;
+}
+
+Quad& Quad::TexCoords(f32 left, f32 top, f32 right, f32 bottom)
+{
+	s[0] = left;
+	t[0] = top;
+	s[1] = right;
+	t[1] = top;
+	s[2] = right;
+	t[2] = bottom;
+	s[3] = left;
+	t[3] = bottom;
+	has_texcoords = true;
+
+	return *this;
+}
+
 void Quad::Draw()
 {
 	VAT vtxattr;
@@ -251,12 +284,24 @@ void Quad::Draw()
 	vtxattr.g0.PosElements = VA_TYPE_POS_XYZ;
 	vtxattr.g0.PosFormat = VA_FMT_F32;
 
+	if (has_normal)
+	{
+		vtxattr.g0.NormalElements = VA_TYPE_NRM_XYZ;
+		vtxattr.g0.NormalFormat = VA_FMT_F32;
+	}
+
 	if (has_color)
 	{
 		vtxattr.g0.Color0Elements = VA_TYPE_CLR_RGBA;
 		vtxattr.g0.Color0Comp = VA_FMT_RGBA8;
 	}
 
+	if (has_texcoords)
+	{
+		vtxattr.g0.Tex0CoordElements = VA_TYPE_TEX_ST;
+		vtxattr.g0.Tex0CoordFormat = VA_FMT_F32;
+	}
+
 	// TODO: Figure out what this does and why it needs to be 1 for Dolphin not to error out
 	vtxattr.g0.ByteDequant = 1;
 
@@ -264,9 +309,15 @@ void Quad::Draw()
 	vtxdesc.Hex = 0;
 	vtxdesc.Position = VTXATTR_DIRECT;
 
+	if (has_normal)
+		vtxdesc.Normal = VTXATTR_DIRECT;
+
 	if (has_color)
 		vtxdesc.Color0 = VTXATTR_DIRECT;
 
+	if (has_texcoords)
+		vtxdesc.Tex0Coord = VTXATTR_DIRECT;
+
 	// TODO: Not sure if the order of these two is correct
 	CGX_LOAD_CP_REG(0x50, vtxdesc.Hex0);
 	CGX_LOAD_CP_REG(0x60, vtxdesc.Hex1);
@@ -275,6 +326,9 @@ void Quad::Draw()
 	CGX_LOAD_CP_REG(0x80, vtxattr.g1.Hex);
 	CGX_LOAD_CP_REG(0x90, vtxattr.g2.Hex);
 
+	// Number of colors, normals and texture coordinates per vertex
+	CGX_LOAD_XF_REG(XFMEM_INVTXSPEC, (has_color ? 1 : 0) | ((has_normal ? 1 : 0) << 2) | ((has_texcoords ? 1 : 0) << 4));
+
 	/* TODO: Should reset this matrix..
 	float mtx[3][4];
 	memset(&mtx, 0, sizeof(mtx));
@@ -299,38 +353,59 @@ void Quad::Draw()
 		wgPipe->F32 = y[i];
 		wgPipe->F32 = z[i];
 
+		if (has_normal)
+		{
+			wgPipe->F32 = normal[0];
+			wgPipe->F32 = normal[1];
+			wgPipe->F32 = normal[2];
+		}
+
 		if (has_color)
 			wgPipe->U32 = color;
+
+		if (has_texcoords)
+		{
+			wgPipe->F32 = s[i];
+			wgPipe->F32 = t[i];
+		}
 	}
 }
 
-void CopyToTestBuffer(int left_most_pixel, int top_most_pixel, int right_most_pixel, int bottom_most_pixel)
+void CopyToTestBuffer(int left_most_pixel, int top_most_pixel, int right_most_pixel, int bottom_most_pixel, u8 format)
 {
 	// TODO: Do we need to impose additional constraints on the parameters?
-	memset(test_buffer, 0, TEST_BUFFER_SIZE);
-	CGX_DoEfbCopyTex(left_most_pixel, top_most_pixel,
-	                 right_most_pixel - left_most_pixel + 1,
-	                 bottom_most_pixel - top_most_pixel + 1, 0x6 /*RGBA8*/,
-	                 false, test_buffer);
+	u16 width = right_most_pixel - left_most_pixel + 1;
+	u16 height = bottom_most_pixel - top_most_pixel + 1;
+	assert(!IsDepthCopyFormat(format));
+	assert(CGX_GetEfbCopySize(width, height, format) <= TEST_BUFFER_SIZE);
+	CGX_DoEfbCopyTex(left_most_pixel, top_most_pixel, width, height, format, format <= GX_TF_IA8, test_buffer);
 }
 
-
-Vec4<int> GetTevOutput(const GenMode& genmode, const TevStageCombiner::ColorCombiner& last_cc, const TevStageCombiner::AlphaCombiner& last_ac)
+void CopyDepthToTestBuffer(int left_most_pixel, int top_most_pixel, int right_most_pixel, int bottom_most_pixel, u8 format, const PE_CONTROL& ctrl)
 {
-	int previous_stage = ((last_cc.hex >> 24)-BPMEM_TEV_COLOR_ENV)>>1;
-	assert(previous_stage < 13);
-	assert(previous_stage == (((last_ac.hex >> 24)-BPMEM_TEV_ALPHA_ENV)>>1));
+	u16 width = right_most_pixel - left_most_pixel + 1;
+	u16 height = bottom_most_pixel - top_most_pixel + 1;
+	assert(IsDepthCopyFormat(format));
+	assert(CGX_GetEfbCopySize(width, height, format) <= TEST_BUFFER_SIZE);
+
+	PE_CONTROL depth_ctrl = ctrl;
+	depth_ctrl.pixel_format = PIXELFMT_Z24;
+	CGX_LOAD_BP_REG(depth_ctrl.hex);
+	CGX_DoEfbCopyTex(left_most_pixel, top_most_pixel, width, height, format, false, test_buffer);
+	CGX_LOAD_BP_REG(ctrl.hex);
+}
 
-	// The TEV output gets truncated to 8 bits when writing to the EFB.
-	// Hence, we cannot retrieve all 11 TEV output bits directly.
-	// Instead, we're performing two render passes, one of which retrieves
-	// the lower 6 output bits, the other one of which retrieves the upper
-	// 5 bits.
+void CopyTileToTestBuffer(int x, int y)
+{
+	CGX_DoEfbCopyTex(x & ~3, y & ~3, 4, 4, GX_TF_RGBA8, false, test_buffer);
+}
 
-	// FIRST RENDER PASS:
-	// As set up by the caller, with one additional tev stage multiplying the result by 4.
-	// This will retrieve the lower 6 bits of the TEV output.
 
+// FIRST RENDER PASS:
+// As set up by the caller, with one additional tev stage multiplying the result by 4.
+// This will retrieve the lower 6 bits of the TEV output.
+static void SetupLowBitsPass(const GenMode& genmode, int previous_stage, const TevStageCombiner::ColorCombiner& last_cc, const TevStageCombiner::AlphaCombiner& last_ac)
+{
 	auto gm = genmode;
 	gm.numtevstages = previous_stage + 1; // one additional stage
 	CGX_LOAD_BP_REG(gm.hex);
@@ -346,75 +421,397 @@ Vec4<int> GetTevOutput(const GenMode& genmode, const TevStageCombiner::ColorComb
 	ac1.a = last_ac.dest * 2;
 	ac1.shift = TEVSCALE_4;
 	CGX_LOAD_BP_REG(ac1.hex);
+}
 
-	memset(test_buffer, 0, TEST_BUFFER_SIZE); // Just for debugging
-	Quad().AtDepth(1.0).ColorRGBA(255,255,255,255).Draw();
-	CGX_DoEfbCopyTex(0, 0, 100, 100, 0x6 /*RGBA8*/, false, test_buffer);
-	CGX_ForcePipelineFlush();
-	CGX_WaitForGpuToFinish();
-	u16 result1r = ReadTestBuffer(5, 5, 100).r >> 2;
-	u16 result1g = ReadTestBuffer(5, 5, 100).g >> 2;
-	u16 result1b = ReadTestBuffer(5, 5, 100).b >> 2;
-	u16 result1a = ReadTestBuffer(5, 5, 100).a >> 2;
-
-	// SECOND RENDER PASS
-	// Uses three additional TEV stages which shift the previous result
-	// three bits to the right. This is necessary to read off the 5 upper bits,
-	// 3 of which got masked off when writing to the EFB in the first pass.
-	gm = genmode;
+// SECOND RENDER PASS
+// Uses three additional TEV stages which shift the previous result
+// three bits to the right. This is necessary to read off the 5 upper bits,
+// 3 of which got masked off when writing to the EFB in the first pass.
+static void SetupHighBitsPass(const GenMode& genmode, int previous_stage, const TevStageCombiner::ColorCombiner& last_cc, const TevStageCombiner::AlphaCombiner& last_ac)
+{
+	auto gm = genmode;
 	gm.numtevstages = previous_stage + 3; // three additional stages
 	CGX_LOAD_BP_REG(gm.hex);
 
 	// The following tev stages are exclusively used to rightshift the
 	// upper bits such that they get written to the render target.
-	cc1 = CGXDefault<TevStageCombiner::ColorCombiner>(previous_stage+1);
-	cc1.d = last_cc.dest * 2;
-	cc1.shift = TEVDIVIDE_2;
-	CGX_LOAD_BP_REG(cc1.hex);
+	for (int stage = previous_stage + 1; stage <= previous_stage + 3; ++stage)
+	{
+		auto cc1 = CGXDefault<TevStageCombiner::ColorCombiner>(stage);
+		cc1.d = last_cc.dest * 2;
+		cc1.shift = TEVDIVIDE_2;
+		CGX_LOAD_BP_REG(cc1.hex);
+
+		auto ac1 = CGXDefault<TevStageCombiner::AlphaCombiner>(stage);
+		ac1.d = last_ac.dest * 2;
+		ac1.shift = TEVDIVIDE_2;
+		CGX_LOAD_BP_REG(ac1.hex);
+	}
+}
 
-	ac1 = CGXDefault<TevStageCombiner::AlphaCombiner>(previous_stage+1);
-	ac1.d = last_ac.dest * 2;
-	ac1.shift = TEVDIVIDE_2;
-	CGX_LOAD_BP_REG(ac1.hex);
+int DecodeTevOutput(u8 low_pass_value, u8 high_pass_value)
+{
+	// The first pass stored the output multiplied by 4, i.e. its lower 6 bits
+	// end up in the upper 6 bits of the EFB value. The second pass stored the
+	// output divided by 8, i.e. the upper 5 bits (including the sign bit) end
+	// up in the upper 5 bits of the EFB value.
+	int low_bits = low_pass_value >> 2;
+	int high_bits = high_pass_value >> 3;
 
-	cc1 = CGXDefault<TevStageCombiner::ColorCombiner>(previous_stage+2);
-	cc1.d = last_cc.dest * 2;
-	cc1.shift = TEVDIVIDE_2;
-	CGX_LOAD_BP_REG(cc1.hex);
+	// uh.. let's just say this works, but I guess it could be simplified.
+	return low_bits + ((high_bits & 0x10) ? (-0x400+((high_bits&0xF)<<6)) : (high_bits<<6));
+}
 
-	ac1 = CGXDefault<TevStageCombiner::AlphaCombiner>(previous_stage+2);
-	ac1.d = last_ac.dest * 2;
-	ac1.shift = TEVDIVIDE_2;
-	CGX_LOAD_BP_REG(ac1.hex);
+Vec4<int> DecodeTevOutput(const Vec4<u8>& low_pass_value, const Vec4<u8>& high_pass_value)
+{
+	Vec4<int> result;
+	result.r = DecodeTevOutput(low_pass_value.r, high_pass_value.r);
+	result.g = DecodeTevOutput(low_pass_value.g, high_pass_value.g);
+	result.b = DecodeTevOutput(low_pass_value.b, high_pass_value.b);
+	result.a = DecodeTevOutput(low_pass_value.a, high_pass_value.a);
+	return result;
+}
 
-	cc1 = CGXDefault<TevStageCombiner::ColorCombiner>(previous_stage+3);
-	cc1.d = last_cc.dest * 2;
-	cc1.shift = TEVDIVIDE_2;
-	CGX_LOAD_BP_REG(cc1.hex);
+static int GetTevStage(const TevStageCombiner::ColorCombiner& cc, const TevStageCombiner::AlphaCombiner& ac)
+{
+	int stage = ((cc.hex >> 24)-BPMEM_TEV_COLOR_ENV)>>1;
+	assert(stage < 13);
+	assert(stage == (int)(((ac.hex >> 24)-BPMEM_TEV_ALPHA_ENV)>>1));
+	return stage;
+}
 
-	ac1 = CGXDefault<TevStageCombiner::AlphaCombiner>(previous_stage+3);
-	ac1.d = last_ac.dest * 2;
-	ac1.shift = TEVDIVIDE_2;
-	CGX_LOAD_BP_REG(ac1.hex);
+// Draws both render passes for the given number of test vectors, each pass
+// to its own half of the batch's EFB region, and copies that region to
+// dest. If configs is NULL, the tev state set up by the caller is used.
+static void DrawTevOutputPasses(const GenMode& genmode, const TevStageCombiner::ColorCombiner& last_cc, const TevStageCombiner::AlphaCombiner& last_ac, const TevBatchConfig* configs, int count, void* dest)
+{
+	int previous_stage = GetTevStage(last_cc, last_ac);
 
-	memset(test_buffer, 0, TEST_BUFFER_SIZE);
-	Quad().AtDepth(1.0).ColorRGBA(255,255,255,255).Draw();
-	CGX_DoEfbCopyTex(0, 0, 100, 100, 0x6 /*RGBA8*/, false, test_buffer);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 0)
+			SetupLowBitsPass(genmode, previous_stage, last_cc, last_ac);
+		else
+			SetupHighBitsPass(genmode, previous_stage, last_cc, last_ac);
+
+		for (int i = 0; i < count; ++i)
+		{
+			if (configs)
+			{
+				const TevBatchConfig& config = configs[i];
+				assert(config.cc.hex >> 24 == last_cc.hex >> 24 && config.cc.dest == last_cc.dest);
+				assert(config.ac.hex >> 24 == last_ac.hex >> 24 && config.ac.dest == last_ac.dest);
+
+				for (const TevReg& reg : config.regs)
+				{
+					CGX_LOAD_BP_REG(reg.low);
+					CGX_LOAD_BP_REG(reg.high);
+				}
+				CGX_LOAD_BP_REG(config.cc.hex);
+				CGX_LOAD_BP_REG(config.ac.hex);
+			}
+
+			int x, y;
+			GetTevBatchCell(count, i, pass, &x, &y);
+			CGX_SetViewport(x, y, TEV_BATCH_CELL_SIZE, TEV_BATCH_CELL_SIZE, 0.0f, 1.0f);
+			Quad().AtDepth(1.0).ColorRGBA(255,255,255,255).Draw();
+		}
+	}
+
+	int copy_width, copy_height;
+	GetTevBatchCopySize(count, &copy_width, &copy_height);
+	CGX_DoEfbCopyTex(0, 0, copy_width, copy_height, 0x6 /*RGBA8*/, false, dest);
+
+	CGX_SetViewport(0.0f, 0.0f, 640.0f, 528.0f, 0.0f, 1.0f);
+}
+
+Vec4<int> GetTevOutput(const GenMode& genmode, const TevStageCombiner::ColorCombiner& last_cc, const TevStageCombiner::AlphaCombiner& last_ac)
+{
+	// The TEV output gets truncated to 8 bits when writing to the EFB.
+	// Hence, we cannot retrieve all 11 TEV output bits directly.
+	// Instead, we're performing two render passes, one of which retrieves
+	// the lower 6 output bits, the other one of which retrieves the upper
+	// 5 bits. Both passes are drawn next to each other, such that a single
+	// EFB copy is enough to read back the results.
+	DrawTevOutputPasses(genmode, last_cc, last_ac, NULL, 1, test_buffer);
 	CGX_ForcePipelineFlush();
 	CGX_WaitForGpuToFinish();
 
-	u16 result2r = ReadTestBuffer(5, 5, 100).r >> 3;
-	u16 result2g = ReadTestBuffer(5, 5, 100).g >> 3;
-	u16 result2b = ReadTestBuffer(5, 5, 100).b >> 3;
-	u16 result2a = ReadTestBuffer(5, 5, 100).a >> 3;
-
-	// uh.. let's just say this works, but I guess it could be simplified.
 	Vec4<int> result;
-	result.r = result1r + ((result2r & 0x10) ? (-0x400+((result2r&0xF)<<6)) : (result2r<<6));
-	result.g = result1g + ((result2g & 0x10) ? (-0x400+((result2g&0xF)<<6)) : (result2g<<6));
-	result.b = result1b + ((result2b & 0x10) ? (-0x400+((result2b&0xF)<<6)) : (result2b<<6));
-	result.a = result1a + ((result2a & 0x10) ? (-0x400+((result2a&0xF)<<6)) : (result2a<<6));
+	DecodeTevBatch(test_buffer, 1, &result);
 	return result;
 }
 
+Vec4<u8> DecodeRGBA8Pixel(const void* data, int x, int y, int width)
+{
+	int width_blocks = (width + 3) >> 2;
+	u32 block = ((y >> 2) * width_blocks + (x >> 2)) << 6;
+	u32 offset = block + ((((y & 3) << 2) + (x & 3)) << 1);
+	const u8* val_addr = (const u8*)data + offset;
+
+	Vec4<u8> ret;
+	ret.r = val_addr[1];
+	ret.g = val_addr[32];
+	ret.b = val_addr[33];
+	ret.a = val_addr[0];
+	return ret;
+}
+
+static void SetTevRegLane(TevReg& reg, int lane, int value)
+{
+	switch (lane)
+	{
+	case 0: reg.red = value; break;
+	case 1: reg.green = value; break;
+	case 2: reg.blue = value; break;
+	case 3: reg.alpha = value; break;
+	}
+}
+
+void PackTevLanes(const TevLaneInputs lanes[4], TevReg regs[4])
+{
+	regs[0] = CGXDefault<TevReg>(0, false); // prev
+	regs[1] = CGXDefault<TevReg>(1, false); // c0
+	regs[2] = CGXDefault<TevReg>(2, false); // c1
+	regs[3] = CGXDefault<TevReg>(3, false); // c2
+
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		SetTevRegLane(regs[0], lane, lanes[lane].d);
+		SetTevRegLane(regs[1], lane, lanes[lane].a);
+		SetTevRegLane(regs[2], lane, lanes[lane].b);
+		SetTevRegLane(regs[3], lane, lanes[lane].c);
+	}
+}
+
+// Number of cells per row of one render pass region
+static int GetTevBatchColumns(int count)
+{
+	return (count < TEV_BATCH_CELLS_PER_ROW) ? count : TEV_BATCH_CELLS_PER_ROW;
+}
+
+void GetTevBatchCell(int count, int index, int pass, int* x, int* y)
+{
+	assert(count > 0 && count <= TEV_BATCH_MAX_SIZE);
+	assert(index >= 0 && index < count);
+	assert(pass == 0 || pass == 1);
+
+	int pass_width = GetTevBatchColumns(count) * TEV_BATCH_CELL_SIZE;
+	*x = pass * pass_width + (index % TEV_BATCH_CELLS_PER_ROW) * TEV_BATCH_CELL_SIZE;
+	*y = (index / TEV_BATCH_CELLS_PER_ROW) * TEV_BATCH_CELL_SIZE;
+}
+
+void GetTevBatchCopySize(int count, int* width, int* height)
+{
+	int num_rows = (count + TEV_BATCH_CELLS_PER_ROW - 1) / TEV_BATCH_CELLS_PER_ROW;
+	*width = 2 * GetTevBatchColumns(count) * TEV_BATCH_CELL_SIZE;
+	*height = num_rows * TEV_BATCH_CELL_SIZE;
+}
+
+void DecodeTevBatch(const void* copy, int count, Vec4<int>* results)
+{
+	int copy_width, copy_height;
+	GetTevBatchCopySize(count, &copy_width, &copy_height);
+
+	for (int i = 0; i < count; ++i)
+	{
+		// Sample the cell centers to stay clear of any rasterization edge cases
+		int x[2], y[2];
+		Vec4<u8> val[2];
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			GetTevBatchCell(count, i, pass, &x[pass], &y[pass]);
+			val[pass] = DecodeRGBA8Pixel(copy, x[pass] + TEV_BATCH_CELL_SIZE / 2, y[pass] + TEV_BATCH_CELL_SIZE / 2, copy_width);
+		}
+
+		results[i] = DecodeTevOutput(val[0], val[1]);
+	}
+}
+
+u32 GetTevBatchBufferSize(int count)
+{
+	int copy_width, copy_height;
+	GetTevBatchCopySize(count, &copy_width, &copy_height);
+	return CGX_GetEfbCopySize(copy_width, copy_height, 0x6 /*RGBA8*/);
+}
+
+void GetTevOutputBatch(const GenMode& genmode, const TevBatchConfig* configs, int count, Vec4<int>* results)
+{
+	DrawTevOutputPasses(genmode, configs[0].cc, configs[0].ac, configs, count, test_buffer);
+	CGX_ForcePipelineFlush();
+	CGX_WaitForGpuToFinish();
+
+	DecodeTevBatch(test_buffer, count, results);
+}
+
+void SubmitTevOutputBatch(const GenMode& genmode, const TevBatchConfig* configs, int count, void* dest)
+{
+	DrawTevOutputPasses(genmode, configs[0].cc, configs[0].ac, configs, count, dest);
+}
+
+u16 GpuFences::InsertFence()
+{
+	return CGX_InsertFence();
+}
+
+bool GpuFences::IsFenceReached(u16 fence)
+{
+	return CGX_IsFenceReached(fence);
+}
+
+void GpuFences::WaitForFence(u16 fence)
+{
+	CGX_WaitForFence(fence);
+}
+
+void GpuBoundingBox::ClearBoundingBox()
+{
+	CGX_ClearBoundingBox();
+}
+
+void GpuBoundingBox::ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom)
+{
+	CGX_WaitForGpuToFinish();
+	CGX_ReadBoundingBox(left, right, top, bottom);
+}
+
+TevLaneInputs GetTevInputTexel(int frame, int x, int y)
+{
+	u32 combination = ((u32)frame * TEV_INPUT_FRAME_SIZE + y * 640 + x) & 0xFFFFFF;
+
+	TevLaneInputs ret;
+	ret.a = combination & 0xFF;
+	ret.b = (combination >> 8) & 0xFF;
+	ret.c = combination >> 16;
+	ret.d = 0;
+	return ret;
+}
+
+// I8 textures consist of 8x4 pixel blocks of 32 bytes each
+static u32 GetI8TexelOffset(int x, int y, int width)
+{
+	int width_blocks = (width + 7) >> 3;
+	u32 block = ((y >> 2) * width_blocks + (x >> 3)) << 5;
+	return block + ((y & 3) << 3) + (x & 7);
+}
+
+void GenerateTevInputTextures(int frame, u8* tex_a, u8* tex_b, u8* tex_c)
+{
+	for (int y = 0; y < 528; ++y)
+	{
+		for (int x = 0; x < 640; ++x)
+		{
+			TevLaneInputs inputs = GetTevInputTexel(frame, x, y);
+			u32 offset = GetI8TexelOffset(x, y, 640);
+			tex_a[offset] = inputs.a;
+			tex_b[offset] = inputs.b;
+			tex_c[offset] = inputs.c;
+		}
+	}
+}
+
+u8 DecodeI8Pixel(const void* data, int x, int y, int width)
+{
+	return ((const u8*)data)[GetI8TexelOffset(x, y, width)];
+}
+
+void DecodeTevOutputFrame(const void* copy, int pass, s16* results)
+{
+	static Vec4<u8> pixels[TEV_INPUT_FRAME_SIZE];
+	DecodeRGBA8Image(copy, 640, 528, pixels);
+
+	for (int i = 0; i < TEV_INPUT_FRAME_SIZE; ++i)
+	{
+		u8 val = pixels[i].r;
+		results[i] = (pass == 0) ? val : DecodeTevOutput((u8)results[i], val);
+	}
+}
+
+void GetTevOutputFrame(const GenMode& genmode, const TevStageCombiner::ColorCombiner& cc, const TevStageCombiner::AlphaCombiner& ac, int frame, s16* results)
+{
+	assert(GetTevStage(cc, ac) == TEV_INPUT_STAGE);
+
+	GenerateTevInputTextures(frame, tev_input_textures[0], tev_input_textures[1], tev_input_textures[2]);
+	for (int i = 0; i < 3; ++i)
+		CGX_LoadTexture(i, tev_input_textures[i], 640, 528, 0x1 /*I8*/);
+
+	// One texgen, passing through the vertex texture coordinates
+	TMatrixIndexA mtxidx;
+	mtxidx.Hex = 0;
+	mtxidx.PosNormalMtxIdx = 0;
+	mtxidx.Tex0MtxIdx = 60; // GX_IDENTITY
+	CGX_LOAD_CP_REG(0x30, mtxidx.Hex);
+	CGX_LOAD_XF_REG(0x1018, mtxidx.Hex);
+
+	CGX_BEGIN_LOAD_XF_REGS(60 * 4, 8); // 2x4 identity texture matrix
+	wgPipe->F32 = 1.0f;
+	wgPipe->F32 = 0.0f;
+	wgPipe->F32 = 0.0f;
+	wgPipe->F32 = 0.0f;
+	wgPipe->F32 = 0.0f;
+	wgPipe->F32 = 1.0f;
+	wgPipe->F32 = 0.0f;
+	wgPipe->F32 = 0.0f;
+
+	CGX_LOAD_XF_REG(0x103f, 1); // number of texgens
+	CGX_LOAD_XF_REG(0x1040, 5 << 7); // regular texgen, ST projection, AB11 input form, source row TEX0
+	CGX_LOAD_XF_REG(0x1050, 61); // identity post-transform matrix, no normalization
+
+	CGX_LOAD_BP_REG((BPMEM_SU_SSIZE << 24) | (640 - 1));
+	CGX_LOAD_BP_REG((BPMEM_SU_TSIZE << 24) | (528 - 1));
+
+	// Stages 0 to 2 read texture maps 0 to 2 and write them to c0, c1 and c2
+	auto orders = CGXDefault<TwoTevStageOrders>(0);
+	orders.texmap0 = 0;
+	orders.texcoord0 = 0;
+	orders.enable0 = 1;
+	orders.texmap1 = 1;
+	orders.texcoord1 = 0;
+	orders.enable1 = 1;
+	CGX_LOAD_BP_REG(orders.hex);
+
+	orders = CGXDefault<TwoTevStageOrders>(1);
+	orders.texmap0 = 2;
+	orders.texcoord0 = 0;
+	orders.enable0 = 1;
+	CGX_LOAD_BP_REG(orders.hex);
+
+	for (int stage = 0; stage < TEV_INPUT_STAGE; ++stage)
+	{
+		auto input_cc = CGXDefault<TevStageCombiner::ColorCombiner>(stage);
+		input_cc.d = TEVCOLORARG_TEXC;
+		input_cc.dest = GX_TEVREG0 + stage;
+		CGX_LOAD_BP_REG(input_cc.hex);
+		CGX_LOAD_BP_REG(CGXDefault<TevStageCombiner::AlphaCombiner>(stage).hex);
+	}
+	CGX_LOAD_BP_REG(cc.hex);
+	CGX_LOAD_BP_REG(ac.hex);
+
+	auto gm = genmode;
+	gm.numtexgens = 1;
+
+	// The render passes cover the whole EFB, so they need one copy each
+	CGX_SetViewport(0.0f, 0.0f, 640.0f, 528.0f, 0.0f, 1.0f);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 0)
+			SetupLowBitsPass(gm, TEV_INPUT_STAGE, cc, ac);
+		else
+			SetupHighBitsPass(gm, TEV_INPUT_STAGE, cc, ac);
+
+		Quad().AtDepth(1.0).ColorRGBA(255,255,255,255).TexCoords(0.0f, 0.0f, 1.0f, 1.0f).Draw();
+		CGX_DoEfbCopyTex(0, 0, 640, 528, 0x6 /*RGBA8*/, false, test_buffer);
+		CGX_ForcePipelineFlush();
+		CGX_WaitForGpuToFinish();
+
+		DecodeTevOutputFrame(test_buffer, pass, results);
+	}
+
+	// Restore texture-less state
+	CGX_LOAD_XF_REG(0x103f, 0);
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(1).hex);
+	CGX_LOAD_BP_REG(genmode.hex);
+}
+
 }
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include "readback_ring.h"
+#include "coverage_probe.h"
+
 namespace GXTest
 {
 
@@ -36,13 +39,25 @@ public:
 
 	Quad& ColorRGBA(u8 r, u8 g, u8 b, u8 a);
 
+	// Normal shared by all vertices, transformed by normal matrix 0
+	Quad& Normal(f32 nx, f32 ny, f32 nz);
+
+	// Texture coordinates (texcoord 0) of the quad edges
+	Quad& TexCoords(f32 left, f32 top, f32 right, f32 bottom);
+
 	void Draw();
 
 private:
 	f32 x[4], y[4], z[4];
 
+	bool has_normal;
+	f32 normal[3];
+
 	bool has_color;
 	u32 color;
+
+	bool has_texcoords;
+	f32 s[4], t[4];
 };
 
 // Initialize CGX and GXTest
@@ -52,21 +67,163 @@ void Init();
 // Modifies the first vertex attribute and descriptor, as well as matrix state
 void DrawFullScreenQuad();
 
-// Perform an RGBA8 EFB copy to the internal testing buffer
-void CopyToTestBuffer(int left_most_pixel, int top_most_pixel, int right_most_pixel, int bottom_most_pixel);
+// Perform an EFB copy to the internal testing buffer
+// format is any color copy format (GX_TF_X or GX_CTF_X), intensity formats
+// enable the intensity conversion of the copy.
+void CopyToTestBuffer(int left_most_pixel, int top_most_pixel, int right_most_pixel, int bottom_most_pixel, u8 format = GX_TF_RGBA8);
 
 // Read back result from test buffer
-// CopyToTestBuffer needs to be called before using this.
+// CopyToTestBuffer needs to be called before using this, format must match
+// the one of the copy. See DecodeCopyPixel for how channels are expanded.
 // After that, this function is free to use in terms of performance.
-Vec4<u8> ReadTestBuffer(int x, int y, int previous_copy_width);
+Vec4<u8> ReadTestBuffer(int x, int y, int previous_copy_width, u8 format = GX_TF_RGBA8);
+
+// Perform an EFB depth copy to the internal testing buffer
+// format is any depth copy format (GX_TF_ZX or GX_CTF_ZX). The hardware
+// copies depth instead of color if the pixel format is PIXELFMT_Z24, so the
+// copy temporarily switches to that format. ctrl needs to be the PE_CONTROL
+// setting currently in use, it is restored after the copy.
+void CopyDepthToTestBuffer(int left_most_pixel, int top_most_pixel, int right_most_pixel, int bottom_most_pixel, u8 format, const PE_CONTROL& ctrl);
+
+// Read back a 24 bit depth value after CopyDepthToTestBuffer, see DecodeDepthPixel
+u32 ReadTestBufferDepth(int x, int y, int previous_copy_width, u8 format);
+
+// Contents of the test buffer, e.g. for decoding a whole copy at once with
+// DecodeRGBA8Image. Like ReadTestBuffer, only use this after the copy is done.
+const void* GetTestBuffer();
+
+// Copy just the 4x4 pixel block (a single RGBA8 tile of 64 bytes) which
+// contains the given EFB pixel, for tests which only probe a few pixels.
+void CopyTileToTestBuffer(int x, int y);
+
+// Read back the given EFB pixel after CopyTileToTestBuffer
+Vec4<u8> ReadTestBufferTile(int x, int y);
 
 // Read back output of the last tev stage (all 11 bits)
 // The BP registers last_cc and last_ac must have already been written before
 // calling this function. The function logic adds 3 additional tev stages,
 // so care must be taken not to enable more than 13 tev stages before usage.
+// Modifies the viewport.
 // NOTE: This will only work correctly if the EFB format is set to RGB8
 Vec4<int> GetTevOutput(const GenMode& genmode, const TevStageCombiner::ColorCombiner& last_cc, const TevStageCombiner::AlphaCombiner& last_ac);
 
+// Reconstruct the 11 bit tev output from the EFB values written by the two
+// render passes of GetTevOutput.
+int DecodeTevOutput(u8 low_pass_value, u8 high_pass_value);
+Vec4<int> DecodeTevOutput(const Vec4<u8>& low_pass_value, const Vec4<u8>& high_pass_value);
+
+// Decode a single pixel of an RGBA8 texture stored in GX tiled layout
+Vec4<u8> DecodeRGBA8Pixel(const void* data, int x, int y, int width);
+
+// A single test vector for GetTevOutputBatch
+struct TevBatchConfig
+{
+	TevReg regs[4]; // prev, c0, c1, c2
+	TevStageCombiner::ColorCombiner cc;
+	TevStageCombiner::AlphaCombiner ac;
+};
+
+// Inputs of a single tev combiner evaluation
+struct TevLaneInputs
+{
+	int a, b, c, d;
+};
+
+// Pack four independent sets of combiner inputs into the r, g, b and a
+// channels of the tev registers prev, c0, c1 and c2 (stored in that order,
+// matching TevBatchConfig::regs). A stage using c0, c1, c2 and prev as its
+// a, b, c and d inputs will then evaluate lanes[0] in its red channel,
+// lanes[1] in green, lanes[2] in blue and lanes[3] in alpha. Note that the
+// latter is evaluated by the alpha combiner, which has its own settings.
+void PackTevLanes(const TevLaneInputs lanes[4], TevReg regs[4]);
+
+// Each test vector of a batch is drawn to its own EFB cell of this size,
+// once for each render pass. The cells of the first pass are located in the
+// left half of the batch's EFB region, the ones of the second pass in the
+// right half.
+#define TEV_BATCH_CELL_SIZE 4
+#define TEV_BATCH_CELLS_PER_ROW (640 / TEV_BATCH_CELL_SIZE / 2)
+#define TEV_BATCH_MAX_SIZE (TEV_BATCH_CELLS_PER_ROW * (528 / TEV_BATCH_CELL_SIZE))
+
+// Top left EFB coordinates of the cell used for the given test vector and render pass
+void GetTevBatchCell(int count, int index, int pass, int* x, int* y);
+
+// Size of the EFB region (starting at the origin) which covers all cells of a batch
+void GetTevBatchCopySize(int count, int* width, int* height);
+
+// Decode the EFB copy of a batch's region
+void DecodeTevBatch(const void* copy, int count, Vec4<int>* results);
+
+// Batched version of GetTevOutput
+// For each test vector, the tev registers and the color/alpha combiners of
+// the last tev stage are reloaded before drawing a small quad to the vector's
+// own EFB cell. All test vectors must use the same tev stage and destination
+// register. Only a single EFB copy is required for the whole batch, hence
+// this is a lot faster than calling GetTevOutput for each test vector.
+// Modifies the viewport and the tev registers.
+void GetTevOutputBatch(const GenMode& genmode, const TevBatchConfig* configs, int count, Vec4<int>* results);
+
+// Size in bytes of the EFB copy of a batch's region
+u32 GetTevBatchBufferSize(int count);
+
+// Asynchronous version of GetTevOutputBatch
+// Issues the same commands, but copies the results to dest (which must hold
+// GetTevBatchBufferSize(count) bytes) and doesn't wait for the GPU. Use a
+// fence (e.g. via ReadbackRing) to tell when dest can be passed to DecodeTevBatch.
+// Modifies the viewport and the tev registers.
+void SubmitTevOutputBatch(const GenMode& genmode, const TevBatchConfig* configs, int count, void* dest);
+
+// Fences in the GPU command stream, see CGX_InsertFence
+class GpuFences : public FenceSource
+{
+public:
+	u16 InsertFence();
+	bool IsFenceReached(u16 fence);
+	void WaitForFence(u16 fence);
+};
+
+// Bounding box registers of the pixel engine, see CGX_ClearBoundingBox
+class GpuBoundingBox : public BoundingBoxSource
+{
+public:
+	void ClearBoundingBox();
+	void ReadBoundingBox(u16* left, u16* right, u16* top, u16* bottom);
+};
+
+// Per-pixel tev inputs:
+// Instead of evaluating a single set of inputs per draw, GetTevOutputFrame
+// fetches the a, b and c inputs of the tested tev stage from three I8 textures,
+// so that each EFB pixel evaluates a different combination of inputs. Since
+// the combiners only use the lower 8 bits of these inputs, the full input
+// space consists of 2^24 combinations, each frame covering 640*528 of them.
+#define TEV_INPUT_FRAME_SIZE (640*528)
+#define TEV_INPUT_FRAME_COUNT (((1 << 24) + TEV_INPUT_FRAME_SIZE - 1) / TEV_INPUT_FRAME_SIZE)
+
+// Stages 0 to 2 copy the input textures to c0, c1 and c2, hence the tested
+// stage must be stage 3 and use these registers for its inputs.
+#define TEV_INPUT_STAGE 3
+
+// Inputs evaluated at the given EFB pixel of the given frame
+TevLaneInputs GetTevInputTexel(int frame, int x, int y);
+
+// Fill the three 640x528 I8 input textures (GX tiled layout) for the given frame
+void GenerateTevInputTextures(int frame, u8* tex_a, u8* tex_b, u8* tex_c);
+
+// Decode a single pixel of an I8 texture stored in GX tiled layout
+u8 DecodeI8Pixel(const void* data, int x, int y, int width);
+
+// Decode the full-EFB copy of one render pass of GetTevOutputFrame.
+// The first pass (pass=0) stores the raw EFB values in results,
+// the second pass (pass=1) turns these into the 11 bit tev output (red channel).
+void DecodeTevOutputFrame(const void* copy, int pass, s16* results);
+
+// Read back the tev output for every pixel of the given input frame.
+// cc and ac configure tev stage TEV_INPUT_STAGE, the previous stages are set
+// up by this function. results must hold TEV_INPUT_FRAME_SIZE elements,
+// which are stored in row-major order.
+// Modifies the viewport, texture, texgen and tev order state.
+void GetTevOutputFrame(const GenMode& genmode, const TevStageCombiner::ColorCombiner& cc, const TevStageCombiner::AlphaCombiner& ac, int frame, s16* results);
+
 void DebugDisplayEfbContents();
 
 
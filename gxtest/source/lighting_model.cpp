@@ -0,0 +1,234 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <math.h>
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "lighting_tables.h"
+#include "lighting_model.h"
+
+namespace GXTest
+{
+
+static inline float Dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Vertex data of a chunk of vertices, along with the direction and distance
+// to the light, computed once per light
+struct LightChunk
+{
+	enum { SIZE = 64 };
+
+	float pos[3][SIZE];
+	float normal[3][SIZE];
+	float ldir[3][SIZE];
+	float dist[SIZE];
+	float dist2[SIZE];
+	float attn[SIZE];
+	int count;
+};
+
+static void LoadLightChunk(const LightingVertices& vertices, int first, LightChunk& chunk)
+{
+	chunk.count = (vertices.count - first < LightChunk::SIZE) ? vertices.count - first : LightChunk::SIZE;
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int v = 0; v < chunk.count; ++v)
+		{
+			chunk.pos[i][v] = vertices.pos[i][first + v];
+			chunk.normal[i][v] = vertices.normal[i][first + v];
+		}
+	}
+}
+
+// Each of the following loops handles a single diffuse or attenuation
+// function, and selects values instead of branching, so that all of them
+// get vectorized.
+
+// a / b if valid is 1.0f, 0.0f if valid is 0.0f, which it is only for b = 0
+// GCC doesn't vectorize divisions in one branch of a conditional, since they
+// might trap. Instead, the zero divisor is replaced by 1.0f.
+static inline float DivideIfValid(float valid, float a, float b)
+{
+	return a / (b + (1.0f - valid)) * valid;
+}
+
+// Direction from the vertex to the light, for all attenuation functions
+static void ComputeLightDirections(const Light& light, LightChunk& chunk)
+{
+	const int count = chunk.count;
+	for (int v = 0; v < count; ++v)
+	{
+		float dx = light.dpos[0] - chunk.pos[0][v];
+		float dy = light.dpos[1] - chunk.pos[1][v];
+		float dz = light.dpos[2] - chunk.pos[2][v];
+		float dist2 = dx * dx + dy * dy + dz * dz;
+		float dist = sqrtf(dist2);
+		float valid = (dist > 0.0f) ? 1.0f : 0.0f;
+		chunk.ldir[0][v] = DivideIfValid(valid, dx, dist);
+		chunk.ldir[1][v] = DivideIfValid(valid, dy, dist);
+		chunk.ldir[2][v] = DivideIfValid(valid, dz, dist);
+		chunk.dist[v] = dist;
+		chunk.dist2[v] = dist2;
+	}
+}
+
+// Quadratic of the angle term divided by the quadratic of the distance term
+static inline float Attenuate(const Light& light, float angle, float distatt)
+{
+	float cosatt = light.cosatt[0] + light.cosatt[1] * angle + light.cosatt[2] * angle * angle;
+	cosatt = (cosatt > 0.0f) ? cosatt : 0.0f;
+	return DivideIfValid((distatt != 0.0f) ? 1.0f : 0.0f, cosatt, distatt);
+}
+
+static void ComputeSpecularAttenuation(u32 diffusefunc, const Light& light, LightChunk& chunk)
+{
+	// The light direction stores the half-angle vector. The distance
+	// coefficients are normalized (as a vector) unless the diffuse
+	// function is disabled.
+	float distatt[3] = { light.distatt[0], light.distatt[1], light.distatt[2] };
+	float length = sqrtf(Dot(distatt, distatt));
+	if (diffusefunc != LIGHTDIF_NONE && length > 0.0f)
+		for (int i = 0; i < 3; ++i)
+			distatt[i] /= length;
+
+	const int count = chunk.count;
+	for (int v = 0; v < count; ++v)
+	{
+		float nx = chunk.normal[0][v], ny = chunk.normal[1][v], nz = chunk.normal[2][v];
+		float facing = nx * chunk.ldir[0][v] + ny * chunk.ldir[1][v] + nz * chunk.ldir[2][v];
+		float angle = nx * light.ddir[0] + ny * light.ddir[1] + nz * light.ddir[2];
+		angle = (angle > 0.0f) ? angle : 0.0f;
+		angle = (facing < 0.0f) ? 0.0f : angle;
+		chunk.attn[v] = Attenuate(light, angle, distatt[0] + distatt[1] * angle + distatt[2] * angle * angle);
+	}
+}
+
+static void ComputeSpotAttenuation(const Light& light, LightChunk& chunk)
+{
+	const int count = chunk.count;
+	for (int v = 0; v < count; ++v)
+	{
+		float angle = chunk.ldir[0][v] * light.ddir[0] + chunk.ldir[1][v] * light.ddir[1] + chunk.ldir[2][v] * light.ddir[2];
+		angle = (angle > 0.0f) ? angle : 0.0f;
+		float dist = chunk.dist[v];
+		chunk.attn[v] = Attenuate(light, angle, light.distatt[0] + light.distatt[1] * dist + light.distatt[2] * chunk.dist2[v]);
+	}
+}
+
+// Factor by which the light color gets scaled for each vertex of the chunk
+static void ComputeLightFactors(u32 diffusefunc, u32 attnfunc, const Light& light, LightChunk& chunk, float* factors)
+{
+	const int count = chunk.count;
+	ComputeLightDirections(light, chunk);
+
+	if (attnfunc == LIGHTATTN_SPEC)
+		ComputeSpecularAttenuation(diffusefunc, light, chunk);
+	else if (attnfunc == LIGHTATTN_SPOT)
+		ComputeSpotAttenuation(light, chunk);
+	else
+		for (int v = 0; v < count; ++v)
+			chunk.attn[v] = 1.0f;
+
+	if (diffusefunc == LIGHTDIF_NONE)
+	{
+		for (int v = 0; v < count; ++v)
+			factors[v] = chunk.attn[v];
+		return;
+	}
+
+	const bool clamp = (diffusefunc == LIGHTDIF_CLAMP);
+	for (int v = 0; v < count; ++v)
+	{
+		float diffuse = chunk.ldir[0][v] * chunk.normal[0][v] + chunk.ldir[1][v] * chunk.normal[1][v] + chunk.ldir[2][v] * chunk.normal[2][v];
+		diffuse = (clamp && !(diffuse > 0.0f)) ? 0.0f : diffuse;
+		factors[v] = chunk.attn[v] * diffuse;
+	}
+}
+
+// Round half away from zero
+static inline int RoundContribution(float value)
+{
+	return (int)(value + ((value >= 0.0f) ? 0.5f : -0.5f));
+}
+
+static inline int GetComponent(u32 rgba, int component)
+{
+	return (rgba >> (24 - 8 * component)) & 0xFF;
+}
+
+int LightContribution(const LitChannel& chan, const Light& light, int component, const float pos[3], const float normal[3])
+{
+	const LightingVertices vertex = { { &pos[0], &pos[1], &pos[2] }, { &normal[0], &normal[1], &normal[2] }, 1 };
+	LightChunk chunk;
+	LoadLightChunk(vertex, 0, chunk);
+	float factor;
+	ComputeLightFactors(chan.diffusefunc, chan.attnfunc, light, chunk, &factor);
+	return RoundContribution(factor * (float)GetComponent(light.color, component));
+}
+
+void ComputeLitColors(const LightingChannel& chan, const Light lights[8], const LightingVertices& vertices, u32* colors)
+{
+	// Vertices are processed in chunks, light by light
+	LightChunk chunk;
+	float factors[LightChunk::SIZE];
+	int lit[4][LightChunk::SIZE];
+
+	const LitChannel* channels[4] = { &chan.color, &chan.color, &chan.color, &chan.alpha };
+	const u32 color_mask = chan.color.GetFullLightMask();
+	const u32 alpha_mask = chan.alpha.GetFullLightMask();
+
+	for (int first = 0; first < vertices.count; first += LightChunk::SIZE)
+	{
+		LoadLightChunk(vertices, first, chunk);
+		const int count = chunk.count;
+
+		for (int component = 0; component < 4; ++component)
+			for (int v = 0; v < count; ++v)
+				lit[component][v] = GetComponent(chan.ambcolor, component);
+
+		for (int i = 0; i < 8; ++i)
+		{
+			const Light& light = lights[i];
+
+			// Color and alpha channels may use different functions
+			for (int component = 0; component < 4; component += 3)
+			{
+				u32 mask = (component == 3) ? alpha_mask : color_mask;
+				if (!(mask & (1 << i)))
+					continue;
+
+				const LitChannel& lit_chan = *channels[component];
+				ComputeLightFactors(lit_chan.diffusefunc, lit_chan.attnfunc, light, chunk, factors);
+
+				int last_component = (component == 3) ? 3 : 2;
+				for (int c = component; c <= last_component; ++c)
+				{
+					float light_color = (float)GetComponent(light.color, c);
+					for (int v = 0; v < count; ++v)
+						lit[c][v] += RoundContribution(factors[v] * light_color);
+				}
+			}
+		}
+
+		for (int v = 0; v < count; ++v)
+		{
+			u32 color = 0;
+			for (int component = 0; component < 4; ++component)
+			{
+				// Without lighting, the material color is passed through
+				int value = channels[component]->enablelighting ? lit[component][v] : 255;
+				value = (value < 0) ? 0 : (value > 255) ? 255 : value;
+				color |= LookupLightingMaterial(GetComponent(chan.matcolor, component), value) << (24 - 8 * component);
+			}
+			colors[first + v] = color;
+		}
+	}
+}
+
+} // namespace
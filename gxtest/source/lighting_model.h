@@ -0,0 +1,47 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Reference model of the XF lighting unit
+// Computes the lit colors of a channel for many vertices at once. Vertex
+// data is passed as one array per coordinate, and each attenuation and
+// diffuse function has a branch-free loop over vertices, so that the
+// per-light loops get vectorized (on the host, see Makefile.host).
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// View space positions and normals of count vertices
+struct LightingVertices
+{
+	const float* pos[3];
+	const float* normal[3];
+	int count;
+};
+
+// Setup of one color channel (COLOR0A0 or COLOR1A1)
+// Material and ambient colors are always taken from the registers.
+struct LightingChannel
+{
+	LitChannel color; // lights the r, g and b components
+	LitChannel alpha; // lights the a component
+	u32 matcolor; // RGBA, with red in the most significant byte
+	u32 ambcolor;
+};
+
+// Contribution of a single light to the given component (0-3: r, g, b, a)
+// of a vertex. The light direction and attenuation are computed in floating
+// point, the result is rounded to an integer.
+int LightContribution(const LitChannel& chan, const Light& light, int component, const float pos[3], const float normal[3]);
+
+// Compute the lit RGBA colors (red in the most significant byte) of all vertices.
+// Contributions of the enabled lights are accumulated on top of the ambient
+// color in integer math, clamped to [0, 255] and multiplied by the material
+// color, see LightingMaterialExpectation.
+void ComputeLitColors(const LightingChannel& chan, const Light lights[8], const LightingVertices& vertices, u32* colors);
+
+} // namespace
@@ -0,0 +1,46 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include "lighting_tables.h"
+
+namespace GXTest
+{
+
+// Expands f(i) for i = base ... base+N-1, separated by commas
+#define LIGHTING_TABLE_4(f, base) f(base), f((base)+1), f((base)+2), f((base)+3)
+#define LIGHTING_TABLE_16(f, base) LIGHTING_TABLE_4(f, base), LIGHTING_TABLE_4(f, (base)+4), LIGHTING_TABLE_4(f, (base)+8), LIGHTING_TABLE_4(f, (base)+12)
+#define LIGHTING_TABLE_256(f, base) LIGHTING_TABLE_16(f, base), LIGHTING_TABLE_16(f, (base)+16), LIGHTING_TABLE_16(f, (base)+32), LIGHTING_TABLE_16(f, (base)+48), \
+	LIGHTING_TABLE_16(f, (base)+64), LIGHTING_TABLE_16(f, (base)+80), LIGHTING_TABLE_16(f, (base)+96), LIGHTING_TABLE_16(f, (base)+112), \
+	LIGHTING_TABLE_16(f, (base)+128), LIGHTING_TABLE_16(f, (base)+144), LIGHTING_TABLE_16(f, (base)+160), LIGHTING_TABLE_16(f, (base)+176), \
+	LIGHTING_TABLE_16(f, (base)+192), LIGHTING_TABLE_16(f, (base)+208), LIGHTING_TABLE_16(f, (base)+224), LIGHTING_TABLE_16(f, (base)+240)
+#define LIGHTING_TABLE_4096(f, base) LIGHTING_TABLE_256(f, base), LIGHTING_TABLE_256(f, (base)+256), LIGHTING_TABLE_256(f, (base)+512), LIGHTING_TABLE_256(f, (base)+768), \
+	LIGHTING_TABLE_256(f, (base)+1024), LIGHTING_TABLE_256(f, (base)+1280), LIGHTING_TABLE_256(f, (base)+1536), LIGHTING_TABLE_256(f, (base)+1792), \
+	LIGHTING_TABLE_256(f, (base)+2048), LIGHTING_TABLE_256(f, (base)+2304), LIGHTING_TABLE_256(f, (base)+2560), LIGHTING_TABLE_256(f, (base)+2816), \
+	LIGHTING_TABLE_256(f, (base)+3072), LIGHTING_TABLE_256(f, (base)+3328), LIGHTING_TABLE_256(f, (base)+3584), LIGHTING_TABLE_256(f, (base)+3840)
+#define LIGHTING_TABLE_65536(f) LIGHTING_TABLE_4096(f, 0), LIGHTING_TABLE_4096(f, 4096), LIGHTING_TABLE_4096(f, 8192), LIGHTING_TABLE_4096(f, 12288), \
+	LIGHTING_TABLE_4096(f, 16384), LIGHTING_TABLE_4096(f, 20480), LIGHTING_TABLE_4096(f, 24576), LIGHTING_TABLE_4096(f, 28672), \
+	LIGHTING_TABLE_4096(f, 32768), LIGHTING_TABLE_4096(f, 36864), LIGHTING_TABLE_4096(f, 40960), LIGHTING_TABLE_4096(f, 45056), \
+	LIGHTING_TABLE_4096(f, 49152), LIGHTING_TABLE_4096(f, 53248), LIGHTING_TABLE_4096(f, 57344), LIGHTING_TABLE_4096(f, 61440)
+
+#define MATERIAL_ENTRY(i) LightingMaterialExpectation((i) >> 8, (i) & 255)
+#define DIFFUSE_NONE_ENTRY(i) LightingDiffuseExpectation(LIGHTDIF_NONE, (i) >> 8, (i) & 255)
+#define DIFFUSE_SIGN_ENTRY(i) LightingDiffuseExpectation(LIGHTDIF_SIGN, (i) >> 8, (i) & 255)
+#define DIFFUSE_CLAMP_ENTRY(i) LightingDiffuseExpectation(LIGHTDIF_CLAMP, (i) >> 8, (i) & 255)
+
+const u8 lighting_material_table[LIGHTING_TABLE_SIZE] = { LIGHTING_TABLE_65536(MATERIAL_ENTRY) };
+
+const s16 lighting_diffuse_tables[3][LIGHTING_TABLE_SIZE] = {
+	{ LIGHTING_TABLE_65536(DIFFUSE_NONE_ENTRY) },
+	{ LIGHTING_TABLE_65536(DIFFUSE_SIGN_ENTRY) },
+	{ LIGHTING_TABLE_65536(DIFFUSE_CLAMP_ENTRY) },
+};
+
+// Some known values, checked at compile time
+static_assert(LightingMaterialExpectation(255, 255) == 255, "Full material and light color must stay at full intensity");
+static_assert(LightingMaterialExpectation(255, 127) == 126, "lit < 128 is not rescaled");
+static_assert(LightingMaterialExpectation(128, 128) == 64, "lit >= 128 is incremented before the multiplication");
+static_assert(LightingDiffuseExpectation(LIGHTDIF_SIGN, 0, 255) == -255, "Lights behind the surface subtract with LIGHTDIF_SIGN");
+static_assert(LightingDiffuseExpectation(LIGHTDIF_CLAMP, 0, 255) == 0, "Lights behind the surface don't contribute with LIGHTDIF_CLAMP");
+
+} // namespace
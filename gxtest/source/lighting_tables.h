@@ -0,0 +1,63 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Expected results of the fixed-point steps of vertex lighting
+// Each step is described by a constexpr function, from which a lookup table
+// covering all 8 bit inputs is generated at compile time. Tests verify
+// hardware output with a table lookup, and the tables can be dumped to
+// compare them against hardware results on the host.
+
+#pragma once
+
+#include "CommonTypes.h"
+#include "BitField.h"
+#include "XFMemory.h"
+
+namespace GXTest
+{
+
+// Final step of lighting a color channel: Material color times the lit
+// color, i.e. the ambient color plus the contributions of all lights,
+// clamped to [0, 255]. The hardware scales lit by 256/255 (approximated as
+// lit + (lit >> 7)) and truncates the product.
+constexpr int LightingMaterialExpectation(int mat, int lit)
+{
+	return (mat * (lit + (lit >> 7))) >> 8;
+}
+
+// Contribution of a light with the given 8 bit color, depending on the
+// channel's diffuse function (LIGHTDIF_X) and on the dot product of the
+// vertex normal with the light direction. The dot product is quantized to
+// 8 bits, dot_index 0 to 255 representing (dot_index - 128) / 128.
+constexpr int LightingDiffuseExpectation(int diffusefunc, int dot_index, int color)
+{
+	return (diffusefunc == LIGHTDIF_NONE) ? color :
+	       (diffusefunc == LIGHTDIF_SIGN) ? (color * (dot_index - 128)) / 128 :
+	       (dot_index > 128) ? (color * (dot_index - 128)) / 128 : 0;
+}
+
+// Whether the channel's attenuation function (LIGHTATTN_X) scales light
+// contributions at all. LIGHTATTN_NONE and LIGHTATTN_DIR don't, the others
+// depend on the light's attenuation coefficients (see XFMemory.h).
+constexpr bool LightingUsesAttenuation(int attnfunc)
+{
+	return attnfunc == LIGHTATTN_SPEC || attnfunc == LIGHTATTN_SPOT;
+}
+
+// Tables of the above functions, indexed by (first argument << 8) | second argument
+#define LIGHTING_TABLE_SIZE (256 * 256)
+extern const u8 lighting_material_table[LIGHTING_TABLE_SIZE];
+extern const s16 lighting_diffuse_tables[3][LIGHTING_TABLE_SIZE]; // one per diffuse function
+
+inline int LookupLightingMaterial(int mat, int lit)
+{
+	return lighting_material_table[(mat << 8) | lit];
+}
+
+inline int LookupLightingDiffuse(int diffusefunc, int dot_index, int color)
+{
+	return lighting_diffuse_tables[diffusefunc][(dot_index << 8) | color];
+}
+
+} // namespace
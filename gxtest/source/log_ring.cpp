@@ -0,0 +1,306 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_ring.h"
+
+namespace GXTest
+{
+
+// Time to sleep while waiting for the other side of the ring
+#define LOG_RING_POLL_INTERVAL_US 200
+
+// Priority of the sender thread, above the main thread so that results keep
+// flowing while the tests are busy
+#define LOG_SENDER_PRIORITY 80
+#define LOG_SENDER_STACK_SIZE (32 * 1024)
+
+// Waits for the other side of the ring to make progress. On the host, the
+// thread yields for the first few attempts of a wait. On the console, the
+// sender runs at a higher priority than the tests, so yielding wouldn't
+// let them run, and the thread always sleeps instead.
+static void WaitForOtherSide(u32 attempt)
+{
+#ifdef GXTEST_HOST
+	if (attempt < 64)
+	{
+		std::this_thread::yield();
+		return;
+	}
+#endif
+	usleep(LOG_RING_POLL_INTERVAL_US);
+}
+
+LogRing::LogRing(u32 capacity, Policy policy)
+	: capacity(capacity), policy(policy), write_pos(0), read_pos(0), spill_head(NULL), spill_tail(NULL),
+	  num_waits(0), num_dropped_writes(0), num_dropped_bytes(0), num_spilled_bytes(0)
+{
+	assert(capacity && (capacity & (capacity - 1)) == 0);
+	buffer = (u8*)malloc(capacity);
+}
+
+LogRing::~LogRing()
+{
+	while (spill_head)
+	{
+		SpillBlock* next = spill_head->next;
+		free(spill_head);
+		spill_head = next;
+	}
+	free(buffer);
+}
+
+u32 LogRing::GetFreeSpace() const
+{
+	// The consumer must be done reading before its space gets overwritten
+	u32 read = read_pos.load(std::memory_order_acquire);
+	return capacity - (write_pos.load(std::memory_order_relaxed) - read);
+}
+
+void LogRing::CopyIn(const u8* data, u32 size)
+{
+	u32 write = write_pos.load(std::memory_order_relaxed);
+	u32 offset = write & (capacity - 1);
+	u32 first = (size < capacity - offset) ? size : capacity - offset;
+	memcpy(buffer + offset, data, first);
+	memcpy(buffer, data + first, size - first);
+
+	// Publish the data along with the new position
+	write_pos.store(write + size, std::memory_order_release);
+}
+
+bool LogRing::ReserveSpill(u32 size, SpillBlock** block)
+{
+	*block = NULL;
+	u32 tail_space = spill_tail ? spill_tail->capacity - spill_tail->size : 0;
+	if (size <= tail_space)
+		return true;
+
+	u32 block_capacity = (size - tail_space > SPILL_BLOCK_SIZE) ? size - tail_space : SPILL_BLOCK_SIZE;
+	*block = (SpillBlock*)malloc(offsetof(SpillBlock, data) + block_capacity);
+	if (!*block)
+		return false;
+
+	(*block)->next = NULL;
+	(*block)->capacity = block_capacity;
+	(*block)->size = 0;
+	(*block)->read = 0;
+	return true;
+}
+
+void LogRing::Spill(const u8* data, u32 size, SpillBlock* block)
+{
+	num_spilled_bytes += size;
+	if (spill_tail)
+	{
+		u32 count = spill_tail->capacity - spill_tail->size;
+		count = (size < count) ? size : count;
+		memcpy(spill_tail->data + spill_tail->size, data, count);
+		spill_tail->size += count;
+		data += count;
+		size -= count;
+	}
+	if (!size)
+		return;
+
+	// The rest goes to the block allocated by ReserveSpill
+	assert(block);
+	memcpy(block->data, data, size);
+	block->size = size;
+	if (spill_tail)
+		spill_tail->next = block;
+	else
+		spill_head = block;
+	spill_tail = block;
+}
+
+bool LogRing::DropWrite(u32 size)
+{
+	++num_dropped_writes;
+	num_dropped_bytes += size;
+	return false;
+}
+
+bool LogRing::DrainSpill()
+{
+	while (spill_head)
+	{
+		u32 free_space = GetFreeSpace();
+		u32 count = spill_head->size - spill_head->read;
+		count = (free_space < count) ? free_space : count;
+		if (count == 0)
+			return false;
+
+		CopyIn(spill_head->data + spill_head->read, count);
+		spill_head->read += count;
+		if (spill_head->read < spill_head->size)
+			return false;
+
+		SpillBlock* next = spill_head->next;
+		free(spill_head);
+		spill_head = next;
+		if (!spill_head)
+			spill_tail = NULL;
+	}
+	return true;
+}
+
+bool LogRing::Write(const u8* data, u32 size)
+{
+	// Spilled data needs to go first to keep everything in order
+	SpillBlock* block;
+	if (spill_head && !DrainSpill())
+	{
+		if (!ReserveSpill(size, &block))
+			return DropWrite(size); // out of memory
+		Spill(data, size, block);
+		return true;
+	}
+
+	u32 free_space = GetFreeSpace();
+	if (size <= free_space)
+	{
+		CopyIn(data, size);
+		return true;
+	}
+
+	switch (policy)
+	{
+	case POLICY_BLOCK:
+		for (u32 attempt = 0; ; ++attempt)
+		{
+			u32 count = (size < free_space) ? size : free_space;
+			CopyIn(data, count);
+			data += count;
+			size -= count;
+			if (!size)
+				return true;
+
+			++num_waits;
+			WaitForOtherSide(count ? 0 : attempt);
+			free_space = GetFreeSpace();
+		}
+
+	case POLICY_DROP:
+		return DropWrite(size);
+
+	case POLICY_SPILL:
+	default:
+		// Memory is allocated before copying anything, so that running out
+		// of it drops the whole write rather than a part of it
+		if (!ReserveSpill(size - free_space, &block))
+			return DropWrite(size);
+		CopyIn(data, free_space);
+		Spill(data + free_space, size - free_space, block);
+		return true;
+	}
+}
+
+void LogRing::WaitUntilEmpty()
+{
+	for (u32 attempt = 0; !DrainSpill() || GetFreeSpace() != capacity; ++attempt)
+	{
+		++num_waits;
+		WaitForOtherSide(attempt);
+	}
+}
+
+u32 LogRing::Peek(const u8** data)
+{
+	// The data must be read after the position it was published with
+	u32 write = write_pos.load(std::memory_order_acquire);
+
+	u32 read = read_pos.load(std::memory_order_relaxed);
+	u32 offset = read & (capacity - 1);
+	u32 available = write - read;
+	*data = buffer + offset;
+	return (available < capacity - offset) ? available : capacity - offset;
+}
+
+void LogRing::Consume(u32 size)
+{
+	// Finish reading before the producer may overwrite the data
+	read_pos.store(read_pos.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+LogSender::LogSender(LogRing& ring, SendFunc send, void* userdata)
+	: ring(ring), send(send), userdata(userdata), stopping(false), running(false)
+{
+}
+
+LogSender::~LogSender()
+{
+	if (running)
+		Stop();
+}
+
+void* LogSender::ThreadFunc(void* arg)
+{
+	((LogSender*)arg)->Run();
+	return NULL;
+}
+
+void LogSender::Run()
+{
+	bool failed = false;
+	u32 attempt = 0;
+	while (true)
+	{
+		// Everything written before stopping was set must be sent
+		bool stop = stopping.load(std::memory_order_acquire);
+
+		const u8* data;
+		u32 size = ring.Peek(&data);
+		if (size)
+		{
+			if (!failed)
+				failed = !send(data, size, userdata);
+			ring.Consume(size);
+			attempt = 0;
+		}
+		else if (stop)
+		{
+			break;
+		}
+		else
+		{
+			WaitForOtherSide(attempt++);
+		}
+	}
+}
+
+void LogSender::Start()
+{
+	assert(!running);
+	stopping.store(false, std::memory_order_relaxed);
+	running = true;
+#ifdef GXTEST_HOST
+	thread = std::thread(ThreadFunc, this);
+#else
+	LWP_CreateThread(&thread, ThreadFunc, this, NULL, LOG_SENDER_STACK_SIZE, LOG_SENDER_PRIORITY);
+#endif
+}
+
+void LogSender::Stop()
+{
+	assert(running);
+
+	// Spilled data is owned by the producer, hence needs to be pushed from here
+	ring.WaitUntilEmpty();
+	stopping.store(true, std::memory_order_release);
+
+#ifdef GXTEST_HOST
+	thread.join();
+#else
+	LWP_JoinThread(thread, NULL);
+#endif
+	running = false;
+}
+
+} // namespace
@@ -0,0 +1,148 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#ifdef GXTEST_HOST
+#include <thread>
+#else
+#include <gccore.h>
+#endif
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Lock-free byte ring between a single producer and a single consumer thread
+// Used to hand test results over to a background thread, so that the test
+// thread never waits for the network. The producer side decides what happens
+// when the ring is full, see Policy. Data is delivered to the consumer in
+// the order it was written in, possibly split at arbitrary points.
+class LogRing
+{
+public:
+	enum Policy
+	{
+		POLICY_BLOCK, // wait for the consumer to make room
+		POLICY_DROP,  // drop the whole write and count it
+		POLICY_SPILL, // keep whatever doesn't fit in heap memory until it does
+	};
+
+	// capacity must be a power of two
+	LogRing(u32 capacity, Policy policy);
+	~LogRing();
+
+	// Producer side
+	// Either the whole data is queued or none of it. Returns false if it
+	// was dropped.
+	bool Write(const u8* data, u32 size);
+
+	// Moves spilled data into the ring, as far as it fits. Returns true if
+	// there's nothing spilled anymore. Called by Write, too.
+	bool DrainSpill();
+
+	// Waits until the consumer has read everything, including spilled data
+	void WaitUntilEmpty();
+
+	void SetPolicy(Policy policy) { this->policy = policy; }
+
+	// Statistics, only to be read by the producer
+	u32 GetNumWaits() const { return num_waits; }
+	u32 GetNumDroppedWrites() const { return num_dropped_writes; }
+	u64 GetNumDroppedBytes() const { return num_dropped_bytes; }
+	u64 GetNumSpilledBytes() const { return num_spilled_bytes; }
+
+	// Consumer side
+	// Returns the number of bytes which can be read contiguously at *data
+	u32 Peek(const u8** data);
+	void Consume(u32 size);
+
+private:
+	LogRing(const LogRing&) = delete;
+	LogRing& operator = (const LogRing&) = delete;
+
+	struct SpillBlock
+	{
+		SpillBlock* next;
+		u32 capacity;
+		u32 size;
+		u32 read; // bytes already moved into the ring
+		u8 data[1];
+	};
+
+	enum { SPILL_BLOCK_SIZE = 64 * 1024 };
+
+	u32 GetFreeSpace() const;
+	void CopyIn(const u8* data, u32 size);
+	// Spilling is split in two steps, so that a write can be dropped when
+	// running out of memory before any part of it got queued. Spill doesn't
+	// fail when given the block returned by ReserveSpill for the same size.
+	bool ReserveSpill(u32 size, SpillBlock** block);
+	void Spill(const u8* data, u32 size, SpillBlock* block);
+	bool DropWrite(u32 size);
+
+	u8* buffer;
+	u32 capacity;
+	Policy policy;
+
+	// Free running positions, each of them is only written by one side.
+	// Each side stores its own position with release semantics and loads the
+	// other one with acquire semantics, which orders the accesses to the
+	// ring contents.
+	std::atomic<u32> write_pos;
+	std::atomic<u32> read_pos;
+
+	// Owned by the producer
+	SpillBlock* spill_head;
+	SpillBlock* spill_tail;
+
+	u32 num_waits;
+	u32 num_dropped_writes;
+	u64 num_dropped_bytes;
+	u64 num_spilled_bytes;
+};
+
+// Drains a LogRing on a background thread, an LWP on the console and a
+// std::thread on the host
+class LogSender
+{
+public:
+	// Returns false if sending failed, in which case everything else is discarded
+	typedef bool (*SendFunc)(const u8* data, u32 size, void* userdata);
+
+	LogSender(LogRing& ring, SendFunc send, void* userdata);
+	~LogSender();
+
+	void Start();
+
+	// Waits until everything written to the ring has been sent, then stops
+	// the thread. Must be called from the producer thread.
+	void Stop();
+
+	bool IsRunning() const { return running; }
+
+private:
+	LogSender(const LogSender&) = delete;
+	LogSender& operator = (const LogSender&) = delete;
+
+	static void* ThreadFunc(void* arg);
+	void Run();
+
+	LogRing& ring;
+	SendFunc send;
+	void* userdata;
+
+	std::atomic<bool> stopping;
+	bool running;
+
+#ifdef GXTEST_HOST
+	std::thread thread;
+#else
+	lwp_t thread;
+#endif
+};
+
+} // namespace
@@ -6,13 +6,36 @@
 #include "Test.h"
 #include <stdlib.h>
 #include <string.h>
+#include <malloc.h>
 #include <math.h>
+#include <unistd.h>
 #include <wiiuse/wpad.h>
+#include <ogc/lwp_watchdog.h>
 #include "cgx.h"
 #include "cgx_defaults.h"
 #include "gxtest_util.h"
+#include "cgx_fake.h"
+#include "tev_batch.h"
+#include "tev_model.h"
+#include "tev_simulator.h"
+#include "lighting_tables.h"
+#include "lighting_model.h"
+#include "texture_decoder.h"
+#include "depth_model.h"
+#include "efb_format_model.h"
+#include "counter_rng.h"
+#include "tev_sweep.h"
+#include "log_ring.h"
+#include "result_protocol.h"
+#ifdef GXTEST_HOST
+#include "result_aggregator.h"
+#endif
 #include <ogcsys.h>
 
+// Selects the samples of random sweeps, see ParseArguments
+static u32 sweep_seed = 1;
+static GXTest::SweepShard sweep_shard = { 0, 1 };
+
 void BitfieldTest()
 {
 	START_TEST();
@@ -42,537 +65,3330 @@ void BitfieldTest()
 	END_TEST();
 }
 
-int TevCombinerExpectation(int a, int b, int c, int d, int shift, int bias, int op, int clamp)
+// Arbitrary 11 bit values, covering the full range for larger batches
+static GXTest::Vec4<int> TevBatchDecodeTestValue(int index)
 {
-	a &= 255;
-	b &= 255;
-	c &= 255;
+	GXTest::Vec4<int> ret;
+	ret.r = (index * 37) % 2048 - 1024;
+	ret.g = (index * 11 + 5) % 2048 - 1024;
+	ret.b = 1023 - (index % 2048);
+	ret.a = (index * 1021) % 2048 - 1024;
+	return ret;
+}
 
-	// TODO: Does not handle compare mode, yet
-	c = c+(c>>7);
-	u16 lshift = (shift == 1) ? 1 : (shift == 2) ? 2 : 0;
-	u16 rshift = (shift == 3) ? 1 : 0;
-	int round_bias = (shift==3) ? 0 : ((op==1) ? 127 : 128);
-	int expected = (((a*(256-c) + b*c) << lshift)+round_bias)>>8; // lerp
-	expected = (d << lshift) + expected * ((op == 1) ? (-1) : 1);
-	expected += ((bias == 2) ? -128 : (bias == 1) ? 128 : 0) << lshift;
-	expected >>= rshift;
-	if (clamp)
-		expected = (expected < 0) ? 0 : (expected > 255) ? 255 : expected;
-	else
-		expected = (expected < -1024) ? -1024 : (expected > 1023) ? 1023 : expected;
-	return expected;
+// Tev output as written to the EFB by the given render pass of GetTevOutput
+static u8 TevOutputPassValue(int value, int pass)
+{
+	// First pass: tev output multiplied by 4, second pass: divided by 8
+	return (u8)((pass == 0) ? (value * 4) : (value >> 3));
 }
 
-void TevCombinerTest()
+void TevOutputDecodeTest()
 {
 	START_TEST();
 
-	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+	for (int value = -1024; value < 1024; ++value)
+	{
+		int result = GXTest::DecodeTevOutput(TevOutputPassValue(value, 0), TevOutputPassValue(value, 1));
+		DO_TEST(result == value, "Got %d, expected %d", result, value);
+	}
 
-	CGX_BEGIN_LOAD_XF_REGS(0x1009, 1);
-	wgPipe->U32 = 1; // 1 color channel
+	END_TEST();
+}
 
-	LitChannel chan;
-	chan.hex = 0;
-	chan.matsource = 1; // from vertex
-	CGX_BEGIN_LOAD_XF_REGS(0x100e, 1); // color channel 1
-	wgPipe->U32 = chan.hex;
-	CGX_BEGIN_LOAD_XF_REGS(0x1010, 1); // alpha channel 1
-	wgPipe->U32 = chan.hex;
+void TevLanePackTest()
+{
+	START_TEST();
 
-	auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
-	CGX_LOAD_BP_REG(ac.hex);
+	GXTest::TevLaneInputs lanes[4];
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		lanes[lane].a = -1024 + lane;
+		lanes[lane].b = 1023 - lane;
+		lanes[lane].c = 100 * lane;
+		lanes[lane].d = -100 * lane;
+	}
 
-	// Test if we can reliably extract all bits of the tev combiner output...
-	auto tevreg = CGXDefault<TevReg>(1, false); // c0
-	for (int i = 0; i < 2; ++i)
-		for (tevreg.red = -1024; tevreg.red != 1023; tevreg.red = tevreg.red+1)
-		{
-			CGX_LOAD_BP_REG(tevreg.low);
-			CGX_LOAD_BP_REG(tevreg.high);
+	TevReg regs[4];
+	GXTest::PackTevLanes(lanes, regs);
 
-			auto genmode = CGXDefault<GenMode>();
-			genmode.numtevstages = 0; // One stage
-			CGX_LOAD_BP_REG(genmode.hex);
+	// Tev registers are stored in the order prev, c0, c1, c2
+	for (int i = 0; i < 4; ++i)
+	{
+		DO_TEST((regs[i].low >> 24) == (u32)(BPMEM_TEV_REGISTER_L + 2 * i), "Register %d has wrong address %x", i, (u32)(regs[i].low >> 24));
+		DO_TEST((regs[i].high >> 24) == (u32)(BPMEM_TEV_REGISTER_H + 2 * i), "Register %d has wrong address %x", i, (u32)(regs[i].high >> 24));
+	}
 
-			auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
-			cc.d = TEVCOLORARG_C0;
-			CGX_LOAD_BP_REG(cc.hex);
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		s32 channel[4];
+		for (int i = 0; i < 4; ++i)
+			channel[i] = (lane == 0) ? (s32)regs[i].red : (lane == 1) ? (s32)regs[i].green : (lane == 2) ? (s32)regs[i].blue : (s32)regs[i].alpha;
 
-			PE_CONTROL ctrl;
-			ctrl.hex = BPMEM_ZCOMPARE<<24;
-			ctrl.zformat = ZC_LINEAR;
-			ctrl.early_ztest = 0;
-			if (i == 0)
-			{
-				// 8 bits per channel: No worries about GetTevOutput making
-				// mistakes when writing to framebuffer or when performing
-				// an EFB copy.
-				ctrl.pixel_format = PIXELFMT_RGB8_Z24;
-				CGX_LOAD_BP_REG(ctrl.hex);
+		DO_TEST(channel[1] == lanes[lane].a && channel[2] == lanes[lane].b && channel[3] == lanes[lane].c && channel[0] == lanes[lane].d,
+		        "Lane %d packed incorrectly (have: %d %d %d %d)", lane, channel[1], channel[2], channel[3], channel[0]);
+	}
 
-				int result = GXTest::GetTevOutput(genmode, cc, ac).r;
+	END_TEST();
+}
 
-				DO_TEST(result == tevreg.red, "Got %d, expected %d", result, (s32)tevreg.red);
-			}
-			else
-			{
-				// TODO: This doesn't quite work, yet.
-				break;
+// Checks the cell layout and result decoding of GetTevOutputBatch
+// against a fake EFB, which is set up the same way the two render passes
+// of the batch would set up the real one.
+void TevBatchDecodeTest()
+{
+	START_TEST();
 
-				// 6 bits per channel: Implement GetTevOutput functionality
-				// manually, to verify how tev output is truncated to 6 bit
-				// and how EFB copies upscale that to 8 bit again.
-				ctrl.pixel_format = PIXELFMT_RGBA6_Z24;
-				CGX_LOAD_BP_REG(ctrl.hex);
+	static CGXFakeEfb efb;
+	static u8 copy[640*528*4];
+	static u8 cell_used[528 / TEV_BATCH_CELL_SIZE][640 / TEV_BATCH_CELL_SIZE];
+	static GXTest::Vec4<int> results[TEV_BATCH_MAX_SIZE];
 
-				GXTest::Quad().AtDepth(1.0).ColorRGBA(255,255,255,255).Draw();
-				GXTest::CopyToTestBuffer(0, 0, 99, 9);
-				CGX_ForcePipelineFlush();
-				CGX_WaitForGpuToFinish();
-				u16 result = GXTest::ReadTestBuffer(5, 5, 100).r;
-
-				int expected = (((tevreg.red+1)>>2)&0xFF) << 2;
-				expected = expected | (expected>>6);
-				DO_TEST(result == expected, "Run %d: Got %d, expected %d", (int)tevreg.red, result, expected);
+	for (int count : {1, 7, TEV_BATCH_CELLS_PER_ROW, 300, TEV_BATCH_MAX_SIZE})
+	{
+		int copy_width, copy_height;
+		GXTest::GetTevBatchCopySize(count, &copy_width, &copy_height);
+		DO_TEST(copy_width <= 640 && copy_height <= 528, "Batch of %d exceeds the EFB (%dx%d)", count, copy_width, copy_height);
+
+		memset(cell_used, 0, sizeof(cell_used));
+		for (int i = 0; i < count; ++i)
+		{
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				int x, y;
+				GXTest::GetTevBatchCell(count, i, pass, &x, &y);
+				bool in_bounds = x >= 0 && x + TEV_BATCH_CELL_SIZE <= copy_width && y >= 0 && y + TEV_BATCH_CELL_SIZE <= copy_height;
+				DO_TEST(in_bounds, "Batch of %d: cell %d of pass %d is out of bounds (%d, %d)", count, i, pass, x, y);
+				if (!in_bounds)
+					continue;
+
+				u8& used = cell_used[y / TEV_BATCH_CELL_SIZE][x / TEV_BATCH_CELL_SIZE];
+				DO_TEST(!used && (x % TEV_BATCH_CELL_SIZE) == 0 && (y % TEV_BATCH_CELL_SIZE) == 0, "Batch of %d: cell %d of pass %d overlaps another one", count, i, pass);
+				used = 1;
+
+				GXTest::Vec4<int> val = TevBatchDecodeTestValue(i);
+				efb.Fill(x, y, TEV_BATCH_CELL_SIZE, TEV_BATCH_CELL_SIZE,
+				         (TevOutputPassValue(val.r, pass) << 24) | (TevOutputPassValue(val.g, pass) << 16) |
+				         (TevOutputPassValue(val.b, pass) << 8) | TevOutputPassValue(val.a, pass));
 			}
 		}
 
-	// Now: Randomized testing of tev combiners.
-	for (int i = 0x000000; i < 0x000F000; ++i)
-	{
-		if ((i & 0xFF00) == i)
-			network_printf("progress: %x\n", i);
+		efb.CopyTex(0, 0, copy_width, copy_height, copy);
+		GXTest::DecodeTevBatch(copy, count, results);
 
-		auto genmode = CGXDefault<GenMode>();
-		genmode.numtevstages = 0; // One stage
-		CGX_LOAD_BP_REG(genmode.hex);
+		for (int i = 0; i < count; ++i)
+		{
+			GXTest::Vec4<int> val = TevBatchDecodeTestValue(i);
+			DO_TEST(results[i].r == val.r && results[i].g == val.g && results[i].b == val.b && results[i].a == val.a,
+			        "Batch of %d, vector %d: got (%d, %d, %d, %d), expected (%d, %d, %d, %d)",
+			        count, i, results[i].r, results[i].g, results[i].b, results[i].a, val.r, val.g, val.b, val.a);
+		}
+	}
 
-		// Randomly configured TEV stage, output in PREV.
-		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
-		cc.a = TEVCOLORARG_C0;
-		cc.b = TEVCOLORARG_C1;
-		cc.c = TEVCOLORARG_C2;
-		cc.d = TEVCOLORARG_ZERO; // TEVCOLORARG_CPREV; // NOTE: TEVCOLORARG_CPREV doesn't actually seem to fetch its data from PREV when used in the first stage?
-		cc.shift = rand() % 4;
-		cc.bias = rand() % 3;
-		cc.op = rand()%2;
-		cc.clamp = rand() % 2;
-		CGX_LOAD_BP_REG(cc.hex);
+	END_TEST();
+}
 
-		int a = -1024 + (rand() % 2048);
-		int b = -1024 + (rand() % 2048);
-		int c = -1024 + (rand() % 2048);
-		int d = 0; //-1024 + (rand() % 2048);
-		tevreg = CGXDefault<TevReg>(1, false); // c0
-		tevreg.red = a;
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
-		tevreg = CGXDefault<TevReg>(2, false); // c1
-		tevreg.red = b;
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
-		tevreg = CGXDefault<TevReg>(3, false); // c2
-		tevreg.red = c;
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
-		tevreg = CGXDefault<TevReg>(0, false); // prev
-		tevreg.red = d;
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
+// Checks that ReadbackRing hands out buffers in submission order, only
+// after their fences have been reached, and keeps doing so when both the
+// ring slots and the 16 bit fence values wrap around.
+void ReadbackRingTest()
+{
+	START_TEST();
 
-		PE_CONTROL ctrl;
-		ctrl.hex = BPMEM_ZCOMPARE<<24;
-		ctrl.pixel_format = PIXELFMT_RGB8_Z24;
-		ctrl.zformat = ZC_LINEAR;
-		ctrl.early_ztest = 0;
-		CGX_LOAD_BP_REG(ctrl.hex);
+	for (u16 first_fence : {1, 0xFFF0, 0x7FF8})
+	{
+		CGXFakeFences fences(first_fence);
+		GXTest::ReadbackRing ring(fences, 3, 64);
 
-		int result = GXTest::GetTevOutput(genmode, cc, ac).r;
+		int next_submission = 0;
+		int next_retrieval = 0;
+		void* buffers[3];
+		for (int step = 0; step < 64; ++step)
+		{
+			// Vary the number of submissions per step to exercise all fill levels
+			for (int i = 0; i < 1 + step % 3 && !ring.IsFull(); ++i)
+			{
+				void* buffer = ring.GetSubmitBuffer();
+				DO_TEST(((uintptr_t)buffer & 31) == 0, "Buffer %d is not 32 byte aligned", next_submission);
+				buffers[next_submission % 3] = buffer;
+				ring.Submit(next_submission++);
+			}
+			DO_TEST(fences.GetNumPending() == ring.GetNumPending(), "Step %d: %d fences pending, but %d buffers", step, fences.GetNumPending(), ring.GetNumPending());
+
+			// Let the GPU catch up partially, after which waiting must not be necessary
+			if (step % 2)
+				fences.Retire(1);
+
+			int num_waits = fences.GetNumWaits();
+			int tag;
+			const void* buffer = ring.WaitForOldest(&tag);
+			DO_TEST(tag == next_retrieval, "Step %d: Got submission %d, expected %d", step, tag, next_retrieval);
+			DO_TEST(buffer == buffers[next_retrieval % 3], "Step %d: Submission %d returned the wrong buffer", step, tag);
+			DO_TEST(fences.GetNumWaits() == num_waits + 1, "Step %d: Expected a single wait", step);
+			ring.ReleaseOldest();
+			++next_retrieval;
+		}
 
-		int expected = TevCombinerExpectation(a, b, c, d, cc.shift, cc.bias, cc.op, cc.clamp);
-		DO_TEST(result == expected, "Mismatch on a=%d, b=%d, c=%d, d=%d, shift=%d, bias=%d, op=%d, clamp=%d: expected %d, got %d", a, b, c, d, (u32)cc.shift, (u32)cc.bias, (u32)cc.op, (u32)cc.clamp, expected, result);
+		while (!ring.IsEmpty())
+		{
+			int tag;
+			ring.WaitForOldest(&tag);
+			DO_TEST(tag == next_retrieval, "Draining: Got submission %d, expected %d", tag, next_retrieval);
+			ring.ReleaseOldest();
+			++next_retrieval;
+		}
+		DO_TEST(next_retrieval == next_submission, "Retrieved %d of %d submissions", next_retrieval, next_submission);
+		DO_TEST(fences.GetNumPending() == 0, "%d fences still pending", fences.GetNumPending());
+	}
 
-		WPAD_ScanPads();
+	// Fence comparison across the wrap-around
+	CGXFakeFences fences(0xFFFE);
+	u16 fence[4];
+	for (auto& f : fence)
+		f = fences.InsertFence();
+	DO_TEST(fence[2] == 0, "Fence values don't wrap around (have: %d)", fence[2]);
+	fences.Retire(3);
+	for (int i = 0; i < 3; ++i)
+		DO_TEST(fences.IsFenceReached(fence[i]), "Fence %d not reached", fence[i]);
+	DO_TEST(!fences.IsFenceReached(fence[3]), "Fence %d reached too early", fence[3]);
 
-		if (WPAD_ButtonsDown(0) & WPAD_BUTTON_HOME)
-			break;
-	}
+	END_TEST();
+}
 
-	// Testing compare mode: (a.r > b.r) ? c.a : 0
-	// One of the following will be the case for the alpha combiner:
-	// (1) a.r will be assigned the value of c2.r (color combiner setting)
-	// (2) a.r will be assigned the value of c0.r (alpha combiner setting)
-	// If (1) is the case, the first run of this test will return black and
-	// the second one will return red. If (2) is the case, the test will
-	// always return black.
-	// Indeed, this test shows that the alpha combiner reads the a and b
-	// inputs from the color combiner setting, i.e. scenario (1) is
-	// accurate to hardware behavior.
-	for (int i = 0; i < 2; ++i)
+// Collects the encoded result stream in memory
+struct ResultSink
+{
+	u8 data[256 * 1024];
+	u32 size;
+	bool drop; // pretend the data couldn't be delivered
+
+	static bool Append(const u8* data, u32 size, void* userdata)
 	{
-		auto genmode = CGXDefault<GenMode>();
-		genmode.numtevstages = 0; // One stage
-		CGX_LOAD_BP_REG(genmode.hex);
+		ResultSink* sink = (ResultSink*)userdata;
+		if (sink->drop)
+			return false;
+		memcpy(sink->data + sink->size, data, size);
+		sink->size += size;
+		return true;
+	}
+};
 
-		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
-		cc.a = TEVCOLORARG_C2;
-		cc.b = TEVCOLORARG_C1;
-		CGX_LOAD_BP_REG(cc.hex);
+// Remembers the last decoded records of each type
+class ResultRecorder : public GXTest::ResultHandler
+{
+public:
+	ResultRecorder() : num_hellos(0), num_passed(0), num_failed(0), num_messages(0), num_dropped(0), num_sweep_records(0), sweep_ok(true), next_sweep_index(0), failed_line(0), test_number(0), num_subtests(0), num_failures(0), end_time(0)
+	{
+		message[0] = failed_file[0] = 0;
+	}
 
-		auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
-		ac.bias = TevBias_COMPARE;
-		ac.a = TEVALPHAARG_A0; // different from color combiner
-		ac.b = TEVALPHAARG_A1; // same as color combiner
-		ac.c = TEVALPHAARG_A2;
-		CGX_LOAD_BP_REG(ac.hex);
+	virtual void OnHello(int version) { ++num_hellos; }
+	virtual void OnPassed(u32 count) { num_passed += count; }
+	virtual void OnDropped(u32 num_bytes) { num_dropped += num_bytes; }
+	virtual void OnSweepResults(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits)
+	{
+		++num_sweep_records;
+		sweep_ok &= (strcmp(sweep, "sweep") == 0 && seed == 1234 && first_index == next_sweep_index);
+		for (u32 i = 0; i < count; ++i)
+			sweep_ok &= (GXTest::IsSweepSampleFailed(bits, i) == ((first_index + i) % 7 == 3));
+		next_sweep_index = first_index + count;
+	}
+	virtual void OnFailed(int subtest, const char* file, int line, const char* msg)
+	{
+		++num_failed;
+		snprintf(failed_file, sizeof(failed_file), "%s", file);
+		failed_line = line;
+		snprintf(message, sizeof(message), "%s", msg);
+	}
+	virtual void OnMessage(const char* msg)
+	{
+		++num_messages;
+		snprintf(message, sizeof(message), "%s", msg);
+	}
+	virtual void OnTestEnd(int test, int subtests, int failures, u64 time)
+	{
+		test_number = test;
+		num_subtests = subtests;
+		num_failures = failures;
+		end_time = time;
+	}
 
-		PE_CONTROL ctrl;
-		ctrl.hex = BPMEM_ZCOMPARE<<24;
-		ctrl.pixel_format = PIXELFMT_RGBA6_Z24;
-		ctrl.zformat = ZC_LINEAR;
-		ctrl.early_ztest = 0;
-		CGX_LOAD_BP_REG(ctrl.hex);
+	int num_hellos, num_passed, num_failed, num_messages;
+	u32 num_dropped;
+	int num_sweep_records;
+	bool sweep_ok;
+	u32 next_sweep_index;
+	char failed_file[64];
+	int failed_line;
+	char message[256];
+	int test_number, num_subtests, num_failures;
+	u64 end_time;
+};
+
+static void EncodeMessage(GXTest::ResultEncoder& encoder, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	encoder.Message(format, args);
+	va_end(args);
+}
 
-		tevreg = CGXDefault<TevReg>(1, false); // c0
-		tevreg.red = 127; // 127 is always NOT less than 127.
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
+static void EncodeFailure(GXTest::ResultEncoder& encoder, int subtest, const char* file, int line, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	encoder.SubtestFailed(subtest, file, line, format, args);
+	va_end(args);
+}
 
-		tevreg = CGXDefault<TevReg>(2, false); // c1
-		tevreg.red = 127;
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
+// Formats the message locally, as reference for the decoded one
+static const char* FormatLocally(const char* format, ...)
+{
+	static char buffer[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	return buffer;
+}
 
-		tevreg = CGXDefault<TevReg>(3, false); // c2
-		tevreg.red = 127+i; // 127+i is less than 127 iff i>0.
-		tevreg.alpha = 255;
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
+// Encodes results and decodes them again
+void ResultProtocolTest()
+{
+	START_TEST();
 
-		int result = GXTest::GetTevOutput(genmode, cc, ac).a;
-		int expected = (i == 1) ? 255 : 0;
-		DO_TEST(result == expected, "Mismatch on run %d: expected %d, got %d", i, expected, result);
+	static u8 buffer[3 + 0xFFFF + 1024];
+	static ResultSink sink;
+	sink.size = 0;
+	sink.drop = false;
+	GXTest::ResultEncoder encoder(buffer, sizeof(buffer), ResultSink::Append, &sink);
+
+	encoder.Hello();
+	encoder.TestStart(7, "main.cpp", 100, 1000);
+	for (int i = 0; i < 1000; ++i)
+		encoder.SubtestPassed();
+	EncodeFailure(encoder, 1000, "main.cpp", 123, "Expected %d, got %d", 5, -3);
+	for (int i = 0; i < 5; ++i)
+		EncodeMessage(encoder, "Step %d of %u: %s\n", i, 5u, "running");
+	EncodeMessage(encoder, "%08x %-5s|%c %lld %.3f %5.1e %%\n", 0xC0FFEEu, "ab", 'z', -(1LL << 40), 3.14159, 0.000125);
+	EncodeMessage(encoder, "%*d|%-*.*f|%hhu\n", 6, 42, 9, 2, 2.5, 300);
+	int written;
+	EncodeMessage(encoder, "Can't send%n this as binary\n", &written);
+	encoder.TestEnd(1001, 1, 0x123456789ULL);
+	DO_TEST(encoder.GetNumFlushes() == 0, "Flushed %d times before the buffer was full", encoder.GetNumFlushes());
+	encoder.Flush();
+	u32 size = sink.size;
+
+	// Failed subtests and repeated messages only send their arguments
+	EncodeFailure(encoder, 1001, "main.cpp", 123, "Expected %d, got %d", 5, -3);
+	encoder.Flush();
+	u32 failure_size = sink.size - size;
+	DO_TEST(failure_size == 3 + 4 + 2 + 4 + 2 + 2 * 5, "Repeated failure encoded in %d bytes", failure_size);
+
+	// Feed byte by byte to test records split at arbitrary points
+	ResultRecorder recorder;
+	GXTest::ResultDecoder decoder(recorder);
+	bool valid = true;
+	int num_message_checks = 0;
+	for (u32 i = 0; i < size && valid; ++i)
+	{
+		int num_messages = recorder.num_messages;
+		valid = decoder.Feed(sink.data + i, 1);
+		if (recorder.num_messages == num_messages)
+			continue;
+
+		// Check every message as soon as it got decoded
+		const char* expected;
+		switch (num_message_checks++)
+		{
+		case 0: expected = "Step 0 of 5: running\n"; break;
+		case 4: expected = "Step 4 of 5: running\n"; break;
+		case 5: expected = FormatLocally("%08x %-5s|%c %lld %.3f %5.1e %%\n", 0xC0FFEEu, "ab", 'z', -(1LL << 40), 3.14159, 0.000125); break;
+		case 6: expected = FormatLocally("%*d|%-*.*f|%hhu\n", 6, 42, 9, 2, 2.5, 300); break;
+		case 7: expected = "Can't send this as binary\n"; break;
+		default: expected = NULL; break;
+		}
+		if (expected)
+			DO_TEST(strcmp(recorder.message, expected) == 0, "Message %d decoded as \"%s\", expected \"%s\"", num_message_checks - 1, recorder.message, expected);
+	}
+	DO_TEST(valid && decoder.IsAtRecordBoundary(), "Failed to decode the stream (valid: %d)", valid);
+	DO_TEST(recorder.num_hellos == 1, "Got %d hello records", recorder.num_hellos);
+	DO_TEST(recorder.num_passed == 1000, "Got %d passed subtests", recorder.num_passed);
+	DO_TEST(num_message_checks == 8, "Got %d messages", num_message_checks);
+	DO_TEST(recorder.num_failed == 1 && recorder.failed_line == 123 && strcmp(recorder.failed_file, "main.cpp") == 0,
+	        "Got %d failures, last one in %s on line %d", recorder.num_failed, recorder.failed_file, recorder.failed_line);
+	DO_TEST(recorder.test_number == 7 && recorder.num_subtests == 1001 && recorder.num_failures == 1 && recorder.end_time == 0x123456789ULL,
+	        "Test %d ended with %d subtests and %d failures at %llu us", recorder.test_number, recorder.num_subtests, recorder.num_failures, (unsigned long long)recorder.end_time);
+
+	// The whole stream in one go, including the repeated failure
+	ResultRecorder recorder2;
+	GXTest::ResultDecoder decoder2(recorder2);
+	DO_TEST(decoder2.Feed(sink.data, sink.size), "Failed to decode the stream in one go");
+	DO_TEST(recorder2.num_failed == 2 && strcmp(recorder2.message, "Expected 5, got -3") == 0, "Repeated failure decoded as \"%s\"", recorder2.message);
+
+	// Malformed streams are rejected
+	ResultRecorder recorder3;
+	GXTest::ResultDecoder decoder3(recorder3);
+	const u8 unknown_string[] = { GXTest::RESULT_RECORD_MESSAGE, 0, 2, 0x12, 0x34 };
+	DO_TEST(!decoder3.Feed(unknown_string, sizeof(unknown_string)), "Accepted a message with an unknown format string");
+	DO_TEST(!decoder3.Feed(sink.data, sink.size), "Kept decoding after an error");
+
+	ResultRecorder recorder4;
+	GXTest::ResultDecoder decoder4(recorder4);
+	const u8 unknown_record[] = { 0x7F, 0, 0 };
+	DO_TEST(!decoder4.Feed(unknown_record, sizeof(unknown_record)), "Accepted an unknown record type");
+
+	// String arguments longer than any the encoder sends, both with a known
+	// format string and with one that got lost
+	const u32 long_string_size = RESULT_MAX_STRING_ARG + 1000;
+	static u8 long_string[2 * (3 + 2 + 1 + 2 + long_string_size) + 20];
+	for (int lost = 0; lost < 2; ++lost)
+	{
+		u8* out = long_string;
+		if (lost)
+		{
+			const u8 dropped[] = { GXTest::RESULT_RECORD_DROPPED, 0, 4, 0, 0, 1, 0 };
+			memcpy(out, dropped, sizeof(dropped));
+			out += sizeof(dropped);
+		}
+		else
+		{
+			const u8 format[] = { GXTest::RESULT_RECORD_STRING, 0, 4, 0x12, 0x34, '%', 's' };
+			memcpy(out, format, sizeof(format));
+			out += sizeof(format);
+		}
+		const u32 message_size = 2 + 1 + 2 + long_string_size;
+		const u8 message[] = { GXTest::RESULT_RECORD_MESSAGE, (u8)(message_size >> 8), (u8)message_size, 0x12, 0x34,
+		                       GXTest::RESULT_ARG_STRING, (u8)(long_string_size >> 8), (u8)long_string_size };
+		memcpy(out, message, sizeof(message));
+		out += sizeof(message);
+		memset(out, 'x', long_string_size);
+		out += long_string_size;
+
+		ResultRecorder recorder_long;
+		GXTest::ResultDecoder decoder_long(recorder_long);
+		DO_TEST(!decoder_long.Feed(long_string, out - long_string), "Accepted a string argument of %u bytes (format string lost: %d)", long_string_size, lost);
 	}
 
+	// Records are flushed in bulk once the buffer is full
+	sink.size = 0;
+	u32 num_flushes = encoder.GetNumFlushes();
+	for (int i = 0; i < 2000; ++i)
+		EncodeMessage(encoder, "Filler message %d %s\n", i, "with a string argument which is somewhat long");
+	DO_TEST(encoder.GetNumFlushes() - num_flushes == 1, "Buffer flushed %d times", encoder.GetNumFlushes() - num_flushes);
+
+	// Strings are sent again after the records containing them got lost
+	ResultRecorder recorder5;
+	GXTest::ResultDecoder decoder5(recorder5);
+	decoder5.Feed(sink.data, sink.size);
+	sink.size = 0;
+	sink.drop = true;
+	EncodeFailure(encoder, 1, "lost.cpp", 1, "Lost failure %d", 1);
+	EncodeMessage(encoder, "Lost message %s\n", "a");
+	encoder.Flush();
+	u32 num_dropped_bytes = (u32)encoder.GetNumDroppedBytes();
+	sink.drop = false;
+	EncodeFailure(encoder, 2, "lost.cpp", 2, "Lost failure %d", 2);
+	EncodeMessage(encoder, "Lost message %s\n", "b");
+	encoder.Flush();
+	DO_TEST(decoder5.Feed(sink.data, sink.size), "Failed to decode the stream after dropped records");
+	DO_TEST(recorder5.num_dropped == num_dropped_bytes && num_dropped_bytes > 0, "Dropped %u bytes, decoder saw %u", num_dropped_bytes, recorder5.num_dropped);
+	DO_TEST(recorder5.num_failed == 1 && strcmp(recorder5.failed_file, "lost.cpp") == 0 && strcmp(recorder5.message, "Lost message b\n") == 0,
+	        "Got %d failures in %s, last message \"%s\"", recorder5.num_failed, recorder5.failed_file, recorder5.message);
+
+	// Sweep bitmaps are split into several records if needed, bits past the
+	// end of the sweep are ignored
+	const u32 num_sweep_samples = 600001;
+	static u8 sweep_bits[(num_sweep_samples + 7) / 8];
+	memset(sweep_bits, 0, sizeof(sweep_bits));
+	for (u32 i = 0; i < num_sweep_samples; ++i)
+		if (i % 7 == 3)
+			GXTest::SetSweepSampleFailed(sweep_bits, i);
+	sweep_bits[sizeof(sweep_bits) - 1] |= 0x7F;
+	sink.size = 0;
+	encoder.SweepResults("sweep", 1234, 0, num_sweep_samples, sweep_bits);
+	encoder.Flush();
+	ResultRecorder recorder6;
+	GXTest::ResultDecoder decoder6(recorder6);
+	DO_TEST(decoder6.Feed(sink.data, sink.size), "Failed to decode sweep results");
+	DO_TEST(recorder6.sweep_ok && recorder6.num_sweep_records == 2 && recorder6.next_sweep_index == num_sweep_samples,
+	        "Sweep decoded incorrectly from %d records, up to sample %u", recorder6.num_sweep_records, recorder6.next_sweep_index);
+	DO_TEST(sink.size < num_sweep_samples / 8 + 64, "Sweep of %u samples encoded in %u bytes", num_sweep_samples, sink.size);
+
+	// Unknown format strings are expected after records got lost
+	const u8 lost_string[] = { GXTest::RESULT_RECORD_DROPPED, 0, 4, 0, 0, 1, 0, GXTest::RESULT_RECORD_MESSAGE, 0, 7, 0x12, 0x34, 'i', 0, 0, 0, 5 };
+	DO_TEST(decoder5.Feed(lost_string, sizeof(lost_string)) && strcmp(recorder5.message, "(message lost)\n") == 0,
+	        "Message with a lost format string decoded as \"%s\"", recorder5.message);
+
 	END_TEST();
 }
 
-void ClipTest()
+#ifdef GXTEST_HOST
+// Runs the summary writer on a temporary file and returns what it wrote
+static std::string WriteSummaryToString(void (*write)(FILE*, const std::vector<GXTest::RunSummary>&), const std::vector<GXTest::RunSummary>& runs)
+{
+	FILE* file = tmpfile();
+	if (!file)
+		return "";
+	write(file, runs);
+	std::string text;
+	rewind(file);
+	char buffer[1024];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		text.append(buffer, size);
+	fclose(file);
+	return text;
+}
+
+// Collects results like the receiver does and checks the summaries
+void ResultAggregatorTest()
 {
 	START_TEST();
 
-	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+	GXTest::ResultAggregator results(NULL, "");
+	results.OnHello(RESULT_PROTOCOL_VERSION);
+
+	u8 sweep_bits[2][4] = {};
+	GXTest::SetSweepSampleFailed(sweep_bits[0], 3);
+	GXTest::SetSweepSampleFailed(sweep_bits[1], 1);
+
+	results.OnTestStart(3, "dir/a,\"b\".cpp", 10, 100);
+	results.OnPassed(5);
+	results.OnFailed(5, "main.cpp", 20, "Said \"hi\" \\\n\tok");
+	results.OnSweepResults("sweep", 7, 0, 16, sweep_bits[0]);
+	results.OnSweepResults("sweep", 7, 16, 16, sweep_bits[1]);
+	results.OnTestEnd(3, 7, 1, 250);
+
+	// The stream gets cut off in the middle of this one
+	results.OnTestStart(4, "main.cpp", 30, 300);
+	results.OnPassed(2);
+	results.OnFailed(2, "main.cpp", 40, "x");
+
+	const std::vector<GXTest::TestResult>& tests = results.GetTests();
+	DO_TEST(tests.size() == 2, "Got %d tests", (int)tests.size());
+	DO_TEST(tests[0].sweeps.size() == 1 && tests[0].sweeps[0].num_samples == 32 && tests[0].sweeps[0].failed_indices.size() == 2 &&
+	        tests[0].sweeps[0].failed_indices[0] == 3 && tests[0].sweeps[0].failed_indices[1] == 17,
+	        "Consecutive sweep records merged into %d sweeps", (int)tests[0].sweeps.size());
+	DO_TEST(!tests[1].finished && tests[1].num_passed == 2 && tests[1].failures.size() == 1,
+	        "Cut off test counted as %d passed and %d failed subtests (finished: %d)", tests[1].num_passed, (int)tests[1].failures.size(), tests[1].finished);
+	DO_TEST(results.GetNumFailedTests() == 2, "Got %d failed tests", results.GetNumFailedTests());
+
+	std::vector<GXTest::RunSummary> runs(1);
+	runs[0].device = "console, 1";
+	runs[0].connected = true;
+	runs[0].complete = false;
+	runs[0].wall_time = 0;
+	runs[0].results = &results;
+
+	std::string json = WriteSummaryToString(GXTest::WriteJsonSummary, runs);
+	const char* expected_json[] = {
+		"\"file\": \"dir/a,\\\"b\\\".cpp\"",
+		"\"message\": \"Said \\\"hi\\\" \\\\\\n\\tok\"",
+		"\"samples\": 32, \"failed\": 2, \"failed_indices\": [3, 17]",
+		"\"subtests\": 10,\n\t\t\t\"failed_subtests\": 2,",
+		"\"tests\": 2,\n\t\t\t\"failed_tests\": 2,",
+		"\"test\": 4, \"file\": \"main.cpp\", \"line\": 30, \"finished\": false, \"subtests\": 0, \"passed\": 2, \"failed\": 0,",
+		"{ \"test\": 4, \"file\": \"main.cpp\", \"line\": 30, \"runs\": 1, \"passed_runs\": 0, \"failed_runs\": 1 }",
+	};
+	for (const char* expected : expected_json)
+		DO_TEST(json.find(expected) != std::string::npos, "JSON summary doesn't contain %s:\n%s", expected, json.c_str());
 
-	CGX_BEGIN_LOAD_XF_REGS(0x1009, 1);
-	wgPipe->U32 = 1; // 1 color channel
+	std::string csv = WriteSummaryToString(GXTest::WriteCsvSummary, runs);
+	const char* expected_csv = "device,test,file,line,finished,subtests,passed,failed,start_us,duration_us\n"
+	                           "\"console, 1\",3,\"dir/a,\"\"b\"\".cpp\",10,1,7,5,1,100,150\n"
+	                           "\"console, 1\",4,main.cpp,30,0,0,2,0,300,0\n";
+	DO_TEST(csv == expected_csv, "CSV summary is:\n%s", csv.c_str());
 
-	LitChannel chan;
-	chan.hex = 0;
-	chan.matsource = 1; // from vertex
-	CGX_BEGIN_LOAD_XF_REGS(0x100e, 1); // color channel 1
-	wgPipe->U32 = chan.hex;
-	CGX_BEGIN_LOAD_XF_REGS(0x1010, 1); // alpha channel 1
-	wgPipe->U32 = chan.hex;
+	END_TEST();
+}
+#endif
 
-	CGX_LOAD_BP_REG(CGXDefault<TevStageCombiner::AlphaCombiner>(0).hex);
+// Byte i of the chunk with the given sequence number
+static inline u8 LogChunkByte(u32 sequence, u32 i)
+{
+	return (u8)(sequence * 31 + i * 7 + (i >> 8));
+}
 
-	auto genmode = CGXDefault<GenMode>();
-	genmode.numtevstages = 0; // One stage
-	CGX_LOAD_BP_REG(genmode.hex);
+// Size of the chunk with the given sequence number (including the 8 byte header)
+static inline u32 LogChunkSize(u32 sequence)
+{
+	return 8 + (sequence * 2654435761u >> 20) % 3000;
+}
 
-	PE_CONTROL ctrl;
-	ctrl.hex = BPMEM_ZCOMPARE<<24;
-	ctrl.pixel_format = PIXELFMT_RGB8_Z24;
-	ctrl.zformat = ZC_LINEAR;
-	ctrl.early_ztest = 0;
-	CGX_LOAD_BP_REG(ctrl.hex);
+// Writes the chunk with the given sequence number, returns its size
+static u32 FillLogChunk(u8* chunk, u32 sequence)
+{
+	u32 size = LogChunkSize(sequence);
+	for (int i = 0; i < 4; ++i)
+	{
+		chunk[i] = (u8)(sequence >> (24 - 8 * i));
+		chunk[4 + i] = (u8)(size >> (24 - 8 * i));
+	}
+	for (u32 i = 8; i < size; ++i)
+		chunk[i] = LogChunkByte(sequence, i);
+	return size;
+}
 
-	for (int step = 0; step < 13; ++step)
+// Checks the stream of chunks arriving at the consumer side of a LogRing.
+// Runs on the sender thread, hence only collects errors.
+struct LogChunkChecker
+{
+	u8 header[8];
+	u32 position; // in the current chunk
+	u32 sequence;
+	u32 size;
+	u32 next_sequence;
+	u32 num_chunks;
+	u32 num_skipped; // chunks missing in the stream
+	u32 num_errors;
+	bool slow; // sleep now and then, to fill up the ring
+
+	static bool Receive(const u8* data, u32 size, void* userdata)
 	{
-		auto zmode = CGXDefault<ZMode>();
-		CGX_LOAD_BP_REG(zmode.hex);
+		LogChunkChecker* checker = (LogChunkChecker*)userdata;
+		if (checker->slow && (checker->num_chunks & 7) == 0)
+			usleep(100);
+		for (u32 i = 0; i < size; ++i)
+			checker->ReceiveByte(data[i]);
+		return true;
+	}
 
-		// First off, clear previous screen contents
-		CGX_SetViewport(0.0f, 0.0f, 201.0f, 50.0f, 0.0f, 1.0f); // stuff which really should not be filled
-		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
-		cc.d = TEVCOLORARG_RASC;
-		CGX_LOAD_BP_REG(cc.hex);
-		GXTest::Quad().ColorRGBA(0,0,0,0xff).Draw();
+	void ReceiveByte(u8 value)
+	{
+		if (position < 8)
+		{
+			header[position++] = value;
+			if (position == 8)
+			{
+				sequence = (header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+				size = (header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7];
+				num_errors += (sequence < next_sequence || size != LogChunkSize(sequence));
+				num_skipped += sequence - next_sequence;
+				next_sequence = sequence + 1;
+				FinishChunk();
+			}
+			return;
+		}
 
-		CGX_SetViewport(75.0f, 0.0f, 100.0f, 50.0f, 0.0f, 1.0f); // guardband
-		cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
-		cc.d = TEVCOLORARG_RASC;
-		CGX_LOAD_BP_REG(cc.hex);
-		GXTest::Quad().ColorRGBA(0,0x7f,0,0xff).Draw();
+		num_errors += (value != LogChunkByte(sequence, position++));
+		FinishChunk();
+	}
 
-		CGX_SetViewport(100.0f, 0.0f, 50.0f, 50.0f, 0.0f, 1.0f); // viewport
-		cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
-		cc.d = TEVCOLORARG_RASC;
-		CGX_LOAD_BP_REG(cc.hex);
-		GXTest::Quad().ColorRGBA(0,0xff,0,0xff).Draw();
+	void FinishChunk()
+	{
+		if (position == size)
+		{
+			position = 0;
+			++num_chunks;
+		}
+	}
+};
 
-		// Now, enable testing viewport and draw the (red) testing quad
-		CGX_SetViewport(100.0f, 0.0f, 50.0f, 50.0f, 0.0f, 1.0f);
+// Pushes chunks through a small LogRing from this thread to a sender thread
+void LogRingTest()
+{
+	START_TEST();
 
-		cc.d = TEVCOLORARG_C0;
-		CGX_LOAD_BP_REG(cc.hex);
+	const u32 num_chunks = 4000;
+	static u8 chunk[8 + 3000];
 
-		auto tevreg = CGXDefault<TevReg>(1, false); // c0
-		tevreg.red = 0xff;
-		CGX_LOAD_BP_REG(tevreg.low);
-		CGX_LOAD_BP_REG(tevreg.high);
+	const struct
+	{
+		GXTest::LogRing::Policy policy;
+		const char* name;
+	} policies[] = {
+		{ GXTest::LogRing::POLICY_BLOCK, "block" }, { GXTest::LogRing::POLICY_DROP, "drop" }, { GXTest::LogRing::POLICY_SPILL, "spill" },
+	};
+	for (const auto& policy : policies)
+	{
+		GXTest::LogRing ring(4096, policy.policy);
+		LogChunkChecker checker;
+		memset(&checker, 0, sizeof(checker));
+		checker.slow = true;
+		GXTest::LogSender sender(ring, LogChunkChecker::Receive, &checker);
+		sender.Start();
+
+		u32 num_dropped = 0;
+		for (u32 sequence = 0; sequence < num_chunks; ++sequence)
+		{
+			u32 size = FillLogChunk(chunk, sequence);
 
-		CGX_BEGIN_LOAD_XF_REGS(0x1005, 1);
-		wgPipe->U32 = 0; // 0 = enable clipping, 1 = disable clipping
+			// Some chunks are written in pieces, which get joined on the other side
+			if (sequence % 5 == 0 && policy.policy != GXTest::LogRing::POLICY_DROP)
+			{
+				ring.Write(chunk, 5);
+				ring.Write(chunk + 5, size - 5);
+			}
+			else if (!ring.Write(chunk, size))
+			{
+				++num_dropped;
+			}
+		}
+		sender.Stop();
+
+		DO_TEST(checker.num_errors == 0 && checker.position == 0, "%s: %u corrupted chunks (stopped at byte %u of a chunk)", policy.name, checker.num_errors, checker.position);
+		DO_TEST(checker.num_chunks + num_dropped == num_chunks, "%s: Received %u chunks, %u dropped, expected %u", policy.name, checker.num_chunks, num_dropped, num_chunks);
+		DO_TEST(checker.num_skipped <= num_dropped, "%s: %u chunks missing in the stream, but only %u dropped", policy.name, checker.num_skipped, num_dropped);
+		DO_TEST(ring.GetNumDroppedWrites() == num_dropped, "%s: Ring dropped %u writes, expected %u", policy.name, ring.GetNumDroppedWrites(), num_dropped);
+
+		// A slow consumer makes the producer wait, drop or spill
+		if (policy.policy == GXTest::LogRing::POLICY_BLOCK)
+			DO_TEST(ring.GetNumWaits() > 0 && num_dropped == 0, "block: %u waits, %u drops", ring.GetNumWaits(), num_dropped);
+		else if (policy.policy == GXTest::LogRing::POLICY_DROP)
+			DO_TEST(num_dropped > 0, "drop: Nothing dropped");
+		else
+			DO_TEST(ring.GetNumSpilledBytes() > 0 && num_dropped == 0, "spill: %u bytes spilled, %u drops", (u32)ring.GetNumSpilledBytes(), num_dropped);
+	}
 
-		bool expect_quad_to_be_drawn = true;
-		int test_x = 125, test_y = 25; // Somewhere within the viewport
+	// Full speed on both sides, across many wrap-arounds of a tiny ring
+	GXTest::LogRing ring(256, GXTest::LogRing::POLICY_BLOCK);
+	LogChunkChecker checker;
+	memset(&checker, 0, sizeof(checker));
+	GXTest::LogSender sender(ring, LogChunkChecker::Receive, &checker);
+	sender.Start();
+	for (u32 sequence = 0; sequence < num_chunks; ++sequence)
+	{
+		ring.Write(chunk, FillLogChunk(chunk, sequence));
+	}
+	sender.Stop();
+	DO_TEST(checker.num_errors == 0 && checker.num_chunks == num_chunks && checker.num_skipped == 0,
+	        "Tiny ring: %u chunks received, %u corrupted, %u skipped", checker.num_chunks, checker.num_errors, checker.num_skipped);
+
+	END_TEST();
+}
+
+// Returns true if exactly the given bytes have been recorded, and clears the recording
+static bool RecordingMatches(CGXRecordingPipe& pipe, std::initializer_list<u8> expected)
+{
+	bool ret = pipe.GetSize() == expected.size() && memcmp(pipe.GetData(), expected.begin(), expected.size()) == 0;
+	pipe.Clear();
+	return ret;
+}
+
+// Checks the RGBA8 copy decoders against a fake EFB with random contents
+void TextureDecoderTest()
+{
+	START_TEST();
+
+	CGXFakeEfb efb;
+	for (int y = 0; y < 528; ++y)
+		for (int x = 0; x < 640; ++x)
+			efb.SetPixel(x, y, ((u32)rand() << 16) ^ (u32)rand());
+
+	const u32 max_size = 640 * 528;
+	u8* copy = (u8*)memalign(32, max_size * 4);
+	GXTest::Vec4<u8>* pixels = (GXTest::Vec4<u8>*)malloc((max_size + 1) * sizeof(GXTest::Vec4<u8>));
+
+	// Round trip of every pixel for all image sizes up to 40x20 and the full
+	// EFB, compared against the per-pixel decoder used by ReadTestBuffer
+	for (int impl = 0; impl < GXTest::NUM_TEXTURE_DECODER_IMPLS; ++impl)
+	{
+		if (!GXTest::IsTextureDecoderImplSupported((GXTest::TextureDecoderImpl)impl))
+			continue;
+
+		int num_failed_sizes = 0;
+		for (int size = 0; size <= 40 * 20; ++size)
+		{
+			int width = (size < 40 * 20) ? 1 + size % 40 : 640;
+			int height = (size < 40 * 20) ? 1 + size / 40 : 528;
+			int left = size % 7, top = size % 5;
+			if (size == 40 * 20)
+				left = top = 0;
+			efb.CopyTex(left, top, width, height, copy);
+
+			// One extra pixel catches writes beyond the image
+			memset(pixels, 0xAB, (width * height + 1) * sizeof(GXTest::Vec4<u8>));
+			GXTest::DecodeRGBA8Image((GXTest::TextureDecoderImpl)impl, copy, width, height, pixels);
+
+			int num_mismatches = 0;
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					GXTest::Vec4<u8> expected = GXTest::DecodeRGBA8Pixel(copy, x, y, width);
+					u32 rgba = efb.GetPixel(left + x, top + y);
+					const GXTest::Vec4<u8>& pixel = pixels[y * width + x];
+					num_mismatches += (memcmp(&pixel, &expected, sizeof(pixel)) != 0);
+					num_mismatches += (pixel.r != (rgba >> 24) || pixel.g != ((rgba >> 16) & 0xFF) || pixel.b != ((rgba >> 8) & 0xFF) || pixel.a != (rgba & 0xFF));
+				}
+			}
+			const u8* end = (const u8*)&pixels[width * height];
+			num_mismatches += (end[0] != 0xAB || end[1] != 0xAB || end[2] != 0xAB || end[3] != 0xAB);
+			num_failed_sizes += (num_mismatches != 0);
+		}
+		DO_TEST(num_failed_sizes == 0, "%s: %d image sizes decoded incorrectly", GXTest::GetTextureDecoderImplName((GXTest::TextureDecoderImpl)impl), num_failed_sizes);
+	}
+
+	// Benchmark: Full EFB copies, compared to decoding pixel by pixel
+	efb.CopyTex(0, 0, 640, 528, copy);
+	const int num_runs = 20;
+	u64 start = gettime();
+	u32 checksum = 0;
+	for (int run = 0; run < num_runs; ++run)
+		for (int y = 0; y < 528; ++y)
+			for (int x = 0; x < 640; ++x)
+				checksum += GXTest::DecodeRGBA8Pixel(copy, x, y, 640).r;
+	u32 per_pixel_usec = diff_usec(start, gettime());
+	network_printf("Per-pixel decoding: %d us per frame (checksum %08x)\n", per_pixel_usec / num_runs, checksum);
+
+	for (int impl = 0; impl < GXTest::NUM_TEXTURE_DECODER_IMPLS; ++impl)
+	{
+		if (!GXTest::IsTextureDecoderImplSupported((GXTest::TextureDecoderImpl)impl))
+			continue;
+
+		start = gettime();
+		for (int run = 0; run < num_runs; ++run)
+			GXTest::DecodeRGBA8Image((GXTest::TextureDecoderImpl)impl, copy, 640, 528, pixels);
+		u32 usec = diff_usec(start, gettime());
+		network_printf("%s: %d us per frame\n", GXTest::GetTextureDecoderImplName((GXTest::TextureDecoderImpl)impl), usec / num_runs);
+	}
+
+	free(pixels);
+	free(copy);
+
+	END_TEST();
+}
+
+// Checks the decoders of all color and depth copy formats against a fake EFB
+void CopyFormatDecoderTest()
+{
+	START_TEST();
+
+	static const u8 color_formats[] = {
+		GX_TF_I4, GX_TF_I8, GX_TF_IA4, GX_TF_IA8, GX_TF_RGB565, GX_TF_RGB5A3, GX_TF_RGBA8,
+		GX_CTF_R4, GX_CTF_RA4, GX_CTF_RA8, GX_CTF_A8, GX_CTF_R8, GX_CTF_G8, GX_CTF_B8, GX_CTF_RG8, GX_CTF_GB8,
+	};
+	static const u8 depth_formats[] = {
+		GX_TF_Z8, GX_TF_Z16, GX_TF_Z24X8, GX_CTF_Z4, GX_CTF_Z8M, GX_CTF_Z8L, GX_CTF_Z16L,
+	};
+
+	const u32 max_size = 640 * 528;
+	u8* copy = (u8*)memalign(32, max_size * 4);
+	GXTest::Vec4<u8>* pixels = (GXTest::Vec4<u8>*)malloc((max_size + 1) * sizeof(GXTest::Vec4<u8>));
+	u32* depth = (u32*)malloc((max_size + 1) * sizeof(u32));
+
+	// Hand-checked texels
+	memset(copy, 0, 256);
+	copy[0] = 0x5A;
+	copy[1] = 0x80;
+	copy[2] = 0xF8;
+	copy[3] = 0x1F;
+	copy[4] = 0x7F;
+	copy[5] = 0x21;
+	copy[32] = 0x12;
+	copy[33] = 0x34;
+	copy[105] = 0x3C;
+	auto check_pixel = [&](u8 format, int x, int y, int width, u32 expected)
+	{
+		GXTest::Vec4<u8> pixel = GXTest::DecodeCopyPixel(format, copy, x, y, width);
+		u32 rgba = (pixel.r << 24) | (pixel.g << 16) | (pixel.b << 8) | pixel.a;
+		DO_TEST(rgba == expected, "Format 0x%02x, pixel (%d, %d): Expected %08x, got %08x", format, x, y, expected, rgba);
+	};
+	check_pixel(GX_TF_I4, 0, 0, 8, 0x55555500);
+	check_pixel(GX_TF_I4, 1, 0, 8, 0xAAAAAA00);
+	check_pixel(GX_CTF_R4, 1, 0, 8, 0xAA000000);
+	check_pixel(GX_TF_I8, 1, 0, 8, 0x80808000);
+	check_pixel(GX_CTF_A8, 1, 0, 8, 0x00000080);
+	check_pixel(GX_CTF_RA4, 9, 5, 16, 0xCC000033); // second block row, second block
+	check_pixel(GX_TF_IA4, 1, 1, 8, 0x00000000);
+	check_pixel(GX_TF_RGB565, 1, 0, 4, 0xFF00FF00);
+	check_pixel(GX_TF_RGB5A3, 1, 0, 4, 0xF700FFFF);
+	check_pixel(GX_TF_RGB5A3, 2, 0, 4, 0xFF2211FF);
+	check_pixel(GX_TF_IA8, 0, 0, 4, 0x8080805A);
+	check_pixel(GX_CTF_RA8, 0, 0, 4, 0x8000005A);
+	check_pixel(GX_CTF_RG8, 0, 0, 4, 0x805A0000);
+	check_pixel(GX_CTF_GB8, 0, 0, 4, 0x00805A00);
+	check_pixel(GX_TF_RGBA8, 0, 0, 4, 0x8012345A);
+
+	auto check_depth = [&](u8 format, int x, int y, int width, u32 expected)
+	{
+		u32 value = GXTest::DecodeDepthPixel(format, copy, x, y, width);
+		DO_TEST(value == expected, "Format 0x%02x, pixel (%d, %d): Expected depth %06x, got %06x", format, x, y, expected, value);
+	};
+	check_depth(GX_CTF_Z4, 0, 0, 8, 0x500000);
+	check_depth(GX_TF_Z8, 2, 0, 8, 0xF80000);
+	check_depth(GX_CTF_Z8M, 2, 0, 8, 0xF800);
+	check_depth(GX_CTF_Z8L, 2, 0, 8, 0xF8);
+	check_depth(GX_TF_Z16, 1, 0, 4, 0xF81F00);
+	check_depth(GX_CTF_Z16L, 1, 0, 4, 0xF81F);
+	check_depth(GX_TF_Z24X8, 0, 0, 4, 0x801234);
+
+	// Whole images of random texels against the per-pixel decoders, for all
+	// image sizes up to 24x20 and the full EFB
+	for (int impl = 0; impl < GXTest::NUM_TEXTURE_DECODER_IMPLS; ++impl)
+	{
+		if (!GXTest::IsTextureDecoderImplSupported((GXTest::TextureDecoderImpl)impl))
+			continue;
+
+		for (bool is_depth : { false, true })
+		{
+			const u8* formats = is_depth ? depth_formats : color_formats;
+			int num_formats = is_depth ? sizeof(depth_formats) : sizeof(color_formats);
+			for (int f = 0; f < num_formats; ++f)
+			{
+				u8 format = formats[f];
+				int num_failed_sizes = 0;
+				for (int size = 0; size <= 24 * 20; ++size)
+				{
+					int width = (size < 24 * 20) ? 1 + size % 24 : 640;
+					int height = (size < 24 * 20) ? 1 + size / 24 : 528;
+					u32 copy_size = CGX_GetEfbCopySize(width, height, format);
+					for (u32 i = 0; i < copy_size; ++i)
+						copy[i] = rand();
+
+					// One extra pixel catches writes beyond the image
+					int num_mismatches = 0;
+					if (is_depth)
+					{
+						depth[width * height] = 0xABABABAB;
+						GXTest::DecodeDepthImage((GXTest::TextureDecoderImpl)impl, format, copy, width, height, depth);
+						for (int y = 0; y < height; ++y)
+							for (int x = 0; x < width; ++x)
+								num_mismatches += (depth[y * width + x] != GXTest::DecodeDepthPixel(format, copy, x, y, width));
+						num_mismatches += (depth[width * height] != 0xABABABAB);
+					}
+					else
+					{
+						memset(&pixels[width * height], 0xAB, sizeof(GXTest::Vec4<u8>));
+						GXTest::DecodeCopyImage((GXTest::TextureDecoderImpl)impl, format, copy, width, height, pixels);
+						for (int y = 0; y < height; ++y)
+						{
+							for (int x = 0; x < width; ++x)
+							{
+								GXTest::Vec4<u8> expected = GXTest::DecodeCopyPixel(format, copy, x, y, width);
+								num_mismatches += (memcmp(&pixels[y * width + x], &expected, sizeof(expected)) != 0);
+							}
+						}
+						const u8* end = (const u8*)&pixels[width * height];
+						num_mismatches += (end[0] != 0xAB || end[1] != 0xAB || end[2] != 0xAB || end[3] != 0xAB);
+					}
+					num_failed_sizes += (num_mismatches != 0);
+				}
+				DO_TEST(num_failed_sizes == 0, "%s, format 0x%02x: %d image sizes decoded incorrectly", GXTest::GetTextureDecoderImplName((GXTest::TextureDecoderImpl)impl), format, num_failed_sizes);
+			}
+		}
+	}
+
+	free(depth);
+	free(pixels);
+	free(copy);
+
+	END_TEST();
+}
+
+// Checks the stride and size of EFB copies of various regions and formats
+void EfbCopyFootprintTest()
+{
+	START_TEST();
+
+	const struct
+	{
+		u16 width, height;
+		u8 format;
+		u32 stride, size;
+	} cases[] = {
+		{ 640, 528, GX_TF_RGBA8, 640 * 16, 640 * 528 * 4 },
+		{ 1, 1, GX_TF_RGBA8, 64, 64 },
+		{ 4, 4, GX_TF_RGBA8, 64, 64 },
+		{ 5, 4, GX_TF_RGBA8, 128, 128 },
+		{ 4, 5, GX_TF_RGBA8, 64, 128 },
+		{ 200, 50, GX_TF_RGBA8, 50 * 64, 50 * 13 * 64 },
+		{ 1, 1, GX_TF_Z24X8, 64, 64 },
+		{ 9, 1, GX_TF_I8, 64, 64 },
+		{ 8, 5, GX_CTF_R8, 32, 64 },
+		{ 1, 1, GX_TF_I4, 32, 32 },
+		{ 9, 9, GX_CTF_Z4, 64, 128 },
+		{ 8, 8, GX_TF_RGB565, 64, 128 },
+		{ 5, 4, GX_TF_Z16, 64, 64 },
+		{ 99, 10, GX_CTF_RA8, 25 * 32, 25 * 3 * 32 },
+	};
+	for (const auto& test : cases)
+	{
+		u32 stride = CGX_GetEfbCopyStride(test.width, test.format);
+		u32 size = CGX_GetEfbCopySize(test.width, test.height, test.format);
+		DO_TEST(stride == test.stride && size == test.size, "%dx%d format 0x%02x: expected stride %d and size %d, got %d and %d",
+		        test.width, test.height, test.format, test.stride, test.size, stride, size);
+	}
+
+#ifndef GXTEST_HOST
+	// Agrees with libogc. The host stand-in of GX_GetTexBufferSize shares
+	// the formula of the code under test, so this is only checked on consoles.
+	for (int i = 0; i < 1000; ++i)
+	{
+		u16 width = 1 + rand() % 640;
+		u16 height = 1 + rand() % 528;
+		for (u8 format : { GX_TF_I8, GX_TF_RGBA8 })
+		{
+			u32 expected = GX_GetTexBufferSize(width, height, format, GX_FALSE, 1);
+			u32 size = CGX_GetEfbCopySize(width, height, format);
+			DO_TEST(size == expected, "%dx%d format 0x%02x: expected %d bytes, got %d", width, height, format, expected, size);
+		}
+	}
+#endif
+
+	// The footprint covers every byte of an RGBA8 copy, but nothing beyond it
+	CGXFakeEfb efb;
+	efb.Fill(0, 0, 640, 528, 0xFFFFFFFF);
+	static u8 copy[640 * 528 * 4 + 64];
+	for (u16 width : { 1, 3, 4, 13, 200, 640 })
+	{
+		for (u16 height : { 1, 4, 7, 50 })
+		{
+			u32 size = CGX_GetEfbCopySize(width, height, GX_TF_RGBA8);
+			memset(copy, 0xCD, sizeof(copy));
+			efb.CopyTex(0, 0, width, height, copy);
+
+			// Written bytes are either 0xFF (pixels) or 0 (padding)
+			u32 num_written = 0;
+			for (u32 i = 0; i < sizeof(copy); ++i)
+				num_written += (copy[i] != 0xCD);
+			DO_TEST(num_written == size && copy[size - 1] != 0xCD, "%dx%d: Footprint of %d bytes, but %d bytes were written", width, height, size, num_written);
+		}
+	}
+
+	END_TEST();
+}
+
+// Checks the bounding box readback of CoverageProbe against a fake bounding box unit
+void CoverageProbeTest()
+{
+	START_TEST();
+
+	CGXFakeBoundingBox bbox;
+	GXTest::CoverageProbe probe(bbox);
+
+	// Nothing drawn
+	probe.Begin();
+	GXTest::BoundingBox box = probe.End();
+	DO_TEST(box.IsEmpty(), "Expected an empty box, got (%d, %d)-(%d, %d)", box.left, box.top, box.right, box.bottom);
+	DO_TEST(!box.Contains(0, 0) && !box.Intersects(0, 0, 1023, 1023), "Empty box must not cover anything");
+	DO_TEST(bbox.GetNumReads() == 1, "Expected one read, got %d", bbox.GetNumReads());
+
+	// Single pixel, at both ends of the coordinate range
+	for (int coord : { 0, 639, 1023 })
+	{
+		probe.Begin();
+		bbox.Draw(coord, coord, coord, coord);
+		box = probe.End();
+		DO_TEST(!box.IsEmpty() && box.left == coord && box.right == coord && box.top == coord && box.bottom == coord,
+		        "Pixel (%d, %d): got (%d, %d)-(%d, %d)", coord, coord, box.left, box.top, box.right, box.bottom);
+		DO_TEST(box.Contains(coord, coord), "Pixel %d not contained", coord);
+	}
+
+	// Union of several draws, which must not leak into the next probe
+	probe.Begin();
+	bbox.Draw(100, 10, 149, 39);
+	bbox.Draw(75, 20, 80, 49);
+	box = probe.End();
+	DO_TEST(box.left == 75 && box.right == 149 && box.top == 10 && box.bottom == 49, "Expected (75, 10)-(149, 49), got (%d, %d)-(%d, %d)", box.left, box.top, box.right, box.bottom);
+	DO_TEST(box.Contains(125, 25) && !box.Contains(74, 25) && !box.Contains(125, 50), "Wrong containment for (%d, %d)-(%d, %d)", box.left, box.top, box.right, box.bottom);
+	DO_TEST(box.Intersects(0, 0, 75, 10) && box.Intersects(149, 49, 200, 200) && !box.Intersects(150, 0, 200, 49) && !box.Intersects(0, 0, 74, 100),
+	        "Wrong intersection for (%d, %d)-(%d, %d)", box.left, box.top, box.right, box.bottom);
+
+	probe.Begin();
+	bbox.Draw(0, 0, 9, 9);
+	box = probe.End();
+	DO_TEST(box.left == 0 && box.right == 9 && box.top == 0 && box.bottom == 9, "Previous draws not cleared: (%d, %d)-(%d, %d)", box.left, box.top, box.right, box.bottom);
+
+	// Register decoding follows the BP register layout
+	bbox.LoadBPReg((BPMEM_CLEARBBOX1 << 24) | (200 << 10) | 100);
+	bbox.LoadBPReg((BPMEM_CLEARBBOX2 << 24) | (40 << 10) | 20);
+	box = probe.End();
+	DO_TEST(box.left == 100 && box.right == 200 && box.top == 20 && box.bottom == 40, "Expected (100, 20)-(200, 40), got (%d, %d)-(%d, %d)", box.left, box.top, box.right, box.bottom);
+
+	// Without a GPU, nothing gets drawn. On hardware, this is covered by ClipTest.
+#ifdef GXTEST_HOST
+	GXTest::GpuBoundingBox gpu_bbox;
+	GXTest::CoverageProbe gpu_probe(gpu_bbox);
+	gpu_probe.Begin();
+	GXTest::Quad().Draw();
+	box = gpu_probe.End();
+	DO_TEST(box.IsEmpty(), "Expected an empty box, got (%d, %d)-(%d, %d)", box.left, box.top, box.right, box.bottom);
+#endif
+
+	END_TEST();
+}
+
+// Checks the register encoding of the performance counter selection
+void PerfCounterDecodeTest()
+{
+	START_TEST();
+
+	// Each metric enables exactly one of the perf0 registers, with a unique value
+	u32 previous_values[CGX_PERF0_NONE];
+	for (int metric = CGX_PERF0_TRIANGLES; metric <= CGX_PERF0_NONE; ++metric)
+	{
+		u32 tri_reg, quad_reg;
+		CGX_GetPerf0SelectRegs((CGXPerf0Metric)metric, &tri_reg, &quad_reg);
+		DO_TEST((tri_reg >> 24) == BPMEM_PERF0_TRI && (quad_reg >> 24) == BPMEM_PERF0_QUAD, "Metric %d: Wrong register addresses 0x%08x 0x%08x", metric, tri_reg, quad_reg);
+
+		bool is_tri = metric <= CGX_PERF0_TRIANGLES_SCISSORED;
+		bool is_quad = !is_tri && metric != CGX_PERF0_NONE;
+		DO_TEST(((tri_reg & 0xFFFFFF) != 0) == is_tri && ((quad_reg & 0xFFFFFF) != 0) == is_quad, "Metric %d: Got 0x%08x 0x%08x", metric, tri_reg, quad_reg);
+
+		if (metric == CGX_PERF0_NONE)
+			break;
+
+		previous_values[metric] = tri_reg | quad_reg;
+		for (int other = CGX_PERF0_TRIANGLES; other < metric; ++other)
+			DO_TEST(previous_values[other] != previous_values[metric], "Metrics %d and %d are encoded the same", other, metric);
+	}
+
+	// Registers are combined lower half first
+	const u16 cp_regs[2] = { 0x5678, 0x1234 };
+	const u16 pe_regs[12] = { 0x0001, 0x0000, 0xFFFF, 0x0000, 0x0000, 0x0001, 0x0003, 0x0002, 0xBEEF, 0xDEAD, 0xFFFF, 0xFFFF };
+	CGXPerfCounters counters = CGX_DecodePerfCounters(cp_regs, pe_regs);
+	DO_TEST(counters.perf0 == 0x12345678, "perf0: got 0x%08x", counters.perf0);
+	DO_TEST(counters.zcomploc_pixels_in == 1 && counters.zcomploc_pixels_out == 0xFFFF, "Early depth test counters: got 0x%08x 0x%08x", counters.zcomploc_pixels_in, counters.zcomploc_pixels_out);
+	DO_TEST(counters.zcomp_pixels_in == 0x10000 && counters.zcomp_pixels_out == 0x20003, "Late depth test counters: got 0x%08x 0x%08x", counters.zcomp_pixels_in, counters.zcomp_pixels_out);
+	DO_TEST(counters.blend_pixels_in == 0xDEADBEEF && counters.copy_clocks == 0xFFFFFFFF, "Blend/copy counters: got 0x%08x 0x%08x", counters.blend_pixels_in, counters.copy_clocks);
+
+	END_TEST();
+}
+
+// Checks which register writes are dropped by the CGX shadow state
+void ShadowStateTest()
+{
+	START_TEST();
+
+	CGXRecordingPipe recording;
+	CGXRecordingPipe* wgPipe = &recording; // Make the CGX macros write to the recording
+	static CGXShadowState shadow;
+	shadow.Invalidate();
+	shadow.ResetBytesSaved();
+	CGXShadowState* previous_shadow = CGX_SetShadowState(&shadow);
+
+	// BP: Repeated values are only sent once
+	CGX_LOAD_BP_REG(0x00123456);
+	CGX_LOAD_BP_REG(0x00123456);
+	DO_TEST(RecordingMatches(recording, { 0x61, 0x00, 0x12, 0x34, 0x56 }), "Redundant BP write not dropped (%d bytes recorded)", recording.GetSize());
+	CGX_LOAD_BP_REG(0x00123457);
+	DO_TEST(RecordingMatches(recording, { 0x61, 0x00, 0x12, 0x34, 0x57 }), "Modified BP write dropped (%d bytes recorded)", recording.GetSize());
+	DO_TEST(shadow.GetBytesSaved() == 5, "Expected 5 bytes saved, got %d", shadow.GetBytesSaved());
+
+	// BP: Registers with side effects are always sent
+	for (u32 reg : { (u32)BPMEM_TRIGGER_EFB_COPY, (u32)BPMEM_SETDRAWDONE, (u32)BPMEM_PE_TOKEN_ID, (u32)BPMEM_TEXINVALIDATE, (u32)BPMEM_TEV_REGISTER_H })
+	{
+		CGX_LOAD_BP_REG((reg << 24) | 2);
+		CGX_LOAD_BP_REG((reg << 24) | 2);
+		DO_TEST(recording.GetSize() == 10, "Write to BP register 0x%02x dropped", reg);
+		recording.Clear();
+	}
+
+	// BP: The write following the BP mask only updates parts of the register,
+	// so the shadow value is unknown afterwards
+	CGX_LOAD_BP_REG((BPMEM_ZMODE << 24) | 0x17);
+	CGX_LOAD_BP_REG((BPMEM_BP_MASK << 24) | 0x10);
+	CGX_LOAD_BP_REG((BPMEM_ZMODE << 24) | 0x17);
+	CGX_LOAD_BP_REG((BPMEM_ZMODE << 24) | 0x17);
+	CGX_LOAD_BP_REG((BPMEM_ZMODE << 24) | 0x17);
+	DO_TEST(recording.GetSize() == 4 * 5, "Masked BP write not handled correctly (%d bytes recorded)", recording.GetSize());
+	recording.Clear();
+
+	// CP
+	CGX_LOAD_CP_REG(0x50, 0x200);
+	CGX_LOAD_CP_REG(0x50, 0x200);
+	CGX_LOAD_CP_REG(0x60, 0x200);
+	DO_TEST(RecordingMatches(recording, { 0x08, 0x50, 0x00, 0x00, 0x02, 0x00, 0x08, 0x60, 0x00, 0x00, 0x02, 0x00 }), "Unexpected CP writes (%d bytes recorded)", recording.GetSize());
+
+	// XF: Blocks are dropped if none of their values change
+	const u32 values[3] = { 1, 2, 3 };
+	const u32 modified_values[3] = { 1, 2, 4 };
+	CGX_LOAD_XF_REG(0x1009, 1);
+	CGX_LOAD_XF_REG(0x1009, 1);
+	DO_TEST(RecordingMatches(recording, { 0x10, 0x00, 0x00, 0x10, 0x09, 0x00, 0x00, 0x00, 0x01 }), "Redundant XF write not dropped (%d bytes recorded)", recording.GetSize());
+	CGX_LOAD_XF_REGS(0x100a, 3, values);
+	CGX_LOAD_XF_REGS(0x100a, 3, values);
+	CGX_LOAD_XF_REGS(0x100a, 3, modified_values);
+	DO_TEST(recording.GetSize() == 2 * (5 + 3 * 4), "Expected two XF blocks to be sent (%d bytes recorded)", recording.GetSize());
+	recording.Clear();
+	CGX_LOAD_XF_REG(0x100c, 4);
+	DO_TEST(recording.GetSize() == 0, "Redundant XF write to part of a block not dropped (%d bytes recorded)", recording.GetSize());
+
+	// XF: Unfiltered loads make the shadow state forget about the loaded registers
+	CGX_BEGIN_LOAD_XF_REGS(0x100b, 2);
+	wgPipe->U32 = 2;
+	wgPipe->U32 = 4;
+	recording.Clear();
+	CGX_LOAD_XF_REG(0x100a, 1);
+	CGX_LOAD_XF_REG(0x100b, 2);
+	CGX_LOAD_XF_REG(0x100c, 4);
+	DO_TEST(recording.GetSize() == 2 * 9, "Unfiltered XF load not handled correctly (%d bytes recorded)", recording.GetSize());
+	recording.Clear();
+
+	u32 bytes_saved = 5 + 5 + 6 + 9 + (5 + 3 * 4) + 9 + 9;
+	DO_TEST(shadow.GetBytesSaved() == bytes_saved, "Expected %d bytes saved, got %d", bytes_saved, shadow.GetBytesSaved());
+
+	// Explicit invalidation
+	CGX_InvalidateShadowState();
+	CGX_LOAD_BP_REG(0x00123457);
+	CGX_LOAD_CP_REG(0x50, 0x200);
+	CGX_LOAD_XF_REG(0x1009, 1);
+	DO_TEST(recording.GetSize() == 5 + 6 + 9, "Writes dropped after invalidation (%d bytes recorded)", recording.GetSize());
+	recording.Clear();
+
+	// No filtering at all without a shadow state
+	CGX_SetShadowState(NULL);
+	CGX_LOAD_BP_REG(0x00123457);
+	CGX_LOAD_CP_REG(0x50, 0x200);
+	CGX_LOAD_XF_REG(0x1009, 1);
+	DO_TEST(recording.GetSize() == 5 + 6 + 9, "Writes dropped without shadow state (%d bytes recorded)", recording.GetSize());
+
+	CGX_SetShadowState(previous_shadow);
+
+	END_TEST();
+}
+
+// Checks the encoding of GPU commands recorded to display lists
+void DisplayListTest()
+{
+	START_TEST();
+
+	const u32 capacity = 96;
+	u8* list = (u8*)memalign(32, capacity);
+
+	CGX_BeginDisplayList(list, capacity);
+	CGX_LOAD_BP_REG(0x00123456);
+	CGX_LOAD_CP_REG(0x50, 0x200);
+	CGX_LOAD_XF_REG(0x1009, 1);
+	u32 size = CGX_EndDisplayList();
+
+	const u8 expected[] = {
+		0x61, 0x00, 0x12, 0x34, 0x56,
+		0x08, 0x50, 0x00, 0x00, 0x02, 0x00,
+		0x10, 0x00, 0x00, 0x10, 0x09, 0x00, 0x00, 0x00, 0x01
+	};
+	DO_TEST(size == 32, "Expected a list of 32 bytes, got %d", size);
+	DO_TEST(memcmp(list, expected, sizeof(expected)) == 0, "Display list contents don't match the expected encoding (first byte: 0x%02x)", list[0]);
+	for (u32 i = sizeof(expected); i < size; ++i)
+		DO_TEST(list[i] == 0, "Expected NOP padding at offset %d, got 0x%02x", i, list[i]);
+
+	// Redundant writes are recorded, too. Lists which end on a 32 byte
+	// boundary get another 32 bytes of NOPs due to flushing the pipe.
+	CGX_BeginDisplayList(list, capacity);
+	for (int i = 0; i < 4; ++i)
+		CGX_LOAD_BP_REG(0x00123456);
+	for (int i = 0; i < 2; ++i)
+		CGX_LOAD_CP_REG(0x50, 0x200);
+	size = CGX_EndDisplayList();
+
+	DO_TEST(size == 64, "Expected a list of 64 bytes, got %d", size);
+	for (int i = 0; i < 4; ++i)
+		DO_TEST(memcmp(list + 5 * i, expected, 5) == 0, "BP write %d not recorded", i);
+	for (int i = 0; i < 2; ++i)
+		DO_TEST(memcmp(list + 20 + 6 * i, expected + 5, 6) == 0, "CP write %d not recorded", i);
+	for (u32 i = 32; i < size; ++i)
+		DO_TEST(list[i] == 0, "Expected NOP padding at offset %d, got 0x%02x", i, list[i]);
+
+	// Filling the buffer completely makes the FIFO wrap around
+	CGX_BeginDisplayList(list, 64);
+	for (int i = 0; i < 4; ++i)
+		CGX_LOAD_BP_REG(0x00123456);
+	for (int i = 0; i < 2; ++i)
+		CGX_LOAD_CP_REG(0x50, 0x200);
+	size = CGX_EndDisplayList();
+	DO_TEST(size == 0, "Expected an overflow when filling 64 bytes, got a list of %d bytes", size);
+
+	free(list);
+
+	END_TEST();
+}
+
+// Checks all implementations of EvaluateTevCombinerBatch against TevCombinerExpectation.
+// The host build checks every combination of (the lower 8 bits of) a, b and c
+// in every mode, while the console only checks a subset of them.
+void TevCombinerBatchTest()
+{
+	START_TEST();
+
+	const int chunk_size = 4096;
+	static u8 a[chunk_size], b[chunk_size], c[chunk_size];
+	static s16 d[chunk_size], expected[chunk_size], results[chunk_size];
+#ifdef GXTEST_HOST
+	const int num_combinations = 1 << 24;
+#else
+	const int num_combinations = 1 << 16;
+#endif
+
+	for (int mode_index = 0; mode_index < 4 * 4 * 2 * 2; ++mode_index)
+	{
+		GXTest::TevCombinerMode mode;
+		mode.shift = mode_index % 4;
+		mode.bias = (mode_index / 4) % 4; // includes compare mode, which is treated like a zero bias
+		mode.op = (mode_index / 16) % 2;
+		mode.clamp = mode_index / 32;
+
+		int num_mismatches[GXTest::NUM_TEV_COMBINER_IMPLS] = { 0 };
+		for (int first = 0; first < num_combinations; first += chunk_size)
+		{
+			for (int i = 0; i < chunk_size; ++i)
+			{
+				u32 index = first + i;
+				a[i] = index & 0xFF;
+				b[i] = (index >> 8) & 0xFF;
+				c[i] = index >> 16;
+				d[i] = (s16)((index * 0x9E3779B1) >> 21) - 1024;
+				expected[i] = GXTest::TevCombinerExpectation(a[i], b[i], c[i], d[i], mode.shift, mode.bias, mode.op, mode.clamp);
+			}
+
+			for (int impl = 0; impl < GXTest::NUM_TEV_COMBINER_IMPLS; ++impl)
+			{
+				if (!GXTest::IsTevCombinerImplSupported((GXTest::TevCombinerImpl)impl))
+					continue;
+
+				GXTest::EvaluateTevCombinerBatch((GXTest::TevCombinerImpl)impl, a, b, c, d, chunk_size, mode, results);
+				num_mismatches[impl] += (memcmp(results, expected, sizeof(results)) != 0);
+			}
+		}
+
+		for (int impl = 0; impl < GXTest::NUM_TEV_COMBINER_IMPLS; ++impl)
+		{
+			if (GXTest::IsTevCombinerImplSupported((GXTest::TevCombinerImpl)impl))
+				DO_TEST(num_mismatches[impl] == 0, "%s: %d chunks mismatch in mode %d", GXTest::GetTevCombinerImplName((GXTest::TevCombinerImpl)impl), num_mismatches[impl], mode_index);
+		}
+	}
+
+	// Batch sizes which leave a remainder for the generic code path, at unaligned addresses
+	for (int impl = 0; impl < GXTest::NUM_TEV_COMBINER_IMPLS; ++impl)
+	{
+		if (!GXTest::IsTevCombinerImplSupported((GXTest::TevCombinerImpl)impl))
+			continue;
+
+		GXTest::TevCombinerMode mode = { 2, 2, 1, 0 };
+		for (int count = 1; count < 40; ++count)
+		{
+			memset(results, 0x55, sizeof(results));
+			GXTest::EvaluateTevCombinerBatch((GXTest::TevCombinerImpl)impl, a + count, b + count, c + count, d + count, count, mode, results + count);
+
+			int num_mismatches = 0;
+			for (int i = 0; i < 80; ++i)
+			{
+				s16 expectation = (i < count || i >= 2 * count) ? 0x5555 : GXTest::TevCombinerExpectation(a[i], b[i], c[i], d[i], mode.shift, mode.bias, mode.op, mode.clamp);
+				num_mismatches += (results[i] != expectation);
+			}
+			DO_TEST(num_mismatches == 0, "%s: %d mismatches for batch size %d", GXTest::GetTevCombinerImplName((GXTest::TevCombinerImpl)impl), num_mismatches, count);
+		}
+	}
+
+	END_TEST();
+}
+
+static GXTest::Vec4<int> MakeVec4(int r, int g, int b, int a)
+{
+	GXTest::Vec4<int> ret;
+	ret.r = r;
+	ret.g = g;
+	ret.b = b;
+	ret.a = a;
+	return ret;
+}
+
+// Hand-checked cases of the compare mode reference model
+void TevCompareModelTest()
+{
+	START_TEST();
+
+	// Only the lower 8 bits are compared: a.r and b.r are considered equal
+	auto a = MakeVec4(10 + 256, 20, 30, 40);
+	auto b = MakeVec4(10, 19, 31, -1024 + 40);
+	const int c = 5;
+	const int d = 100;
+	const struct
+	{
+		int mode;
+		int channel;
+		bool passed;
+	} cases[] = {
+		{ TEVCMP_R8_GT - 8, 0, false }, { TEVCMP_R8_EQ - 8, 1, true },
+		{ TEVCMP_GR16_GT - 8, 2, true }, { TEVCMP_GR16_EQ - 8, 3, false },
+		{ TEVCMP_BGR24_GT - 8, 0, false }, { TEVCMP_BGR24_EQ - 8, 3, false },
+		{ TEVCMP_RGB8_GT - 8, 0, false }, { TEVCMP_RGB8_GT - 8, 1, true }, { TEVCMP_RGB8_GT - 8, 2, false },
+		{ TEVCMP_RGB8_EQ - 8, 0, true }, { TEVCMP_RGB8_EQ - 8, 1, false }, { TEVCMP_RGB8_EQ - 8, 2, false },
+		{ TEVCMP_A8_GT - 8, 3, false }, { TEVCMP_A8_EQ - 8, 3, true },
+	};
+	for (const auto& test : cases)
+	{
+		int result = GXTest::TevCompareExpectation(a, b, c, d, test.channel, test.mode, 0);
+		int expected = test.passed ? (d + c) : d;
+		DO_TEST(result == expected, "Mode %d, channel %d: expected %d, got %d", test.mode, test.channel, expected, result);
+	}
+
+	// c is masked to 8 bits, the result is clamped like in regular mode
+	int result = GXTest::TevCompareExpectation(a, b, 300, 250, 0, TEVCMP_R8_EQ - 8, 1);
+	DO_TEST(result == 255, "Expected a clamped result of 255, got %d", result);
+	result = GXTest::TevCompareExpectation(a, b, 300, 250, 0, TEVCMP_R8_EQ - 8, 0);
+	DO_TEST(result == 294, "Expected an unclamped result of 294, got %d", result);
+	result = GXTest::TevCompareExpectation(a, b, 255, 1000, 0, TEVCMP_R8_EQ - 8, 0);
+	DO_TEST(result == 1023, "Expected a saturated result of 1023, got %d", result);
+
+	// Reproduces the hardware test at the end of TevCombinerTest: The alpha
+	// combiner compares the red channels of the color combiner's inputs.
+	for (int i = 0; i < 2; ++i)
+	{
+		GXTest::Vec4<int> regs[4] = { MakeVec4(0, 0, 0, 0), MakeVec4(127, 0, 0, 0),
+		                              MakeVec4(127, 0, 0, 0), MakeVec4(127 + i, 0, 0, 255) };
+
+		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+		cc.a = TEVCOLORARG_C2;
+		cc.b = TEVCOLORARG_C1;
+
+		auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+		ac.bias = TevBias_COMPARE;
+		ac.a = TEVALPHAARG_A0;
+		ac.b = TEVALPHAARG_A1;
+		ac.c = TEVALPHAARG_A2;
+
+		GXTest::TevStageInputs inputs = GXTest::GetTevStageInputs(regs, cc, ac);
+		result = GXTest::TevStageExpectation(inputs, cc, ac).a;
+		int expected = (i == 1) ? 255 : 0;
+		DO_TEST(result == expected, "Alpha compare run %d: expected %d, got %d", i, expected, result);
+	}
+
+	END_TEST();
+}
+
+// Store a BP register write to a BPMemory snapshot
+static void LoadBPRegToSnapshot(BPMemory& bp, u32 value)
+{
+	((u32*)&bp)[value >> 24] = value;
+}
+
+static void LoadTevRegToSnapshot(BPMemory& bp, int index, bool is_konst, const GXTest::Vec4<int>& value)
+{
+	auto tevreg = CGXDefault<TevReg>(index, is_konst);
+	tevreg.red = value.r;
+	tevreg.green = value.g;
+	tevreg.blue = value.b;
+	tevreg.alpha = value.a;
+	LoadBPRegToSnapshot(bp, tevreg.low);
+	LoadBPRegToSnapshot(bp, tevreg.high);
+}
+
+// Swap table entries of TevKSel registers 2*table and 2*table+1
+static void LoadSwapTableToSnapshot(BPMemory& bp, int table, int r, int g, int b, int a, int kcsel0, int kasel0)
+{
+	TevKSel ksel;
+	ksel.hex = (BPMEM_TEV_KSEL + 2 * table) << 24;
+	ksel.swap1 = r;
+	ksel.swap2 = g;
+	ksel.kcsel0 = kcsel0;
+	ksel.kasel0 = kasel0;
+	LoadBPRegToSnapshot(bp, ksel.hex);
+
+	ksel.hex = (BPMEM_TEV_KSEL + 2 * table + 1) << 24;
+	ksel.swap1 = b;
+	ksel.swap2 = a;
+	LoadBPRegToSnapshot(bp, ksel.hex);
+}
+
+// Checks the tev pipeline simulator against chained evaluations of the
+// reference model, and checks the inputs which the model doesn't cover.
+void TevSimulatorTest()
+{
+	START_TEST();
+
+	static BPMemory bp;
+
+	// Random setups of up to 16 stages which only use register and constant inputs
+	const u32 color_args[] = { TEVCOLORARG_CPREV, TEVCOLORARG_APREV, TEVCOLORARG_C0, TEVCOLORARG_A0,
+	                           TEVCOLORARG_C1, TEVCOLORARG_A1, TEVCOLORARG_C2, TEVCOLORARG_A2,
+	                           TEVCOLORARG_ONE, TEVCOLORARG_HALF, TEVCOLORARG_ZERO };
+	const u32 alpha_args[] = { TEVALPHAARG_APREV, TEVALPHAARG_A0, TEVALPHAARG_A1, TEVALPHAARG_A2, TEVALPHAARG_ZERO };
+	auto random_value = []() { return -1024 + (rand() % 2048); };
+	for (int setup = 0; setup < 2000; ++setup)
+	{
+		memset(&bp, 0, sizeof(bp));
+
+		auto genmode = CGXDefault<GenMode>();
+		genmode.numtevstages = rand() % 16;
+		LoadBPRegToSnapshot(bp, genmode.hex);
+
+		GXTest::Vec4<int> regs[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			regs[i] = MakeVec4(random_value(), random_value(), random_value(), random_value());
+			LoadTevRegToSnapshot(bp, i, false, regs[i]);
+		}
+
+		TevStageCombiner::ColorCombiner cc;
+		TevStageCombiner::AlphaCombiner ac;
+		for (int stage = 0; stage <= (int)genmode.numtevstages; ++stage)
+		{
+			cc = CGXDefault<TevStageCombiner::ColorCombiner>(stage);
+			cc.a = color_args[rand() % 11];
+			cc.b = color_args[rand() % 11];
+			cc.c = color_args[rand() % 11];
+			cc.d = color_args[rand() % 11];
+			cc.bias = rand() % 4;
+			cc.shift = rand() % 4;
+			cc.op = rand() % 2;
+			cc.clamp = rand() % 2;
+			cc.dest = rand() % 4;
+
+			ac = CGXDefault<TevStageCombiner::AlphaCombiner>(stage);
+			ac.a = alpha_args[rand() % 5];
+			ac.b = alpha_args[rand() % 5];
+			ac.c = alpha_args[rand() % 5];
+			ac.d = alpha_args[rand() % 5];
+			ac.bias = rand() % 4;
+			ac.shift = rand() % 4;
+			ac.op = rand() % 2;
+			ac.clamp = rand() % 2;
+			ac.dest = rand() % 4;
+
+			LoadBPRegToSnapshot(bp, cc.hex);
+			LoadBPRegToSnapshot(bp, ac.hex);
+
+			GXTest::TevStageInputs inputs = GXTest::GetTevStageInputs(regs, cc, ac);
+			GXTest::Vec4<int> out = GXTest::TevStageExpectation(inputs, cc, ac);
+			regs[cc.dest].r = out.r;
+			regs[cc.dest].g = out.g;
+			regs[cc.dest].b = out.b;
+			regs[ac.dest].a = out.a;
+		}
+		GXTest::TevSimulator simulator(bp);
+		GXTest::TevPixelInputs pixel;
+		memset(&pixel, 0, sizeof(pixel));
+		GXTest::Vec4<int> result = simulator.Evaluate(pixel);
+		GXTest::Vec4<int> expected = MakeVec4(regs[cc.dest].r, regs[cc.dest].g, regs[cc.dest].b, regs[ac.dest].a);
+		DO_TEST(result.r == expected.r && result.g == expected.g && result.b == expected.b && result.a == expected.a,
+		        "Setup %d (%d stages): expected (%d, %d, %d, %d), got (%d, %d, %d, %d)", setup, genmode.numtevstages + 1,
+		        expected.r, expected.g, expected.b, expected.a, result.r, result.g, result.b, result.a);
+	}
+
+	// Konst selection, swap tables, texture and rasterized color inputs
+	memset(&bp, 0, sizeof(bp));
+	auto genmode = CGXDefault<GenMode>();
+	genmode.numtevstages = 3;
+	LoadBPRegToSnapshot(bp, genmode.hex);
+
+	// Table 0 is the identity, table 1 reverses the channels,
+	// table 2 broadcasts green. Stage 0 selects konst values 7/8 and K2.a.
+	LoadSwapTableToSnapshot(bp, 0, 0, 1, 2, 3, 1, 30);
+	LoadSwapTableToSnapshot(bp, 1, 3, 2, 1, 0, 0, 0);
+	LoadSwapTableToSnapshot(bp, 2, 1, 1, 1, 1, 0, 0);
+	LoadTevRegToSnapshot(bp, 2, true, MakeVec4(1, 2, 3, 44));
+
+	// Stage 0 outputs konst to c0
+	auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+	auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+	cc.d = TEVCOLORARG_KONST;
+	ac.d = TEVALPHAARG_KONST;
+	cc.dest = GX_TEVREG0;
+	ac.dest = GX_TEVREG0;
+	LoadBPRegToSnapshot(bp, cc.hex);
+	LoadBPRegToSnapshot(bp, ac.hex);
+
+	// Stage 1 outputs texture map 3 swapped by table 1 to c1
+	cc = CGXDefault<TevStageCombiner::ColorCombiner>(1);
+	ac = CGXDefault<TevStageCombiner::AlphaCombiner>(1);
+	cc.d = TEVCOLORARG_TEXC;
+	ac.d = TEVALPHAARG_TEXA;
+	ac.tswap = 1;
+	cc.dest = GX_TEVREG1;
+	ac.dest = GX_TEVREG1;
+	LoadBPRegToSnapshot(bp, cc.hex);
+	LoadBPRegToSnapshot(bp, ac.hex);
+
+	auto orders = CGXDefault<TwoTevStageOrders>(0);
+	orders.enable1 = 1;
+	orders.texmap1 = 3;
+	LoadBPRegToSnapshot(bp, orders.hex);
+
+	// Stage 2 outputs color channel 1 swapped by table 2 to c2
+	cc = CGXDefault<TevStageCombiner::ColorCombiner>(2);
+	ac = CGXDefault<TevStageCombiner::AlphaCombiner>(2);
+	cc.d = TEVCOLORARG_RASC;
+	ac.d = TEVALPHAARG_RASA;
+	ac.rswap = 2;
+	cc.dest = GX_TEVREG2;
+	ac.dest = GX_TEVREG2;
+	LoadBPRegToSnapshot(bp, cc.hex);
+	LoadBPRegToSnapshot(bp, ac.hex);
+
+	// Stage 3 adds a disabled texture (white) to the lerp of c0 and c1, and
+	// c0 alpha to c2 alpha
+	cc = CGXDefault<TevStageCombiner::ColorCombiner>(3);
+	ac = CGXDefault<TevStageCombiner::AlphaCombiner>(3);
+	cc.a = TEVCOLORARG_C0;
+	cc.b = TEVCOLORARG_C1;
+	cc.c = TEVCOLORARG_HALF;
+	cc.d = TEVCOLORARG_TEXC;
+	ac.a = TEVALPHAARG_A0;
+	ac.b = TEVALPHAARG_ZERO;
+	ac.c = TEVALPHAARG_ZERO;
+	ac.d = TEVALPHAARG_A2;
+	LoadBPRegToSnapshot(bp, cc.hex);
+	LoadBPRegToSnapshot(bp, ac.hex);
+
+	orders = CGXDefault<TwoTevStageOrders>(1);
+	orders.colorchan0 = 1;
+	LoadBPRegToSnapshot(bp, orders.hex);
+
+	GXTest::TevPixelInputs pixel;
+	memset(&pixel, 0, sizeof(pixel));
+	pixel.texmaps[3] = MakeVec4(10, 20, 30, 40);
+	pixel.colors[1] = MakeVec4(50, 60, 70, 80);
+
+	GXTest::TevSimulator simulator(bp);
+	GXTest::Vec4<int> result = simulator.Evaluate(pixel);
+	// c0 = (223, 223, 223, 44), c1 = (40, 30, 20, 10), c2 = (60, 60, 60, 60)
+	// Texture input is white: (255, 255, 255) + lerp(c0, c1, 129/256)
+	GXTest::Vec4<int> expected = MakeVec4(255 + 131, 255 + 126, 255 + 121, 60 + 44);
+	DO_TEST(result.r == expected.r && result.g == expected.g && result.b == expected.b && result.a == expected.a,
+	        "Expected (%d, %d, %d, %d), got (%d, %d, %d, %d)",
+	        expected.r, expected.g, expected.b, expected.a, result.r, result.g, result.b, result.a);
+
+	// Konst registers may also be set directly. K2.a reaches the output
+	// through c0 alpha.
+	simulator.SetKonst(2, MakeVec4(0, 0, 0, 100));
+	result = simulator.Evaluate(pixel);
+	DO_TEST(result.a == 60 + 100, "Expected alpha %d after setting K2, got %d", 60 + 100, result.a);
+
+	// So may tev registers, which keep their value until a stage writes them
+	memset(&bp, 0, sizeof(bp));
+	genmode.numtevstages = 0;
+	LoadBPRegToSnapshot(bp, genmode.hex);
+	cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+	ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+	cc.d = TEVCOLORARG_C1;
+	ac.d = TEVALPHAARG_A1;
+	LoadBPRegToSnapshot(bp, cc.hex);
+	LoadBPRegToSnapshot(bp, ac.hex);
+	GXTest::TevSimulator register_simulator(bp);
+	register_simulator.SetRegister(GX_TEVREG1, MakeVec4(1, -2, 300, 4));
+	result = register_simulator.Evaluate(pixel);
+	DO_TEST(result.r == 1 && result.g == -2 && result.b == 300 && result.a == 4, "Expected c1 (1, -2, 300, 4), got (%d, %d, %d, %d)", result.r, result.g, result.b, result.a);
+
+	END_TEST();
+}
+
+// Checks that the input textures of GetTevOutputFrame cover the expected
+// combinations and that the frame decoder recovers the tev output of each
+// pixel from a fake EFB, which is set up like the two render passes would.
+void TevInputFrameTest()
+{
+	START_TEST();
+
+	static u8 textures[3][TEV_INPUT_FRAME_SIZE];
+	for (int frame : {0, 1, TEV_INPUT_FRAME_COUNT - 1})
+	{
+		GXTest::GenerateTevInputTextures(frame, textures[0], textures[1], textures[2]);
+
+		int num_mismatches = 0;
+		for (int y = 0; y < 528; ++y)
+		{
+			for (int x = 0; x < 640; ++x)
+			{
+				GXTest::TevLaneInputs inputs = GXTest::GetTevInputTexel(frame, x, y);
+				u32 combination = inputs.a | (inputs.b << 8) | (inputs.c << 16);
+				u32 expected = (frame * TEV_INPUT_FRAME_SIZE + y * 640 + x) & 0xFFFFFF;
+				if (combination != expected ||
+				    GXTest::DecodeI8Pixel(textures[0], x, y, 640) != inputs.a ||
+				    GXTest::DecodeI8Pixel(textures[1], x, y, 640) != inputs.b ||
+				    GXTest::DecodeI8Pixel(textures[2], x, y, 640) != inputs.c)
+					++num_mismatches;
+			}
+		}
+		DO_TEST(num_mismatches == 0, "Frame %d: %d pixels have unexpected inputs", frame, num_mismatches);
+	}
+
+	static CGXFakeEfb efb;
+	static u8 copy[640*528*4];
+	static s16 results[TEV_INPUT_FRAME_SIZE];
+
+	const int frame = 5;
+	const int shift = TEVSCALE_2, bias = TevBias_SUBHALF, op = TEVOP_SUB, clamp = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int y = 0; y < 528; ++y)
+		{
+			for (int x = 0; x < 640; ++x)
+			{
+				GXTest::TevLaneInputs inputs = GXTest::GetTevInputTexel(frame, x, y);
+				int expected = GXTest::TevCombinerExpectation(inputs.a, inputs.b, inputs.c, inputs.d, shift, bias, op, clamp);
+				u32 value = TevOutputPassValue(expected, pass);
+				efb.SetPixel(x, y, (value << 24) | (value << 16) | (value << 8) | 0xFF);
+			}
+		}
+		efb.CopyTex(0, 0, 640, 528, copy);
+		GXTest::DecodeTevOutputFrame(copy, pass, results);
+	}
+
+	int num_mismatches = 0;
+	for (int y = 0; y < 528; ++y)
+	{
+		for (int x = 0; x < 640; ++x)
+		{
+			GXTest::TevLaneInputs inputs = GXTest::GetTevInputTexel(frame, x, y);
+			if (results[y * 640 + x] != GXTest::TevCombinerExpectation(inputs.a, inputs.b, inputs.c, inputs.d, shift, bias, op, clamp))
+				++num_mismatches;
+		}
+	}
+	DO_TEST(num_mismatches == 0, "%d pixels decoded incorrectly", num_mismatches);
+
+	END_TEST();
+}
+
+// Counter-based random numbers used by random sweeps
+// These must give the same values on the console and on the host.
+void CounterRandomTest()
+{
+	START_TEST();
+
+	// Known answers of Philox4x32-10, from the Random123 distribution
+	struct
+	{
+		u32 counter[4];
+		u32 key[2];
+		u32 result[4];
+	} philox_tests[] = {
+		{ { 0, 0, 0, 0 }, { 0, 0 }, { 0x6627E8D5, 0xE169C58D, 0xBC57AC4C, 0x9B00DBD8 } },
+		{ { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF }, { 0xFFFFFFFF, 0xFFFFFFFF }, { 0x408F276D, 0x41C83B0E, 0xA20BC7C6, 0x6D5451FD } },
+		{ { 0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344 }, { 0xA4093822, 0x299F31D0 }, { 0xD16CFE09, 0x94FDCCEB, 0x5001E420, 0x24126EA1 } },
+	};
+	for (const auto& test : philox_tests)
+	{
+		u32 result[4];
+		GXTest::Philox4x32(test.counter, test.key, result);
+		DO_TEST(memcmp(result, test.result, sizeof(result)) == 0, "Philox4x32(%08x, %08x) gave %08x %08x %08x %08x",
+		        test.counter[0], test.key[0], result[0], result[1], result[2], result[3]);
+	}
+
+	// Streams continue with the next counter after four values
+	const u32 expected_values[] = { 0xE3E80670, 0xE50A0EBC, 0x95F222C0, 0xB615AA27, 0xAC08141B, 0xDFC5CCBE };
+	GXTest::CounterRandom random(1, 0);
+	for (u32 i = 0; i < sizeof(expected_values) / sizeof(expected_values[0]); ++i)
+	{
+		u32 value = random.Next();
+		DO_TEST(value == expected_values[i], "Value %u of sample 0 of seed 1 is %08x", i, value);
+	}
+
+	// Ranges, including the extremes of the underlying values
+	int num_out_of_range = 0;
+	GXTest::CounterRandom random2(0xDEADBEEF, 61439);
+	for (int i = 0; i < 10000; ++i)
+	{
+		num_out_of_range += (random2.NextBelow(3) >= 3);
+		int value = random2.NextInRange(-1024, 1023);
+		num_out_of_range += (value < -1024 || value > 1023);
+	}
+	DO_TEST(num_out_of_range == 0, "%d values out of range", num_out_of_range);
+
+	// Shards cover the whole sweep without overlapping, at aligned boundaries
+	const u32 shard_counts[] = { 1, 2, 3, 7, 64 };
+	for (u32 num_shards : shard_counts)
+	{
+		const u32 num_samples = 0xF000 + 100;
+		u32 next_index = 0;
+		int num_misplaced = 0;
+		for (u32 shard = 0; shard < num_shards; ++shard)
+		{
+			GXTest::SweepShard sweep_shard = { shard, num_shards };
+			u32 first_index, count;
+			sweep_shard.GetRange(num_samples, 256, &first_index, &count);
+			num_misplaced += (first_index != next_index || (first_index % 256) != 0);
+			next_index = first_index + count;
+		}
+		DO_TEST(num_misplaced == 0 && next_index == num_samples, "%d of %u shards misplaced, covering %u samples", num_misplaced, num_shards, next_index);
+	}
+
+	GXTest::SweepShard shard;
+	DO_TEST(GXTest::ParseSweepShard("2/5", &shard) && shard.shard == 2 && shard.num_shards == 5, "Failed to parse shard 2/5");
+	DO_TEST(!GXTest::ParseSweepShard("5/5", &shard) && !GXTest::ParseSweepShard("1/0", &shard) && !GXTest::ParseSweepShard("1", &shard) && !GXTest::ParseSweepShard("1/2x", &shard),
+	        "Invalid shards accepted");
+
+	END_TEST();
+}
+
+// Samples of the random tev combiner sweep in TevCombinerTest
+void TevSweepTest()
+{
+	START_TEST();
+
+	// Samples are fully determined by seed and index, on all platforms
+	char text[512];
+	GXTest::TevSweepSample sample, other;
+	GXTest::GetTevSweepSample(1, 0, &sample);
+	GXTest::FormatTevSweepSample(sample, text, sizeof(text));
+	const char* expected_text = "lane 0: a=-518, b=115, c=436, d=0, shift=3, bias=2, op=1, clamp=1; "
+	                            "lane 1: a=863, b=527, c=-950, d=0, shift=3, bias=2, op=1, clamp=1; "
+	                            "lane 2: a=-731, b=-914, c=-517, d=0, shift=3, bias=2, op=1, clamp=1; "
+	                            "lane 3: a=334, b=319, c=683, d=0, shift=2, bias=2, op=0, clamp=1";
+	DO_TEST(strcmp(text, expected_text) == 0, "Sample 0 of seed 1 is \"%s\"", text);
+
+	GXTest::GetTevSweepSample(1, 1, &sample);
+	GXTest::Vec4<int> expected = GXTest::GetTevSweepExpectation(sample);
+	DO_TEST(expected.r == 529 && expected.g == 836 && expected.b == 540 && expected.a == 18,
+	        "Sample 1 of seed 1 expected to give (%d, %d, %d, %d)", expected.r, expected.g, expected.b, expected.a);
+
+	GXTest::GetTevSweepSample(0x12345678, 61439, &sample);
+	GXTest::GetTevSweepSample(0x12345678, 61439, &other);
+	DO_TEST(memcmp(&sample, &other, sizeof(sample)) == 0, "Regenerated sample differs");
+
+	// Value ranges and distribution
+	const int num_samples = 4096;
+	int num_out_of_range = 0;
+	int num_repeated = 0;
+	int shift_counts[4] = { 0 };
+	int bias_counts[3] = { 0 };
+	for (int i = 0; i < num_samples; ++i)
+	{
+		GXTest::GetTevSweepSample(7, i, &sample);
+		GXTest::GetTevSweepSample(8, i, &other);
+		num_repeated += (memcmp(&sample, &other, sizeof(sample)) == 0);
+		GXTest::GetTevSweepSample(7, i + 1, &other);
+		num_repeated += (memcmp(&sample, &other, sizeof(sample)) == 0);
+
+		num_out_of_range += (sample.cc.a != TEVCOLORARG_C0 || sample.cc.b != TEVCOLORARG_C1 || sample.cc.c != TEVCOLORARG_C2 || sample.cc.d != TEVCOLORARG_ZERO);
+		num_out_of_range += (sample.ac.a != TEVALPHAARG_A0 || sample.ac.b != TEVALPHAARG_A1 || sample.ac.c != TEVALPHAARG_A2 || sample.ac.d != TEVALPHAARG_ZERO);
+		num_out_of_range += (sample.cc.bias > 2 || sample.ac.bias > 2);
+		for (const auto& lane : sample.lanes)
+		{
+			num_out_of_range += (lane.a < -1024 || lane.a > 1023 || lane.b < -1024 || lane.b > 1023 || lane.c < -1024 || lane.c > 1023);
+			num_out_of_range += (lane.d != 0);
+		}
+		++shift_counts[sample.cc.shift];
+		++bias_counts[sample.cc.bias > 2 ? 0 : (u32)sample.cc.bias];
+	}
+	DO_TEST(num_out_of_range == 0, "%d values out of range", num_out_of_range);
+	DO_TEST(num_repeated == 0, "%d samples repeated across seeds or indices", num_repeated);
+	for (int i = 0; i < 4; ++i)
+		DO_TEST(shift_counts[i] > num_samples / 4 * 9 / 10 && shift_counts[i] < num_samples / 4 * 11 / 10, "Shift %d picked %d times", i, shift_counts[i]);
+	for (int i = 0; i < 3; ++i)
+		DO_TEST(bias_counts[i] > num_samples / 3 * 9 / 10 && bias_counts[i] < num_samples / 3 * 11 / 10, "Bias %d picked %d times", i, bias_counts[i]);
+
+	END_TEST();
+}
+
+void TevCombinerTest()
+{
+	START_TEST();
+
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+
+	CGX_LOAD_XF_REG(0x1009, 1); // 1 color channel
+
+	LitChannel chan;
+	chan.hex = 0;
+	chan.matsource = 1; // from vertex
+	CGX_LOAD_XF_REG(0x100e, chan.hex); // color channel 1
+	CGX_LOAD_XF_REG(0x1010, chan.hex); // alpha channel 1
+
+	auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+	CGX_LOAD_BP_REG(ac.hex);
+
+	// Test if we can reliably extract all bits of the tev combiner output...
+	// 8 bits per channel: No worries about GetTevOutput making mistakes when
+	// writing to framebuffer or when performing an EFB copy.
+	auto tevreg = CGXDefault<TevReg>(1, false); // c0
+	for (tevreg.red = -1024; tevreg.red != 1023; tevreg.red = tevreg.red+1)
+	{
+		CGX_LOAD_BP_REG(tevreg.low);
+		CGX_LOAD_BP_REG(tevreg.high);
+
+		auto genmode = CGXDefault<GenMode>();
+		genmode.numtevstages = 0; // One stage
+		CGX_LOAD_BP_REG(genmode.hex);
+
+		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+		cc.d = TEVCOLORARG_C0;
+		CGX_LOAD_BP_REG(cc.hex);
+
+		PE_CONTROL ctrl;
+		ctrl.hex = BPMEM_ZCOMPARE<<24;
+		ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+		ctrl.zformat = ZC_LINEAR;
+		ctrl.early_ztest = 0;
+		CGX_LOAD_BP_REG(ctrl.hex);
+
+		int result = GXTest::GetTevOutput(genmode, cc, ac).r;
+
+		DO_TEST(result == tevreg.red, "Got %d, expected %d", result, (s32)tevreg.red);
+	}
+
+	// Truncation of tev output by the EFB formats with fewer bits per channel,
+	// and expansion back to 8 bits by EFB copies: All 2048 tev output values
+	// are drawn to 4x4 pixel cells and checked with a single copy per format.
+	{
+		const int cells_per_row = 128;
+		const int num_cells = 2048;
+		const int width = 4 * cells_per_row, height = 4 * (num_cells / cells_per_row);
+
+		auto genmode = CGXDefault<GenMode>();
+		genmode.numtevstages = 0; // One stage
+		CGX_LOAD_BP_REG(genmode.hex);
+
+		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+		cc.d = TEVCOLORARG_C0;
+		CGX_LOAD_BP_REG(cc.hex);
+		auto ac_c0 = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+		ac_c0.d = TEVALPHAARG_A0;
+		CGX_LOAD_BP_REG(ac_c0.hex);
+
+		// Dithering would add noise to the truncated values
+		BlendMode blendmode;
+		blendmode.hex = BPMEM_BLENDMODE << 24;
+		blendmode.colorupdate = 1;
+		blendmode.alphaupdate = 1;
+		CGX_LOAD_BP_REG(blendmode.hex);
+
+		// Each channel takes a different value, so that every channel sees
+		// all values over the whole copy
+		static GXTest::Vec4<int> outputs[num_cells];
+		for (int cell = 0; cell < num_cells; ++cell)
+		{
+			outputs[cell].r = cell - 1024;
+			outputs[cell].g = ((cell + 512) & 2047) - 1024;
+			outputs[cell].b = ((cell + 1024) & 2047) - 1024;
+			outputs[cell].a = ((cell + 1536) & 2047) - 1024;
+		}
+
+		static u32 expected[num_cells];
+		static GXTest::Vec4<u8> pixels[width * height];
+		for (int pixel_format : { PIXELFMT_RGB8_Z24, PIXELFMT_RGBA6_Z24, PIXELFMT_RGB565_Z16 })
+		{
+			PE_CONTROL ctrl;
+			ctrl.hex = BPMEM_ZCOMPARE<<24;
+			ctrl.pixel_format = pixel_format;
+			ctrl.zformat = ZC_LINEAR;
+			ctrl.early_ztest = 0;
+			CGX_LOAD_BP_REG(ctrl.hex);
+
+			for (int cell = 0; cell < num_cells; ++cell)
+			{
+				tevreg = CGXDefault<TevReg>(1, false); // c0
+				tevreg.red = outputs[cell].r;
+				tevreg.alpha = outputs[cell].a;
+				tevreg.green = outputs[cell].g;
+				tevreg.blue = outputs[cell].b;
+				CGX_LOAD_BP_REG(tevreg.low);
+				CGX_LOAD_BP_REG(tevreg.high);
+
+				CGX_SetViewport(4.0f * (cell % cells_per_row), 4.0f * (cell / cells_per_row), 4.0f, 4.0f, 0.0f, 1.0f);
+				GXTest::Quad().AtDepth(1.0).ColorRGBA(255,255,255,255).Draw();
+			}
+			GXTest::CopyToTestBuffer(0, 0, width - 1, height - 1);
+			GXTest::EfbColorExpectationBatch(pixel_format, outputs, num_cells, expected);
+			CGX_WaitForGpuToFinish();
+			GXTest::DecodeRGBA8Image(GXTest::GetTestBuffer(), width, height, pixels);
+
+			int num_mismatches = 0;
+			int first_mismatch = -1;
+			u32 first_result = 0;
+			for (int cell = 0; cell < num_cells; ++cell)
+			{
+				const GXTest::Vec4<u8>& pixel = pixels[(4 * (cell / cells_per_row) + 2) * width + 4 * (cell % cells_per_row) + 2];
+				u32 result = (pixel.r << 24) | (pixel.g << 16) | (pixel.b << 8) | pixel.a;
+				if (result != expected[cell] && first_mismatch < 0)
+				{
+					first_mismatch = cell;
+					first_result = result;
+				}
+				num_mismatches += (result != expected[cell]);
+			}
+			DO_TEST(num_mismatches == 0, "Pixel format %d: %d mismatching values, first one is %d (expected %08x, got %08x)", pixel_format,
+			        num_mismatches, first_mismatch - 1024, expected[first_mismatch < 0 ? 0 : first_mismatch], first_result);
+		}
+
+		// Restore the state set up by GX_Init
+		blendmode.dither = 1;
+		blendmode.srcfactor = GX_BL_SRCALPHA;
+		blendmode.dstfactor = GX_BL_INVSRCALPHA;
+		CGX_LOAD_BP_REG(blendmode.hex);
+		CGX_SetViewport(0.0f, 0.0f, 640.0f, 528.0f, 0.0f, 1.0f);
+
+		CGX_LOAD_BP_REG(ac.hex);
+	}
+
+	// Now: Randomized testing of tev combiners.
+	// Test vectors are read back in batches to save GPU round trips. Each
+	// test vector evaluates four independent sets of inputs, one per channel.
+	// Batches are double-buffered: While the results of one batch are being
+	// verified, the GPU already processes the next one.
+	// Test vectors are samples of a sweep (see tev_sweep.h), whose outcomes are
+	// sent as a bitmap. The receiver regenerates the failing ones. The sweep
+	// may be split across several consoles, each running one shard of it.
+	const int batch_size = 256;
+	const int num_buffers = 2;
+	const u32 num_samples = 0x000F000;
+	u32 first_index, num_shard_samples;
+	sweep_shard.GetRange(num_samples, batch_size, &first_index, &num_shard_samples);
+	static GXTest::TevBatchConfig configs[num_buffers][batch_size];
+	static GXTest::TevSweepSample samples[num_buffers][batch_size];
+	static GXTest::Vec4<int> results[batch_size];
+	static u8 failed_samples[num_samples / 8];
+	memset(failed_samples, 0, sizeof(failed_samples));
+	u32 num_failed_samples = 0;
+	u32 num_verified_samples = 0;
+	GXTest::GpuFences fences;
+	GXTest::ReadbackRing ring(fences, num_buffers, GXTest::GetTevBatchBufferSize(batch_size));
+	auto verify_oldest_batch = [&]()
+	{
+		int first_sample;
+		GXTest::DecodeTevBatch(ring.WaitForOldest(&first_sample), batch_size, results);
+		ring.ReleaseOldest();
+
+		const int slot = (first_sample / batch_size) % num_buffers;
+		for (int j = 0; j < batch_size; ++j)
+		{
+			GXTest::Vec4<int> expected = GXTest::GetTevSweepExpectation(samples[slot][j]);
+			if (results[j].r != expected.r || results[j].g != expected.g || results[j].b != expected.b || results[j].a != expected.a)
+			{
+				GXTest::SetSweepSampleFailed(failed_samples, first_sample + j);
+				++num_failed_samples;
+			}
+		}
+		num_verified_samples += batch_size;
+	};
+	for (u32 i = 0; i < num_shard_samples; i += batch_size)
+	{
+		if ((i & 0xFF00) == i)
+			network_progress(i, num_shard_samples);
+
+		if (ring.IsFull())
+			verify_oldest_batch();
+
+		const int slot = (i / batch_size) % num_buffers;
+
+		auto genmode = CGXDefault<GenMode>();
+		genmode.numtevstages = 0; // One stage
+
+		PE_CONTROL ctrl;
+		ctrl.hex = BPMEM_ZCOMPARE<<24;
+		ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+		ctrl.zformat = ZC_LINEAR;
+		ctrl.early_ztest = 0;
+		CGX_LOAD_BP_REG(ctrl.hex);
+
+		for (int j = 0; j < batch_size; ++j)
+		{
+			GXTest::TevSweepSample& sample = samples[slot][j];
+			GXTest::GetTevSweepSample(sweep_seed, first_index + i + j, &sample);
+			configs[slot][j].cc = sample.cc;
+			configs[slot][j].ac = sample.ac;
+			GXTest::PackTevLanes(sample.lanes, configs[slot][j].regs);
+		}
+
+		GXTest::SubmitTevOutputBatch(genmode, configs[slot], batch_size, ring.GetSubmitBuffer());
+		ring.Submit(i);
+
+		WPAD_ScanPads();
+
+		if (WPAD_ButtonsDown(0) & WPAD_BUTTON_HOME)
+			break;
+	}
+	while (!ring.IsEmpty())
+		verify_oldest_batch();
+
+	// Bits are relative to the first sample of the shard
+	network_sweep_results(TEV_SWEEP_NAME, sweep_seed, first_index, num_verified_samples, failed_samples);
+	DO_TEST(num_failed_samples == 0, "%u of %u random tev combiner samples failed (sweep seed %u, first sample %u)", num_failed_samples, num_verified_samples, sweep_seed, first_index);
+
+	// Exhaustive testing of all (lower 8 bits of) inputs, using per-pixel
+	// inputs from textures. Each tev mode gets to check a different frame.
+	static s16 frame_results[TEV_INPUT_FRAME_SIZE];
+	static s16 frame_expected[TEV_INPUT_FRAME_SIZE];
+	static u8 frame_inputs[3][TEV_INPUT_FRAME_SIZE];
+	static s16 frame_inputs_d[TEV_INPUT_FRAME_SIZE];
+	for (int mode = 0; mode < 4 * 3 * 2 * 2; ++mode)
+	{
+		auto genmode = CGXDefault<GenMode>();
+
+		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(TEV_INPUT_STAGE);
+		cc.a = TEVCOLORARG_C0;
+		cc.b = TEVCOLORARG_C1;
+		cc.c = TEVCOLORARG_C2;
+		cc.d = TEVCOLORARG_ZERO;
+		cc.shift = mode % 4;
+		cc.bias = (mode / 4) % 3;
+		cc.op = (mode / 12) % 2;
+		cc.clamp = mode / 24;
+		auto stage_ac = CGXDefault<TevStageCombiner::AlphaCombiner>(TEV_INPUT_STAGE);
+
+		int frame = mode % TEV_INPUT_FRAME_COUNT;
+		network_progress(mode, 4 * 3 * 2 * 2);
+		GXTest::GetTevOutputFrame(genmode, cc, stage_ac, frame, frame_results);
+
+		for (int i = 0; i < TEV_INPUT_FRAME_SIZE; ++i)
+		{
+			GXTest::TevLaneInputs in = GXTest::GetTevInputTexel(frame, i % 640, i / 640);
+			frame_inputs[0][i] = in.a;
+			frame_inputs[1][i] = in.b;
+			frame_inputs[2][i] = in.c;
+			frame_inputs_d[i] = in.d;
+		}
+		GXTest::TevCombinerMode batch_mode = { (int)cc.shift, (int)cc.bias, (int)cc.op, (int)cc.clamp };
+		GXTest::EvaluateTevCombinerBatch(frame_inputs[0], frame_inputs[1], frame_inputs[2], frame_inputs_d, TEV_INPUT_FRAME_SIZE, batch_mode, frame_expected);
+
+		// A single subtest per mode, so that systematic errors don't flood
+		// the results with one failure per pixel
+		int num_mismatches = 0;
+		int first_mismatch = -1;
+		for (int index = 0; index < TEV_INPUT_FRAME_SIZE; ++index)
+		{
+			if (frame_results[index] != frame_expected[index] && first_mismatch < 0)
+				first_mismatch = index;
+			num_mismatches += (frame_results[index] != frame_expected[index]);
+		}
+		int index = (first_mismatch < 0) ? 0 : first_mismatch;
+		DO_TEST(num_mismatches == 0, "shift=%d, bias=%d, op=%d, clamp=%d: %d mismatching pixels, first one at (%d, %d) on a=%d, b=%d, c=%d, d=%d: expected %d, got %d",
+		        (u32)cc.shift, (u32)cc.bias, (u32)cc.op, (u32)cc.clamp, num_mismatches, index % 640, index / 640, frame_inputs[0][index], frame_inputs[1][index],
+		        frame_inputs[2][index], frame_inputs_d[index], frame_expected[index], frame_results[index]);
+
+		WPAD_ScanPads();
+
+		if (WPAD_ButtonsDown(0) & WPAD_BUTTON_HOME)
+			break;
+	}
+
+	// Testing compare mode: (a.r > b.r) ? c.a : 0
+	// One of the following will be the case for the alpha combiner:
+	// (1) a.r will be assigned the value of c2.r (color combiner setting)
+	// (2) a.r will be assigned the value of c0.r (alpha combiner setting)
+	// If (1) is the case, the first run of this test will return black and
+	// the second one will return red. If (2) is the case, the test will
+	// always return black.
+	// Indeed, this test shows that the alpha combiner reads the a and b
+	// inputs from the color combiner setting, i.e. scenario (1) is
+	// accurate to hardware behavior.
+	for (int i = 0; i < 2; ++i)
+	{
+		auto genmode = CGXDefault<GenMode>();
+		genmode.numtevstages = 0; // One stage
+		CGX_LOAD_BP_REG(genmode.hex);
+
+		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+		cc.a = TEVCOLORARG_C2;
+		cc.b = TEVCOLORARG_C1;
+		CGX_LOAD_BP_REG(cc.hex);
+
+		auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+		ac.bias = TevBias_COMPARE;
+		ac.a = TEVALPHAARG_A0; // different from color combiner
+		ac.b = TEVALPHAARG_A1; // same as color combiner
+		ac.c = TEVALPHAARG_A2;
+		CGX_LOAD_BP_REG(ac.hex);
+
+		PE_CONTROL ctrl;
+		ctrl.hex = BPMEM_ZCOMPARE<<24;
+		ctrl.pixel_format = PIXELFMT_RGBA6_Z24;
+		ctrl.zformat = ZC_LINEAR;
+		ctrl.early_ztest = 0;
+		CGX_LOAD_BP_REG(ctrl.hex);
+
+		tevreg = CGXDefault<TevReg>(1, false); // c0
+		tevreg.red = 127; // 127 is always NOT less than 127.
+		CGX_LOAD_BP_REG(tevreg.low);
+		CGX_LOAD_BP_REG(tevreg.high);
+
+		tevreg = CGXDefault<TevReg>(2, false); // c1
+		tevreg.red = 127;
+		CGX_LOAD_BP_REG(tevreg.low);
+		CGX_LOAD_BP_REG(tevreg.high);
+
+		tevreg = CGXDefault<TevReg>(3, false); // c2
+		tevreg.red = 127+i; // 127+i is less than 127 iff i>0.
+		tevreg.alpha = 255;
+		CGX_LOAD_BP_REG(tevreg.low);
+		CGX_LOAD_BP_REG(tevreg.high);
+
+		int result = GXTest::GetTevOutput(genmode, cc, ac).a;
+		int expected = (i == 1) ? 255 : 0;
+		DO_TEST(result == expected, "Mismatch on run %d: expected %d, got %d", i, expected, result);
+	}
+
+	END_TEST();
+}
+
+// Randomized testing of all compare modes of both combiners against the
+// reference model, read back in batches. Since compare modes mix channels,
+// each test vector evaluates a single set of register values.
+void TevCompareTest()
+{
+	START_TEST();
+
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+
+	PE_CONTROL ctrl;
+	ctrl.hex = BPMEM_ZCOMPARE<<24;
+	ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+	ctrl.zformat = ZC_LINEAR;
+	ctrl.early_ztest = 0;
+	CGX_LOAD_BP_REG(ctrl.hex);
+
+	auto genmode = CGXDefault<GenMode>();
+	genmode.numtevstages = 0; // One stage
+
+	const int batch_size = 256;
+	const int num_batches = 64;
+	const int num_buffers = 2;
+	static GXTest::TevBatchConfig configs[num_buffers][batch_size];
+	static GXTest::Vec4<int> regs[num_buffers][batch_size][4];
+	static GXTest::Vec4<int> results[batch_size];
+	GXTest::GpuFences fences;
+	GXTest::ReadbackRing ring(fences, num_buffers, GXTest::GetTevBatchBufferSize(batch_size));
+	auto verify_oldest_batch = [&]()
+	{
+		int slot;
+		GXTest::DecodeTevBatch(ring.WaitForOldest(&slot), batch_size, results);
+		ring.ReleaseOldest();
+
+		for (int j = 0; j < batch_size; ++j)
+		{
+			const GXTest::TevBatchConfig& config = configs[slot][j];
+			GXTest::TevStageInputs inputs = GXTest::GetTevStageInputs(regs[slot][j], config.cc, config.ac);
+			GXTest::Vec4<int> expected = GXTest::TevStageExpectation(inputs, config.cc, config.ac);
+			const GXTest::Vec4<int>& result = results[j];
+			DO_TEST(result.r == expected.r && result.g == expected.g && result.b == expected.b,
+			        "Color compare mode %d (a=%d, b=%d, clamp=%d): expected (%d, %d, %d), got (%d, %d, %d)",
+			        GXTest::GetTevCompareMode(config.cc.shift, config.cc.op), (u32)config.cc.a, (u32)config.cc.b, (u32)config.cc.clamp,
+			        expected.r, expected.g, expected.b, result.r, result.g, result.b);
+			DO_TEST(result.a == expected.a, "Alpha compare mode %d (a=%d, b=%d, clamp=%d): expected %d, got %d",
+			        GXTest::GetTevCompareMode(config.ac.shift, config.ac.op), (u32)config.ac.a, (u32)config.ac.b, (u32)config.ac.clamp,
+			        expected.a, result.a);
+		}
+	};
+
+	// Random value of a register channel. Upper bits are random as well,
+	// since compare mode only looks at the lower 8 bits.
+	auto random_value = []() { return -1024 + (rand() % 2048); };
+
+	for (int batch = 0; batch < num_batches; ++batch)
+	{
+		if (ring.IsFull())
+			verify_oldest_batch();
+
+		const int slot = batch % num_buffers;
+		for (int j = 0; j < batch_size; ++j)
+		{
+			// Cycle through all combinations of color and alpha compare modes
+			int index = batch * batch_size + j;
+			int color_mode = index % 8;
+			int alpha_mode = (index / 8) % 8;
+
+			// a and b are selected independently for both combiners,
+			// so that the alpha combiner may compare different registers
+			auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+			cc.a = TEVCOLORARG_C0 + 2 * (rand() % 3);
+			cc.b = TEVCOLORARG_C0 + 2 * (rand() % 3);
+			cc.c = TEVCOLORARG_C2;
+			cc.d = TEVCOLORARG_ZERO;
+			cc.bias = TevBias_COMPARE;
+			cc.shift = color_mode >> 1;
+			cc.op = color_mode & 1;
+			cc.clamp = rand() % 2;
+			configs[slot][j].cc = cc;
+
+			auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+			ac.a = TEVALPHAARG_A0 + (rand() % 3);
+			ac.b = TEVALPHAARG_A0 + (rand() % 3);
+			ac.c = TEVALPHAARG_A2;
+			ac.d = TEVALPHAARG_ZERO;
+			ac.bias = TevBias_COMPARE;
+			ac.shift = alpha_mode >> 1;
+			ac.op = alpha_mode & 1;
+			ac.clamp = rand() % 2;
+			configs[slot][j].ac = ac;
+
+			// Make channels of c0 and c1 equal in their lower 8 bits quite
+			// often, so that both GT and EQ get to pass and fail.
+			GXTest::Vec4<int>* vec_regs = regs[slot][j];
+			vec_regs[0] = MakeVec4(0, 0, 0, 0);
+			for (int reg = 1; reg < 4; ++reg)
+				vec_regs[reg] = MakeVec4(random_value(), random_value(), random_value(), random_value());
+			int* c0[4] = { &vec_regs[1].r, &vec_regs[1].g, &vec_regs[1].b, &vec_regs[1].a };
+			int* c1[4] = { &vec_regs[2].r, &vec_regs[2].g, &vec_regs[2].b, &vec_regs[2].a };
+			for (int channel = 0; channel < 4; ++channel)
+				if (rand() % 2)
+					*c1[channel] = ((*c0[channel] & 255) | (random_value() & ~255));
+
+			TevReg* tevregs = configs[slot][j].regs;
+			for (int reg = 0; reg < 4; ++reg)
+			{
+				tevregs[reg] = CGXDefault<TevReg>(reg, false);
+				tevregs[reg].red = vec_regs[reg].r;
+				tevregs[reg].green = vec_regs[reg].g;
+				tevregs[reg].blue = vec_regs[reg].b;
+				tevregs[reg].alpha = vec_regs[reg].a;
+			}
+		}
+
+		GXTest::SubmitTevOutputBatch(genmode, configs[slot], batch_size, ring.GetSubmitBuffer());
+		ring.Submit(slot);
+
+		WPAD_ScanPads();
+
+		if (WPAD_ButtonsDown(0) & WPAD_BUTTON_HOME)
+			break;
+	}
+	while (!ring.IsEmpty())
+		verify_oldest_batch();
+
+	END_TEST();
+}
+
+void ClipTest()
+{
+	START_TEST();
+
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+
+	CGX_LOAD_XF_REG(0x1009, 1); // 1 color channel
+
+	LitChannel chan;
+	chan.hex = 0;
+	chan.matsource = 1; // from vertex
+	CGX_LOAD_XF_REG(0x100e, chan.hex); // color channel 1
+	CGX_LOAD_XF_REG(0x1010, chan.hex); // alpha channel 1
+
+	CGX_LOAD_BP_REG(CGXDefault<TevStageCombiner::AlphaCombiner>(0).hex);
+
+	auto genmode = CGXDefault<GenMode>();
+	genmode.numtevstages = 0; // One stage
+	CGX_LOAD_BP_REG(genmode.hex);
+
+	PE_CONTROL ctrl;
+	ctrl.hex = BPMEM_ZCOMPARE<<24;
+	ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+	ctrl.zformat = ZC_LINEAR;
+	ctrl.early_ztest = 0;
+	CGX_LOAD_BP_REG(ctrl.hex);
+
+	// The setup of each step is always the same, so record it to a display list once
+	const u32 setup_list_capacity = 2048;
+	void* setup_list = memalign(32, setup_list_capacity);
+	CGX_BeginDisplayList(setup_list, setup_list_capacity);
+	{
+		auto zmode = CGXDefault<ZMode>();
+		CGX_LOAD_BP_REG(zmode.hex);
+
+		// First off, clear previous screen contents
+		CGX_SetViewport(0.0f, 0.0f, 201.0f, 50.0f, 0.0f, 1.0f); // stuff which really should not be filled
+		auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+		cc.d = TEVCOLORARG_RASC;
+		CGX_LOAD_BP_REG(cc.hex);
+		GXTest::Quad().ColorRGBA(0,0,0,0xff).Draw();
+
+		CGX_SetViewport(75.0f, 0.0f, 100.0f, 50.0f, 0.0f, 1.0f); // guardband
+		cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+		cc.d = TEVCOLORARG_RASC;
+		CGX_LOAD_BP_REG(cc.hex);
+		GXTest::Quad().ColorRGBA(0,0x7f,0,0xff).Draw();
+
+		CGX_SetViewport(100.0f, 0.0f, 50.0f, 50.0f, 0.0f, 1.0f); // viewport
+		cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+		cc.d = TEVCOLORARG_RASC;
+		CGX_LOAD_BP_REG(cc.hex);
+		GXTest::Quad().ColorRGBA(0,0xff,0,0xff).Draw();
+
+		// Now, enable testing viewport and draw the (red) testing quad
+		CGX_SetViewport(100.0f, 0.0f, 50.0f, 50.0f, 0.0f, 1.0f);
+
+		cc.d = TEVCOLORARG_C0;
+		CGX_LOAD_BP_REG(cc.hex);
+
+		auto tevreg = CGXDefault<TevReg>(1, false); // c0
+		tevreg.red = 0xff;
+		CGX_LOAD_BP_REG(tevreg.low);
+		CGX_LOAD_BP_REG(tevreg.high);
+
+		CGX_LOAD_XF_REG(0x1005, 0); // 0 = enable clipping, 1 = disable clipping
+	}
+	u32 setup_list_size = CGX_EndDisplayList();
+	DO_TEST(setup_list_size != 0, "Display list exceeds %d bytes", setup_list_capacity);
+
+	GXTest::GpuBoundingBox bbox;
+	GXTest::CoverageProbe probe(bbox);
+
+	for (int step = 0; step < 13; ++step)
+	{
+		CGX_CallDisplayList(setup_list, setup_list_size);
+
+		bool expect_quad_to_be_drawn = true;
+		int test_x = 125, test_y = 25; // Somewhere within the viewport
 		GXTest::Quad test_quad;
 		test_quad.ColorRGBA(0xff,0xff,0xff,0xff);
 
-		switch (step)
+		switch (step)
+		{
+		// Rendering outside the viewport when scissor rect is bigger than viewport
+		// TODO: What about partially covered primitives?
+
+		case 0: // all vertices within viewport
+			// Nothing to do
+			break;
+
+
+		case 1: // two vertices outside viewport, but within guardband
+			test_quad.VertexTopLeft(-1.8f, 1.0f, 1.0f).VertexBottomLeft(-1.8f, -1.0f, 1.0f);
+			test_x = 75; // TODO: Move closer to actual viewport, but debug readback issues first
+			break;
+
+		case 2: // two vertices outside viewport and guardband
+			test_quad.VertexTopLeft(-2.5f, 1.0f, 1.0f).VertexBottomLeft(-2.5f, -1.0f, 1.0f);
+			test_x = 51; // TODO: This is actually outside the guardband
+			// TODO: Check x=50, should be green
+			break;
+
+		case 3: // all vertices outside viewport, but within guardband and NOT on the same side of the viewport
+			test_quad.VertexTopLeft(-1.5f, 1.0f, 1.0f).VertexBottomLeft(-1.5f, -1.0f, 1.0f);
+			test_quad.VertexTopRight(1.5f, 1.0f, 1.0f).VertexBottomRight(1.5f, 1.0f, 1.0f);
+			test_x = 80; // TODO: Move closer to actual viewport
+			break;
+
+		case 4: // all vertices outside viewport and guardband, but NOT on the same side of the viewport
+			test_quad.VertexTopLeft(-2.5f, 1.0f, 1.0f).VertexBottomLeft(-2.5f, -1.0f, 1.0f);
+			test_quad.VertexTopRight(2.5f, 1.0f, 1.0f).VertexBottomRight(2.5f, 1.0f, 1.0f);
+			test_x = 51; // TODO: This is actually outside the guardband
+			// TODO: Check x=50,x=200?,x=201?, 50 and 201 should be green, 200 should be red
+			break;
+
+		case 5: // all vertices outside viewport, but within guardband and on the same side of the viewport
+			test_quad.VertexTopLeft(-1.8f, 1.0f, 1.0f).VertexBottomLeft(-1.8f, -1.0f, 1.0f);
+			test_quad.VertexTopRight(-1.2f, 1.0f, 1.0f).VertexBottomRight(-1.2f, 1.0f, 1.0f);
+			test_quad.VertexTopRight(1.5f, 1.0f, 1.0f);
+			expect_quad_to_be_drawn = false;
+			break;
+
+		case 6: // guardband-clipping test
+			// TODO: Currently broken
+			// Exceeds the guard-band clipping plane by the viewport width,
+			// so the primitive will get clipped such that one edge touches
+			// the clipping plane.exactly at the vertical viewport center.
+			// ASCII picture of clipped primitive (within guard-band region):
+			// |-----  pixel row  0
+			// |       pixel row  1
+			// |       pixel row  2
+			// |       pixel row  3
+			// |       pixel row  4
+			// \       pixel row  5 <-- vertical viewport center
+			//  \      pixel row  6
+			//   \     pixel row  7
+			//    \    pixel row  8
+			//     \   pixel row  9
+			//      \  pixel row 10
+			test_quad.VertexTopLeft(-4.0f, 1.0f, 1.0f);
+			test_x = 51; // TODO: This is actually outside the guardband
+			test_y = 1;
+			// TODO: Test y roughly equals 60 (there's no good way to test this without relying on pixel-perfect clipping), here should NOT be a quad!
+			break;
+
+		// Depth clipping tests
+		case 7:  // Everything behind z=w plane, depth clipping enabled
+		case 8:  // Everything behind z=w plane, depth clipping disabled
+			CGX_LOAD_XF_REG(0x1005, step - 7); // 0 = enable clipping, 1 = disable clipping
+
+			test_quad.AtDepth(1.1);
+			expect_quad_to_be_drawn = false;
+			break;
+
+		case 9:  // Everything in front of z=0 plane, depth clipping enabled
+		case 10:  // Everything in front of z=0 plane, depth clipping disabled
+			CGX_LOAD_XF_REG(0x1005, step - 9); // 0 = enable clipping, 1 = disable clipping
+
+			test_quad.AtDepth(-0.00001);
+			expect_quad_to_be_drawn = false;
+			break;
+
+		case 11: // Very slightly behind z=w plane, depth clipping enabled
+		case 12: // Very slightly behind z=w plane, depth clipping disabled
+			// TODO: For whatever reason, this doesn't actually work, yet
+			// The GC/Wii GPU doesn't implement IEEE floats strictly, hence
+			// the sum of the projected position's z and w is a very small
+			// number, which by IEEE would be non-zero but which in fact is
+			// treated as zero.
+			// In particular, the value by IEEE is -0.00000011920928955078125.
+			CGX_LOAD_XF_REG(0x1005, step - 11); // 0 = enable clipping, 1 = disable clipping
+
+			test_quad.AtDepth(1.0000001);
+			break;
+
+		case 13:  // One vertex behind z=w plane, depth clipping enabled
+		case 14:  // One vertex behind z=w plane, depth clipping disabled
+			CGX_LOAD_XF_REG(0x1005, step - 13); // 0 = enable clipping, 1 = disable clipping
+
+			test_quad.VertexTopLeft(-1.0f, 1.0f, 1.5f);
+
+			// whole primitive gets clipped away
+			expect_quad_to_be_drawn = false;
+			break;
+
+		case 15:  // Three vertices with a very large value for z, depth clipping disabled
+			CGX_LOAD_XF_REG(0x1005, 1); // 0 = enable clipping, 1 = disable clipping
+
+			test_quad.VertexTopLeft(-1.0f, 1.0f, 65537.f);
+			test_quad.VertexTopRight(1.0f, 1.0f, 65537.f);
+			test_quad.VertexBottomLeft(-1.0f, -1.0f, 65537.f);
+			break;
+
+		// TODO: One vertex with z < 0, depth clipping enabled, primitive gets properly (!) clipped
+		// TODO: One vertex with z < 0, depth clipping disabled, whole primitive gets drawn
+
+		}
+
+		// The bounding box contains every pixel of the test quad, but it's
+		// rounded to 2x2 quads and clipped primitives don't fill it. Hence
+		// it only proves that the test pixel wasn't drawn, otherwise the
+		// pixel gets read back.
+		probe.Begin();
+		test_quad.Draw();
+		GXTest::BoundingBox drawn = probe.End();
+
+		int red = 0x00; // everything but the test quad is black or green
+		if (drawn.Contains(test_x, test_y))
+		{
+			GXTest::CopyTileToTestBuffer(test_x, test_y);
+			CGX_WaitForGpuToFinish();
+			red = GXTest::ReadTestBufferTile(test_x, test_y).r;
+		}
+
+		if (expect_quad_to_be_drawn)
+			DO_TEST(red == 0xff, "Clipping test failed at step %d (expected quad to be shown at pixel (%d, %d), but it was not)", step, test_x, test_y);
+		else
+			DO_TEST(red == 0x00, "Clipping test failed at step %d (expected quad to be hidden at pixel (%d, %d), but it was not)", step, test_x, test_y);
+
+		GXTest::DebugDisplayEfbContents();
+	}
+
+	free(setup_list);
+
+	END_TEST();
+}
+
+void CoordinatePrecisionTest()
+{
+	START_TEST();
+
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+
+	CGX_LOAD_XF_REG(0x1009, 1); // 1 color channel
+
+	LitChannel chan;
+	chan.hex = 0;
+	chan.matsource = 1; // from vertex
+	CGX_LOAD_XF_REG(0x100e, chan.hex); // color channel 1
+	CGX_LOAD_XF_REG(0x1010, chan.hex); // alpha channel 1
+
+	auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
+	ac.d = TEVALPHAARG_RASA;
+	CGX_LOAD_BP_REG(ac.hex);
+
+	auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+	cc.d = TEVCOLORARG_RASC;
+	CGX_LOAD_BP_REG(cc.hex);
+
+	// Test at which coordinates a pixel is considered to be within a primitive.
+	// TODO: Not sure how to interpret the results, yet.
+	for (float xpos = 0.583328247070f; xpos <= 0.583328306675f; xpos = nextafterf(xpos,+1.0f))
+	{
+		CGX_SetViewport(xpos, 0.0f, 100.0f, 100.0f, 0.0f, 1.0f);
+
+		// first off, clear the full area.
+		GXTest::Quad().VertexTopLeft(-2.0, 2.0, 1.0).VertexBottomLeft(-2.0, -2.0, 1.0).VertexTopRight(2.0, 2.0, 1.0).VertexBottomRight(2.0, -2.0, 1.0).ColorRGBA(0,0,0,255).Draw();
+		GXTest::Quad().ColorRGBA(0,255,0,255).Draw();
+
+		// now, draw the actual testing quad.
+		GXTest::Quad().VertexTopLeft(0, 1.0, 1.0).VertexBottomLeft(0, -1.0, 1.0).ColorRGBA(255,0,255,255).Draw();
+		GXTest::CopyTileToTestBuffer(50, 0);
+		CGX_WaitForGpuToFinish();
+		GXTest::DebugDisplayEfbContents();
+
+		GXTest::Vec4<u8> result = GXTest::ReadTestBufferTile(50, 0);
+		u8 expectation = (xpos <= 0.583328247070f) ? 255 : 0;
+		int subsample_index = (int)(xpos * 12.0f) % 12;
+		DO_TEST(result.r == expectation, "Incorrect rasterization (result=%d,expected=%d,screencoord=%.6f,subsample_index=%d)", result.r, expectation, xpos, subsample_index);
+	}
+
+	// Test for the default pixel subsample location by creating tiny viewports (smaller than the pixel width)
+	// By drawing a quad over the whole viewport, we can check if the current viewport spans the subsample location.
+	// The results seem to indicate that the default subsample is located close to (but somewhat off) screen position 7/12.
+	// I (neobrain) am not sure if the sample indeed is not at that location or if it's just due to floating point rounding errors.
+	for (float xpos = 0.583297669888f; xpos <= 0.583328306675; xpos = nextafterf(xpos,+1.0f))
+	{
+		CGX_SetViewport(0.0, 0.0f, 100.0f, 100.0f, 0.0f, 1.0f);
+
+		// first off, clear the full area.
+		GXTest::Quad().VertexTopLeft(-2.0, 2.0, 1.0).VertexBottomLeft(-2.0, -2.0, 1.0).VertexTopRight(2.0, 2.0, 1.0).VertexBottomRight(2.0, -2.0, 1.0).ColorRGBA(0,0,0,255).Draw();
+		GXTest::Quad().ColorRGBA(0,255,0,255).Draw();
+
+		// manual viewport setting to make sure we aren't limited (too much) by floating point precision
+		// 2.0e-5 seems to be the smallest possible viewport width which behaves sane.
+		// For this size, values of xpos from 0.583297729492 to 0.583328247070 will yield a covered pixel
+		float vp_width = 2.0e-5f;
+		CGX_BEGIN_LOAD_XF_REGS(0x101a,6);
+		wgPipe->F32 = vp_width;
+		wgPipe->F32 = -50.0f;
+		wgPipe->F32 = 16777215.0f;
+		wgPipe->F32 = 342.0f+xpos+vp_width;
+		wgPipe->F32 = 392.0f;
+		wgPipe->F32 = 16777215.0f;
+
+		// now, draw the actual testing quad.
+		GXTest::Quad().ColorRGBA(255,0,255,255).Draw();
+		GXTest::CopyTileToTestBuffer(0, 0);
+		CGX_WaitForGpuToFinish();
+		GXTest::DebugDisplayEfbContents();
+
+		GXTest::Vec4<u8> result = GXTest::ReadTestBufferTile(0, 0);
+		u8 expectation = (xpos == 0.583297669888f || xpos == 0.583328306675f) ? 0 : 255;
+		int subsample_index = (int)(xpos * 12.0f) % 12;
+		DO_TEST(result.r == expectation, "Incorrect rasterization (result=%d,expected=%d,screencoord=%.12f,subsample_index=%d)", result.r, expectation, xpos, subsample_index);
+	}
+
+	// Guardband clipping indeed uses floating point math!
+	// Hence, the smallest floating point value smaller than -2.0 will yield a clipped primitive.
+	CGX_SetViewport(100.0f, 100.0f, 100.0f, 100.0f, 0.0f, 1.0f);
+	for (float xpos : {-2.0000000f, nextafterf(-2.0f, -1.0f)})
+	{
+		// first off, clear the full area, including the guardband
+		GXTest::Quad().VertexTopLeft(-2.0, 2.0, 1.0).VertexBottomLeft(-2.0, -2.0, 1.0).VertexTopRight(2.0, 2.0, 1.0).VertexBottomRight(2.0, -2.0, 1.0).ColorRGBA(0,0,0,255).Draw();
+
+		// now, draw the actual testing quad such that all vertices are outside the viewport (and on the same side of the viewport)
+		// The two left vertices are at the border of the guardband; if they are outside the guardband, the primitive gets clipped away.
+		GXTest::Quad().VertexTopLeft(xpos, 1.0, 1.0).VertexBottomLeft(xpos, -1.0, 1.0).VertexTopRight(xpos+1.0, 1.0, 1.0).VertexBottomRight(xpos+1.0, -1.0, 1.0).ColorRGBA(255,0,255,255).Draw();
+		GXTest::CopyTileToTestBuffer(60, 110);
+		CGX_WaitForGpuToFinish();
+		GXTest::DebugDisplayEfbContents();
+
+		GXTest::Vec4<u8> result = GXTest::ReadTestBufferTile(60, 110);
+
+		int expectation = (xpos >= -2.0) ? 255 : 0;
+		DO_TEST(result.r == expectation, "Incorrect guardband clipping (result=%d,expected=%d,xpos=%.10f)", result.r, expectation, xpos);
+	};
+
+	END_TEST();
+}
+
+// Checks that the compile-time lighting tables match the functions they're generated from
+void LightingTablesTest()
+{
+	START_TEST();
+
+	int num_mismatches = 0;
+	for (int i = 0; i < LIGHTING_TABLE_SIZE; ++i)
+		num_mismatches += (GXTest::LookupLightingMaterial(i >> 8, i & 255) != GXTest::LightingMaterialExpectation(i >> 8, i & 255));
+	DO_TEST(num_mismatches == 0, "%d mismatches in the material table", num_mismatches);
+
+	for (int func : { LIGHTDIF_NONE, LIGHTDIF_SIGN, LIGHTDIF_CLAMP })
+	{
+		num_mismatches = 0;
+		for (int i = 0; i < LIGHTING_TABLE_SIZE; ++i)
+			num_mismatches += (GXTest::LookupLightingDiffuse(func, i >> 8, i & 255) != GXTest::LightingDiffuseExpectation(func, i >> 8, i & 255));
+		DO_TEST(num_mismatches == 0, "%d mismatches in the table of diffuse function %d", num_mismatches, func);
+	}
+
+	// LIGHTDIF_NONE ignores the light direction
+	DO_TEST(GXTest::LookupLightingDiffuse(LIGHTDIF_NONE, 0, 128) == 128, "Expected 128, got %d", GXTest::LookupLightingDiffuse(LIGHTDIF_NONE, 0, 128));
+	DO_TEST(GXTest::LookupLightingDiffuse(LIGHTDIF_SIGN, 255, 128) == 127, "Expected 127, got %d", GXTest::LookupLightingDiffuse(LIGHTDIF_SIGN, 255, 128));
+	DO_TEST(GXTest::LookupLightingDiffuse(LIGHTDIF_CLAMP, 64, 128) == 0, "Expected 0, got %d", GXTest::LookupLightingDiffuse(LIGHTDIF_CLAMP, 64, 128));
+
+	END_TEST();
+}
+
+static void RandomUnitVector(float v[3])
+{
+	float length;
+	do
+	{
+		for (int i = 0; i < 3; ++i)
+			v[i] = (rand() % 2001 - 1000) / 1000.0f;
+		length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	} while (length < 0.1f || length > 1.0f);
+
+	for (int i = 0; i < 3; ++i)
+		v[i] /= length;
+}
+
+// Random light for the given attenuation function. Lights are placed far
+// away, so that the light direction is (almost) the same for all vertices of
+// a small quad. Specular lights are set up like GX_InitSpecularDir does,
+// with the half-angle vector between the light and the viewer (looking down
+// -z) as their direction.
+static Light RandomLight(int attnfunc)
+{
+	Light light;
+	memset(&light, 0, sizeof(light));
+	light.color = ((u32)rand() << 16) ^ (u32)rand();
+
+	float dir[3];
+	RandomUnitVector(dir);
+	for (int i = 0; i < 3; ++i)
+		light.dpos[i] = dir[i] * 10000.0f;
+	if (attnfunc == LIGHTATTN_SPEC)
+	{
+		float half[3] = { dir[0], dir[1], dir[2] + 1.0f };
+		float length = sqrtf(half[0] * half[0] + half[1] * half[1] + half[2] * half[2]);
+		for (int i = 0; i < 3; ++i)
+			light.ddir[i] = (length > 0.0f) ? half[i] / length : 0.0f;
+	}
+	else
+	{
+		RandomUnitVector(light.ddir);
+	}
+
+	for (int i = 0; i < 3; ++i)
+		light.cosatt[i] = (rand() % 1001) / 1000.0f;
+	light.distatt[0] = 0.5f + (rand() % 1501) / 1000.0f;
+	if (attnfunc == LIGHTATTN_SPEC)
+	{
+		light.distatt[1] = (rand() % 1001) / 1000.0f;
+		light.distatt[2] = (rand() % 1001) / 1000.0f;
+	}
+	return light;
+}
+
+static LitChannel RandomLitChannel()
+{
+	LitChannel chan;
+	chan.hex = 0;
+	chan.enablelighting = 1;
+	chan.lightMask0_3 = rand() % 16;
+	chan.lightMask4_7 = rand() % 16;
+	chan.diffusefunc = rand() % 3;
+	chan.attnfunc = rand() % 4;
+	return chan;
+}
+
+// Checks the lighting model against hand-computed cases
+void LightingModelTest()
+{
+	START_TEST();
+
+	// A single white light straight above an upwards facing vertex
+	Light light;
+	memset(&light, 0, sizeof(light));
+	light.color = 0x806040FF;
+	light.dpos[1] = 100.0f;
+	light.cosatt[0] = 1.0f;
+	light.distatt[0] = 2.0f;
+	Light lights[8] = { light, light, light, light, light, light, light, light };
+
+	const float vertex_pos[3] = { 0.0f, 0.0f, 0.0f };
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+	const float down[3] = { 0.0f, -1.0f, 0.0f };
+	LitChannel chan;
+	chan.hex = 0;
+	chan.enablelighting = 1;
+	chan.lightMask0_3 = 1;
+	const struct
+	{
+		u32 diffusefunc;
+		u32 attnfunc;
+		const float* normal;
+		int expected;
+	} cases[] = {
+		{ LIGHTDIF_NONE, LIGHTATTN_NONE, down, 0x80 },
+		{ LIGHTDIF_SIGN, LIGHTATTN_NONE, up, 0x80 },
+		{ LIGHTDIF_SIGN, LIGHTATTN_DIR, down, -0x80 },
+		{ LIGHTDIF_CLAMP, LIGHTATTN_NONE, down, 0 },
+		{ LIGHTDIF_NONE, LIGHTATTN_SPOT, up, 0x40 }, // divided by K0
+	};
+	for (const auto& test : cases)
+	{
+		chan.diffusefunc = test.diffusefunc;
+		chan.attnfunc = test.attnfunc;
+		int result = GXTest::LightContribution(chan, light, 0, vertex_pos, test.normal);
+		DO_TEST(result == test.expected, "Diffuse function %d, attenuation function %d: expected %d, got %d", test.diffusefunc, test.attnfunc, test.expected, result);
+	}
+
+	// Specular and spot attenuation, for a red component of 128 and the
+	// light at (0, 100, 0). Specular lights use the half-angle vector as
+	// direction and normalize the distance coefficients unless the diffuse
+	// function is disabled. Spot lights point towards their direction.
+	const float tilted[3] = { 0.6f, 0.8f, 0.0f };
+	const float above_light[3] = { 0.0f, 200.0f, 0.0f };
+	const struct
+	{
+		u32 diffusefunc;
+		u32 attnfunc;
+		float ddir[3];
+		float cosatt[3];
+		float distatt[3];
+		const float* pos;
+		const float* normal;
+		int expected;
+	} attn_cases[] = {
+		// attn = n.h = 0.6, 0.6^2 / 1 * 128 = 46.08
+		{ LIGHTDIF_NONE, LIGHTATTN_SPEC, { 0.0f, 0.6f, 0.8f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, vertex_pos, up, 46 },
+		// 0.36 / (3 + 4 * 0.36) * 128 = 10.38
+		{ LIGHTDIF_NONE, LIGHTATTN_SPEC, { 0.0f, 0.6f, 0.8f }, { 0.0f, 0.0f, 1.0f }, { 3.0f, 0.0f, 4.0f }, vertex_pos, up, 10 },
+		// Normalized coefficients: 0.36 / (0.6 + 0.8 * 0.36) * 128 = 51.89
+		{ LIGHTDIF_CLAMP, LIGHTATTN_SPEC, { 0.0f, 0.6f, 0.8f }, { 0.0f, 0.0f, 1.0f }, { 3.0f, 0.0f, 4.0f }, vertex_pos, up, 52 },
+		// The light is below the vertex, i.e. behind the surface
+		{ LIGHTDIF_NONE, LIGHTATTN_SPEC, { 0.0f, 0.6f, 0.8f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, above_light, up, 0 },
+		// cos = 0.8, distance 100: 0.8 / (0.01 * 100) * 128 = 102.4
+		{ LIGHTDIF_CLAMP, LIGHTATTN_SPOT, { 0.0f, 0.8f, 0.6f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.01f, 0.0f }, vertex_pos, up, 102 },
+		// 0.8^2 / (0.0001 * 100^2) * (n.l = 0.8) * 128 = 65.54
+		{ LIGHTDIF_SIGN, LIGHTATTN_SPOT, { 0.0f, 0.8f, 0.6f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0001f }, vertex_pos, tilted, 66 },
+		// Pointing away from the vertex
+		{ LIGHTDIF_NONE, LIGHTATTN_SPOT, { 0.0f, 0.8f, 0.6f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, above_light, up, 0 },
+	};
+	for (const auto& test : attn_cases)
+	{
+		Light attn_light = light;
+		for (int i = 0; i < 3; ++i)
+		{
+			attn_light.ddir[i] = test.ddir[i];
+			attn_light.cosatt[i] = test.cosatt[i];
+			attn_light.distatt[i] = test.distatt[i];
+		}
+		chan.diffusefunc = test.diffusefunc;
+		chan.attnfunc = test.attnfunc;
+		int result = GXTest::LightContribution(chan, attn_light, 0, test.pos, test.normal);
+		DO_TEST(result == test.expected, "Diffuse function %d, attenuation function %d at y=%.0f: expected %d, got %d",
+		        test.diffusefunc, test.attnfunc, test.pos[1], test.expected, result);
+	}
+
+	// Ambient plus one light, times the material color
+	GXTest::LightingChannel lit_chan;
+	lit_chan.color = chan;
+	lit_chan.color.diffusefunc = LIGHTDIF_CLAMP;
+	lit_chan.color.attnfunc = LIGHTATTN_NONE;
+	lit_chan.alpha.hex = 0; // lighting disabled, passes material alpha through
+	lit_chan.matcolor = 0xFF80FF7F;
+	lit_chan.ambcolor = 0x10101010;
+	float px = 0.0f, py = 0.0f, pz = 0.0f, nx = 0.0f, ny = 1.0f, nz = 0.0f;
+	GXTest::LightingVertices vertex = { { &px, &py, &pz }, { &nx, &ny, &nz }, 1 };
+	u32 color;
+	GXTest::ComputeLitColors(lit_chan, lights, vertex, &color);
+	DO_TEST(color == 0x90384F7F, "Expected 0x90384F7F, got 0x%08x", color);
+
+	// Same for several chunks of vertices
+	const int num_vertices = 150;
+	static float pos[3][num_vertices], normal[3][num_vertices];
+	static u32 colors[num_vertices];
+	for (int v = 0; v < num_vertices; ++v)
+	{
+		pos[0][v] = pos[1][v] = pos[2][v] = 0.0f;
+		normal[0][v] = normal[2][v] = 0.0f;
+		normal[1][v] = 1.0f;
+	}
+	GXTest::LightingVertices vertices = { { pos[0], pos[1], pos[2] }, { normal[0], normal[1], normal[2] }, num_vertices };
+	GXTest::ComputeLitColors(lit_chan, lights, vertices, colors);
+	int num_mismatches = 0;
+	for (int v = 0; v < num_vertices; ++v)
+		num_mismatches += (colors[v] != 0x90384F7F);
+	DO_TEST(num_mismatches == 0, "%d of %d vertices lit incorrectly", num_mismatches, num_vertices);
+
+	END_TEST();
+}
+
+// Draws batches of small quads with random normals under random light setups
+// and compares the lit colors to the lighting model
+void LightingSweepTest()
+{
+	START_TEST();
+
+	// Cells of 4x4 pixels, each quad covers one cell
+	const int cells_per_row = 160;
+	const int num_rows = 8;
+	const int batch_size = cells_per_row * num_rows;
+	const int num_batches = 64;
+
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
+	CGX_LOAD_XF_REG(XFMEM_SETNUMCHAN, 1);
+
+	auto genmode = CGXDefault<GenMode>();
+	genmode.numtevstages = 0; // One stage
+	CGX_LOAD_BP_REG(genmode.hex);
+
+	auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+	cc.d = TEVCOLORARG_RASC;
+	CGX_LOAD_BP_REG(cc.hex);
+	CGX_LOAD_BP_REG(CGXDefault<TevStageCombiner::AlphaCombiner>(0).hex);
+
+	PE_CONTROL ctrl;
+	ctrl.hex = BPMEM_ZCOMPARE << 24;
+	ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+	ctrl.zformat = ZC_LINEAR;
+	ctrl.early_ztest = 0;
+	CGX_LOAD_BP_REG(ctrl.hex);
+	CGX_LOAD_BP_REG(CGXDefault<ZMode>().hex);
+	CGX_LOAD_XF_REG(XFMEM_CLIPDISABLE, 0);
+
+	// Normals are passed through unchanged, positions already are by Init()
+	float normal_matrix[3][3];
+	memset(normal_matrix, 0, sizeof(normal_matrix));
+	for (int i = 0; i < 3; ++i)
+		normal_matrix[i][i] = 1.0f;
+	CGX_LoadNormalMatrixDirect(normal_matrix, 0);
+
+	// The four corners of each quad, as vertices for the lighting model
+	static float pos[3][4 * batch_size], normal[3][4 * batch_size];
+	static u32 colors[4 * batch_size];
+	const float corners[4][2] = { { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, -1.0f }, { -1.0f, -1.0f } };
+	GXTest::LightingVertices vertices = { { pos[0], pos[1], pos[2] }, { normal[0], normal[1], normal[2] }, 4 * batch_size };
+
+	for (int batch = 0; batch < num_batches; ++batch)
+	{
+		GXTest::LightingChannel chan;
+		chan.color = RandomLitChannel();
+		chan.alpha.hex = 0; // alpha is not stored in RGB8
+		chan.matcolor = ((u32)rand() << 16) ^ (u32)rand();
+		chan.ambcolor = ((u32)rand() << 16) ^ (u32)rand();
+		CGX_LOAD_XF_REG(XFMEM_SETCHAN0_COLOR, chan.color.hex);
+		CGX_LOAD_XF_REG(XFMEM_SETCHAN0_ALPHA, chan.alpha.hex);
+		CGX_LOAD_XF_REG(XFMEM_SETCHAN0_AMBCOLOR, chan.ambcolor);
+		CGX_LOAD_XF_REG(XFMEM_SETCHAN0_MATCOLOR, chan.matcolor);
+
+		Light lights[8];
+		for (int i = 0; i < 8; ++i)
+		{
+			lights[i] = RandomLight(chan.color.attnfunc);
+			CGX_LoadLight(i, lights[i]);
+		}
+
+		for (int cell = 0; cell < batch_size; ++cell)
+		{
+			float n[3];
+			RandomUnitVector(n);
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				int v = 4 * cell + corner;
+				pos[0][v] = corners[corner][0];
+				pos[1][v] = corners[corner][1];
+				pos[2][v] = 1.0f;
+				for (int i = 0; i < 3; ++i)
+					normal[i][v] = n[i];
+			}
+
+			CGX_SetViewport(4.0f * (cell % cells_per_row), 4.0f * (cell / cells_per_row), 4.0f, 4.0f, 0.0f, 1.0f);
+			GXTest::Quad().Normal(n[0], n[1], n[2]).Draw();
+		}
+
+		GXTest::CopyToTestBuffer(0, 0, 4 * cells_per_row - 1, 4 * num_rows - 1);
+		GXTest::ComputeLitColors(chan, lights, vertices, colors);
+		CGX_WaitForGpuToFinish();
+
+		// Colors are interpolated across the quad, so the cell center must
+		// lie within the range spanned by the corners. Usually, all corners
+		// are lit equally.
+		static GXTest::Vec4<u8> pixels[16 * batch_size];
+		GXTest::DecodeRGBA8Image(GXTest::GetTestBuffer(), 4 * cells_per_row, 4 * num_rows, pixels);
+
+		int num_mismatches = 0;
+		int first_mismatch = -1;
+		for (int cell = 0; cell < batch_size; ++cell)
+		{
+			const GXTest::Vec4<u8>& result = pixels[(4 * (cell / cells_per_row) + 2) * 4 * cells_per_row + 4 * (cell % cells_per_row) + 2];
+			const int actual[3] = { result.r, result.g, result.b };
+			bool match = true;
+			for (int component = 0; component < 3; ++component)
+			{
+				int min = 255, max = 0;
+				for (int corner = 0; corner < 4; ++corner)
+				{
+					int value = (colors[4 * cell + corner] >> (24 - 8 * component)) & 0xFF;
+					min = (value < min) ? value : min;
+					max = (value > max) ? value : max;
+				}
+				match = match && actual[component] >= min && actual[component] <= max;
+			}
+			if (!match && first_mismatch < 0)
+				first_mismatch = cell;
+			num_mismatches += !match;
+		}
+		DO_TEST(num_mismatches == 0, "Batch %d (chan 0x%08x): %d mismatching cells, first one at %d", batch, chan.color.hex, num_mismatches, first_mismatch);
+
+		GXTest::DebugDisplayEfbContents();
+		WPAD_ScanPads();
+		if (WPAD_ButtonsDown(0) & WPAD_BUTTON_HOME) break;
+	}
+
+	END_TEST();
+}
+
+// Hand-checked cases of the EFB color quantization model
+void EfbFormatModelTest()
+{
+	START_TEST();
+
+	auto make_output = [](int r, int g, int b, int a)
+	{
+		GXTest::Vec4<int> ret;
+		ret.r = r;
+		ret.g = g;
+		ret.b = b;
+		ret.a = a;
+		return ret;
+	};
+	const struct
+	{
+		int pixel_format;
+		GXTest::Vec4<int> tev_output;
+		u32 expected;
+	} cases[] = {
+		{ PIXELFMT_RGB8_Z24, make_output(-1, 256, 5, 7), 0xFF0005FF },
+		{ PIXELFMT_RGBA6_Z24, make_output(0xFF, 0x80, 0x41, 0x3), 0xFF824100 },
+		{ PIXELFMT_RGBA6_Z24, make_output(-1024, 1023, -4, 0x7F), 0x00FFFF7D },
+		{ PIXELFMT_RGB565_Z16, make_output(0x84, 0x84, 0x07, 0), 0x848600FF },
+	};
+	for (const auto& test : cases)
+	{
+		u32 color = GXTest::EfbColorExpectation(test.pixel_format, test.tev_output);
+		DO_TEST(color == test.expected, "Pixel format %d, tev output (%d, %d, %d, %d): Expected %08x, got %08x", test.pixel_format,
+		        test.tev_output.r, test.tev_output.g, test.tev_output.b, test.tev_output.a, test.expected, color);
+	}
+
+	// All tev output values of all channels against per-channel bit replication
+	static GXTest::Vec4<int> outputs[2048];
+	static u32 colors[2048];
+	for (int i = 0; i < 2048; ++i)
+		outputs[i] = make_output(i - 1024, 1023 - i, ((i + 1024) & 2047) - 1024, ((i * 7) & 2047) - 1024);
+	for (int pixel_format : { PIXELFMT_RGB8_Z24, PIXELFMT_RGBA6_Z24, PIXELFMT_RGB565_Z16 })
+	{
+		GXTest::EfbColorExpectationBatch(pixel_format, outputs, 2048, colors);
+
+		int num_mismatches = 0;
+		for (int i = 0; i < 2048; ++i)
 		{
-		// Rendering outside the viewport when scissor rect is bigger than viewport
-		// TODO: What about partially covered primitives?
+			const int values[4] = { outputs[i].r, outputs[i].g, outputs[i].b, outputs[i].a };
+			for (int channel = 0; channel < 4; ++channel)
+			{
+				int bits = GXTest::GetEfbChannelBits(pixel_format, channel);
+				int stored = (values[channel] & 0xFF) >> (8 - bits);
+				int expected = bits ? ((stored << (8 - bits)) | (stored >> (2 * bits - 8))) : 255;
+				num_mismatches += ((int)((colors[i] >> (24 - 8 * channel)) & 0xFF) != expected);
+			}
+		}
+		DO_TEST(num_mismatches == 0, "Pixel format %d: %d mismatching channels", pixel_format, num_mismatches);
+	}
 
-		case 0: // all vertices within viewport
-			// Nothing to do
-			break;
+	const int expected_bits[3][4] = { { 8, 8, 8, 0 }, { 6, 6, 6, 6 }, { 5, 6, 5, 0 } };
+	for (int pixel_format = PIXELFMT_RGB8_Z24; pixel_format <= PIXELFMT_RGB565_Z16; ++pixel_format)
+		for (int channel = 0; channel < 4; ++channel)
+			DO_TEST(GXTest::GetEfbChannelBits(pixel_format, channel) == expected_bits[pixel_format][channel], "Pixel format %d, channel %d: Expected %d bits, got %d",
+			        pixel_format, channel, expected_bits[pixel_format][channel], GXTest::GetEfbChannelBits(pixel_format, channel));
 
+	END_TEST();
+}
 
-		case 1: // two vertices outside viewport, but within guardband
-			test_quad.VertexTopLeft(-1.8f, 1.0f, 1.0f).VertexBottomLeft(-1.8f, -1.0f, 1.0f);
-			test_x = 75; // TODO: Move closer to actual viewport, but debug readback issues first
-			break;
+// Hand-checked cases of the depth buffer model: encodings and compare functions
+void DepthModelTest()
+{
+	START_TEST();
 
-		case 2: // two vertices outside viewport and guardband
-			test_quad.VertexTopLeft(-2.5f, 1.0f, 1.0f).VertexBottomLeft(-2.5f, -1.0f, 1.0f);
-			test_x = 51; // TODO: This is actually outside the guardband
-			// TODO: Check x=50, should be green
-			break;
+	const struct
+	{
+		int zformat;
+		u32 depth;
+		u16 compressed;
+		u32 decompressed;
+	} cases[] = {
+		{ ZC_LINEAR, 0xABCDEF, 0xABCD, 0xABCD00 },
+		{ ZC_NEAR, 0x000000, 0x0000, 0x000000 },
+		{ ZC_NEAR, 0x7FFFFF, 0x3FFF, 0x7FFE00 },
+		{ ZC_NEAR, 0xC00000, 0x8000, 0xC00000 },
+		{ ZC_NEAR, 0xFFFFFF, 0xFFFF, 0xFFFF80 },
+		{ ZC_MID, 0xF00001, 0x8000, 0xF00000 },
+		{ ZC_MID, 0xFFFFFF, 0xFFFF, 0xFFFFF0 },
+		{ ZC_FAR, 0xFFF000, 0xC000, 0xFFF000 },
+		{ ZC_FAR, 0xFFFFFF, 0xFFF8, 0xFFFFFF },
+	};
+	for (const auto& test : cases)
+	{
+		u16 compressed = GXTest::CompressDepth(test.zformat, test.depth);
+		u32 decompressed = GXTest::DecompressDepth(test.zformat, compressed);
+		DO_TEST(compressed == test.compressed && decompressed == test.decompressed, "zformat %d, depth %06x: Expected %04x (%06x), got %04x (%06x)",
+		        test.zformat, test.depth, test.compressed, test.decompressed, compressed, decompressed);
+	}
 
-		case 3: // all vertices outside viewport, but within guardband and NOT on the same side of the viewport
-			test_quad.VertexTopLeft(-1.5f, 1.0f, 1.0f).VertexBottomLeft(-1.5f, -1.0f, 1.0f);
-			test_quad.VertexTopRight(1.5f, 1.0f, 1.0f).VertexBottomRight(1.5f, 1.0f, 1.0f);
-			test_x = 80; // TODO: Move closer to actual viewport
-			break;
+	// The encodings are monotonic and round trip, for all depth values
+	for (int zformat = ZC_LINEAR; zformat <= ZC_FAR; ++zformat)
+	{
+		int num_failures = 0;
+		u32 first_failure = 0;
+		u16 previous = 0;
+		for (u32 depth = 0; depth <= 0xFFFFFF; ++depth)
+		{
+			u16 compressed = GXTest::CompressDepth(zformat, depth);
+			u32 decompressed = GXTest::DecompressDepth(zformat, compressed);
+			bool valid = compressed >= previous && decompressed <= depth && GXTest::CompressDepth(zformat, decompressed) == compressed;
+			if (!valid && num_failures++ == 0)
+				first_failure = depth;
+			previous = compressed;
+		}
+		DO_TEST(num_failures == 0, "zformat %d: %d depth values violate the encoding, first one is %06x", zformat, num_failures, first_failure);
+	}
 
-		case 4: // all vertices outside viewport and guardband, but NOT on the same side of the viewport
-			test_quad.VertexTopLeft(-2.5f, 1.0f, 1.0f).VertexBottomLeft(-2.5f, -1.0f, 1.0f);
-			test_quad.VertexTopRight(2.5f, 1.0f, 1.0f).VertexBottomRight(2.5f, 1.0f, 1.0f);
-			test_x = 51; // TODO: This is actually outside the guardband
-			// TODO: Check x=50,x=200?,x=201?, 50 and 201 should be green, 200 should be red
-			break;
+	// Truth table of the compare functions, for depth less than, equal to and greater than the stored value
+	static const char* compare_results[8] = { "000", "100", "010", "110", "001", "101", "011", "111" };
+	for (int func = COMPARE_NEVER; func <= COMPARE_ALWAYS; ++func)
+	{
+		char result[4] = { 0 };
+		for (int i = 0; i < 3; ++i)
+			result[i] = GXTest::DepthCompareExpectation(func, 0x800000 + i - 1, 0x800000) ? '1' : '0';
+		DO_TEST(strcmp(result, compare_results[func]) == 0, "Compare function %d: Expected %s, got %s", func, compare_results[func], result);
+	}
 
-		case 5: // all vertices outside viewport, but within guardband and on the same side of the viewport
-			test_quad.VertexTopLeft(-1.8f, 1.0f, 1.0f).VertexBottomLeft(-1.8f, -1.0f, 1.0f);
-			test_quad.VertexTopRight(-1.2f, 1.0f, 1.0f).VertexBottomRight(-1.2f, 1.0f, 1.0f);
-			test_quad.VertexTopRight(1.5f, 1.0f, 1.0f);
-			expect_quad_to_be_drawn = false;
-			break;
+	// 16 bit depth compares the compressed values, which may be equal for
+	// different depths. The depth buffer is only updated with testing enabled.
+	auto zmode = CGXDefault<ZMode>();
+	zmode.testenable = 1;
+	zmode.updateenable = 1;
+	zmode.func = COMPARE_EQUAL;
+	u32 updated = GXTest::DepthTestExpectation(zmode, PIXELFMT_RGB565_Z16, ZC_LINEAR, 0x123456, 0x123400);
+	DO_TEST(updated == 0x123400, "Expected Z16 depth 123400 to equal 123456, got %06x", updated);
+	updated = GXTest::DepthTestExpectation(zmode, PIXELFMT_RGB8_Z24, ZC_LINEAR, 0x123456, 0x123400);
+	DO_TEST(updated == 0x123400, "Expected Z24 depth 123456 to fail the test, got %06x", updated);
+	zmode.func = COMPARE_ALWAYS;
+	zmode.testenable = 0;
+	updated = GXTest::DepthTestExpectation(zmode, PIXELFMT_RGB8_Z24, ZC_LINEAR, 0x123456, 0x123400);
+	DO_TEST(updated == 0x123400, "Expected no update with testing disabled, got %06x", updated);
+
+	// The batch version agrees with the single fragment one
+	const int count = 1024;
+	static u32 depth[count], stored[count], expected[count];
+	int num_mismatches = 0;
+	for (int i = 0; i < 64; ++i)
+	{
+		zmode.hex = rand() & 0x1F;
+		int pixel_format = (i & 1) ? PIXELFMT_RGB565_Z16 : PIXELFMT_RGB8_Z24;
+		int zformat = rand() & 3;
+		for (int j = 0; j < count; ++j)
+		{
+			depth[j] = rand() & 0xFFFFFF;
+			stored[j] = GXTest::DepthBufferExpectation(pixel_format, zformat, (j & 3) ? rand() & 0xFFFFFF : depth[j]);
+			expected[j] = GXTest::DepthTestExpectation(zmode, pixel_format, zformat, depth[j], stored[j]);
+		}
+		GXTest::DepthTestBatch(zmode, pixel_format, zformat, depth, stored, count);
+		num_mismatches += (memcmp(stored, expected, sizeof(stored)) != 0);
+	}
+	DO_TEST(num_mismatches == 0, "%d mismatching batches", num_mismatches);
 
-		case 6: // guardband-clipping test
-			// TODO: Currently broken
-			// Exceeds the guard-band clipping plane by the viewport width,
-			// so the primitive will get clipped such that one edge touches
-			// the clipping plane.exactly at the vertical viewport center.
-			// ASCII picture of clipped primitive (within guard-band region):
-			// |-----  pixel row  0
-			// |       pixel row  1
-			// |       pixel row  2
-			// |       pixel row  3
-			// |       pixel row  4
-			// \       pixel row  5 <-- vertical viewport center
-			//  \      pixel row  6
-			//   \     pixel row  7
-			//    \    pixel row  8
-			//     \   pixel row  9
-			//      \  pixel row 10
-			test_quad.VertexTopLeft(-4.0f, 1.0f, 1.0f);
-			test_x = 51; // TODO: This is actually outside the guardband
-			test_y = 1;
-			// TODO: Test y roughly equals 60 (there's no good way to test this without relying on pixel-perfect clipping), here should NOT be a quad!
-			break;
+	END_TEST();
+}
 
-		// Depth clipping tests
-		case 7:  // Everything behind z=w plane, depth clipping enabled
-		case 8:  // Everything behind z=w plane, depth clipping disabled
-			CGX_BEGIN_LOAD_XF_REGS(0x1005, 1);
-			wgPipe->U32 = step - 7; // 0 = enable clipping, 1 = disable clipping
+// Depth values written by the rasterizer as read back via depth copies, for
+// all 16 bit depth encodings and compare functions
+void DepthPrecisionTest()
+{
+	START_TEST();
 
-			test_quad.AtDepth(1.1);
-			expect_quad_to_be_drawn = false;
-			break;
+	// Cells of 4x4 pixels, each quad covers one cell
+	const int cells_per_row = 160;
+	const int num_rows = 16;
+	const int num_cells = cells_per_row * num_rows;
+	const int width = 4 * cells_per_row, height = 4 * num_rows;
 
-		case 9:  // Everything in front of z=0 plane, depth clipping enabled
-		case 10:  // Everything in front of z=0 plane, depth clipping disabled
-			CGX_BEGIN_LOAD_XF_REGS(0x1005, 1);
-			wgPipe->U32 = step - 9; // 0 = enable clipping, 1 = disable clipping
+	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
 
-			test_quad.AtDepth(-0.00001);
-			expect_quad_to_be_drawn = false;
-			break;
+	auto genmode = CGXDefault<GenMode>();
+	genmode.numtevstages = 0; // One stage
+	CGX_LOAD_BP_REG(genmode.hex);
 
-		case 11: // Very slightly behind z=w plane, depth clipping enabled
-		case 12: // Very slightly behind z=w plane, depth clipping disabled
-			// TODO: For whatever reason, this doesn't actually work, yet
-			// The GC/Wii GPU doesn't implement IEEE floats strictly, hence
-			// the sum of the projected position's z and w is a very small
-			// number, which by IEEE would be non-zero but which in fact is
-			// treated as zero.
-			// In particular, the value by IEEE is -0.00000011920928955078125.
-			CGX_BEGIN_LOAD_XF_REGS(0x1005, 1);
-			wgPipe->U32 = step - 11; // 0 = enable clipping, 1 = disable clipping
+	auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
+	cc.d = TEVCOLORARG_RASC;
+	CGX_LOAD_BP_REG(cc.hex);
+	CGX_LOAD_BP_REG(CGXDefault<TevStageCombiner::AlphaCombiner>(0).hex);
+	CGX_LOAD_XF_REG(XFMEM_CLIPDISABLE, 0);
 
-			test_quad.AtDepth(1.0000001);
-			break;
+	PE_CONTROL ctrl;
+	ctrl.hex = BPMEM_ZCOMPARE << 24;
+	ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+	ctrl.zformat = ZC_LINEAR;
+	ctrl.early_ztest = 0;
+	CGX_LOAD_BP_REG(ctrl.hex);
 
-		case 13:  // One vertex behind z=w plane, depth clipping enabled
-		case 14:  // One vertex behind z=w plane, depth clipping disabled
-			CGX_BEGIN_LOAD_XF_REGS(0x1005, 1);
-			wgPipe->U32 = step - 13; // 0 = enable clipping, 1 = disable clipping
+	auto zmode_always = CGXDefault<ZMode>();
+	zmode_always.testenable = 1;
+	zmode_always.updateenable = 1;
 
-			test_quad.VertexTopLeft(-1.0f, 1.0f, 1.5f);
+	// Every fourth cell is drawn at the same depth twice, for testing equality
+	static float depths_a[num_cells], depths_b[num_cells];
+	for (int cell = 0; cell < num_cells; ++cell)
+	{
+		depths_a[cell] = (float)(rand() & 0xFFFFFF) / 16777215.0f;
+		depths_b[cell] = (cell & 3) ? (float)(rand() & 0xFFFFFF) / 16777215.0f : depths_a[cell];
+	}
 
-			// whole primitive gets clipped away
-			expect_quad_to_be_drawn = false;
-			break;
+	// Draws the cells and reads back their depth values
+	static u32 depth[width * height];
+	auto draw_cells = [&](const float* depths, const ZMode& zmode)
+	{
+		CGX_LOAD_BP_REG(zmode.hex);
+		for (int cell = 0; cell < num_cells; ++cell)
+		{
+			// With near == far, all vertices end up at exactly that depth
+			CGX_SetViewport(4.0f * (cell % cells_per_row), 4.0f * (cell / cells_per_row), 4.0f, 4.0f, depths[cell], depths[cell]);
+			GXTest::Quad().Draw();
+		}
+	};
+	auto read_cells = [&](u8 format, u32* values)
+	{
+		GXTest::CopyDepthToTestBuffer(0, 0, width - 1, height - 1, format, ctrl);
+		CGX_WaitForGpuToFinish();
+		GXTest::DecodeDepthImage(format, GXTest::GetTestBuffer(), width, height, depth);
+		for (int cell = 0; cell < num_cells; ++cell)
+			values[cell] = depth[(4 * (cell / cells_per_row) + 2) * width + 4 * (cell % cells_per_row) + 2];
+	};
+	auto check_cells = [&](const u32* values, const u32* expected, const char* description)
+	{
+		int num_mismatches = 0;
+		int first_mismatch = -1;
+		for (int cell = 0; cell < num_cells; ++cell)
+		{
+			if (values[cell] != expected[cell] && first_mismatch < 0)
+				first_mismatch = cell;
+			num_mismatches += (values[cell] != expected[cell]);
+		}
+		DO_TEST(num_mismatches == 0, "%s: %d mismatching cells, first one at %d (expected %06x, got %06x)", description, num_mismatches,
+		        first_mismatch, expected[first_mismatch < 0 ? 0 : first_mismatch], values[first_mismatch < 0 ? 0 : first_mismatch]);
+	};
 
-		case 15:  // Three vertices with a very large value for z, depth clipping disabled
-			CGX_BEGIN_LOAD_XF_REGS(0x1005, 1);
-			wgPipe->U32 = 1; // 0 = enable clipping, 1 = disable clipping
+	// Reference values in full precision
+	static u32 reference_a[num_cells], reference_b[num_cells];
+	static u32 values[num_cells], expected[num_cells];
+	draw_cells(depths_b, zmode_always);
+	read_cells(GX_TF_Z24X8, reference_b);
+	draw_cells(depths_a, zmode_always);
+	read_cells(GX_TF_Z24X8, reference_a);
 
-			test_quad.VertexTopLeft(-1.0f, 1.0f, 65537.f);
-			test_quad.VertexTopRight(1.0f, 1.0f, 65537.f);
-			test_quad.VertexBottomLeft(-1.0f, -1.0f, 65537.f);
-			break;
+	// Lower precision copy formats keep a subset of the bits
+	const struct
+	{
+		u8 format;
+		u32 mask;
+		const char* name;
+	} copy_formats[] = {
+		{ GX_CTF_Z4, 0xF00000, "Z4" }, { GX_TF_Z8, 0xFF0000, "Z8" }, { GX_CTF_Z8M, 0x00FF00, "Z8M" }, { GX_CTF_Z8L, 0x0000FF, "Z8L" },
+		{ GX_TF_Z16, 0xFFFF00, "Z16" }, { GX_CTF_Z16L, 0x00FFFF, "Z16L" },
+	};
+	for (const auto& copy_format : copy_formats)
+	{
+		read_cells(copy_format.format, values);
+		for (int cell = 0; cell < num_cells; ++cell)
+			expected[cell] = reference_a[cell] & copy_format.mask;
+		check_cells(values, expected, copy_format.name);
+	}
 
-		// TODO: One vertex with z < 0, depth clipping enabled, primitive gets properly (!) clipped
-		// TODO: One vertex with z < 0, depth clipping disabled, whole primitive gets drawn
+	// 16 bit depth encodings
+	for (int zformat = ZC_LINEAR; zformat <= ZC_FAR; ++zformat)
+	{
+		ctrl.pixel_format = PIXELFMT_RGB565_Z16;
+		ctrl.zformat = zformat;
+		CGX_LOAD_BP_REG(ctrl.hex);
 
-		}
+		draw_cells(depths_a, zmode_always);
+		read_cells(GX_TF_Z24X8, values);
+		for (int cell = 0; cell < num_cells; ++cell)
+			expected[cell] = GXTest::DepthBufferExpectation(ctrl.pixel_format, zformat, reference_a[cell]);
 
-		test_quad.Draw();
-		GXTest::CopyToTestBuffer(0, 0, 199, 49);
-		CGX_WaitForGpuToFinish();
+		char description[32];
+		sprintf(description, "zformat %d", zformat);
+		check_cells(values, expected, description);
+	}
 
-		GXTest::Vec4<u8> result = GXTest::ReadTestBuffer(test_x, test_y, 200);
-		if (expect_quad_to_be_drawn)
-			DO_TEST(result.r == 0xff, "Clipping test failed at step %d (expected quad to be shown at pixel (%d, %d), but it was not)", step, test_x, test_y);
-		else
-			DO_TEST(result.r == 0x00, "Clipping test failed at step %d (expected quad to be hidden at pixel (%d, %d), but it was not)", step, test_x, test_y);
+	// Compare functions, drawing b on top of a
+	for (int pixel_format : { PIXELFMT_RGB8_Z24, PIXELFMT_RGB565_Z16 })
+	{
+		ctrl.pixel_format = pixel_format;
+		ctrl.zformat = ZC_MID;
+		CGX_LOAD_BP_REG(ctrl.hex);
+
+		for (int func = COMPARE_NEVER; func <= COMPARE_ALWAYS; ++func)
+		{
+			auto zmode = zmode_always;
+			zmode.func = func;
+			draw_cells(depths_a, zmode_always);
+			draw_cells(depths_b, zmode);
+			read_cells(GX_TF_Z24X8, values);
+
+			for (int cell = 0; cell < num_cells; ++cell)
+				expected[cell] = GXTest::DepthBufferExpectation(pixel_format, ctrl.zformat, reference_a[cell]);
+			GXTest::DepthTestBatch(zmode, pixel_format, ctrl.zformat, reference_b, expected, num_cells);
+
+			char description[48];
+			sprintf(description, "Pixel format %d, compare function %d", pixel_format, func);
+			check_cells(values, expected, description);
+		}
 
 		GXTest::DebugDisplayEfbContents();
 	}
 
+	ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+	ctrl.zformat = ZC_LINEAR;
+	CGX_LOAD_BP_REG(ctrl.hex);
+	CGX_LOAD_BP_REG(CGXDefault<ZMode>().hex);
+
 	END_TEST();
 }
 
-void CoordinatePrecisionTest()
+// Exact pixel and primitive counts of a single quad
+void PerfCounterTest()
 {
 	START_TEST();
 
 	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
-
-	CGX_BEGIN_LOAD_XF_REGS(0x1009, 1);
-	wgPipe->U32 = 1; // 1 color channel
+	CGX_LOAD_XF_REG(XFMEM_SETNUMCHAN, 1);
 
 	LitChannel chan;
 	chan.hex = 0;
 	chan.matsource = 1; // from vertex
-	CGX_BEGIN_LOAD_XF_REGS(0x100e, 1); // color channel 1
-	wgPipe->U32 = chan.hex;
-	CGX_BEGIN_LOAD_XF_REGS(0x1010, 1); // alpha channel 1
-	wgPipe->U32 = chan.hex;
+	CGX_LOAD_XF_REG(XFMEM_SETCHAN0_COLOR, chan.hex);
+	CGX_LOAD_XF_REG(XFMEM_SETCHAN0_ALPHA, chan.hex);
 
-	auto ac = CGXDefault<TevStageCombiner::AlphaCombiner>(0);
-	ac.d = TEVALPHAARG_RASA;
-	CGX_LOAD_BP_REG(ac.hex);
+	auto genmode = CGXDefault<GenMode>();
+	genmode.numtevstages = 0; // One stage
+	CGX_LOAD_BP_REG(genmode.hex);
 
 	auto cc = CGXDefault<TevStageCombiner::ColorCombiner>(0);
 	cc.d = TEVCOLORARG_RASC;
 	CGX_LOAD_BP_REG(cc.hex);
+	CGX_LOAD_BP_REG(CGXDefault<TevStageCombiner::AlphaCombiner>(0).hex);
+	CGX_LOAD_BP_REG(CGXDefault<ZMode>().hex);
+	CGX_LOAD_XF_REG(XFMEM_CLIPDISABLE, 0);
 
-	// Test at which coordinates a pixel is considered to be within a primitive.
-	// TODO: Not sure how to interpret the results, yet.
-	for (float xpos = 0.583328247070f; xpos <= 0.583328306675f; xpos = nextafterf(xpos,+1.0f))
-	{
-		CGX_SetViewport(xpos, 0.0f, 100.0f, 100.0f, 0.0f, 1.0f);
-
-		// first off, clear the full area.
-		GXTest::Quad().VertexTopLeft(-2.0, 2.0, 1.0).VertexBottomLeft(-2.0, -2.0, 1.0).VertexTopRight(2.0, 2.0, 1.0).VertexBottomRight(2.0, -2.0, 1.0).ColorRGBA(0,0,0,255).Draw();
-		GXTest::Quad().ColorRGBA(0,255,0,255).Draw();
-
-		// now, draw the actual testing quad.
-		GXTest::Quad().VertexTopLeft(0, 1.0, 1.0).VertexBottomLeft(0, -1.0, 1.0).ColorRGBA(255,0,255,255).Draw();
-		GXTest::CopyToTestBuffer(50, 0, 127, 127);
-		CGX_WaitForGpuToFinish();
-		GXTest::DebugDisplayEfbContents();
+	// All pixels go through the late depth test, which always passes
+	PE_CONTROL ctrl;
+	ctrl.hex = BPMEM_ZCOMPARE<<24;
+	ctrl.pixel_format = PIXELFMT_RGB8_Z24;
+	ctrl.zformat = ZC_LINEAR;
+	ctrl.early_ztest = 0;
+	CGX_LOAD_BP_REG(ctrl.hex);
 
-		GXTest::Vec4<u8> result = GXTest::ReadTestBuffer(0, 0, 128);
-		u8 expectation = (xpos <= 0.583328247070f) ? 255 : 0;
-		int subsample_index = (int)(xpos * 12.0f) % 12;
-		DO_TEST(result.r == expectation, "Incorrect rasterization (result=%d,expected=%d,screencoord=%.6f,subsample_index=%d)", result.r, expectation, xpos, subsample_index);
-	}
+	// Aligned to 2x2 pixel quads
+	const int width = 40, height = 20;
+	CGX_SetViewport(0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f);
 
-	// Test for the default pixel subsample location by creating tiny viewports (smaller than the pixel width)
-	// By drawing a quad over the whole viewport, we can check if the current viewport spans the subsample location.
-	// The results seem to indicate that the default subsample is located close to (but somewhat off) screen position 7/12.
-	// I (neobrain) am not sure if the sample indeed is not at that location or if it's just due to floating point rounding errors.
-	for (float xpos = 0.583297669888f; xpos <= 0.583328306675; xpos = nextafterf(xpos,+1.0f))
+	const struct
 	{
-		CGX_SetViewport(0.0, 0.0f, 100.0f, 100.0f, 0.0f, 1.0f);
-
-		// first off, clear the full area.
-		GXTest::Quad().VertexTopLeft(-2.0, 2.0, 1.0).VertexBottomLeft(-2.0, -2.0, 1.0).VertexTopRight(2.0, 2.0, 1.0).VertexBottomRight(2.0, -2.0, 1.0).ColorRGBA(0,0,0,255).Draw();
-		GXTest::Quad().ColorRGBA(0,255,0,255).Draw();
-
-		// manual viewport setting to make sure we aren't limited (too much) by floating point precision
-		// 2.0e-5 seems to be the smallest possible viewport width which behaves sane.
-		// For this size, values of xpos from 0.583297729492 to 0.583328247070 will yield a covered pixel
-		float vp_width = 2.0e-5f;
-		CGX_BEGIN_LOAD_XF_REGS(0x101a,6);
-		wgPipe->F32 = vp_width;
-		wgPipe->F32 = -50.0f;
-		wgPipe->F32 = 16777215.0f;
-		wgPipe->F32 = 342.0f+xpos+vp_width;
-		wgPipe->F32 = 392.0f;
-		wgPipe->F32 = 16777215.0f;
-
-		// now, draw the actual testing quad.
-		GXTest::Quad().ColorRGBA(255,0,255,255).Draw();
-		GXTest::CopyToTestBuffer(0, 0, 127, 127);
+		CGXPerf0Metric metric;
+		u32 expected;
+		const char* name;
+	} cases[] = {
+		{ CGX_PERF0_TRIANGLES, 2, "triangles in" },
+		{ CGX_PERF0_TRIANGLES_PASSED, 2, "triangles out" },
+		{ CGX_PERF0_QUAD_NON0CVG, width * height / 4, "covered quads" },
+		{ CGX_PERF0_QUAD_4CVG, width * height / 4, "fully covered quads" },
+	};
+	for (const auto& test : cases)
+	{
+		CGX_SelectPerf0Metric(test.metric);
+		CGX_ClearPerfCounters();
+		GXTest::Quad().ColorRGBA(0xff, 0xff, 0xff, 0xff).Draw();
 		CGX_WaitForGpuToFinish();
-		GXTest::DebugDisplayEfbContents();
 
-		GXTest::Vec4<u8> result = GXTest::ReadTestBuffer(0, 0, 128);
-		u8 expectation = (xpos == 0.583297669888f || xpos == 0.583328306675f) ? 0 : 255;
-		int subsample_index = (int)(xpos * 12.0f) % 12;
-		DO_TEST(result.r == expectation, "Incorrect rasterization (result=%d,expected=%d,screencoord=%.12f,subsample_index=%d)", result.r, expectation, xpos, subsample_index);
+		CGXPerfCounters counters = CGX_ReadPerfCounters();
+		DO_TEST(counters.perf0 == test.expected, "Expected %d %s, got %d", test.expected, test.name, counters.perf0);
+		DO_TEST(counters.blend_pixels_in == (u32)(width * height), "Expected %d blended pixels, got %d", width * height, counters.blend_pixels_in);
+		DO_TEST(counters.zcomp_pixels_in == (u32)(width * height) && counters.zcomp_pixels_out == (u32)(width * height),
+		        "Expected %d pixels in and out of the late depth test, got %d/%d", width * height, counters.zcomp_pixels_in, counters.zcomp_pixels_out);
+		DO_TEST(counters.zcomploc_pixels_in == 0 && counters.zcomploc_pixels_out == 0,
+		        "Expected no pixels in the early depth test, got %d/%d", counters.zcomploc_pixels_in, counters.zcomploc_pixels_out);
 	}
 
-	// Guardband clipping indeed uses floating point math!
-	// Hence, the smallest floating point value smaller than -2.0 will yield a clipped primitive.
-	CGX_SetViewport(100.0f, 100.0f, 100.0f, 100.0f, 0.0f, 1.0f);
-	for (float xpos : {-2.0000000f, nextafterf(-2.0f, -1.0f)})
-	{
-		// first off, clear the full area, including the guardband
-		GXTest::Quad().VertexTopLeft(-2.0, 2.0, 1.0).VertexBottomLeft(-2.0, -2.0, 1.0).VertexTopRight(2.0, 2.0, 1.0).VertexBottomRight(2.0, -2.0, 1.0).ColorRGBA(0,0,0,255).Draw();
-
-		// now, draw the actual testing quad such that all vertices are outside the viewport (and on the same side of the viewport)
-		// The two left vertices are at the border of the guardband; if they are outside the guardband, the primitive gets clipped away.
-		GXTest::Quad().VertexTopLeft(xpos, 1.0, 1.0).VertexBottomLeft(xpos, -1.0, 1.0).VertexTopRight(xpos+1.0, 1.0, 1.0).VertexBottomRight(xpos+1.0, -1.0, 1.0).ColorRGBA(255,0,255,255).Draw();
-		GXTest::CopyToTestBuffer(50, 100, 127, 127);
-		CGX_WaitForGpuToFinish();
-		GXTest::DebugDisplayEfbContents();
-
-		GXTest::Vec4<u8> result = GXTest::ReadTestBuffer(10, 10, 128);
+	// EFB copies only show up in the copy clock counter
+	CGX_ClearPerfCounters();
+	GXTest::CopyToTestBuffer(0, 0, width - 1, height - 1);
+	CGX_WaitForGpuToFinish();
+	CGXPerfCounters counters = CGX_ReadPerfCounters();
+	DO_TEST(counters.copy_clocks != 0 && counters.blend_pixels_in == 0, "EFB copy: %d clocks, %d blended pixels", counters.copy_clocks, counters.blend_pixels_in);
 
-		int expectation = (xpos >= -2.0) ? 255 : 0;
-		DO_TEST(result.r == expectation, "Incorrect guardband clipping (result=%d,expected=%d,xpos=%.10f)", result.r, expectation, xpos);
-	};
+	CGX_SelectPerf0Metric(CGX_PERF0_NONE);
+	CGX_SetViewport(0.0f, 0.0f, 640.0f, 528.0f, 0.0f, 1.0f);
 
 	END_TEST();
 }
@@ -583,18 +3399,15 @@ void LightingTest()
 
 	CGX_LOAD_BP_REG(CGXDefault<TwoTevStageOrders>(0).hex);
 
-	CGX_BEGIN_LOAD_XF_REGS(0x1009, 1);
-	wgPipe->U32 = 1; // 1 color channel
+	CGX_LOAD_XF_REG(0x1009, 1); // 1 color channel
 
 	LitChannel chan;
 	chan.hex = 0;
 	chan.matsource = 0; // from register
 	chan.ambsource = 0; // from register
 	chan.enablelighting = true;
-	CGX_BEGIN_LOAD_XF_REGS(0x100e, 1); // color channel 1
-	wgPipe->U32 = chan.hex;
-	CGX_BEGIN_LOAD_XF_REGS(0x1010, 1); // alpha channel 1
-	wgPipe->U32 = chan.hex;
+	CGX_LOAD_XF_REG(0x100e, chan.hex); // color channel 1
+	CGX_LOAD_XF_REG(0x1010, chan.hex); // alpha channel 1
 
 	CGX_LOAD_BP_REG(CGXDefault<TevStageCombiner::AlphaCombiner>(0).hex);
 
@@ -626,14 +3439,11 @@ void LightingTest()
 		CGX_LOAD_BP_REG(tevreg.low);
 		CGX_LOAD_BP_REG(tevreg.high);
 
-		CGX_BEGIN_LOAD_XF_REGS(0x1005, 1);
-		wgPipe->U32 = 0; // 0 = enable clipping, 1 = disable clipping
+		CGX_LOAD_XF_REG(0x1005, 0); // 0 = enable clipping, 1 = disable clipping
 
-		CGX_BEGIN_LOAD_XF_REGS(0x100a, 1);
-		wgPipe->U32 = (ambcolor << 24) | 255;
+		CGX_LOAD_XF_REG(0x100a, (ambcolor << 24) | 255);
 
-		CGX_BEGIN_LOAD_XF_REGS(0x100c, 1);
-		wgPipe->U32 = (matcolor << 24) | 255;
+		CGX_LOAD_XF_REG(0x100c, (matcolor << 24) | 255);
 
 		int test_x = 125, test_y = 25; // Somewhere within the viewport
 
@@ -643,11 +3453,11 @@ void LightingTest()
 		CGX_LOAD_BP_REG(cc.hex);
 		GXTest::Quad().ColorRGBA(0, 0, 0, 0xff).Draw();
 
-		GXTest::CopyToTestBuffer(0, 0, 199, 49);
+		GXTest::CopyTileToTestBuffer(test_x, test_y);
 		CGX_WaitForGpuToFinish();
 
-		GXTest::Vec4<u8> result = GXTest::ReadTestBuffer(test_x, test_y, 200);
-		int expected = (matcolor * (ambcolor + (ambcolor >> 7))) >> 8;
+		GXTest::Vec4<u8> result = GXTest::ReadTestBufferTile(test_x, test_y);
+		int expected = GXTest::LookupLightingMaterial(matcolor, ambcolor);
 		DO_TEST(result.r == expected, "lighting test failed at amb %d mat %d actual %d", ambcolor, matcolor, result.r);
 
 		GXTest::DebugDisplayEfbContents();
@@ -658,18 +3468,65 @@ void LightingTest()
 	END_TEST();
 }
 
-int main()
+// Arguments are passed via meta.xml on the console, e.g.
+//   <arguments><arg>shard=1/4</arg><arg>seed=2</arg></arguments>
+// to run the second quarter of each random sweep with a different seed.
+static void ParseArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strncmp(argv[i], "seed=", 5) == 0)
+			sweep_seed = strtoul(argv[i] + 5, NULL, 0);
+		else if (strncmp(argv[i], "shard=", 6) == 0)
+		{
+			if (!GXTest::ParseSweepShard(argv[i] + 6, &sweep_shard))
+				network_printf("Invalid shard %s, expected index/count\n", argv[i] + 6);
+		}
+		else
+			network_printf("Ignoring unknown argument %s\n", argv[i]);
+	}
+	if (sweep_shard.num_shards > 1)
+		network_printf("Running shard %u of %u of random sweeps\n", sweep_shard.shard, sweep_shard.num_shards);
+}
+
+int main(int argc, char** argv)
 {
 	network_init();
 	WPAD_Init();
+	ParseArguments(argc, argv);
 
 	GXTest::Init();
 
-	BitfieldTest();
-	TevCombinerTest();
-	ClipTest();
-	CoordinatePrecisionTest();
-	LightingTest();
+	// Skip redundant register writes, and report how much that saves
+	static CGXShadowState shadow_state;
+	CGX_SetShadowState(&shadow_state);
+
+	auto run_test = [](void (*test)())
+	{
+		shadow_state.ResetBytesSaved();
+		test();
+		if (shadow_state.GetBytesSaved())
+			network_printf("Skipped %d bytes of redundant register writes\n", shadow_state.GetBytesSaved());
+	};
+
+	// These don't depend on GPU output and also run in the host build
+	for (auto test : { BitfieldTest, TevOutputDecodeTest, TevLanePackTest, TevBatchDecodeTest,
+	                   TevInputFrameTest, TevCombinerBatchTest, TevCompareModelTest, TevSimulatorTest, CounterRandomTest, TevSweepTest,
+	                   LightingTablesTest, LightingModelTest, EfbCopyFootprintTest, TextureDecoderTest,
+	                   CopyFormatDecoderTest, DepthModelTest, EfbFormatModelTest, ReadbackRingTest,
+	                   ResultProtocolTest, LogRingTest, CoverageProbeTest, PerfCounterDecodeTest, ShadowStateTest, DisplayListTest })
+		run_test(test);
+
+#ifdef GXTEST_HOST
+	// The receiver only gets built for the host
+	run_test(ResultAggregatorTest);
+#endif
+
+#ifndef GXTEST_HOST
+	for (auto test : { TevCombinerTest, TevCompareTest, ClipTest, CoordinatePrecisionTest, LightingTest,
+	                   LightingSweepTest, DepthPrecisionTest, PerfCounterTest })
+		run_test(test);
+#endif
 
 	network_printf("Shutting down...\n");
 	network_shutdown();
@@ -0,0 +1,67 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+#include "readback_ring.h"
+
+namespace GXTest
+{
+
+ReadbackRing::ReadbackRing(FenceSource& fences, int num_buffers, u32 buffer_size)
+	: fences(fences), num_buffers(num_buffers), oldest(0), num_pending(0)
+{
+	assert(num_buffers > 0);
+
+	slots = new Slot[num_buffers];
+	for (int i = 0; i < num_buffers; ++i)
+	{
+		slots[i].buffer = memalign(32, buffer_size);
+		slots[i].fence = 0;
+		slots[i].tag = 0;
+	}
+}
+
+ReadbackRing::~ReadbackRing()
+{
+	for (int i = 0; i < num_buffers; ++i)
+		free(slots[i].buffer);
+	delete[] slots;
+}
+
+void* ReadbackRing::GetSubmitBuffer()
+{
+	assert(!IsFull());
+	return slots[(oldest + num_pending) % num_buffers].buffer;
+}
+
+void ReadbackRing::Submit(int tag)
+{
+	assert(!IsFull());
+	Slot& slot = slots[(oldest + num_pending) % num_buffers];
+	slot.fence = fences.InsertFence();
+	slot.tag = tag;
+	++num_pending;
+}
+
+const void* ReadbackRing::WaitForOldest(int* tag)
+{
+	assert(!IsEmpty());
+	Slot& slot = slots[oldest];
+	fences.WaitForFence(slot.fence);
+	*tag = slot.tag;
+	return slot.buffer;
+}
+
+void ReadbackRing::ReleaseOldest()
+{
+	assert(!IsEmpty());
+	assert(fences.IsFenceReached(slots[oldest].fence));
+	oldest = (oldest + 1) % num_buffers;
+	--num_pending;
+}
+
+} // namespace
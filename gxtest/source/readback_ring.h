@@ -0,0 +1,73 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Source of fences, i.e. markers in the GPU command stream which tell us
+// whether the GPU has finished processing all commands preceding them.
+// Fences are 16 bit values which wrap around, hence only a limited number
+// of them may be pending at any given time.
+class FenceSource
+{
+public:
+	virtual ~FenceSource() {}
+
+	virtual u16 InsertFence() = 0;
+	virtual bool IsFenceReached(u16 fence) = 0;
+	virtual void WaitForFence(u16 fence) = 0;
+};
+
+// Ring of readback buffers
+// Allows for submitting new GPU work before the results of previous work
+// have been verified: Each buffer gets a fence when being submitted, and
+// its contents are only handed out to the CPU once that fence was reached.
+// Buffers are retrieved in the order they were submitted in.
+class ReadbackRing
+{
+public:
+	ReadbackRing(FenceSource& fences, int num_buffers, u32 buffer_size);
+	~ReadbackRing();
+
+	int GetNumPending() const { return num_pending; }
+	bool IsEmpty() const { return num_pending == 0; }
+	bool IsFull() const { return num_pending == num_buffers; }
+
+	// Buffer to be written by the next submission (32 byte aligned).
+	// Must not be called if the ring is full.
+	void* GetSubmitBuffer();
+
+	// Hand the submit buffer over to the GPU, by inserting a fence behind
+	// all previously issued commands. The tag is an arbitrary value which
+	// is returned together with the buffer by WaitForOldest.
+	void Submit(int tag);
+
+	// Wait until the GPU is done with the oldest pending buffer and return it.
+	// The buffer may be read until it is released with ReleaseOldest.
+	const void* WaitForOldest(int* tag);
+	void ReleaseOldest();
+
+private:
+	ReadbackRing(const ReadbackRing&) = delete;
+	ReadbackRing& operator = (const ReadbackRing&) = delete;
+
+	struct Slot
+	{
+		void* buffer;
+		u16 fence;
+		int tag;
+	};
+
+	FenceSource& fences;
+	Slot* slots;
+	int num_buffers;
+	int oldest;
+	int num_pending;
+};
+
+} // namespace
@@ -0,0 +1,732 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "result_protocol.h"
+
+namespace GXTest
+{
+
+static inline u8* Write16(u8* out, u32 value)
+{
+	out[0] = value >> 8;
+	out[1] = value;
+	return out + 2;
+}
+
+static inline u8* Write32(u8* out, u32 value)
+{
+	out[0] = value >> 24;
+	out[1] = value >> 16;
+	out[2] = value >> 8;
+	out[3] = value;
+	return out + 4;
+}
+
+static inline u8* Write64(u8* out, u64 value)
+{
+	return Write32(Write32(out, value >> 32), (u32)value);
+}
+
+static inline u32 Read16(const u8* in)
+{
+	return (in[0] << 8) | in[1];
+}
+
+static inline u32 Read32(const u8* in)
+{
+	return ((u32)in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3];
+}
+
+static inline u64 Read64(const u8* in)
+{
+	return ((u64)Read32(in) << 32) | Read32(in + 4);
+}
+
+// Types passed to va_arg for the arguments of a format string
+enum FormatArgType
+{
+	FORMAT_ARG_INT = 'i',
+	FORMAT_ARG_LONG = 'I',
+	FORMAT_ARG_LONG_LONG = 'L',
+	FORMAT_ARG_SIZE = 'z',
+	FORMAT_ARG_INTMAX = 'j',
+	FORMAT_ARG_PTRDIFF = 't',
+	FORMAT_ARG_DOUBLE = 'd',
+	FORMAT_ARG_LONG_DOUBLE = 'D',
+	FORMAT_ARG_STRING = 's',
+	FORMAT_ARG_POINTER = 'p',
+};
+
+// Finds the next conversion specification in format, stores the types of
+// the arguments it consumes in args and returns a pointer behind it.
+// Returns NULL if there's none, sets *num_args to -1 for unsupported ones.
+static const char* ParseConversion(const char* format, char* args, int* num_args)
+{
+	*num_args = 0;
+	const char* p = strchr(format, '%');
+	while (p && p[1] == '%')
+		p = strchr(p + 2, '%');
+	if (!p)
+		return NULL;
+
+	++p;
+	while (*p && strchr("-+ #0'", *p))
+		++p;
+	if (*p == '*')
+	{
+		args[(*num_args)++] = FORMAT_ARG_INT;
+		++p;
+	}
+	while (*p >= '0' && *p <= '9')
+		++p;
+	if (*p == '.')
+	{
+		++p;
+		if (*p == '*')
+		{
+			args[(*num_args)++] = FORMAT_ARG_INT;
+			++p;
+		}
+		while (*p >= '0' && *p <= '9')
+			++p;
+	}
+
+	char length = 0;
+	if (p[0] == 'l' && p[1] == 'l')
+	{
+		length = 'L';
+		p += 2;
+	}
+	else if (p[0] == 'h' && p[1] == 'h')
+	{
+		p += 2;
+	}
+	else if (*p && strchr("hlLzjtq", *p))
+	{
+		length = (*p == 'q') ? 'L' : (*p == 'h') ? 0 : *p;
+		++p;
+	}
+
+	char type;
+	if (*p && strchr("diouxXc", *p))
+		type = (length == 'l') ? FORMAT_ARG_LONG : (length == 'L') ? FORMAT_ARG_LONG_LONG : (length == 'z') ? FORMAT_ARG_SIZE :
+		       (length == 'j') ? FORMAT_ARG_INTMAX : (length == 't') ? FORMAT_ARG_PTRDIFF : FORMAT_ARG_INT;
+	else if (*p && strchr("fFeEgGaA", *p))
+		type = (length == 'L') ? FORMAT_ARG_LONG_DOUBLE : FORMAT_ARG_DOUBLE;
+	else if (*p == 's' && length == 0)
+		type = FORMAT_ARG_STRING;
+	else if (*p == 'p')
+		type = FORMAT_ARG_POINTER;
+	else
+		type = 0; // %n, wide characters, ...
+
+	if (!type)
+	{
+		*num_args = -1;
+		return *p ? p + 1 : p;
+	}
+	args[(*num_args)++] = type;
+	return p + 1;
+}
+
+ResultEncoder::ResultEncoder(u8* buffer, u32 capacity, FlushFunc flush, void* userdata)
+	: buffer(buffer), capacity(capacity), size(0), record(NULL), flush(flush), userdata(userdata), num_flushes(0), num_dropped_bytes(0), num_pending_passes(0), num_strings(0)
+{
+	assert(capacity >= RESULT_MIN_BUFFER_SIZE);
+	memset(strings, 0, sizeof(strings));
+}
+
+u8* ResultEncoder::BeginRecord(u8 type, u32 max_payload_size)
+{
+	assert(max_payload_size <= RESULT_MAX_PAYLOAD_SIZE);
+
+	if (type != RESULT_RECORD_PASSED)
+		FlushPendingPasses();
+
+	if (size + RESULT_RECORD_HEADER_SIZE + max_payload_size > capacity)
+		FlushBuffer();
+
+	record = buffer + size;
+	record[0] = type;
+	return record + RESULT_RECORD_HEADER_SIZE;
+}
+
+void ResultEncoder::EndRecord(u8* end)
+{
+	u32 payload_size = end - (record + RESULT_RECORD_HEADER_SIZE);
+	Write16(record + 1, payload_size);
+	size = end - buffer;
+}
+
+void ResultEncoder::FlushPendingPasses()
+{
+	if (!num_pending_passes)
+		return;
+
+	u8* out = BeginRecord(RESULT_RECORD_PASSED, 4);
+	EndRecord(Write32(out, num_pending_passes));
+	num_pending_passes = 0;
+}
+
+void ResultEncoder::FlushBuffer()
+{
+	if (!size)
+		return;
+
+	bool delivered = flush(buffer, size, userdata);
+	++num_flushes;
+	if (delivered)
+	{
+		size = 0;
+		return;
+	}
+
+	// The strings sent with the lost records are sent again when they are
+	// used next. Records already encoded may refer to them in the meantime,
+	// which the receiver knows to expect after this record.
+	num_dropped_bytes += size;
+	for (int i = 0; i < STRING_TABLE_SIZE; ++i)
+		strings[i].sent = false;
+
+	record = buffer;
+	record[0] = RESULT_RECORD_DROPPED;
+	EndRecord(Write32(record + RESULT_RECORD_HEADER_SIZE, size));
+}
+
+void ResultEncoder::Flush()
+{
+	FlushPendingPasses();
+	FlushBuffer();
+}
+
+const ResultEncoder::StringEntry* ResultEncoder::RegisterString(const char* str)
+{
+	u32 index = ((u32)(uintptr_t)str * 2654435761u) >> 21; // 11 bits, see STRING_TABLE_SIZE
+	while (strings[index].str && strings[index].str != str)
+		index = (index + 1) & (STRING_TABLE_SIZE - 1);
+
+	StringEntry& entry = strings[index];
+	if (entry.str)
+	{
+		if (!entry.sent)
+			SendString(entry);
+		return &entry;
+	}
+	if (num_strings == MAX_STRINGS)
+		return NULL;
+
+	entry.str = str;
+	entry.id = num_strings++;
+	entry.num_args = 0;
+	int num_args;
+	char args[3];
+	for (const char* p = ParseConversion(str, args, &num_args); p; p = ParseConversion(p, args, &num_args))
+	{
+		if (num_args < 0 || entry.num_args + num_args > MAX_ARGS)
+		{
+			entry.num_args = UNSUPPORTED_FORMAT;
+			break;
+		}
+		memcpy(entry.args + entry.num_args, args, num_args);
+		entry.num_args += num_args;
+	}
+
+	SendString(entry);
+	return &entry;
+}
+
+void ResultEncoder::SendString(StringEntry& entry)
+{
+	u32 length = strlen(entry.str);
+	length = (length > RESULT_MAX_PAYLOAD_SIZE - 2) ? RESULT_MAX_PAYLOAD_SIZE - 2 : length;
+	u8* out = BeginRecord(RESULT_RECORD_STRING, 2 + length);
+	out = Write16(out, entry.id);
+	memcpy(out, entry.str, length);
+	EndRecord(out + length);
+	entry.sent = true;
+}
+
+u8* ResultEncoder::EncodeArgs(u8* out, const StringEntry& entry, va_list args)
+{
+	for (int i = 0; i < entry.num_args; ++i)
+	{
+		// Integers are sent with their native size, which depends on the platform for some types
+		u64 value;
+		u32 value_size;
+		switch (entry.args[i])
+		{
+		case FORMAT_ARG_INT:
+			value = va_arg(args, int);
+			value_size = sizeof(int);
+			break;
+		case FORMAT_ARG_LONG:
+			value = va_arg(args, long);
+			value_size = sizeof(long);
+			break;
+		case FORMAT_ARG_LONG_LONG:
+			value = va_arg(args, long long);
+			value_size = sizeof(long long);
+			break;
+		case FORMAT_ARG_SIZE:
+			value = va_arg(args, size_t);
+			value_size = sizeof(size_t);
+			break;
+		case FORMAT_ARG_INTMAX:
+			value = va_arg(args, intmax_t);
+			value_size = sizeof(intmax_t);
+			break;
+		case FORMAT_ARG_PTRDIFF:
+			value = va_arg(args, ptrdiff_t);
+			value_size = sizeof(ptrdiff_t);
+			break;
+		case FORMAT_ARG_DOUBLE:
+		case FORMAT_ARG_LONG_DOUBLE:
+		{
+			double d = (entry.args[i] == FORMAT_ARG_DOUBLE) ? va_arg(args, double) : (double)va_arg(args, long double);
+			memcpy(&value, &d, sizeof(value));
+			*out++ = RESULT_ARG_DOUBLE;
+			out = Write64(out, value);
+			continue;
+		}
+		case FORMAT_ARG_STRING:
+		{
+			const char* str = va_arg(args, const char*);
+			u32 length = str ? strnlen(str, RESULT_MAX_STRING_ARG) : 6;
+			*out++ = RESULT_ARG_STRING;
+			out = Write16(out, length);
+			memcpy(out, str ? str : "(null)", length);
+			out += length;
+			continue;
+		}
+		default: // FORMAT_ARG_POINTER
+			*out++ = RESULT_ARG_POINTER;
+			out = Write64(out, (uintptr_t)va_arg(args, void*));
+			continue;
+		}
+
+		if (value_size == 8)
+		{
+			*out++ = RESULT_ARG_INT64;
+			out = Write64(out, value);
+		}
+		else
+		{
+			*out++ = RESULT_ARG_INT32;
+			out = Write32(out, (u32)value);
+		}
+	}
+	return out;
+}
+
+void ResultEncoder::EncodeMessage(u8 type, const u8* prefix, u32 prefix_size, const char* format, va_list args)
+{
+	const StringEntry* entry = RegisterString(format);
+	if (!entry || entry->num_args == UNSUPPORTED_FORMAT)
+	{
+		// Format on this side, without knowing about the arguments
+		u8* out = BeginRecord(RESULT_RECORD_TEXT, MAX_TEXT_SIZE);
+		int length = vsnprintf((char*)out, MAX_TEXT_SIZE, format, args);
+		length = (length < 0) ? 0 : (length >= MAX_TEXT_SIZE) ? MAX_TEXT_SIZE - 1 : length;
+		EndRecord(out + length);
+		return;
+	}
+
+	u8* out = BeginRecord(type, prefix_size + 2 + entry->num_args * (3 + RESULT_MAX_STRING_ARG));
+	memcpy(out, prefix, prefix_size);
+	out = Write16(out + prefix_size, entry->id);
+	EndRecord(EncodeArgs(out, *entry, args));
+}
+
+void ResultEncoder::Hello()
+{
+	u8* out = BeginRecord(RESULT_RECORD_HELLO, 6);
+	out = Write32(out, RESULT_PROTOCOL_MAGIC);
+	EndRecord(Write16(out, RESULT_PROTOCOL_VERSION));
+}
+
+void ResultEncoder::TestStart(int test_number, const char* file, int line, u64 time)
+{
+	const StringEntry* entry = RegisterString(file);
+	u8* out = BeginRecord(RESULT_RECORD_TEST_START, 16);
+	out = Write16(out, test_number);
+	out = Write16(out, entry ? entry->id : NO_STRING);
+	out = Write32(out, line);
+	EndRecord(Write64(out, time));
+}
+
+void ResultEncoder::SubtestFailed(int subtest, const char* file, int line, const char* format, va_list args)
+{
+	const StringEntry* entry = RegisterString(file);
+	u8 prefix[10];
+	Write32(prefix, subtest);
+	Write16(prefix + 4, entry ? entry->id : NO_STRING);
+	Write32(prefix + 6, line);
+
+	// The location is lost if the message needs to be sent as text
+	EncodeMessage(RESULT_RECORD_FAILED, prefix, sizeof(prefix), format, args);
+}
+
+void ResultEncoder::Message(const char* format, va_list args)
+{
+	EncodeMessage(RESULT_RECORD_MESSAGE, NULL, 0, format, args);
+}
+
+void ResultEncoder::Progress(u32 current, u32 total)
+{
+	u8* out = BeginRecord(RESULT_RECORD_PROGRESS, 8);
+	out = Write32(out, current);
+	EndRecord(Write32(out, total));
+}
+
+void ResultEncoder::SweepResults(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits)
+{
+	// Large bitmaps are split into several records at byte boundaries
+	const u32 max_bytes = RESULT_MAX_PAYLOAD_SIZE - 14;
+	do
+	{
+		const StringEntry* entry = RegisterString(sweep);
+		u32 num_bits = (count > max_bytes * 8) ? max_bytes * 8 : count;
+		u32 num_bytes = (num_bits + 7) / 8;
+		u8* out = BeginRecord(RESULT_RECORD_SWEEP, 14 + num_bytes);
+		out = Write16(out, entry ? entry->id : NO_STRING);
+		out = Write32(out, seed);
+		out = Write32(out, first_index);
+		out = Write32(out, num_bits);
+		memcpy(out, bits, num_bytes);
+
+		// Bits past the end of the sweep are sent as zero
+		if (num_bits & 7)
+			out[num_bytes - 1] &= 0xFF << (8 - (num_bits & 7));
+		EndRecord(out + num_bytes);
+
+		first_index += num_bits;
+		count -= num_bits;
+		bits += num_bytes;
+	} while (count);
+}
+
+void ResultEncoder::TestEnd(int num_subtests, int num_failures, u64 time)
+{
+	u8* out = BeginRecord(RESULT_RECORD_TEST_END, 16);
+	out = Write32(out, num_subtests);
+	out = Write32(out, num_failures);
+	EndRecord(Write64(out, time));
+}
+
+ResultDecoder::ResultDecoder(ResultHandler& handler)
+	: handler(handler), valid(true), records_dropped(false), pending_size(0), strings(NULL), num_strings(0), test_number(0)
+{
+	pending = (u8*)malloc(RESULT_RECORD_HEADER_SIZE + RESULT_MAX_PAYLOAD_SIZE);
+}
+
+ResultDecoder::~ResultDecoder()
+{
+	for (u32 i = 0; i < num_strings; ++i)
+		free(strings[i]);
+	free(strings);
+	free(pending);
+}
+
+bool ResultDecoder::Feed(const u8* data, u32 size)
+{
+	while (valid && size)
+	{
+		// Complete records are decoded in place, the rest goes through the pending buffer
+		if (pending_size == 0 && size >= RESULT_RECORD_HEADER_SIZE)
+		{
+			u32 record_size = RESULT_RECORD_HEADER_SIZE + Read16(data + 1);
+			if (size >= record_size)
+			{
+				valid = DecodeRecord(data[0], data + RESULT_RECORD_HEADER_SIZE, record_size - RESULT_RECORD_HEADER_SIZE);
+				data += record_size;
+				size -= record_size;
+				continue;
+			}
+		}
+
+		u32 needed = RESULT_RECORD_HEADER_SIZE;
+		if (pending_size >= RESULT_RECORD_HEADER_SIZE)
+			needed += Read16(pending + 1);
+		u32 count = (needed - pending_size < size) ? needed - pending_size : size;
+		memcpy(pending + pending_size, data, count);
+		pending_size += count;
+		data += count;
+		size -= count;
+
+		if (pending_size >= RESULT_RECORD_HEADER_SIZE && pending_size == RESULT_RECORD_HEADER_SIZE + Read16(pending + 1))
+		{
+			valid = DecodeRecord(pending[0], pending + RESULT_RECORD_HEADER_SIZE, pending_size - RESULT_RECORD_HEADER_SIZE);
+			pending_size = 0;
+		}
+	}
+	return valid;
+}
+
+const char* ResultDecoder::GetString(u16 id) const
+{
+	return (id < num_strings && strings[id]) ? strings[id] : NULL;
+}
+
+// Appends printf-formatted text to message, cutting it off at the end of the buffer
+static void AppendFormatted(char* message, u32 message_size, u32* length, const char* format, ...)
+{
+	if (*length + 1 >= message_size)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	int count = vsnprintf(message + *length, message_size - *length, format, args);
+	va_end(args);
+	if (count > 0)
+		*length = (*length + count < message_size) ? *length + count : message_size - 1;
+}
+
+// Messages whose format string got lost are replaced by a note, after
+// checking that the arguments are well-formed
+bool ResultDecoder::SkipArgs(const u8* data, const u8* end, char* message, u32 message_size)
+{
+	while (data < end)
+	{
+		u8 tag = *data++;
+		u32 value_size = (tag == RESULT_ARG_INT32) ? 4 : (tag == RESULT_ARG_STRING) ? 2 : 8;
+		if (tag != RESULT_ARG_INT32 && tag != RESULT_ARG_INT64 && tag != RESULT_ARG_DOUBLE && tag != RESULT_ARG_STRING && tag != RESULT_ARG_POINTER)
+			return false;
+		if (end - data < (int)value_size)
+			return false;
+		u32 string_size = (tag == RESULT_ARG_STRING) ? Read16(data) : 0;
+		data += value_size;
+		if (string_size > RESULT_MAX_STRING_ARG || end - data < (int)string_size)
+			return false;
+		data += string_size;
+	}
+	snprintf(message, message_size, "(message lost)\n");
+	return true;
+}
+
+bool ResultDecoder::FormatMessage(const u8* data, const u8* end, char* message, u32 message_size)
+{
+	if (end - data < 2)
+		return false;
+	const char* format = GetString(Read16(data));
+	data += 2;
+	if (!format && records_dropped)
+		return SkipArgs(data, end, message, message_size);
+	if (!format)
+		return false;
+
+	u32 length = 0;
+	message[0] = 0;
+	const char* p = format;
+	while (true)
+	{
+		char types[3];
+		int num_args;
+		const char* next = ParseConversion(p, types, &num_args);
+		const char* spec_start = next ? strchr(p, '%') : NULL;
+		while (spec_start && spec_start[1] == '%')
+			spec_start = strchr(spec_start + 2, '%');
+
+		// Literal text, with %% sequences
+		const char* text_end = spec_start ? spec_start : p + strlen(p);
+		for (; p < text_end; ++p)
+		{
+			if (length + 1 < message_size)
+				message[length++] = *p;
+			if (p[0] == '%' && p[1] == '%')
+				++p;
+		}
+		message[length] = 0;
+		if (!next)
+			return data == end;
+		if (num_args < 0)
+			return false;
+
+		// Rebuild the conversion specification with the values of '*' and
+		// a length modifier matching the transmitted value
+		char spec[64];
+		u32 spec_length = 0;
+		int arg = 0;
+		u64 values[3];
+		u8 tags[3];
+		for (; arg < num_args; ++arg)
+		{
+			if (data >= end)
+				return false;
+			tags[arg] = *data++;
+			u32 value_size = (tags[arg] == RESULT_ARG_INT32) ? 4 : (tags[arg] == RESULT_ARG_STRING) ? 2 : 8;
+			if (end - data < (int)value_size)
+				return false;
+			values[arg] = (value_size == 4) ? Read32(data) : (value_size == 2) ? Read16(data) : Read64(data);
+			data += value_size;
+			if (tags[arg] == RESULT_ARG_STRING)
+			{
+				// Longer strings are never sent, see RESULT_MAX_STRING_ARG
+				if (values[arg] > RESULT_MAX_STRING_ARG || end - data < (int)values[arg])
+					return false;
+				data += values[arg];
+			}
+		}
+
+		// The value itself is the last argument
+		int value_arg = num_args - 1;
+		u64 value = values[value_arg];
+		u8 tag = tags[value_arg];
+
+		// h and hh narrow int arguments, so they are kept for those
+		char conversion = next[-1];
+		int star = 0;
+		for (const char* s = spec_start; s < next - 1 && spec_length < sizeof(spec) - 24; ++s)
+		{
+			if (*s == '*')
+				spec_length += sprintf(spec + spec_length, "%d", (int)(s32)values[star++]);
+			else if (!strchr("hlLzjtq", *s) || (*s == 'h' && tag == RESULT_ARG_INT32))
+				spec[spec_length++] = *s;
+		}
+		bool is_integer = strchr("diouxXc", conversion) != NULL;
+		bool is_float = strchr("fFeEgGaA", conversion) != NULL;
+		if (is_integer && tag == RESULT_ARG_INT64)
+		{
+			spec_length += sprintf(spec + spec_length, "ll%c", conversion);
+			AppendFormatted(message, message_size, &length, spec, (long long)value);
+		}
+		else if (is_integer && tag == RESULT_ARG_INT32)
+		{
+			spec[spec_length++] = conversion;
+			spec[spec_length] = 0;
+			AppendFormatted(message, message_size, &length, spec, (int)(u32)value);
+		}
+		else if (is_float && tag == RESULT_ARG_DOUBLE)
+		{
+			double d;
+			memcpy(&d, &value, sizeof(d));
+			spec[spec_length++] = conversion;
+			spec[spec_length] = 0;
+			AppendFormatted(message, message_size, &length, spec, d);
+		}
+		else if (conversion == 's' && tag == RESULT_ARG_STRING)
+		{
+			char str[RESULT_MAX_STRING_ARG + 1];
+			memcpy(str, data - value, value);
+			str[value] = 0;
+			spec[spec_length++] = 's';
+			spec[spec_length] = 0;
+			AppendFormatted(message, message_size, &length, spec, str);
+		}
+		else if (conversion == 'p' && tag == RESULT_ARG_POINTER)
+		{
+			AppendFormatted(message, message_size, &length, "0x%llx", (unsigned long long)value);
+		}
+		else
+		{
+			return false;
+		}
+		p = next;
+	}
+}
+
+bool ResultDecoder::DecodeRecord(u8 type, const u8* payload, u32 size)
+{
+	static char message[8192];
+	const u8* end = payload + size;
+
+	switch (type)
+	{
+	case RESULT_RECORD_HELLO:
+		if (size != 6 || Read32(payload) != RESULT_PROTOCOL_MAGIC || Read16(payload + 4) != RESULT_PROTOCOL_VERSION)
+			return false;
+		handler.OnHello(Read16(payload + 4));
+		return true;
+
+	case RESULT_RECORD_STRING:
+	{
+		if (size < 2)
+			return false;
+		u32 id = Read16(payload);
+		if (id >= num_strings)
+		{
+			strings = (char**)realloc(strings, (id + 1) * sizeof(char*));
+			memset(strings + num_strings, 0, (id + 1 - num_strings) * sizeof(char*));
+			num_strings = id + 1;
+		}
+		free(strings[id]);
+		strings[id] = (char*)malloc(size - 1);
+		memcpy(strings[id], payload + 2, size - 2);
+		strings[id][size - 2] = 0;
+		return true;
+	}
+
+	case RESULT_RECORD_TEST_START:
+		if (size != 16)
+			return false;
+		test_number = Read16(payload);
+		handler.OnTestStart(test_number, GetString(Read16(payload + 2)), Read32(payload + 4), Read64(payload + 8));
+		return true;
+
+	case RESULT_RECORD_PASSED:
+		if (size != 4)
+			return false;
+		handler.OnPassed(Read32(payload));
+		return true;
+
+	case RESULT_RECORD_FAILED:
+		if (size < 10 || !FormatMessage(payload + 10, end, message, sizeof(message)))
+			return false;
+		handler.OnFailed(Read32(payload), GetString(Read16(payload + 4)), Read32(payload + 6), message);
+		return true;
+
+	case RESULT_RECORD_MESSAGE:
+		if (!FormatMessage(payload, end, message, sizeof(message)))
+			return false;
+		handler.OnMessage(message);
+		return true;
+
+	case RESULT_RECORD_TEXT:
+		memcpy(message, payload, (size < sizeof(message)) ? size : sizeof(message) - 1);
+		message[(size < sizeof(message)) ? size : sizeof(message) - 1] = 0;
+		handler.OnMessage(message);
+		return true;
+
+	case RESULT_RECORD_DROPPED:
+		if (size != 4)
+			return false;
+		records_dropped = true;
+		handler.OnDropped(Read32(payload));
+		return true;
+
+	case RESULT_RECORD_SWEEP:
+	{
+		if (size < 14 || size != 14 + (Read32(payload + 10) + 7) / 8)
+			return false;
+		const char* sweep = GetString(Read16(payload));
+		if (!sweep && !records_dropped)
+			return false;
+		handler.OnSweepResults(sweep, Read32(payload + 2), Read32(payload + 6), Read32(payload + 10), payload + 14);
+		return true;
+	}
+
+	case RESULT_RECORD_PROGRESS:
+		if (size != 8)
+			return false;
+		handler.OnProgress(Read32(payload), Read32(payload + 4));
+		return true;
+
+	case RESULT_RECORD_TEST_END:
+		if (size != 16)
+			return false;
+		handler.OnTestEnd(test_number, Read32(payload), Read32(payload + 4), Read64(payload + 8));
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+} // namespace
@@ -0,0 +1,231 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Binary protocol for sending test results
+// Instead of formatting messages on the console and sending them line by
+// line, results are encoded as a stream of records, which are collected in
+// a large buffer and sent in bulk. Messages are sent as the ID of their
+// format string plus the raw arguments, and get formatted by the receiver.
+//
+// Each record starts with a 3 byte header: the record type (RESULT_RECORD_X)
+// and the size of the payload as big endian u16. All multi-byte values are
+// big endian. Strings (format strings and file names) are sent once in a
+// RESULT_RECORD_STRING record and referred to by their ID afterwards.
+// Times are in microseconds since the sender started, measured on the sender
+// since records only arrive when the send buffer gets flushed.
+
+#pragma once
+
+#include <stdarg.h>
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+#define RESULT_PROTOCOL_MAGIC   0x47585452 // "GXTR"
+#define RESULT_PROTOCOL_VERSION 4
+
+enum ResultRecordType
+{
+	RESULT_RECORD_HELLO = 1,      // u32 magic, u16 version
+	RESULT_RECORD_STRING,         // u16 id, characters (not null-terminated)
+	RESULT_RECORD_TEST_START,     // u16 test number, u16 file id, u32 line, u64 time
+	RESULT_RECORD_PASSED,         // u32 number of consecutive passed subtests
+	RESULT_RECORD_FAILED,         // u32 subtest, u16 file id, u32 line, message
+	RESULT_RECORD_MESSAGE,        // message
+	RESULT_RECORD_PROGRESS,       // u32 current, u32 total
+	RESULT_RECORD_TEST_END,       // u32 number of subtests, u32 number of failures, u64 time
+	RESULT_RECORD_TEXT,           // preformatted message (characters)
+	RESULT_RECORD_DROPPED,        // u32 number of bytes lost before this record
+	RESULT_RECORD_SWEEP,          // u16 sweep name id, u32 seed, u32 first index, u32 count, bitmap
+};
+
+// Messages consist of the u16 ID of the format string and one tagged value
+// per argument consumed by the format string.
+enum ResultArgTag
+{
+	RESULT_ARG_INT32 = 'i',  // u32
+	RESULT_ARG_INT64 = 'l',  // u64
+	RESULT_ARG_DOUBLE = 'd', // IEEE double, as u64
+	RESULT_ARG_STRING = 's', // u16 length, characters
+	RESULT_ARG_POINTER = 'p', // u64
+};
+
+// Sweep bitmaps hold one bit per sample, which is set if the sample failed.
+// Bits are stored starting with the most significant bit of the first byte.
+inline bool IsSweepSampleFailed(const u8* bits, u32 index)
+{
+	return (bits[index / 8] >> (7 - index % 8)) & 1;
+}
+
+inline void SetSweepSampleFailed(u8* bits, u32 index)
+{
+	bits[index / 8] |= 0x80 >> (index % 8);
+}
+
+#define RESULT_RECORD_HEADER_SIZE 3
+#define RESULT_MAX_PAYLOAD_SIZE 0xFFFF
+
+// Minimum size of the encoder buffer: The largest record plus a
+// RESULT_RECORD_DROPPED record
+#define RESULT_MIN_BUFFER_SIZE (2 * RESULT_RECORD_HEADER_SIZE + 4 + RESULT_MAX_PAYLOAD_SIZE)
+
+// Longest string argument which is sent, longer ones are cut off
+#define RESULT_MAX_STRING_ARG 1024
+
+// Encodes results into a buffer, which gets handed to a flush function when
+// it's full and whenever Flush is called.
+// Format strings are identified by their address, so they need to stay
+// valid and unchanged for the lifetime of the encoder (e.g. string literals).
+class ResultEncoder
+{
+public:
+	// Returns false if the data couldn't be delivered
+	typedef bool (*FlushFunc)(const u8* data, u32 size, void* userdata);
+
+	// capacity must be at least RESULT_MIN_BUFFER_SIZE
+	ResultEncoder(u8* buffer, u32 capacity, FlushFunc flush, void* userdata);
+
+	void Hello();
+	void TestStart(int test_number, const char* file, int line, u64 time);
+
+	// Passed subtests are merely counted, and sent as a single record
+	// before the next record of any other type.
+	void SubtestPassed() { ++num_pending_passes; }
+	void SubtestFailed(int subtest, const char* file, int line, const char* format, va_list args);
+
+	void Message(const char* format, va_list args);
+	void Progress(u32 current, u32 total);
+
+	// Outcomes of count samples of the named sweep, as a bitmap (see
+	// IsSweepSampleFailed). Samples are identified by the seed of the sweep
+	// and their index, the first one being first_index.
+	void SweepResults(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits);
+	void TestEnd(int num_subtests, int num_failures, u64 time);
+
+	// Hand all buffered records to the flush function
+	void Flush();
+
+	u32 GetNumFlushes() const { return num_flushes; }
+	u64 GetNumDroppedBytes() const { return num_dropped_bytes; }
+
+private:
+	ResultEncoder(const ResultEncoder&) = delete;
+	ResultEncoder& operator = (const ResultEncoder&) = delete;
+
+	enum
+	{
+		STRING_TABLE_SIZE = 2048, // power of two
+		MAX_STRINGS = 1536,
+		MAX_ARGS = 32,
+		UNSUPPORTED_FORMAT = 0xFF,
+		NO_STRING = 0xFFFF,
+		MAX_TEXT_SIZE = 4096,
+	};
+
+	struct StringEntry
+	{
+		const char* str;
+		u16 id;
+		u8 num_args; // UNSUPPORTED_FORMAT if the message needs to be sent as text
+		bool sent; // false if the string record got lost
+		char args[MAX_ARGS]; // types of the arguments consumed by the format string
+	};
+
+	// Start a record with at most max_payload_size bytes of payload,
+	// returns a pointer to the payload.
+	u8* BeginRecord(u8 type, u32 max_payload_size);
+	void EndRecord(u8* end);
+
+	void FlushPendingPasses();
+	void FlushBuffer();
+
+	// Looks up the given string, which is sent to the receiver when it's
+	// used for the first time. Returns NULL if the table is full.
+	const StringEntry* RegisterString(const char* str);
+	void SendString(StringEntry& entry);
+
+	u8* EncodeArgs(u8* out, const StringEntry& entry, va_list args);
+
+	// Sends a record consisting of prefix followed by the message. Messages
+	// which can't be encoded are formatted here and sent as text instead.
+	void EncodeMessage(u8 type, const u8* prefix, u32 prefix_size, const char* format, va_list args);
+
+	u8* buffer;
+	u32 capacity;
+	u32 size;
+	u8* record;
+
+	FlushFunc flush;
+	void* userdata;
+	u32 num_flushes;
+	u64 num_dropped_bytes;
+
+	u32 num_pending_passes;
+
+	// Open addressing hash table of registered strings, keyed by address
+	StringEntry strings[STRING_TABLE_SIZE];
+	int num_strings;
+};
+
+// Receives the decoded records, see ResultDecoder
+class ResultHandler
+{
+public:
+	virtual ~ResultHandler() {}
+
+	virtual void OnHello(int version) {}
+	virtual void OnTestStart(int test_number, const char* file, int line, u64 time) {}
+	virtual void OnPassed(u32 count) {}
+	virtual void OnFailed(int subtest, const char* file, int line, const char* message) {}
+	virtual void OnMessage(const char* message) {}
+	virtual void OnProgress(u32 current, u32 total) {}
+	virtual void OnSweepResults(const char* sweep, u32 seed, u32 first_index, u32 count, const u8* bits) {}
+	virtual void OnTestEnd(int test_number, int num_subtests, int num_failures, u64 time) {}
+
+	// Records got lost on the sending side, strings (like file names) may be
+	// NULL and messages incomplete until they get sent again
+	virtual void OnDropped(u32 num_bytes) {}
+};
+
+// Parses a stream of records, which may be split at arbitrary points
+class ResultDecoder
+{
+public:
+	ResultDecoder(ResultHandler& handler);
+	~ResultDecoder();
+
+	// Returns false if the stream is malformed, after which it is not
+	// decoded any further.
+	bool Feed(const u8* data, u32 size);
+
+	bool IsValid() const { return valid; }
+
+	// Whether the stream ended at a record boundary
+	bool IsAtRecordBoundary() const { return pending_size == 0; }
+
+private:
+	ResultDecoder(const ResultDecoder&) = delete;
+	ResultDecoder& operator = (const ResultDecoder&) = delete;
+
+	bool DecodeRecord(u8 type, const u8* payload, u32 size);
+	bool FormatMessage(const u8* data, const u8* end, char* message, u32 message_size);
+	bool SkipArgs(const u8* data, const u8* end, char* message, u32 message_size);
+	const char* GetString(u16 id) const;
+
+	ResultHandler& handler;
+	bool valid;
+	bool records_dropped; // unknown strings are expected after that
+
+	u8* pending; // incomplete record
+	u32 pending_size;
+
+	char** strings;
+	u32 num_strings;
+
+	int test_number;
+};
+
+} // namespace
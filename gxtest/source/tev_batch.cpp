@@ -0,0 +1,202 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+
+#include "tev_batch.h"
+
+#if defined(GXTEST_HOST) && defined(__SSE2__)
+#define TEV_BATCH_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEV_BATCH_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace GXTest
+{
+
+// Mode dependent terms of the combiner formula, see TevCombinerExpectation
+struct TevCombinerConstants
+{
+	TevCombinerConstants(const TevCombinerMode& mode)
+	{
+		lshift = (mode.shift == 1) ? 1 : (mode.shift == 2) ? 2 : 0;
+		rshift = (mode.shift == 3) ? 1 : 0;
+		round_bias = (mode.shift == 3) ? 0 : ((mode.op == 1) ? 127 : 128);
+		negate = (mode.op == 1) ? -1 : 0;
+		bias = ((mode.bias == 2) ? -128 : (mode.bias == 1) ? 128 : 0) * (1 << lshift);
+		min = mode.clamp ? 0 : -1024;
+		max = mode.clamp ? 255 : 1023;
+	}
+
+	int lshift;
+	int rshift;
+	int round_bias;
+	int negate; // all bits set for subtraction
+	int bias;
+	int min;
+	int max;
+};
+
+// Plain integer version, which is also used on the console.
+// Paired singles don't help here: the lerp needs exact products of up to 18
+// bits followed by a flooring shift, which doesn't map to ps instructions
+// without costly conversions. Instead, all mode dependent branches are hoisted
+// out of the loop and the lerp is reduced to a single multiplication.
+static void EvaluateGeneric(const TevCombinerConstants& k, const u8* a, const u8* b, const u8* c, const s16* d, int count, s16* results)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		int ci = c[i] + (c[i] >> 7);
+		int lerp = (a[i] << 8) + (b[i] - a[i]) * ci; // a*(256-c) + b*c
+		lerp = ((lerp << k.lshift) + k.round_bias) >> 8;
+		lerp = (lerp ^ k.negate) - k.negate;
+
+		int result = (d[i] * (1 << k.lshift) + lerp + k.bias) >> k.rshift;
+		result = (result < k.min) ? k.min : (result > k.max) ? k.max : result;
+		results[i] = result;
+	}
+}
+
+#ifdef TEV_BATCH_SSE2
+// Intermediate values fit into 16 bits except for the lerp products, which
+// are summed up to 32 bits by pmaddwd (a*(256-c) + b*c) and packed back
+// after the rounding shift. 8 evaluations per iteration.
+static int EvaluateSSE2(const TevCombinerConstants& k, const u8* a, const u8* b, const u8* c, const s16* d, int count, s16* results)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lshift = _mm_cvtsi32_si128(k.lshift);
+	const __m128i rshift = _mm_cvtsi32_si128(k.rshift);
+	const __m128i round_bias = _mm_set1_epi32(k.round_bias);
+	const __m128i negate = _mm_set1_epi16(k.negate);
+	const __m128i bias = _mm_set1_epi16(k.bias);
+	const __m128i min = _mm_set1_epi16(k.min);
+	const __m128i max = _mm_set1_epi16(k.max);
+	const __m128i c256 = _mm_set1_epi16(256);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a + i)), zero);
+		__m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(b + i)), zero);
+		__m128i vc = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(c + i)), zero);
+		vc = _mm_add_epi16(vc, _mm_srli_epi16(vc, 7));
+		__m128i vinv = _mm_sub_epi16(c256, vc);
+
+		__m128i lerp_lo = _mm_madd_epi16(_mm_unpacklo_epi16(va, vb), _mm_unpacklo_epi16(vinv, vc));
+		__m128i lerp_hi = _mm_madd_epi16(_mm_unpackhi_epi16(va, vb), _mm_unpackhi_epi16(vinv, vc));
+		lerp_lo = _mm_srai_epi32(_mm_add_epi32(_mm_sll_epi32(lerp_lo, lshift), round_bias), 8);
+		lerp_hi = _mm_srai_epi32(_mm_add_epi32(_mm_sll_epi32(lerp_hi, lshift), round_bias), 8);
+		__m128i lerp = _mm_packs_epi32(lerp_lo, lerp_hi);
+		lerp = _mm_sub_epi16(_mm_xor_si128(lerp, negate), negate);
+
+		__m128i vd = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(d + i)), lshift);
+		__m128i result = _mm_sra_epi16(_mm_add_epi16(_mm_add_epi16(vd, lerp), bias), rshift);
+		result = _mm_min_epi16(_mm_max_epi16(result, min), max);
+		_mm_storeu_si128((__m128i*)(results + i), result);
+	}
+	return i;
+}
+#endif
+
+#ifdef TEV_BATCH_AVX2
+// Same as the SSE2 version, but with 16 evaluations per iteration.
+// Unpacking and packing both operate on 128 bit halves, hence the
+// element order is preserved.
+__attribute__((target("avx2")))
+static int EvaluateAVX2(const TevCombinerConstants& k, const u8* a, const u8* b, const u8* c, const s16* d, int count, s16* results)
+{
+	const __m128i lshift = _mm_cvtsi32_si128(k.lshift);
+	const __m128i rshift = _mm_cvtsi32_si128(k.rshift);
+	const __m256i round_bias = _mm256_set1_epi32(k.round_bias);
+	const __m256i negate = _mm256_set1_epi16(k.negate);
+	const __m256i bias = _mm256_set1_epi16(k.bias);
+	const __m256i min = _mm256_set1_epi16(k.min);
+	const __m256i max = _mm256_set1_epi16(k.max);
+	const __m256i c256 = _mm256_set1_epi16(256);
+
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+		__m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+		__m256i vc = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(c + i)));
+		vc = _mm256_add_epi16(vc, _mm256_srli_epi16(vc, 7));
+		__m256i vinv = _mm256_sub_epi16(c256, vc);
+
+		__m256i lerp_lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(va, vb), _mm256_unpacklo_epi16(vinv, vc));
+		__m256i lerp_hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(va, vb), _mm256_unpackhi_epi16(vinv, vc));
+		lerp_lo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sll_epi32(lerp_lo, lshift), round_bias), 8);
+		lerp_hi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sll_epi32(lerp_hi, lshift), round_bias), 8);
+		__m256i lerp = _mm256_packs_epi32(lerp_lo, lerp_hi);
+		lerp = _mm256_sub_epi16(_mm256_xor_si256(lerp, negate), negate);
+
+		__m256i vd = _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)(d + i)), lshift);
+		__m256i result = _mm256_sra_epi16(_mm256_add_epi16(_mm256_add_epi16(vd, lerp), bias), rshift);
+		result = _mm256_min_epi16(_mm256_max_epi16(result, min), max);
+		_mm256_storeu_si256((__m256i*)(results + i), result);
+	}
+	return i;
+}
+#endif
+
+bool IsTevCombinerImplSupported(TevCombinerImpl impl)
+{
+	switch (impl)
+	{
+	case TEV_COMBINER_GENERIC:
+		return true;
+#ifdef TEV_BATCH_SSE2
+	case TEV_COMBINER_SSE2:
+		return true;
+#endif
+#ifdef TEV_BATCH_AVX2
+	case TEV_COMBINER_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* GetTevCombinerImplName(TevCombinerImpl impl)
+{
+	static const char* names[NUM_TEV_COMBINER_IMPLS] = { "generic", "SSE2", "AVX2" };
+	return names[impl];
+}
+
+void EvaluateTevCombinerBatch(const u8* a, const u8* b, const u8* c, const s16* d, int count, const TevCombinerMode& mode, s16* results)
+{
+	static int best_impl = -1;
+	if (best_impl == -1)
+	{
+		best_impl = NUM_TEV_COMBINER_IMPLS - 1;
+		while (!IsTevCombinerImplSupported((TevCombinerImpl)best_impl))
+			--best_impl;
+	}
+	EvaluateTevCombinerBatch((TevCombinerImpl)best_impl, a, b, c, d, count, mode, results);
+}
+
+void EvaluateTevCombinerBatch(TevCombinerImpl impl, const u8* a, const u8* b, const u8* c, const s16* d, int count, const TevCombinerMode& mode, s16* results)
+{
+	assert(IsTevCombinerImplSupported(impl));
+
+	TevCombinerConstants k(mode);
+
+	// The vectorized versions leave the remainder to the generic one
+	int done = 0;
+#ifdef TEV_BATCH_AVX2
+	if (impl == TEV_COMBINER_AVX2)
+		done = EvaluateAVX2(k, a, b, c, d, count, results);
+#endif
+#ifdef TEV_BATCH_SSE2
+	if (impl == TEV_COMBINER_SSE2)
+		done = EvaluateSSE2(k, a, b, c, d, count, results);
+#endif
+	EvaluateGeneric(k, a + done, b + done, c + done, d + done, count - done, results + done);
+}
+
+} // namespace
@@ -0,0 +1,47 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Settings of a tev combiner (see TevStageCombiner), shared by all
+// evaluations of a batch
+struct TevCombinerMode
+{
+	int shift;
+	int bias;
+	int op;
+	int clamp;
+};
+
+// Implementations of EvaluateTevCombinerBatch.
+// All of them are bit-exact with each other. The vectorized ones are only
+// available in the host build and depend on the CPU's feature set.
+enum TevCombinerImpl
+{
+	TEV_COMBINER_GENERIC,
+	TEV_COMBINER_SSE2,
+	TEV_COMBINER_AVX2,
+
+	NUM_TEV_COMBINER_IMPLS
+};
+
+bool IsTevCombinerImplSupported(TevCombinerImpl impl);
+const char* GetTevCombinerImplName(TevCombinerImpl impl);
+
+// Evaluate the tev combiner formula (lerp, bias, shift and clamp) for count
+// sets of inputs, using the best supported implementation.
+// Only the lower 8 bits of a, b and c are used, d must be an 11 bit signed
+// value. Compare mode (TevBias_COMPARE) is not handled, i.e. treated like
+// a zero bias.
+void EvaluateTevCombinerBatch(const u8* a, const u8* b, const u8* c, const s16* d, int count, const TevCombinerMode& mode, s16* results);
+
+// Same as above, using the given implementation, which must be supported.
+void EvaluateTevCombinerBatch(TevCombinerImpl impl, const u8* a, const u8* b, const u8* c, const s16* d, int count, const TevCombinerMode& mode, s16* results);
+
+} // namespace
@@ -0,0 +1,143 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "tev_model.h"
+
+namespace GXTest
+{
+
+static int ClampTevOutput(int value, int clamp)
+{
+	if (clamp)
+		return (value < 0) ? 0 : (value > 255) ? 255 : value;
+	else
+		return (value < -1024) ? -1024 : (value > 1023) ? 1023 : value;
+}
+
+int TevCombinerExpectation(int a, int b, int c, int d, int shift, int bias, int op, int clamp)
+{
+	a &= 255;
+	b &= 255;
+	c &= 255;
+
+	c = c+(c>>7);
+	u16 lshift = (shift == 1) ? 1 : (shift == 2) ? 2 : 0;
+	u16 rshift = (shift == 3) ? 1 : 0;
+	int round_bias = (shift==3) ? 0 : ((op==1) ? 127 : 128);
+	int expected = (((a*(256-c) + b*c) << lshift)+round_bias)>>8; // lerp
+	expected = (d << lshift) + expected * ((op == 1) ? (-1) : 1);
+	expected += ((bias == 2) ? -128 : (bias == 1) ? 128 : 0) << lshift;
+	expected >>= rshift;
+	return ClampTevOutput(expected, clamp);
+}
+
+static int GetTevCompareChannel(const Vec4<int>& v, int channel)
+{
+	const int values[4] = { v.r, v.g, v.b, v.a };
+	return values[channel] & 255;
+}
+
+int TevCompareExpectation(const Vec4<int>& a, const Vec4<int>& b, int c, int d, int channel, int mode, int clamp)
+{
+	// Number of compared 8 bit channels, starting with red
+	int num_channels = (mode >> 1) + 1;
+
+	u32 value_a = 0;
+	u32 value_b = 0;
+	if (num_channels == 4) // TEVCMP_RGB8 or TEVCMP_A8
+	{
+		value_a = GetTevCompareChannel(a, channel);
+		value_b = GetTevCompareChannel(b, channel);
+	}
+	else
+	{
+		for (int i = num_channels - 1; i >= 0; --i)
+		{
+			value_a = (value_a << 8) | GetTevCompareChannel(a, i);
+			value_b = (value_b << 8) | GetTevCompareChannel(b, i);
+		}
+	}
+
+	bool passed = (mode & 1) ? (value_a == value_b) : (value_a > value_b);
+	return ClampTevOutput(d + (passed ? (c & 255) : 0), clamp);
+}
+
+static Vec4<int> GetTevColorInput(const Vec4<int> regs[4], u32 arg)
+{
+	Vec4<int> ret;
+	if (arg <= TEVCOLORARG_A2)
+	{
+		const Vec4<int>& reg = regs[arg / 2];
+		ret.r = (arg & 1) ? reg.a : reg.r;
+		ret.g = (arg & 1) ? reg.a : reg.g;
+		ret.b = (arg & 1) ? reg.a : reg.b;
+	}
+	else
+	{
+		assert(arg == TEVCOLORARG_ONE || arg == TEVCOLORARG_HALF || arg == TEVCOLORARG_ZERO);
+		ret.r = ret.g = ret.b = (arg == TEVCOLORARG_ONE) ? 255 : (arg == TEVCOLORARG_HALF) ? 128 : 0;
+	}
+	ret.a = 0;
+	return ret;
+}
+
+static int GetTevAlphaInput(const Vec4<int> regs[4], u32 arg)
+{
+	if (arg <= TEVALPHAARG_A2)
+		return regs[arg].a;
+
+	assert(arg == TEVALPHAARG_ZERO);
+	return 0;
+}
+
+TevStageInputs GetTevStageInputs(const Vec4<int> regs[4], const TevStageCombiner::ColorCombiner& cc, const TevStageCombiner::AlphaCombiner& ac)
+{
+	TevStageInputs ret;
+	ret.a = GetTevColorInput(regs, cc.a);
+	ret.b = GetTevColorInput(regs, cc.b);
+	ret.c = GetTevColorInput(regs, cc.c);
+	ret.d = GetTevColorInput(regs, cc.d);
+	ret.a.a = GetTevAlphaInput(regs, ac.a);
+	ret.b.a = GetTevAlphaInput(regs, ac.b);
+	ret.c.a = GetTevAlphaInput(regs, ac.c);
+	ret.d.a = GetTevAlphaInput(regs, ac.d);
+	return ret;
+}
+
+Vec4<int> TevStageExpectation(const TevStageInputs& in, const TevStageCombiner::ColorCombiner& cc, const TevStageCombiner::AlphaCombiner& ac)
+{
+	const int a[4] = { in.a.r, in.a.g, in.a.b, in.a.a };
+	const int b[4] = { in.b.r, in.b.g, in.b.b, in.b.a };
+	const int c[4] = { in.c.r, in.c.g, in.c.b, in.c.a };
+	const int d[4] = { in.d.r, in.d.g, in.d.b, in.d.a };
+	int out[4];
+
+	for (int channel = 0; channel < 4; ++channel)
+	{
+		bool is_alpha = (channel == 3);
+		u32 bias = is_alpha ? ac.bias : cc.bias;
+		u32 shift = is_alpha ? ac.shift : cc.shift;
+		u32 op = is_alpha ? ac.op : cc.op;
+		u32 clamp = is_alpha ? ac.clamp : cc.clamp;
+
+		if (bias == TevBias_COMPARE)
+			out[channel] = TevCompareExpectation(in.a, in.b, c[channel], d[channel], channel, GetTevCompareMode(shift, op), clamp);
+		else
+			out[channel] = TevCombinerExpectation(a[channel], b[channel], c[channel], d[channel], shift, bias, op, clamp);
+	}
+
+	Vec4<int> ret;
+	ret.r = out[0];
+	ret.g = out[1];
+	ret.b = out[2];
+	ret.a = out[3];
+	return ret;
+}
+
+} // namespace
@@ -0,0 +1,54 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Reference model of the tev combiners
+// These functions describe the expected hardware behavior and serve as the
+// oracle for tests. They are written for clarity rather than performance.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Expected output of a single combiner channel in regular (non-compare) mode
+// Only the lower 8 bits of a, b and c are used. A bias of TevBias_COMPARE
+// is treated like a zero bias, use TevCompareExpectation for that one.
+int TevCombinerExpectation(int a, int b, int c, int d, int shift, int bias, int op, int clamp);
+
+// Compare mode (bias == TevBias_COMPARE) selects one of the TEVCMP_* modes
+// via the shift and op fields of the combiner.
+inline int GetTevCompareMode(int shift, int op)
+{
+	return (shift << 1) | op;
+}
+
+// Expected output of the given channel (0-2: color, 3: alpha) in compare mode:
+// d + ((a cmp b) ? c : 0), clamped like in regular mode.
+// The compared values are built from the lower 8 bits of the r, g and b
+// channels of a and b (TEVCMP_R8, TEVCMP_GR16 and TEVCMP_BGR24) or from the
+// tested channel itself (TEVCMP_RGB8 for color, TEVCMP_A8 for alpha).
+int TevCompareExpectation(const Vec4<int>& a, const Vec4<int>& b, int c, int d, int channel, int mode, int clamp);
+
+// Inputs of a tev stage, as selected by its combiners:
+// The r, g and b channels are selected by the color combiner, the a channel
+// by the alpha combiner.
+// This matches hardware behavior in compare mode: The non-A8 compare modes
+// of the alpha combiner compare the color channels of its a and b inputs,
+// and hence use the values selected by the color combiner setting.
+struct TevStageInputs
+{
+	Vec4<int> a, b, c, d;
+};
+
+// Resolve the combiner inputs of a tev stage from the given tev register
+// values (prev, c0, c1 and c2, in that order). Only register and constant
+// (one, half, zero) arguments are supported.
+TevStageInputs GetTevStageInputs(const Vec4<int> regs[4], const TevStageCombiner::ColorCombiner& cc, const TevStageCombiner::AlphaCombiner& ac);
+
+// Expected output of a tev stage (all modes, including compare mode)
+Vec4<int> TevStageExpectation(const TevStageInputs& inputs, const TevStageCombiner::ColorCombiner& cc, const TevStageCombiner::AlphaCombiner& ac);
+
+} // namespace
@@ -0,0 +1,269 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <string.h>
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "tev_simulator.h"
+
+namespace GXTest
+{
+
+// Values of the konst selections 0 to 7 (1, 7/8, 3/4, ..., 1/8)
+static const int konst_fractions[8] = { 255, 223, 191, 159, 128, 96, 64, 32 };
+
+TevSimulator::TevSimulator(const BPMemory& bp)
+{
+	num_stages = bp.genMode.numtevstages + 1;
+
+	memset(registers, 0, sizeof(registers));
+	memset(konst_registers, 0, sizeof(konst_registers));
+
+	// TevReg spans two 32 bit words, which are read individually to not
+	// depend on host endianness.
+	const u32* words = (const u32*)&bp;
+	for (int i = 0; i < 4; ++i)
+	{
+		TevReg reg;
+		reg.hex = words[BPMEM_TEV_REGISTER_L + 2 * i] | ((u64)words[BPMEM_TEV_REGISTER_H + 2 * i] << 32);
+		int* ra = reg.type_ra ? konst_registers[i] : registers[i];
+		int* bg = reg.type_bg ? konst_registers[i] : registers[i];
+		ra[0] = reg.red;
+		bg[1] = reg.green;
+		bg[2] = reg.blue;
+		ra[3] = reg.alpha;
+	}
+
+	for (int i = 0; i < num_stages; ++i)
+	{
+		Stage& stage = stages[i];
+		TwoTevStageOrders orders = bp.tevorders[i / 2];
+		const TevStageCombiner::ColorCombiner& cc = bp.combiners[i].colorC;
+		const TevStageCombiner::AlphaCombiner& ac = bp.combiners[i].alphaC;
+
+		for (int channel = 0; channel < 3; ++channel)
+			DecodeCombiner(stage.combiners[channel], channel, cc.a, cc.b, cc.c, cc.d, cc.bias, cc.op, cc.clamp, cc.shift, cc.dest, false);
+		DecodeCombiner(stage.combiners[3], 3, ac.a, ac.b, ac.c, ac.d, ac.bias, ac.op, ac.clamp, ac.shift, ac.dest, true);
+
+		stage.texmap = orders.getEnable(i & 1) ? orders.getTexMap(i & 1) : -1;
+
+		// Bump alpha (colorchan 5 and 6) is not supported, hence treated like zero
+		int colorchan = orders.getColorChan(i & 1);
+		stage.colorchan = (colorchan <= 1) ? colorchan : -1;
+
+		// Swap table n is made up of the swap fields of TevKSel 2n and 2n+1
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			const TevKSel& tex_ksel = bp.tevksel[ac.tswap * 2 + channel / 2];
+			const TevKSel& ras_ksel = bp.tevksel[ac.rswap * 2 + channel / 2];
+			stage.tex_swap[channel] = (channel & 1) ? tex_ksel.swap2 : tex_ksel.swap1;
+			stage.ras_swap[channel] = (channel & 1) ? ras_ksel.swap2 : ras_ksel.swap1;
+		}
+
+		TevKSel ksel = bp.tevksel[i / 2];
+		stage.kcsel = ksel.getKC(i & 1);
+		stage.kasel = ksel.getKA(i & 1);
+	}
+
+	UpdateKonst();
+}
+
+void TevSimulator::SetRegister(int index, const Vec4<int>& value)
+{
+	registers[index][0] = value.r;
+	registers[index][1] = value.g;
+	registers[index][2] = value.b;
+	registers[index][3] = value.a;
+}
+
+void TevSimulator::SetKonst(int index, const Vec4<int>& value)
+{
+	konst_registers[index][0] = value.r;
+	konst_registers[index][1] = value.g;
+	konst_registers[index][2] = value.b;
+	konst_registers[index][3] = value.a;
+	UpdateKonst();
+}
+
+// Value of the given konst selection for the given channel
+static int GetKonstValue(const int konst_registers[4][4], int sel, int channel)
+{
+	if (sel < 8)
+		return konst_fractions[sel];
+	else if (sel < 12)
+		return 0; // reserved
+	else if (sel < 16)
+		return konst_registers[sel - 12][channel]; // KCSEL_Kn, color only
+	else
+		return konst_registers[sel & 3][(sel - 16) / 4]; // single channel of Kn
+}
+
+void TevSimulator::UpdateKonst()
+{
+	for (int i = 0; i < num_stages; ++i)
+	{
+		Stage& stage = stages[i];
+		for (int channel = 0; channel < 3; ++channel)
+			stage.konst[channel] = GetKonstValue(konst_registers, stage.kcsel, channel);
+		stage.konst[3] = GetKonstValue(konst_registers, (stage.kasel >= 12 && stage.kasel < 16) ? 8 : stage.kasel, 3);
+	}
+}
+
+void TevSimulator::DecodeCombiner(Combiner& combiner, int channel, u32 a, u32 b, u32 c, u32 d, u32 bias, u32 op, u32 clamp, u32 shift, u32 dest, bool is_alpha)
+{
+	// Sources of the color and alpha combiner arguments, with the read
+	// channel (-1 for the channel being evaluated)
+	static const struct { u8 source; s8 channel; } color_args[16] = {
+		{ SOURCE_PREV, -1 }, { SOURCE_PREV, 3 }, { SOURCE_C0, -1 }, { SOURCE_C0, 3 },
+		{ SOURCE_C1, -1 }, { SOURCE_C1, 3 }, { SOURCE_C2, -1 }, { SOURCE_C2, 3 },
+		{ SOURCE_TEX, -1 }, { SOURCE_TEX, 3 }, { SOURCE_RAS, -1 }, { SOURCE_RAS, 3 },
+		{ SOURCE_ONE, -1 }, { SOURCE_HALF, -1 }, { SOURCE_KONST, -1 }, { SOURCE_ZERO, -1 },
+	};
+	static const u8 alpha_args[8] = {
+		SOURCE_PREV, SOURCE_C0, SOURCE_C1, SOURCE_C2, SOURCE_TEX, SOURCE_RAS, SOURCE_KONST, SOURCE_ZERO
+	};
+
+	const u32 args[4] = { a, b, c, d };
+	for (int i = 0; i < 4; ++i)
+	{
+		if (is_alpha)
+		{
+			combiner.source[i] = alpha_args[args[i]];
+			combiner.channel[i] = 3;
+		}
+		else
+		{
+			combiner.source[i] = color_args[args[i]].source;
+			combiner.channel[i] = (color_args[args[i]].channel < 0) ? channel : color_args[args[i]].channel;
+		}
+	}
+	combiner.dest = dest;
+
+	// See TevCombinerExpectation and TevCompareExpectation
+	combiner.compare = (bias == TevBias_COMPARE);
+	combiner.compare_mode = (shift << 1) | op;
+	combiner.lshift = (shift == 1) ? 1 : (shift == 2) ? 2 : 0;
+	combiner.rshift = (shift == 3) ? 1 : 0;
+	combiner.round_bias = (shift == 3) ? 0 : ((op == 1) ? 127 : 128);
+	combiner.negate = (op == 1) ? -1 : 0;
+	combiner.bias = ((bias == 2) ? -128 : (bias == 1) ? 128 : 0) * (1 << combiner.lshift);
+	combiner.min = clamp ? 0 : -1024;
+	combiner.max = clamp ? 255 : 1023;
+}
+
+inline int TevSimulator::EvaluateCombiner(const Combiner& combiner, int channel, const int a[4], const int b[4], int c, int d)
+{
+	int result;
+	if (combiner.compare)
+	{
+		// Number of compared 8 bit channels, starting with red
+		int num_channels = (combiner.compare_mode >> 1) + 1;
+		u32 value_a, value_b;
+		if (num_channels == 4)
+		{
+			value_a = a[channel] & 255;
+			value_b = b[channel] & 255;
+		}
+		else
+		{
+			u32 mask = (1 << (8 * num_channels)) - 1;
+			value_a = ((a[0] & 255) | ((a[1] & 255) << 8) | ((a[2] & 255) << 16)) & mask;
+			value_b = ((b[0] & 255) | ((b[1] & 255) << 8) | ((b[2] & 255) << 16)) & mask;
+		}
+		bool passed = (combiner.compare_mode & 1) ? (value_a == value_b) : (value_a > value_b);
+		result = d + (passed ? (c & 255) : 0);
+	}
+	else
+	{
+		int ai = a[channel] & 255;
+		int bi = b[channel] & 255;
+		int ci = c & 255;
+		ci += ci >> 7;
+		int lerp = (ai << 8) + (bi - ai) * ci; // a*(256-c) + b*c
+		lerp = ((lerp << combiner.lshift) + combiner.round_bias) >> 8;
+		lerp = (lerp ^ combiner.negate) - combiner.negate;
+		result = (d * (1 << combiner.lshift) + lerp + combiner.bias) >> combiner.rshift;
+	}
+	return (result < combiner.min) ? combiner.min : (result > combiner.max) ? combiner.max : result;
+}
+
+Vec4<int> TevSimulator::Evaluate(const TevPixelInputs& inputs) const
+{
+	int sources[NUM_SOURCES][4];
+	memcpy(sources[SOURCE_PREV], registers, sizeof(registers));
+	for (int channel = 0; channel < 4; ++channel)
+	{
+		sources[SOURCE_ONE][channel] = 255;
+		sources[SOURCE_HALF][channel] = 128;
+		sources[SOURCE_ZERO][channel] = 0;
+	}
+
+	for (int i = 0; i < num_stages; ++i)
+	{
+		const Stage& stage = stages[i];
+
+		if (stage.texmap >= 0)
+		{
+			const Vec4<int>& tex = inputs.texmaps[stage.texmap];
+			const int values[4] = { tex.r, tex.g, tex.b, tex.a };
+			for (int channel = 0; channel < 4; ++channel)
+				sources[SOURCE_TEX][channel] = values[stage.tex_swap[channel]];
+		}
+		else
+		{
+			for (int channel = 0; channel < 4; ++channel)
+				sources[SOURCE_TEX][channel] = 255;
+		}
+
+		if (stage.colorchan >= 0)
+		{
+			const Vec4<int>& ras = inputs.colors[stage.colorchan];
+			const int values[4] = { ras.r, ras.g, ras.b, ras.a };
+			for (int channel = 0; channel < 4; ++channel)
+				sources[SOURCE_RAS][channel] = values[stage.ras_swap[channel]];
+		}
+		else
+		{
+			for (int channel = 0; channel < 4; ++channel)
+				sources[SOURCE_RAS][channel] = 0;
+		}
+
+		memcpy(sources[SOURCE_KONST], stage.konst, sizeof(stage.konst));
+
+		// All inputs are fetched before any output is written
+		int a[4], b[4], c[4], d[4];
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			const Combiner& combiner = stage.combiners[channel];
+			a[channel] = sources[combiner.source[0]][combiner.channel[0]];
+			b[channel] = sources[combiner.source[1]][combiner.channel[1]];
+			c[channel] = sources[combiner.source[2]][combiner.channel[2]];
+			d[channel] = sources[combiner.source[3]][combiner.channel[3]];
+		}
+
+		int out[4];
+		for (int channel = 0; channel < 4; ++channel)
+			out[channel] = EvaluateCombiner(stage.combiners[channel], channel, a, b, c[channel], d[channel]);
+		for (int channel = 0; channel < 4; ++channel)
+			sources[SOURCE_PREV + stage.combiners[channel].dest][channel] = out[channel];
+	}
+
+	const Stage& last_stage = stages[num_stages - 1];
+	Vec4<int> ret;
+	ret.r = sources[SOURCE_PREV + last_stage.combiners[0].dest][0];
+	ret.g = sources[SOURCE_PREV + last_stage.combiners[1].dest][1];
+	ret.b = sources[SOURCE_PREV + last_stage.combiners[2].dest][2];
+	ret.a = sources[SOURCE_PREV + last_stage.combiners[3].dest][3];
+	return ret;
+}
+
+void TevSimulator::EvaluateBatch(const TevPixelInputs* inputs, int count, Vec4<int>* results) const
+{
+	for (int i = 0; i < count; ++i)
+		results[i] = Evaluate(inputs[i]);
+}
+
+} // namespace
@@ -0,0 +1,108 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Software implementation of the whole tev pipeline
+// Evaluates up to 16 tev stages as configured by a snapshot of BP memory,
+// for predicting the output of multi-stage setups. Per-stage results match
+// the reference model in tev_model.h, but the stage configuration is decoded
+// up front so that evaluating a pixel is cheap.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Per-pixel inputs of the tev pipeline, 8 bits per channel
+struct TevPixelInputs
+{
+	Vec4<int> texmaps[8]; // Texture color sampled from each texture map
+	Vec4<int> colors[2];  // Rasterized color channels (COLOR0A0, COLOR1A1)
+};
+
+class TevSimulator
+{
+public:
+	// Takes the number of tev stages, tev orders, combiners, konst selection
+	// and swap tables from the given BP memory contents. Registers 0xE0+2*i
+	// (red/alpha) and 0xE1+2*i (blue/green) initialize the channels of tev
+	// register i or konst register i, depending on their type bits. All other
+	// registers start out as zero.
+	explicit TevSimulator(const BPMemory& bp);
+
+	int GetNumStages() const { return num_stages; }
+
+	// index is one of GX_TEVPREV, GX_TEVREG0, GX_TEVREG1 and GX_TEVREG2
+	void SetRegister(int index, const Vec4<int>& value);
+	void SetKonst(int index, const Vec4<int>& value);
+
+	// Returns the 11 bit output of the last tev stage, i.e. the contents of
+	// its color and alpha destination registers. The lower 8 bits of each
+	// channel make up the final pixel color.
+	Vec4<int> Evaluate(const TevPixelInputs& inputs) const;
+	void EvaluateBatch(const TevPixelInputs* inputs, int count, Vec4<int>* results) const;
+
+private:
+	// Sources of stage inputs. Each source has four channels.
+	enum
+	{
+		SOURCE_PREV,
+		SOURCE_C0,
+		SOURCE_C1,
+		SOURCE_C2,
+		SOURCE_TEX,
+		SOURCE_RAS,
+		SOURCE_KONST, // konst color in r, g and b, konst alpha in a
+		SOURCE_ONE,
+		SOURCE_HALF,
+		SOURCE_ZERO,
+
+		NUM_SOURCES
+	};
+
+	// Decoded combiner setting for one channel
+	struct Combiner
+	{
+		u8 source[4]; // a, b, c, d
+		u8 channel[4]; // channel of the source to read from
+		u8 dest;
+
+		bool compare;
+		int compare_mode;
+
+		int lshift;
+		int rshift;
+		int round_bias;
+		int negate; // all bits set for subtraction
+		int bias;
+		int min;
+		int max;
+	};
+
+	struct Stage
+	{
+		Combiner combiners[4]; // r, g, b, a
+
+		int texmap; // -1 if disabled
+		int colorchan; // -1 if zero
+		u8 tex_swap[4];
+		u8 ras_swap[4];
+
+		u8 kcsel;
+		u8 kasel;
+		int konst[4];
+	};
+
+	void UpdateKonst();
+	static void DecodeCombiner(Combiner& combiner, int channel, u32 a, u32 b, u32 c, u32 d, u32 bias, u32 op, u32 clamp, u32 shift, u32 dest, bool is_alpha);
+	static int EvaluateCombiner(const Combiner& combiner, int channel, const int a[4], const int b[4], int c, int d);
+
+	int num_stages;
+	Stage stages[16];
+	int registers[4][4];
+	int konst_registers[4][4];
+};
+
+} // namespace
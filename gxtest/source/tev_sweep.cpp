@@ -0,0 +1,87 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <stdio.h>
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "counter_rng.h"
+#include "tev_model.h"
+#include "tev_sweep.h"
+
+namespace GXTest
+{
+
+void GetTevSweepSample(u32 seed, u32 index, TevSweepSample* sample)
+{
+	CounterRandom random(seed, index);
+
+	// First stage, output goes to PREV
+	TevStageCombiner::ColorCombiner cc;
+	cc.hex = BPMEM_TEV_COLOR_ENV << 24;
+	cc.dest = GX_TEVPREV;
+	cc.a = TEVCOLORARG_C0;
+	cc.b = TEVCOLORARG_C1;
+	cc.c = TEVCOLORARG_C2;
+	cc.d = TEVCOLORARG_ZERO; // TEVCOLORARG_CPREV; // NOTE: TEVCOLORARG_CPREV doesn't actually seem to fetch its data from PREV when used in the first stage?
+	cc.shift = random.NextBelow(4);
+	cc.bias = random.NextBelow(3);
+	cc.op = random.NextBelow(2);
+	cc.clamp = random.NextBelow(2);
+	sample->cc = cc;
+
+	TevStageCombiner::AlphaCombiner ac;
+	ac.hex = BPMEM_TEV_ALPHA_ENV << 24;
+	ac.dest = GX_TEVPREV;
+	ac.a = TEVALPHAARG_A0;
+	ac.b = TEVALPHAARG_A1;
+	ac.c = TEVALPHAARG_A2;
+	ac.d = TEVALPHAARG_ZERO;
+	ac.shift = random.NextBelow(4);
+	ac.bias = random.NextBelow(3);
+	ac.op = random.NextBelow(2);
+	ac.clamp = random.NextBelow(2);
+	sample->ac = ac;
+
+	for (auto& lane : sample->lanes)
+	{
+		lane.a = random.NextInRange(-1024, 1023);
+		lane.b = random.NextInRange(-1024, 1023);
+		lane.c = random.NextInRange(-1024, 1023);
+		lane.d = 0;
+	}
+}
+
+Vec4<int> GetTevSweepExpectation(const TevSweepSample& sample)
+{
+	const TevStageCombiner::ColorCombiner& cc = sample.cc;
+	const TevStageCombiner::AlphaCombiner& ac = sample.ac;
+	const TevLaneInputs* lanes = sample.lanes;
+	Vec4<int> ret;
+	ret.r = TevCombinerExpectation(lanes[0].a, lanes[0].b, lanes[0].c, lanes[0].d, cc.shift, cc.bias, cc.op, cc.clamp);
+	ret.g = TevCombinerExpectation(lanes[1].a, lanes[1].b, lanes[1].c, lanes[1].d, cc.shift, cc.bias, cc.op, cc.clamp);
+	ret.b = TevCombinerExpectation(lanes[2].a, lanes[2].b, lanes[2].c, lanes[2].d, cc.shift, cc.bias, cc.op, cc.clamp);
+	ret.a = TevCombinerExpectation(lanes[3].a, lanes[3].b, lanes[3].c, lanes[3].d, ac.shift, ac.bias, ac.op, ac.clamp);
+	return ret;
+}
+
+void FormatTevSweepSample(const TevSweepSample& sample, char* text, u32 size)
+{
+	u32 length = 0;
+	text[0] = 0;
+	for (int lane = 0; lane < 4 && length < size; ++lane)
+	{
+		const TevLaneInputs& in = sample.lanes[lane];
+		u32 shift = (lane == 3) ? sample.ac.shift : sample.cc.shift;
+		u32 bias = (lane == 3) ? sample.ac.bias : sample.cc.bias;
+		u32 op = (lane == 3) ? sample.ac.op : sample.cc.op;
+		u32 clamp = (lane == 3) ? sample.ac.clamp : sample.cc.clamp;
+		int count = snprintf(text + length, size - length, "%slane %d: a=%d, b=%d, c=%d, d=%d, shift=%d, bias=%d, op=%d, clamp=%d",
+		                     lane ? "; " : "", lane, in.a, in.b, in.c, in.d, shift, bias, op, clamp);
+		length += (count > 0) ? count : 0;
+	}
+}
+
+} // namespace
@@ -0,0 +1,38 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Random sweep over tev combiner settings and inputs
+// Each sample is derived from the seed of the sweep and its own index only
+// (see counter_rng.h), so that failing samples can be regenerated without
+// rerunning the sweep, e.g. by the receiver of the sweep results (see
+// network_sweep_results), and so that sweeps can be split across consoles.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+#define TEV_SWEEP_NAME "tev_combiner"
+
+// Four sets of inputs and the combiner settings they are evaluated with,
+// see PackTevLanes. The combiners use c0, c1 and c2 as their a, b and c
+// inputs, d is zero.
+struct TevSweepSample
+{
+	TevStageCombiner::ColorCombiner cc;
+	TevStageCombiner::AlphaCombiner ac;
+	TevLaneInputs lanes[4];
+};
+
+void GetTevSweepSample(u32 seed, u32 index, TevSweepSample* sample);
+
+// Expected output of a sample, per lane, see TevCombinerExpectation
+Vec4<int> GetTevSweepExpectation(const TevSweepSample& sample);
+
+// Lists the (a, b, c, d, shift, bias, op, clamp) tuple of each lane
+void FormatTevSweepSample(const TevSweepSample& sample, char* text, u32 size);
+
+} // namespace
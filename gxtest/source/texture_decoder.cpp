@@ -0,0 +1,541 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include <assert.h>
+#include <string.h>
+#include <gccore.h>
+
+#include "cgx.h"
+#include "gxtest_util.h"
+#include "texture_decoder.h"
+
+#if defined(GXTEST_HOST) && defined(__SSE2__)
+#define DECODE_TEXTURE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(GXTEST_HOST) && defined(__ARM_NEON) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define DECODE_TEXTURE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace GXTest
+{
+
+// Decodes the pixels of the given block within [0, width) x [0, height)
+static void DecodeRGBA8BlockClipped(const u8* block, int block_x, int block_y, int width, int height, Vec4<u8>* pixels)
+{
+	for (int y = 0; y < 4 && block_y * 4 + y < height; ++y)
+	{
+		for (int x = 0; x < 4 && block_x * 4 + x < width; ++x)
+		{
+			int i = y * 4 + x;
+			Vec4<u8>& pixel = pixels[(block_y * 4 + y) * width + block_x * 4 + x];
+			pixel.r = block[2 * i + 1];
+			pixel.g = block[32 + 2 * i];
+			pixel.b = block[32 + 2 * i + 1];
+			pixel.a = block[2 * i];
+		}
+	}
+}
+
+// Plain version, which is also used on the console.
+// Paired singles don't help here, since decoding only shuffles bytes around.
+// Instead, each block row is unrolled, so that the compiler can schedule the
+// loads of the AR and GB halves of all four pixels back to back.
+static void DecodeRGBA8Row(const u8* block, Vec4<u8>* out)
+{
+	const u8* ar = block;
+	const u8* gb = block + 32;
+	u8 a0 = ar[0], r0 = ar[1], a1 = ar[2], r1 = ar[3], a2 = ar[4], r2 = ar[5], a3 = ar[6], r3 = ar[7];
+	u8 g0 = gb[0], b0 = gb[1], g1 = gb[2], b1 = gb[3], g2 = gb[4], b2 = gb[5], g3 = gb[6], b3 = gb[7];
+	out[0].r = r0; out[0].g = g0; out[0].b = b0; out[0].a = a0;
+	out[1].r = r1; out[1].g = g1; out[1].b = b1; out[1].a = a1;
+	out[2].r = r2; out[2].g = g2; out[2].b = b2; out[2].a = a2;
+	out[3].r = r3; out[3].g = g3; out[3].b = b3; out[3].a = a3;
+}
+
+static void DecodeRGBA8BlockGeneric(const u8* block, Vec4<u8>* out, int width)
+{
+	for (int y = 0; y < 4; ++y)
+		DecodeRGBA8Row(block + 8 * y, out + y * width);
+}
+
+#ifdef DECODE_TEXTURE_SSE2
+// Interleaving the 16 bit AR and GB pairs yields one ARGB dword per pixel
+// (in memory order), which is rotated by one byte to get RGBA.
+static inline __m128i ARGBToRGBA(__m128i argb)
+{
+	return _mm_or_si128(_mm_srli_epi32(argb, 8), _mm_slli_epi32(argb, 24));
+}
+
+static void DecodeRGBA8BlockSSE2(const u8* block, Vec4<u8>* out, int width)
+{
+	__m128i ar01 = _mm_load_si128((const __m128i*)block);
+	__m128i ar23 = _mm_load_si128((const __m128i*)(block + 16));
+	__m128i gb01 = _mm_load_si128((const __m128i*)(block + 32));
+	__m128i gb23 = _mm_load_si128((const __m128i*)(block + 48));
+	_mm_storeu_si128((__m128i*)out, ARGBToRGBA(_mm_unpacklo_epi16(ar01, gb01)));
+	_mm_storeu_si128((__m128i*)(out + width), ARGBToRGBA(_mm_unpackhi_epi16(ar01, gb01)));
+	_mm_storeu_si128((__m128i*)(out + 2 * width), ARGBToRGBA(_mm_unpacklo_epi16(ar23, gb23)));
+	_mm_storeu_si128((__m128i*)(out + 3 * width), ARGBToRGBA(_mm_unpackhi_epi16(ar23, gb23)));
+}
+#endif
+
+#ifdef DECODE_TEXTURE_NEON
+// Same approach as the SSE2 version
+static inline uint8x16_t ARGBToRGBA(uint16x8_t argb)
+{
+	uint32x4_t value = vreinterpretq_u32_u16(argb);
+	return vreinterpretq_u8_u32(vorrq_u32(vshrq_n_u32(value, 8), vshlq_n_u32(value, 24)));
+}
+
+static void DecodeRGBA8BlockNEON(const u8* block, Vec4<u8>* out, int width)
+{
+	uint16x8x2_t rows01 = vzipq_u16(vld1q_u16((const u16*)block), vld1q_u16((const u16*)(block + 32)));
+	uint16x8x2_t rows23 = vzipq_u16(vld1q_u16((const u16*)(block + 16)), vld1q_u16((const u16*)(block + 48)));
+	vst1q_u8((u8*)out, ARGBToRGBA(rows01.val[0]));
+	vst1q_u8((u8*)(out + width), ARGBToRGBA(rows01.val[1]));
+	vst1q_u8((u8*)(out + 2 * width), ARGBToRGBA(rows23.val[0]));
+	vst1q_u8((u8*)(out + 3 * width), ARGBToRGBA(rows23.val[1]));
+}
+#endif
+
+// Detilers for the formats with 4, 8 and 16 bits per texel
+// Each of them converts a row of num_blocks blocks to block_height lines of
+// stride texels. 16 bit texels are converted to host endianness.
+static void Detile4Generic(const u8* blocks, int num_blocks, u8* out, int stride)
+{
+	// 8x8 texels per block, the first texel of each pair in the upper nibble
+	for (int block = 0; block < num_blocks; ++block, blocks += 32)
+	{
+		for (int y = 0; y < 8; ++y)
+		{
+			u8* line = out + y * stride + block * 8;
+			for (int x = 0; x < 4; ++x)
+			{
+				line[2 * x] = blocks[4 * y + x] >> 4;
+				line[2 * x + 1] = blocks[4 * y + x] & 0xF;
+			}
+		}
+	}
+}
+
+static void Detile8Generic(const u8* blocks, int num_blocks, u8* out, int stride)
+{
+	// 8x4 texels per block
+	for (int block = 0; block < num_blocks; ++block, blocks += 32)
+		for (int y = 0; y < 4; ++y)
+			memcpy(out + y * stride + block * 8, blocks + 8 * y, 8);
+}
+
+static void Detile16Generic(const u8* blocks, int num_blocks, u16* out, int stride)
+{
+	// 4x4 texels per block
+	for (int block = 0; block < num_blocks; ++block, blocks += 32)
+		for (int y = 0; y < 4; ++y)
+			for (int x = 0; x < 4; ++x)
+				out[y * stride + block * 4 + x] = (blocks[8 * y + 2 * x] << 8) | blocks[8 * y + 2 * x + 1];
+}
+
+#ifdef DECODE_TEXTURE_SSE2
+// Blocks are processed in pairs: Each block line is 8 bytes, so the lines of
+// two neighboring blocks combine to 16 contiguous bytes of output.
+static void Detile8SSE2(const u8* blocks, int num_blocks, u8* out, int stride)
+{
+	int block = 0;
+	for (; block + 2 <= num_blocks; block += 2, blocks += 64)
+	{
+		__m128i a01 = _mm_load_si128((const __m128i*)blocks);
+		__m128i a23 = _mm_load_si128((const __m128i*)(blocks + 16));
+		__m128i b01 = _mm_load_si128((const __m128i*)(blocks + 32));
+		__m128i b23 = _mm_load_si128((const __m128i*)(blocks + 48));
+		u8* line = out + block * 8;
+		_mm_storeu_si128((__m128i*)line, _mm_unpacklo_epi64(a01, b01));
+		_mm_storeu_si128((__m128i*)(line + stride), _mm_unpackhi_epi64(a01, b01));
+		_mm_storeu_si128((__m128i*)(line + 2 * stride), _mm_unpacklo_epi64(a23, b23));
+		_mm_storeu_si128((__m128i*)(line + 3 * stride), _mm_unpackhi_epi64(a23, b23));
+	}
+	Detile8Generic(blocks, num_blocks - block, out + block * 8, stride);
+}
+
+static inline __m128i ByteSwap16(__m128i value)
+{
+	return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+
+static void Detile16SSE2(const u8* blocks, int num_blocks, u16* out, int stride)
+{
+	int block = 0;
+	for (; block + 2 <= num_blocks; block += 2, blocks += 64)
+	{
+		__m128i a01 = ByteSwap16(_mm_load_si128((const __m128i*)blocks));
+		__m128i a23 = ByteSwap16(_mm_load_si128((const __m128i*)(blocks + 16)));
+		__m128i b01 = ByteSwap16(_mm_load_si128((const __m128i*)(blocks + 32)));
+		__m128i b23 = ByteSwap16(_mm_load_si128((const __m128i*)(blocks + 48)));
+		u16* line = out + block * 4;
+		_mm_storeu_si128((__m128i*)line, _mm_unpacklo_epi64(a01, b01));
+		_mm_storeu_si128((__m128i*)(line + stride), _mm_unpackhi_epi64(a01, b01));
+		_mm_storeu_si128((__m128i*)(line + 2 * stride), _mm_unpacklo_epi64(a23, b23));
+		_mm_storeu_si128((__m128i*)(line + 3 * stride), _mm_unpackhi_epi64(a23, b23));
+	}
+	Detile16Generic(blocks, num_blocks - block, out + block * 4, stride);
+}
+#endif
+
+#ifdef DECODE_TEXTURE_NEON
+// Same approach as the SSE2 versions
+static void Detile8NEON(const u8* blocks, int num_blocks, u8* out, int stride)
+{
+	int block = 0;
+	for (; block + 2 <= num_blocks; block += 2, blocks += 64)
+	{
+		uint8x16_t a01 = vld1q_u8(blocks);
+		uint8x16_t a23 = vld1q_u8(blocks + 16);
+		uint8x16_t b01 = vld1q_u8(blocks + 32);
+		uint8x16_t b23 = vld1q_u8(blocks + 48);
+		u8* line = out + block * 8;
+		vst1q_u8(line, vcombine_u8(vget_low_u8(a01), vget_low_u8(b01)));
+		vst1q_u8(line + stride, vcombine_u8(vget_high_u8(a01), vget_high_u8(b01)));
+		vst1q_u8(line + 2 * stride, vcombine_u8(vget_low_u8(a23), vget_low_u8(b23)));
+		vst1q_u8(line + 3 * stride, vcombine_u8(vget_high_u8(a23), vget_high_u8(b23)));
+	}
+	Detile8Generic(blocks, num_blocks - block, out + block * 8, stride);
+}
+
+static void Detile16NEON(const u8* blocks, int num_blocks, u16* out, int stride)
+{
+	int block = 0;
+	for (; block + 2 <= num_blocks; block += 2, blocks += 64)
+	{
+		uint8x16_t a01 = vrev16q_u8(vld1q_u8(blocks));
+		uint8x16_t a23 = vrev16q_u8(vld1q_u8(blocks + 16));
+		uint8x16_t b01 = vrev16q_u8(vld1q_u8(blocks + 32));
+		uint8x16_t b23 = vrev16q_u8(vld1q_u8(blocks + 48));
+		u8* line = (u8*)(out + block * 4);
+		vst1q_u8(line, vcombine_u8(vget_low_u8(a01), vget_low_u8(b01)));
+		vst1q_u8(line + 2 * stride, vcombine_u8(vget_high_u8(a01), vget_high_u8(b01)));
+		vst1q_u8(line + 4 * stride, vcombine_u8(vget_low_u8(a23), vget_low_u8(b23)));
+		vst1q_u8(line + 6 * stride, vcombine_u8(vget_high_u8(a23), vget_high_u8(b23)));
+	}
+	Detile16Generic(blocks, num_blocks - block, out + block * 4, stride);
+}
+#endif
+
+// Calls expand(texel, index) for each texel of an image with 4, 8 or 16 bits
+// per texel, index being the position in row-major order. Each row of blocks
+// is detiled to a scratch buffer first.
+template<typename Expand>
+static void DecodeTiledImage(TextureDecoderImpl impl, int bits, const void* data, int width, int height, Expand expand)
+{
+	static u8 scratch8[8 * 1024];
+	static u16 scratch16[4 * 1024];
+	assert(width <= 1024);
+
+	void (*detile8)(const u8* blocks, int num_blocks, u8* out, int stride) = (bits == 4) ? Detile4Generic : Detile8Generic;
+	void (*detile16)(const u8* blocks, int num_blocks, u16* out, int stride) = Detile16Generic;
+#ifdef DECODE_TEXTURE_SSE2
+	if (impl == TEXTURE_DECODER_SSE2 && bits == 8)
+		detile8 = Detile8SSE2;
+	if (impl == TEXTURE_DECODER_SSE2)
+		detile16 = Detile16SSE2;
+#endif
+#ifdef DECODE_TEXTURE_NEON
+	if (impl == TEXTURE_DECODER_NEON && bits == 8)
+		detile8 = Detile8NEON;
+	if (impl == TEXTURE_DECODER_NEON)
+		detile16 = Detile16NEON;
+#endif
+
+	int block_width = (bits <= 8) ? 8 : 4;
+	int block_height = (bits == 4) ? 8 : 4;
+	int width_blocks = (width + block_width - 1) / block_width;
+	int stride = width_blocks * block_width;
+
+	const u8* blocks = (const u8*)data;
+	for (int top = 0; top < height; top += block_height, blocks += width_blocks * 32)
+	{
+		if (bits == 16)
+			detile16(blocks, width_blocks, scratch16, stride);
+		else
+			detile8(blocks, width_blocks, scratch8, stride);
+
+		for (int y = top; y < top + block_height && y < height; ++y)
+		{
+			if (bits == 16)
+			{
+				const u16* line = scratch16 + (y - top) * stride;
+				for (int x = 0; x < width; ++x)
+					expand(line[x], y * width + x);
+			}
+			else
+			{
+				const u8* line = scratch8 + (y - top) * stride;
+				for (int x = 0; x < width; ++x)
+					expand(line[x], y * width + x);
+			}
+		}
+	}
+}
+
+// Raw value of a texel of an image with 4, 8 or 16 bits per texel
+static u32 ReadTexel(int bits, const void* data, int x, int y, int width)
+{
+	int block_width = (bits <= 8) ? 8 : 4;
+	int block_height = (bits == 4) ? 8 : 4;
+	int width_blocks = (width + block_width - 1) / block_width;
+	const u8* block = (const u8*)data + ((y / block_height) * width_blocks + x / block_width) * 32;
+	int index = (y % block_height) * block_width + x % block_width;
+
+	if (bits == 4)
+		return (index & 1) ? (block[index / 2] & 0xF) : (block[index / 2] >> 4);
+	else if (bits == 8)
+		return block[index];
+	else
+		return (block[2 * index] << 8) | block[2 * index + 1];
+}
+
+static inline u8 Expand3(u32 value) { return (value << 5) | (value << 2) | (value >> 1); }
+static inline u8 Expand4(u32 value) { return (value << 4) | value; }
+static inline u8 Expand5(u32 value) { return (value << 3) | (value >> 2); }
+static inline u8 Expand6(u32 value) { return (value << 2) | (value >> 4); }
+
+static inline Vec4<u8> MakePixel(u8 r, u8 g, u8 b, u8 a)
+{
+	Vec4<u8> ret;
+	ret.r = r;
+	ret.g = g;
+	ret.b = b;
+	ret.a = a;
+	return ret;
+}
+
+// Converts the raw value of a texel in the given color format (except RGBA8)
+static Vec4<u8> ExpandTexel(u8 format, u32 value)
+{
+	switch (format)
+	{
+	case GX_TF_I4:
+		return MakePixel(Expand4(value), Expand4(value), Expand4(value), 0);
+	case GX_TF_I8:
+		return MakePixel(value, value, value, 0);
+	case GX_TF_IA4:
+		return MakePixel(Expand4(value & 0xF), Expand4(value & 0xF), Expand4(value & 0xF), Expand4(value >> 4));
+	case GX_TF_IA8:
+		return MakePixel(value & 0xFF, value & 0xFF, value & 0xFF, value >> 8);
+	case GX_TF_RGB565:
+		return MakePixel(Expand5(value >> 11), Expand6((value >> 5) & 0x3F), Expand5(value & 0x1F), 0);
+	case GX_TF_RGB5A3:
+		if (value & 0x8000)
+			return MakePixel(Expand5((value >> 10) & 0x1F), Expand5((value >> 5) & 0x1F), Expand5(value & 0x1F), 255);
+		else
+			return MakePixel(Expand4((value >> 8) & 0xF), Expand4((value >> 4) & 0xF), Expand4(value & 0xF), Expand3((value >> 12) & 0x7));
+	case GX_CTF_R4:
+		return MakePixel(Expand4(value), 0, 0, 0);
+	case GX_CTF_RA4:
+		return MakePixel(Expand4(value & 0xF), 0, 0, Expand4(value >> 4));
+	case GX_CTF_RA8:
+		return MakePixel(value & 0xFF, 0, 0, value >> 8);
+	case GX_CTF_A8:
+		return MakePixel(0, 0, 0, value);
+	case GX_CTF_R8:
+		return MakePixel(value, 0, 0, 0);
+	case GX_CTF_G8:
+		return MakePixel(0, value, 0, 0);
+	case GX_CTF_B8:
+		return MakePixel(0, 0, value, 0);
+	case GX_CTF_RG8:
+		return MakePixel(value & 0xFF, value >> 8, 0, 0);
+	case GX_CTF_GB8:
+		return MakePixel(0, value & 0xFF, value >> 8, 0);
+	default:
+		assert(0);
+		return MakePixel(0, 0, 0, 0);
+	}
+}
+
+// Converts the raw value of a texel in the given depth format (except Z24X8)
+static inline u32 ExpandDepth(u8 format, u32 value)
+{
+	switch (format)
+	{
+	case GX_CTF_Z4:
+		return value << 20;
+	case GX_TF_Z8:
+		return value << 16;
+	case GX_CTF_Z8M:
+	case GX_TF_Z16:
+		return value << 8;
+	case GX_CTF_Z8L:
+	case GX_CTF_Z16L:
+		return value;
+	default:
+		assert(0);
+		return 0;
+	}
+}
+
+bool IsTextureDecoderImplSupported(TextureDecoderImpl impl)
+{
+	switch (impl)
+	{
+	case TEXTURE_DECODER_GENERIC:
+		return true;
+#ifdef DECODE_TEXTURE_SSE2
+	case TEXTURE_DECODER_SSE2:
+		return true;
+#endif
+#ifdef DECODE_TEXTURE_NEON
+	case TEXTURE_DECODER_NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* GetTextureDecoderImplName(TextureDecoderImpl impl)
+{
+	static const char* names[NUM_TEXTURE_DECODER_IMPLS] = { "generic", "SSE2", "NEON" };
+	return names[impl];
+}
+
+static TextureDecoderImpl GetBestTextureDecoderImpl()
+{
+	static int best_impl = -1;
+	if (best_impl == -1)
+	{
+		best_impl = NUM_TEXTURE_DECODER_IMPLS - 1;
+		while (!IsTextureDecoderImplSupported((TextureDecoderImpl)best_impl))
+			--best_impl;
+	}
+	return (TextureDecoderImpl)best_impl;
+}
+
+void DecodeRGBA8Image(const void* data, int width, int height, Vec4<u8>* pixels)
+{
+	DecodeRGBA8Image(GetBestTextureDecoderImpl(), data, width, height, pixels);
+}
+
+void DecodeRGBA8Image(TextureDecoderImpl impl, const void* data, int width, int height, Vec4<u8>* pixels)
+{
+	assert(IsTextureDecoderImplSupported(impl));
+	assert(((uintptr_t)data & 31) == 0);
+
+	void (*decode_block)(const u8* block, Vec4<u8>* out, int width) = DecodeRGBA8BlockGeneric;
+#ifdef DECODE_TEXTURE_SSE2
+	if (impl == TEXTURE_DECODER_SSE2)
+		decode_block = DecodeRGBA8BlockSSE2;
+#endif
+#ifdef DECODE_TEXTURE_NEON
+	if (impl == TEXTURE_DECODER_NEON)
+		decode_block = DecodeRGBA8BlockNEON;
+#endif
+
+	// Blocks which are cut off by the image borders are left to the clipped
+	// version, all others are written as a whole.
+	const u8* block = (const u8*)data;
+	int width_blocks = (width + 3) >> 2;
+	int height_blocks = (height + 3) >> 2;
+	int full_width_blocks = width >> 2;
+	int full_height_blocks = height >> 2;
+	for (int block_y = 0; block_y < height_blocks; ++block_y)
+	{
+		for (int block_x = 0; block_x < width_blocks; ++block_x, block += 64)
+		{
+			if (block_x < full_width_blocks && block_y < full_height_blocks)
+				decode_block(block, pixels + block_y * 4 * width + block_x * 4, width);
+			else
+				DecodeRGBA8BlockClipped(block, block_x, block_y, width, height, pixels);
+		}
+	}
+}
+
+bool IsDepthCopyFormat(u8 format)
+{
+	return (format & 0x10) != 0;
+}
+
+Vec4<u8> DecodeCopyPixel(u8 format, const void* data, int x, int y, int width)
+{
+	assert(!IsDepthCopyFormat(format));
+
+	int bits = CGX_GetTexelBits(format);
+	if (bits == 32)
+		return DecodeRGBA8Pixel(data, x, y, width);
+	return ExpandTexel(format, ReadTexel(bits, data, x, y, width));
+}
+
+void DecodeCopyImage(u8 format, const void* data, int width, int height, Vec4<u8>* pixels)
+{
+	DecodeCopyImage(GetBestTextureDecoderImpl(), format, data, width, height, pixels);
+}
+
+void DecodeCopyImage(TextureDecoderImpl impl, u8 format, const void* data, int width, int height, Vec4<u8>* pixels)
+{
+	assert(IsTextureDecoderImplSupported(impl));
+	assert(((uintptr_t)data & 31) == 0);
+	assert(!IsDepthCopyFormat(format));
+
+	int bits = CGX_GetTexelBits(format);
+	if (bits == 32)
+	{
+		DecodeRGBA8Image(impl, data, width, height, pixels);
+	}
+	else if (bits == 16)
+	{
+		DecodeTiledImage(impl, bits, data, width, height, [=](u32 texel, int index) { pixels[index] = ExpandTexel(format, texel); });
+	}
+	else
+	{
+		// Few enough values to look all of them up
+		Vec4<u8> table[256];
+		for (int texel = 0; texel < (1 << bits); ++texel)
+			table[texel] = ExpandTexel(format, texel);
+		DecodeTiledImage(impl, bits, data, width, height, [=, &table](u32 texel, int index) { pixels[index] = table[texel]; });
+	}
+}
+
+u32 DecodeDepthPixel(u8 format, const void* data, int x, int y, int width)
+{
+	assert(IsDepthCopyFormat(format));
+
+	int bits = CGX_GetTexelBits(format);
+	if (bits == 32)
+	{
+		// Stored like RGBA8, with the most significant byte in R
+		Vec4<u8> pixel = DecodeRGBA8Pixel(data, x, y, width);
+		return (pixel.r << 16) | (pixel.g << 8) | pixel.b;
+	}
+	return ExpandDepth(format, ReadTexel(bits, data, x, y, width));
+}
+
+void DecodeDepthImage(u8 format, const void* data, int width, int height, u32* depth)
+{
+	DecodeDepthImage(GetBestTextureDecoderImpl(), format, data, width, height, depth);
+}
+
+void DecodeDepthImage(TextureDecoderImpl impl, u8 format, const void* data, int width, int height, u32* depth)
+{
+	assert(IsTextureDecoderImplSupported(impl));
+	assert(((uintptr_t)data & 31) == 0);
+	assert(IsDepthCopyFormat(format));
+
+	int bits = CGX_GetTexelBits(format);
+	if (bits == 32)
+	{
+		// Decode in place, both pixel types are 4 bytes large
+		Vec4<u8>* pixels = (Vec4<u8>*)depth;
+		DecodeRGBA8Image(impl, data, width, height, pixels);
+		for (int i = 0; i < width * height; ++i)
+			depth[i] = (pixels[i].r << 16) | (pixels[i].g << 8) | pixels[i].b;
+	}
+	else
+	{
+		// All formats just shift the stored bits into place
+		u32 scale = ExpandDepth(format, 1);
+		DecodeTiledImage(impl, bits, data, width, height, [=](u32 texel, int index) { depth[index] = texel * scale; });
+	}
+}
+
+} // namespace
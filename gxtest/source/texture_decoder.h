@@ -0,0 +1,65 @@
+// Copyright 2013 Dolphin Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+// Decoders for whole EFB copies
+// Converts GX tiled textures to linear images in one pass, for tests which
+// read back many pixels of a copy. Single pixels are better read with
+// DecodeRGBA8Pixel or DecodeCopyPixel.
+
+#pragma once
+
+#include "CommonTypes.h"
+
+namespace GXTest
+{
+
+// Implementations of DecodeRGBA8Image, DecodeCopyImage and DecodeDepthImage.
+// All of them produce identical results. The vectorized ones are only
+// available in the host build and depend on the host architecture.
+enum TextureDecoderImpl
+{
+	TEXTURE_DECODER_GENERIC,
+	TEXTURE_DECODER_SSE2,
+	TEXTURE_DECODER_NEON,
+
+	NUM_TEXTURE_DECODER_IMPLS
+};
+
+bool IsTextureDecoderImplSupported(TextureDecoderImpl impl);
+const char* GetTextureDecoderImplName(TextureDecoderImpl impl);
+
+// Decode an RGBA8 texture of the given dimensions (e.g. a CopyToTestBuffer
+// copy), which consists of 4x4 pixel blocks of 64 bytes: 16 AR pairs followed
+// by 16 GB pairs. data must be 32 byte aligned, like any EFB copy destination.
+// pixels receives width*height values in row-major order.
+void DecodeRGBA8Image(const void* data, int width, int height, Vec4<u8>* pixels);
+
+// Same as above, using the given implementation, which must be supported.
+void DecodeRGBA8Image(TextureDecoderImpl impl, const void* data, int width, int height, Vec4<u8>* pixels);
+
+// Whether the given copy format (GX_TF_X or GX_CTF_X) stores depth values
+bool IsDepthCopyFormat(u8 format);
+
+// Decode a single pixel of a color copy in the given format.
+// Stored channels are expanded to 8 bits by bit replication, channels which
+// the format doesn't store are 0. Intensity formats (I4, I8, IA4, IA8) store
+// a single value, which is returned in r, g and b. The opaque RGB555 encoding
+// of RGB5A3 returns an alpha of 255.
+Vec4<u8> DecodeCopyPixel(u8 format, const void* data, int x, int y, int width);
+
+// Decode a whole color copy in the given format, see DecodeRGBA8Image and
+// DecodeCopyPixel. width must not exceed 1024.
+void DecodeCopyImage(u8 format, const void* data, int width, int height, Vec4<u8>* pixels);
+void DecodeCopyImage(TextureDecoderImpl impl, u8 format, const void* data, int width, int height, Vec4<u8>* pixels);
+
+// Decode a single pixel of a depth copy in the given format to a 24 bit
+// depth value. Bits which the format doesn't store are 0, e.g. GX_CTF_Z8M
+// returns bits 8 to 15 of the depth value.
+u32 DecodeDepthPixel(u8 format, const void* data, int x, int y, int width);
+
+// Decode a whole depth copy in the given format, see DecodeDepthPixel.
+void DecodeDepthImage(u8 format, const void* data, int width, int height, u32* depth);
+void DecodeDepthImage(TextureDecoderImpl impl, u8 format, const void* data, int width, int height, u32* depth);
+
+} // namespace